@@ -228,6 +228,7 @@ class OpServerProxy::OpServerImpl {
                                               redis_password_);
                 started_=true;
             }
+            RedisProcessorExec::LoadScripts(to_ops_conn_.get());
             if (collector_) {
                 collector_->RedisUpdate(true);
                 redis_up_ = true;
@@ -2,6 +2,7 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <algorithm>
 #include <exception>
 #include <boost/bind.hpp>
 #include <boost/assign/list_of.hpp>
@@ -13,7 +14,9 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <base/bloom_filter.h>
 #include <base/logging.h>
+#include <base/string_util.h>
 #include <io/event_manager.h>
 #include <base/connection_info.h>
 #include <sandesh/sandesh_types.h>
@@ -57,7 +60,8 @@ DbHandler::DbHandler(EventManager *evm,
         const std::string& cassandra_user,
         const std::string& cassandra_password) :
     name_(name),
-    drop_level_(SandeshLevel::INVALID), ttl_map_(ttl_map), field_cache_t2_(0) {
+    drop_level_(SandeshLevel::INVALID), ttl_map_(ttl_map), field_cache_t2_(0),
+    partition_filter_t2_(0) {
         dbif_.reset(new ThriftIf(err_handler,
           cassandra_ips, cassandra_ports, name, false,
           cassandra_user, cassandra_password));
@@ -68,7 +72,7 @@ DbHandler::DbHandler(EventManager *evm,
 
 DbHandler::DbHandler(GenDb::GenDbIf *dbif, const TtlMap& ttl_map) :
     dbif_(dbif),
-    ttl_map_(ttl_map), field_cache_t2_(0) {
+    ttl_map_(ttl_map), field_cache_t2_(0), partition_filter_t2_(0) {
 }
 
 DbHandler::~DbHandler() {
@@ -374,30 +378,27 @@ bool DbHandler::AllowMessageTableInsert(const SandeshHeader &header) {
     return header.get_Type() != SandeshType::FLOW;
 }
 
-bool DbHandler::MessageIndexTableInsert(const std::string& cfname,
+bool DbHandler::MessageIndexRowKey(const std::string& cfname,
         const SandeshHeader& header,
         const std::string& message_type,
         const boost::uuids::uuid& unm,
-        const std::string keyword) {
-    std::auto_ptr<GenDb::ColList> col_list(new GenDb::ColList);
-    col_list->cfname_ = cfname;
-    // Rowkey
-    GenDb::DbDataValueVec& rowkey = col_list->rowkey_;
-    rowkey.reserve(8);
+        const std::string& keyword,
+        GenDb::DbDataValueVec *rowkey) {
+    rowkey->reserve(2);
     uint32_t T2(header.get_Timestamp() >> g_viz_constants.RowTimeInBits);
-    rowkey.push_back(T2);
+    rowkey->push_back(T2);
     if (cfname == g_viz_constants.MESSAGE_TABLE_SOURCE) {
-        rowkey.push_back(header.get_Source());
+        rowkey->push_back(header.get_Source());
     } else if (cfname == g_viz_constants.MESSAGE_TABLE_MODULE_ID) {
-        rowkey.push_back(header.get_Module());
+        rowkey->push_back(header.get_Module());
     } else if (cfname == g_viz_constants.MESSAGE_TABLE_CATEGORY) {
-        rowkey.push_back(header.get_Category());
+        rowkey->push_back(header.get_Category());
     } else if (cfname == g_viz_constants.MESSAGE_TABLE_MESSAGE_TYPE) {
-        rowkey.push_back(message_type);
+        rowkey->push_back(message_type);
     } else if (cfname == g_viz_constants.MESSAGE_TABLE_TIMESTAMP) {
     } else if (cfname == g_viz_constants.MESSAGE_TABLE_KEYWORD) {
         if (keyword.length())
-            rowkey.push_back(keyword);
+            rowkey->push_back(keyword);
         else
             return false;
     } else {
@@ -405,19 +406,36 @@ bool DbHandler::MessageIndexTableInsert(const std::string& cfname,
                 << message_type << ", message UUID: " << unm);
         return false;
     }
+    return true;
+}
+
+int DbHandler::MessageIndexTtl(const std::string& message_type) {
+    if (message_type == "VncApiConfigLog") {
+        return GetTtl(TtlType::CONFIGAUDIT_TTL);
+    }
+    return GetTtl(TtlType::GLOBAL_TTL);
+}
+
+bool DbHandler::MessageIndexTableInsert(const std::string& cfname,
+        const SandeshHeader& header,
+        const std::string& message_type,
+        const boost::uuids::uuid& unm,
+        const std::string keyword) {
+    std::auto_ptr<GenDb::ColList> col_list(new GenDb::ColList);
+    col_list->cfname_ = cfname;
+    // Rowkey
+    if (!MessageIndexRowKey(cfname, header, message_type, unm, keyword,
+            &col_list->rowkey_)) {
+        return false;
+    }
     // Columns
     GenDb::NewColVec& columns = col_list->columns_;
     columns.reserve(1);
     uint32_t T1(header.get_Timestamp() & g_viz_constants.RowTimeInMask);
     GenDb::DbDataValueVec *col_name(new GenDb::DbDataValueVec(1, T1));
     GenDb::DbDataValueVec *col_value(new GenDb::DbDataValueVec(1, unm));
-    int ttl;
-    if (message_type == "VncApiConfigLog") {
-        ttl = GetTtl(TtlType::CONFIGAUDIT_TTL);
-    } else {
-        ttl = GetTtl(TtlType::GLOBAL_TTL);
-    }
-    GenDb::NewCol *col(new GenDb::NewCol(col_name, col_value, ttl));
+    GenDb::NewCol *col(new GenDb::NewCol(col_name, col_value,
+        MessageIndexTtl(message_type)));
     columns.push_back(col);
     if (!dbif_->Db_AddColumn(col_list)) {
         DB_LOG(ERROR, "Addition of message: " << message_type <<
@@ -428,6 +446,143 @@ bool DbHandler::MessageIndexTableInsert(const std::string& cfname,
     return true;
 }
 
+/*
+ * Add the index column of a message to the index row it belongs to in
+ * the batch, creating the column list for the row on first use. Messages
+ * of a batch mostly share T2 and the source, module, category and message
+ * type, so the column list is sized for the whole batch.
+ */
+bool DbHandler::MessageIndexAdd(IndexRowMap *index_rows,
+        const std::string& cfname,
+        const SandeshHeader& header,
+        const std::string& message_type,
+        const boost::uuids::uuid& unm,
+        const std::string& keyword,
+        int ttl, size_t nmsgs) {
+    IndexRowKey key(cfname, GenDb::DbDataValueVec());
+    if (!MessageIndexRowKey(cfname, header, message_type, unm, keyword,
+            &key.second)) {
+        return false;
+    }
+    IndexRowMap::iterator it = index_rows->find(key);
+    if (it == index_rows->end()) {
+        GenDb::ColList *col_list(new GenDb::ColList);
+        col_list->cfname_ = cfname;
+        col_list->rowkey_ = key.second;
+        col_list->columns_.reserve(
+            cfname == g_viz_constants.MESSAGE_TABLE_KEYWORD ? 1 : nmsgs);
+        it = index_rows->insert(key, col_list).first;
+    }
+    uint32_t T1(header.get_Timestamp() & g_viz_constants.RowTimeInMask);
+    GenDb::DbDataValueVec *col_name(new GenDb::DbDataValueVec(1, T1));
+    GenDb::DbDataValueVec *col_value(new GenDb::DbDataValueVec(1, unm));
+    it->second->columns_.push_back(new GenDb::NewCol(col_name, col_value,
+        ttl));
+    return true;
+}
+
+/*
+ * Record that value was written to partition t2 of the index table cfname.
+ * A collector that writes to a partition creates its own filter for it,
+ * with a new column in the filter row, so that a filter is never
+ * overwritten with one holding fewer values, e.g. when a message arrives
+ * late for a partition whose filter was already written and dropped.
+ *
+ * Once kPartitionFilterMaxColumns filters were written for a partition,
+ * the values go to a column with the nil uuid instead, which is never
+ * sealed, so that the query engine always reads the partition. Partitions
+ * in the future do not count as the newest partition, as messages with
+ * future timestamps would otherwise seal the current partitions on every
+ * write.
+ */
+void DbHandler::PartitionFilterAdd(const std::string& cfname, uint32_t t2,
+        const std::string& value, int ttl) {
+    tbb::mutex::scoped_lock lock(filter_mutex_);
+    PartitionFilterKey key(cfname, t2);
+    PartitionFilterMap::iterator it = partition_filters_.find(key);
+    if (it == partition_filters_.end()) {
+        PartitionFilter *filter(new PartitionFilter);
+        uint32_t &count(partition_filter_counts_[key]);
+        if (count < kPartitionFilterMaxColumns) {
+            filter->id = umn_gen_();
+            count++;
+        } else {
+            filter->id = boost::uuids::nil_uuid();
+        }
+        filter->ttl = ttl;
+        filter->written = false;
+        it = partition_filters_.insert(key, filter).first;
+    }
+    it->second->values.insert(value);
+    it->second->ttl = std::max(it->second->ttl, ttl);
+    uint32_t now_t2 = UTCTimestampUsec() >> g_viz_constants.RowTimeInBits;
+    if (t2 > partition_filter_t2_ && t2 <= now_t2) {
+        partition_filter_t2_ = t2;
+        PartitionFilterCountMap::iterator cit =
+            partition_filter_counts_.begin();
+        while (cit != partition_filter_counts_.end()) {
+            if (cit->first.second + kPartitionFilterHistory <= t2) {
+                partition_filter_counts_.erase(cit++);
+            } else {
+                ++cit;
+            }
+        }
+    }
+}
+
+/*
+ * Write the partition filters, before the index columns that were added
+ * to them. The query engine only skips a partition if all the filters of
+ * the partition are sealed, so a new filter is first written as an empty,
+ * unsealed column, and then sealed with the Bloom filter of its values
+ * once no more values are expected for the partition.
+ */
+void DbHandler::PartitionFiltersWrite() {
+    tbb::mutex::scoped_lock lock(filter_mutex_);
+    PartitionFilterMap::iterator it = partition_filters_.begin();
+    while (it != partition_filters_.end()) {
+        if (it->first.second + kPartitionFilterPartitions <=
+                partition_filter_t2_) {
+            PartitionFilterWrite(it->first, *it->second, true);
+            partition_filters_.erase(it++);
+            continue;
+        }
+        if (!it->second->written) {
+            it->second->written =
+                PartitionFilterWrite(it->first, *it->second, false);
+        }
+        ++it;
+    }
+}
+
+bool DbHandler::PartitionFilterWrite(const PartitionFilterKey& key,
+        const PartitionFilter& filter, bool sealed) {
+    std::string value;
+    if (sealed && !filter.id.is_nil()) {
+        BloomFilter bloom(filter.values.size(), 0.01);
+        for (std::set<std::string>::const_iterator it = filter.values.begin();
+             it != filter.values.end(); ++it) {
+            bloom.Add(*it);
+        }
+        value = bloom.ToString();
+    }
+    std::auto_ptr<GenDb::ColList> col_list(new GenDb::ColList);
+    col_list->cfname_ = g_viz_constants.INDEX_PARTITION_FILTER_TABLE;
+    col_list->rowkey_.reserve(2);
+    col_list->rowkey_.push_back(key.second);
+    col_list->rowkey_.push_back(key.first);
+    GenDb::DbDataValueVec *col_name(new GenDb::DbDataValueVec(1, filter.id));
+    GenDb::DbDataValueVec *col_value(new GenDb::DbDataValueVec(1, value));
+    col_list->columns_.push_back(new GenDb::NewCol(col_name, col_value,
+        filter.ttl));
+    if (!dbif_->Db_AddColumn(col_list)) {
+        DB_LOG(ERROR, "Addition of partition filter for table: " <<
+                key.first << ", T2: " << key.second << " FAILED");
+        return false;
+    }
+    return true;
+}
+
 void DbHandler::MessageTableOnlyInsert(const VizMsg *vmsgp) {
     const SandeshHeader &header(vmsgp->msg->GetHeader());
     const std::string &message_type(vmsgp->msg->GetMessageType());
@@ -507,69 +662,109 @@ void DbHandler::MessageTableOnlyInsert(const VizMsg *vmsgp) {
 }
 
 void DbHandler::MessageTableInsert(const VizMsg *vmsgp) {
-    const SandeshHeader &header(vmsgp->msg->GetHeader());
-    const std::string &message_type(vmsgp->msg->GetMessageType());
+    std::vector<const VizMsg *> vmsgs(1, vmsgp);
+    MessageTableInsertBatch(vmsgs);
+}
 
-    if (!AllowMessageTableInsert(header))
-        return;
+/*
+ * Insert a batch of messages into the message table and build the index
+ * columns of all the messages in one pass, so that each index row touched
+ * by the batch is written with a single column list.
+ */
+void DbHandler::MessageTableInsertBatch(
+        const std::vector<const VizMsg *> &vmsgs) {
+    IndexRowMap index_rows;
+    for (std::vector<const VizMsg *>::const_iterator it = vmsgs.begin();
+         it != vmsgs.end(); ++it) {
+        const VizMsg *vmsgp(*it);
+        const SandeshHeader &header(vmsgp->msg->GetHeader());
+        const std::string &message_type(vmsgp->msg->GetMessageType());
 
-    MessageTableOnlyInsert(vmsgp);
-
-    MessageIndexTableInsert(g_viz_constants.MESSAGE_TABLE_SOURCE, header,
-            message_type, vmsgp->unm, "");
-    MessageIndexTableInsert(g_viz_constants.MESSAGE_TABLE_MODULE_ID, header,
-            message_type, vmsgp->unm, "");
-    MessageIndexTableInsert(g_viz_constants.MESSAGE_TABLE_CATEGORY, header,
-            message_type, vmsgp->unm, "");
-    MessageIndexTableInsert(g_viz_constants.MESSAGE_TABLE_MESSAGE_TYPE, header,
-            message_type, vmsgp->unm, "");
-    MessageIndexTableInsert(g_viz_constants.MESSAGE_TABLE_TIMESTAMP, header,
-            message_type, vmsgp->unm, "");
-
-    const SandeshType::type &stype(header.get_Type());
-    std::string s;
-
-    if (stype == SandeshType::SYSTEM) {
-        const SandeshXMLMessage *sxmsg =
-            static_cast<const SandeshXMLMessage *>(vmsgp->msg);
-        const pugi::xml_node &parent(sxmsg->GetMessageNode());
-        s = LineParser::GetXmlString(parent);
-    } else if (!vmsgp->keyword_doc_.empty()) {
-        s = std::string(vmsgp->keyword_doc_);
-    }
-    if (!s.empty()) {
-        LineParser::WordListType words = LineParser::ParseDoc(s.begin(),
-                s.end());
-        LineParser::RemoveStopWords(&words);
-        for (LineParser::WordListType::iterator i = words.begin();
-                i != words.end(); i++) {
-            // tableinsert@{(t2,*i), (t1,header.get_Source())} -> vmsgp->unm
-            bool r = MessageIndexTableInsert(
-                    g_viz_constants.MESSAGE_TABLE_KEYWORD, header,
-                    message_type, vmsgp->unm, *i);
-            if (!r)
-                DB_LOG(ERROR, "Failed to parse:" << s);
+        if (!AllowMessageTableInsert(header))
+            continue;
+
+        MessageTableOnlyInsert(vmsgp);
+
+        int ttl = MessageIndexTtl(message_type);
+        MessageIndexAdd(&index_rows, g_viz_constants.MESSAGE_TABLE_SOURCE,
+                header, message_type, vmsgp->unm, "", ttl, vmsgs.size());
+        MessageIndexAdd(&index_rows, g_viz_constants.MESSAGE_TABLE_MODULE_ID,
+                header, message_type, vmsgp->unm, "", ttl, vmsgs.size());
+        MessageIndexAdd(&index_rows, g_viz_constants.MESSAGE_TABLE_CATEGORY,
+                header, message_type, vmsgp->unm, "", ttl, vmsgs.size());
+        MessageIndexAdd(&index_rows,
+                g_viz_constants.MESSAGE_TABLE_MESSAGE_TYPE,
+                header, message_type, vmsgp->unm, "", ttl, vmsgs.size());
+        MessageIndexAdd(&index_rows, g_viz_constants.MESSAGE_TABLE_TIMESTAMP,
+                header, message_type, vmsgp->unm, "", ttl, vmsgs.size());
+
+        const SandeshType::type &stype(header.get_Type());
+        std::string s;
+
+        if (stype == SandeshType::SYSTEM) {
+            const SandeshXMLMessage *sxmsg =
+                static_cast<const SandeshXMLMessage *>(vmsgp->msg);
+            const pugi::xml_node &parent(sxmsg->GetMessageNode());
+            s = LineParser::GetXmlString(parent);
+        } else if (!vmsgp->keyword_doc_.empty()) {
+            s = std::string(vmsgp->keyword_doc_);
+        }
+        if (!s.empty()) {
+            uint32_t T2(header.get_Timestamp() >>
+                g_viz_constants.RowTimeInBits);
+            LineParser::WordListType words = LineParser::ParseDoc(s.begin(),
+                    s.end());
+            LineParser::RemoveStopWords(&words);
+            // A word repeated in the message is indexed once
+            std::sort(words.begin(), words.end());
+            words.erase(std::unique(words.begin(), words.end()), words.end());
+            for (LineParser::WordListType::iterator i = words.begin();
+                    i != words.end(); i++) {
+                // tableinsert@{(t2,*i), (t1,header.get_Source())} -> vmsgp->unm
+                bool r = MessageIndexAdd(&index_rows,
+                        g_viz_constants.MESSAGE_TABLE_KEYWORD, header,
+                        message_type, vmsgp->unm, *i, ttl, vmsgs.size());
+                if (!r) {
+                    DB_LOG(ERROR, "Failed to parse:" << s);
+                    continue;
+                }
+                PartitionFilterAdd(g_viz_constants.MESSAGE_TABLE_KEYWORD,
+                        T2, *i, ttl);
+            }
+        }
+
+        /*
+         * Insert the message types,module_id in the stat table
+         * Construct the atttributes,attrib_tags beofore inserting
+         * to the StatTableInsert
+         */
+        if ((stype == SandeshType::SYSLOG) || (stype == SandeshType::SYSTEM)) {
+            //Insert only if sandesh type is a SYSTEM LOG or SYSLOG
+            //Insert into the FieldNames stats table entries for Messagetype and Module ID
+            int field_ttl = GetTtl(TtlType::GLOBAL_TTL);
+            FieldNamesTableInsert(header.get_Timestamp(),
+                g_viz_constants.COLLECTOR_GLOBAL_TABLE,
+                ":Messagetype", message_type, field_ttl);
+            FieldNamesTableInsert(header.get_Timestamp(),
+                g_viz_constants.COLLECTOR_GLOBAL_TABLE,
+                ":ModuleId", header.get_Module(), field_ttl);
+            FieldNamesTableInsert(header.get_Timestamp(),
+                g_viz_constants.COLLECTOR_GLOBAL_TABLE,
+                ":Source", header.get_Source(), field_ttl);
         }
     }
 
-    /*
-     * Insert the message types,module_id in the stat table
-     * Construct the atttributes,attrib_tags beofore inserting
-     * to the StatTableInsert
-     */
-    if ((stype == SandeshType::SYSLOG) || (stype == SandeshType::SYSTEM)) {
-        //Insert only if sandesh type is a SYSTEM LOG or SYSLOG
-        //Insert into the FieldNames stats table entries for Messagetype and Module ID
-        int ttl = GetTtl(TtlType::GLOBAL_TTL);
-        FieldNamesTableInsert(header.get_Timestamp(),
-            g_viz_constants.COLLECTOR_GLOBAL_TABLE,
-            ":Messagetype", message_type, ttl);
-        FieldNamesTableInsert(header.get_Timestamp(),
-            g_viz_constants.COLLECTOR_GLOBAL_TABLE,
-            ":ModuleId", header.get_Module(), ttl);
-        FieldNamesTableInsert(header.get_Timestamp(),
-            g_viz_constants.COLLECTOR_GLOBAL_TABLE,
-            ":Source", header.get_Source(), ttl);
+    PartitionFiltersWrite();
+    while (!index_rows.empty()) {
+        IndexRowMap::iterator it = index_rows.begin();
+        std::string cfname(it->second->cfname_);
+        size_t ncols(it->second->columns_.size());
+        std::auto_ptr<GenDb::ColList> col_list(
+            index_rows.release(it).release());
+        if (!dbif_->Db_AddColumn(col_list)) {
+            DB_LOG(ERROR, "Addition of " << ncols << " message index " <<
+                    "columns to table: " << cfname << " FAILED");
+        }
     }
 }
 
@@ -590,7 +785,9 @@ void DbHandler::FieldNamesTableInsert(uint64_t timestamp,
     table_name.append(field_name);
 
     /* Check if fieldname and value were already seen in this T2
-       We only need to record them if they have NOT been seen yet */
+       We only need to record them if they have NOT been seen yet.
+       The entries of the previous T2 are kept as well, so that messages
+       arriving late across a T2 boundary do not record them again */
     bool record = false;
     std::string fc_entry(table_name);
     fc_entry.append(":");
@@ -598,14 +795,18 @@ void DbHandler::FieldNamesTableInsert(uint64_t timestamp,
     {
         tbb::mutex::scoped_lock lock(smutex_);
         if (temp_u32 > field_cache_t2_) {
+            if (temp_u32 == field_cache_t2_ + 1) {
+                field_cache_prev_set_.swap(field_cache_set_);
+            } else {
+                field_cache_prev_set_.clear();
+            }
             field_cache_set_.clear();
             field_cache_t2_ = temp_u32;
         }
         if (temp_u32 == field_cache_t2_) {
-            if (field_cache_set_.find(fc_entry) == field_cache_set_.end()) {
-                field_cache_set_.insert(fc_entry);
-                record = true;
-            }
+            record = field_cache_set_.insert(fc_entry).second;
+        } else if (temp_u32 + 1 == field_cache_t2_) {
+            record = field_cache_prev_set_.insert(fc_entry).second;
         } else {
             /* This is an old time-stamp */
             record = true;
@@ -1367,6 +1568,20 @@ bool DbHandler::FlowSampleAdd(const pugi::xml_node& flow_sample,
             this, timestamp, g_viz_constants.FLOW_SERIES_TABLE, _1,_2,_3);
     if (diff_bytes.which() != GenDb::DB_VALUE_BLANK &&
         diff_packets.which() != GenDb::DB_VALUE_BLANK) {
+       int ttl = GetTtl(TtlType::FLOWDATA_TTL);
+       GenDb::DbDataValue &sip(
+           flow_entry_values[FlowRecordFields::FLOWREC_SOURCEIP]);
+       if (sip.which() == GenDb::DB_VALUE_UINT32) {
+           PartitionFilterAdd(g_viz_constants.FLOW_TABLE_SVN_SIP, T2,
+               integerToString(boost::get<uint32_t>(sip)), ttl);
+       }
+       GenDb::DbDataValue &dip(
+           flow_entry_values[FlowRecordFields::FLOWREC_DESTIP]);
+       if (dip.which() == GenDb::DB_VALUE_UINT32) {
+           PartitionFilterAdd(g_viz_constants.FLOW_TABLE_DVN_DIP, T2,
+               integerToString(boost::get<uint32_t>(dip)), ttl);
+       }
+       PartitionFiltersWrite();
        if (!PopulateFlowIndexTables(flow_entry_values, T2, T1, partition_no,
                 dbif_.get(), ttl_map_, fncb2)) {
            DB_LOG(ERROR, "Populating FlowIndexTables FAILED");
@@ -103,6 +103,7 @@ public:
         const SandeshHeader& header, const std::string& message_type,
         const boost::uuids::uuid& unm, const std::string keyword);
     virtual void MessageTableInsert(const VizMsg *vmsgp);
+    void MessageTableInsertBatch(const std::vector<const VizMsg *> &vmsgs);
     void MessageTableOnlyInsert(const VizMsg *vmsgp);
     void FieldNamesTableInsert(uint64_t timestamp,
         const std::string& table_name,
@@ -160,6 +161,37 @@ private:
         const std::string& jsonline, int ttl);
     bool FlowSampleAdd(const pugi::xml_node& flowdata,
         const SandeshHeader& header);
+    // Message index rows of a batch, keyed by column family and row key
+    typedef std::pair<std::string, GenDb::DbDataValueVec> IndexRowKey;
+    typedef boost::ptr_map<IndexRowKey, GenDb::ColList> IndexRowMap;
+    bool MessageIndexRowKey(const std::string& cfname,
+        const SandeshHeader& header, const std::string& message_type,
+        const boost::uuids::uuid& unm, const std::string& keyword,
+        GenDb::DbDataValueVec *rowkey);
+    int MessageIndexTtl(const std::string& message_type);
+    bool MessageIndexAdd(IndexRowMap *index_rows, const std::string& cfname,
+        const SandeshHeader& header, const std::string& message_type,
+        const boost::uuids::uuid& unm, const std::string& keyword,
+        int ttl, size_t nmsgs);
+    // Values written to a partition (T2) of an index table, kept until the
+    // partition is kPartitionFilterPartitions older than the newest one and
+    // written as a Bloom filter to INDEX_PARTITION_FILTER_TABLE
+    struct PartitionFilter {
+        boost::uuids::uuid id;
+        std::set<std::string> values;
+        int ttl;
+        bool written;
+    };
+    typedef std::pair<std::string, uint32_t> PartitionFilterKey;
+    typedef boost::ptr_map<PartitionFilterKey, PartitionFilter>
+        PartitionFilterMap;
+    // Number of filter columns written for each recent partition
+    typedef std::map<PartitionFilterKey, uint32_t> PartitionFilterCountMap;
+    void PartitionFilterAdd(const std::string& cfname, uint32_t t2,
+        const std::string& value, int ttl);
+    void PartitionFiltersWrite();
+    bool PartitionFilterWrite(const PartitionFilterKey& key,
+        const PartitionFilter& filter, bool sealed);
     uint64_t GetTtl(TtlType::type type) {
         return GetTtlFromMap(ttl_map_, type);
     }
@@ -177,6 +209,17 @@ private:
     TtlMap ttl_map_;
     uint32_t field_cache_t2_;
     std::set<std::string> field_cache_set_;
+    std::set<std::string> field_cache_prev_set_;
+    static const uint32_t kPartitionFilterPartitions = 4;
+    // At most kPartitionFilterMaxColumns filters are written for a
+    // partition, further values go to a single column that is never
+    // sealed. Counts are kept for kPartitionFilterHistory partitions.
+    static const uint32_t kPartitionFilterMaxColumns = 16;
+    static const uint32_t kPartitionFilterHistory = 256;
+    tbb::mutex filter_mutex_;
+    PartitionFilterMap partition_filters_;
+    PartitionFilterCountMap partition_filter_counts_;
+    uint32_t partition_filter_t2_;
  
     DISALLOW_COPY_AND_ASSIGN(DbHandler);
 };
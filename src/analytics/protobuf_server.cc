@@ -2,6 +2,8 @@
 // Copyright (c) 2014 Juniper Networks, Inc. All rights reserved.
 //
 
+#include <string.h>
+#include <algorithm>
 #include <utility>
 #include <string>
 #include <vector>
@@ -12,6 +14,8 @@
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh.h>
@@ -35,6 +39,7 @@ using ::google::protobuf::DescriptorPool;
 using ::google::protobuf::DynamicMessageFactory;
 using ::google::protobuf::Message;
 using ::google::protobuf::Reflection;
+using ::google::protobuf::io::CodedInputStream;
 
 using std::make_pair;
 
@@ -43,6 +48,7 @@ namespace protobuf {
 namespace impl {
 
 ProtobufReader::ProtobufReader() {
+    prototype_cache_ = NULL;
 }
 
 ProtobufReader::~ProtobufReader() {
@@ -52,26 +58,76 @@ const Message* ProtobufReader::GetPrototype(const Descriptor *mdesc) {
     return dmf_.GetPrototype(mdesc);
 }
 
-bool ProtobufReader::ParseSelfDescribingMessage(const uint8_t *data,
-    size_t size, uint64_t *timestamp, Message **msg,
-    ParseFailureCallback parse_failure_cb) {
-    // Parse the SelfDescribingMessage from data
-    SelfDescribingMessage sdm_message;
-    bool success = sdm_message.ParseFromArray(data, size);
-    if (!success) {
-        if (!parse_failure_cb.empty()) {
-	    parse_failure_cb("Unknown");
+// Fingerprint of the serialized FileDescriptorSet and the type name, hashed
+// a word at a time. Cached entries with the same fingerprint are compared
+// byte for byte, so collisions only cost a comparison.
+static uint64_t Fingerprint(const uint8_t *proto_files, int proto_files_size,
+    const std::string &type_name) {
+    static const uint64_t kPrime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL ^ proto_files_size;
+    int i = 0;
+    for (; i + 8 <= proto_files_size; i += 8) {
+        uint64_t word;
+        memcpy(&word, proto_files + i, sizeof(word));
+        hash = (hash ^ word) * kPrime;
+    }
+    for (; i < proto_files_size; i++) {
+        hash = (hash ^ proto_files[i]) * kPrime;
+    }
+    for (size_t j = 0; j < type_name.size(); j++) {
+        hash = (hash ^ static_cast<uint8_t>(type_name[j])) * kPrime;
+    }
+    return hash;
+}
+
+bool ProtobufReader::CachedPrototypeLess(const CachedPrototype *lhs,
+    uint64_t fingerprint) {
+    return lhs->fingerprint < fingerprint;
+}
+
+const Message *ProtobufReader::FindPrototype(const PrototypeCache *cache,
+    uint64_t fingerprint, const uint8_t *proto_files, int proto_files_size,
+    const std::string &type_name) const {
+    if (cache == NULL) {
+        return NULL;
+    }
+    for (PrototypeCache::const_iterator it = std::lower_bound(cache->begin(),
+             cache->end(), fingerprint, CachedPrototypeLess);
+         it != cache->end() && (*it)->fingerprint == fingerprint; ++it) {
+        const CachedPrototype *cached(*it);
+        if (cached->type_name == type_name &&
+            cached->proto_files.size() == (size_t) proto_files_size &&
+            memcmp(cached->proto_files.data(), proto_files,
+                   proto_files_size) == 0) {
+            return cached->prototype;
         }
-        LOG(ERROR, "SelfDescribingMessage: Parsing FAILED");
-        return false;
     }
-    *timestamp = sdm_message.timestamp();
-    const std::string &msg_type(sdm_message.type_name());
+    return NULL;
+}
+
+const Message *ProtobufReader::BuildPrototype(uint64_t fingerprint,
+    const uint8_t *proto_files, int proto_files_size,
+    const std::string &msg_type, ParseFailureCallback parse_failure_cb) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    // Another thread may have resolved it while we waited for the lock
+    const PrototypeCache *cache(prototype_cache_);
+    const Message *msg_proto(FindPrototype(cache, fingerprint, proto_files,
+        proto_files_size, msg_type));
+    if (msg_proto != NULL) {
+        return msg_proto;
+    }
     // Extract the FileDescriptorProto and populate the Descriptor pool
-    const FileDescriptorSet &fds(sdm_message.proto_files());
+    FileDescriptorSet fds;
+    if (!fds.ParseFromArray(proto_files, proto_files_size)) {
+        if (!parse_failure_cb.empty()) {
+            parse_failure_cb(msg_type);
+        }
+        LOG(ERROR, "SelfDescribingMessage: " << msg_type <<
+            ": FileDescriptorSet Parsing FAILED");
+        return NULL;
+    }
     for (int i = 0; i < fds.file_size(); i++) {
         const FileDescriptorProto &fdp(fds.file(i));
-        tbb::mutex::scoped_lock lock(mutex_);
         const FileDescriptor *fd(dpool_.BuildFile(fdp));
         if (fd == NULL) {
             if (!parse_failure_cb.empty()) {
@@ -79,9 +135,8 @@ bool ProtobufReader::ParseSelfDescribingMessage(const uint8_t *data,
             }
             LOG(ERROR, "SelfDescribingMessage: " << msg_type <<
                 ": DescriptorPool BuildFile(" << i << ") FAILED");
-            return false;
+            return NULL;
         }
-        lock.release();
     }
     // Extract the Descriptor
     const Descriptor *mdesc = dpool_.FindMessageTypeByName(msg_type);
@@ -91,24 +146,128 @@ bool ProtobufReader::ParseSelfDescribingMessage(const uint8_t *data,
         }
         LOG(ERROR, "SelfDescribingMessage: " << msg_type << ": Descriptor " <<
             "not FOUND");
-        return false;
+        return NULL;
     }
-    // Parse the message.
-    const Message* msg_proto = GetPrototype(mdesc);
+    msg_proto = GetPrototype(mdesc);
     if (msg_proto == NULL) {
         if (!parse_failure_cb.empty()) {
             parse_failure_cb(msg_type);
         }
         LOG(ERROR, msg_type << ": Prototype FAILED");
+        return NULL;
+    }
+    // Publish a new cache with the prototype added
+    size_t count(cache != NULL ? cache->size() : 0);
+    if (count < kMaxCachedPrototypes) {
+        CachedPrototype *cached(new CachedPrototype);
+        cached->fingerprint = fingerprint;
+        cached->proto_files.assign(
+            reinterpret_cast<const char *>(proto_files), proto_files_size);
+        cached->type_name = msg_type;
+        cached->prototype = msg_proto;
+        cached_prototypes_.push_back(cached);
+        PrototypeCache *ncache(new PrototypeCache);
+        ncache->reserve(count + 1);
+        if (cache != NULL) {
+            ncache->assign(cache->begin(), cache->end());
+        }
+        ncache->insert(std::lower_bound(ncache->begin(), ncache->end(),
+            fingerprint, CachedPrototypeLess), cached);
+        prototype_caches_.push_back(ncache);
+        prototype_cache_ = ncache;
+    }
+    return msg_proto;
+}
+
+//
+// Walk the fields of the SelfDescribingMessage without parsing the
+// FileDescriptorSet, which is only needed when the prototype for it is not
+// cached yet.
+//
+const Message *ProtobufReader::ResolvePrototype(const uint8_t *data,
+    size_t size, uint64_t *timestamp, const uint8_t **message_data,
+    int *message_data_size, ParseFailureCallback parse_failure_cb) {
+    using ::google::protobuf::internal::WireFormatLite;
+    CodedInputStream input(data, size);
+    const uint8_t *proto_files(NULL);
+    int proto_files_size(0);
+    std::string msg_type;
+    bool has_timestamp(false), has_type_name(false), has_message_data(false);
+    bool success(true);
+    uint32_t tag;
+    while (success && (tag = input.ReadTag()) != 0) {
+        int field(WireFormatLite::GetTagFieldNumber(tag));
+        WireFormatLite::WireType wire_type(
+            WireFormatLite::GetTagWireType(tag));
+        if (field == SelfDescribingMessage::kTimestampFieldNumber &&
+            wire_type == WireFormatLite::WIRETYPE_VARINT) {
+            success = input.ReadVarint64(
+                reinterpret_cast< ::google::protobuf::uint64 *>(timestamp));
+            has_timestamp = true;
+        } else if (field == SelfDescribingMessage::kTypeNameFieldNumber &&
+            wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            uint32_t length;
+            success = input.ReadVarint32(&length) &&
+                input.ReadString(&msg_type, length);
+            has_type_name = true;
+        } else if ((field == SelfDescribingMessage::kProtoFilesFieldNumber ||
+            field == SelfDescribingMessage::kMessageDataFieldNumber) &&
+            wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            uint32_t length;
+            success = input.ReadVarint32(&length);
+            if (success) {
+                const uint8_t *start(data + input.CurrentPosition());
+                success = input.Skip(length);
+                if (field == SelfDescribingMessage::kProtoFilesFieldNumber) {
+                    proto_files = start;
+                    proto_files_size = length;
+                } else {
+                    *message_data = start;
+                    *message_data_size = length;
+                    has_message_data = true;
+                }
+            }
+        } else {
+            success = WireFormatLite::SkipField(&input, tag);
+        }
+    }
+    if (!success || input.CurrentPosition() != (int) size ||
+        !has_timestamp || !has_type_name || !has_message_data) {
+        if (!parse_failure_cb.empty()) {
+            parse_failure_cb("Unknown");
+        }
+        LOG(ERROR, "SelfDescribingMessage: Parsing FAILED");
+        return NULL;
+    }
+    uint64_t fingerprint(Fingerprint(proto_files, proto_files_size,
+        msg_type));
+    const Message *msg_proto(FindPrototype(prototype_cache_, fingerprint,
+        proto_files, proto_files_size, msg_type));
+    if (msg_proto != NULL) {
+        return msg_proto;
+    }
+    return BuildPrototype(fingerprint, proto_files, proto_files_size,
+        msg_type, parse_failure_cb);
+}
+
+bool ProtobufReader::ParseSelfDescribingMessage(const uint8_t *data,
+    size_t size, uint64_t *timestamp, Message **msg,
+    ParseFailureCallback parse_failure_cb) {
+    const uint8_t *message_data(NULL);
+    int message_data_size(0);
+    const Message *msg_proto(ResolvePrototype(data, size, timestamp,
+        &message_data, &message_data_size, parse_failure_cb));
+    if (msg_proto == NULL) {
         return false;
     }
+    // Parse the message.
     *msg = msg_proto->New();
-    success = (*msg)->ParseFromString(sdm_message.message_data());
+    bool success = (*msg)->ParseFromArray(message_data, message_data_size);
     if (!success) {
         if (!parse_failure_cb.empty()) {
-            parse_failure_cb(msg_type);
+            parse_failure_cb(msg_proto->GetTypeName());
         }
-        LOG(ERROR, msg_type << ": Parsing FAILED");
+        LOG(ERROR, msg_proto->GetTypeName() << ": Parsing FAILED");
         delete *msg;
         *msg = NULL;
         return false;
@@ -116,6 +275,41 @@ bool ProtobufReader::ParseSelfDescribingMessage(const uint8_t *data,
     return true;
 }
 
+bool ProtobufReader::ReadSelfDescribingMessage(const uint8_t *data,
+    size_t size, uint64_t *timestamp, const Message **msg,
+    ParseFailureCallback parse_failure_cb) {
+    const uint8_t *message_data(NULL);
+    int message_data_size(0);
+    const Message *msg_proto(ResolvePrototype(data, size, timestamp,
+        &message_data, &message_data_size, parse_failure_cb));
+    if (msg_proto == NULL) {
+        return false;
+    }
+    // Parse the message into the instance of this thread.
+    MessageMap &messages(messages_.local());
+    MessageMap::iterator it = messages.find(msg_proto);
+    if (it == messages.end()) {
+        it = messages.insert(std::make_pair(msg_proto,
+            boost::shared_ptr<Message>(msg_proto->New()))).first;
+    }
+    Message *message(it->second.get());
+    if (!message->ParseFromArray(message_data, message_data_size)) {
+        if (!parse_failure_cb.empty()) {
+            parse_failure_cb(msg_proto->GetTypeName());
+        }
+        LOG(ERROR, msg_proto->GetTypeName() << ": Parsing FAILED");
+        *msg = NULL;
+        return false;
+    }
+    *msg = message;
+    return true;
+}
+
+size_t ProtobufReader::CachedPrototypeCount() const {
+    const PrototypeCache *cache(prototype_cache_);
+    return cache != NULL ? cache->size() : 0;
+}
+
 void PopulateProtobufTopLevelTags(const Message& message,
     const boost::asio::ip::udp::endpoint &remote_endpoint,
     StatWalker::TagMap *top_tags) {
@@ -450,9 +644,9 @@ class ProtobufServer::ProtobufServerImpl {
         virtual void OnRead(boost::asio::const_buffer &recv_buffer,
             const boost::asio::ip::udp::endpoint &remote_endpoint) {
             uint64_t timestamp;
-            Message *message = NULL;
+            const Message *message = NULL;
             size_t recv_buffer_size(boost::asio::buffer_size(recv_buffer));
-            if (!reader_.ParseSelfDescribingMessage(
+            if (!reader_.ReadSelfDescribingMessage(
                     boost::asio::buffer_cast<const uint8_t *>(recv_buffer),
                     recv_buffer_size, &timestamp,
                     &message, boost::bind(&MessageStatistics::UpdateRxFail,
@@ -467,7 +661,6 @@ class ProtobufServer::ProtobufServerImpl {
             const std::string &message_name(message->GetTypeName());
             msg_stats_.UpdateRx(remote_endpoint, message_name,
                 recv_buffer_size);
-            delete message;
             DeallocateBuffer(recv_buffer);
         }
 
@@ -5,6 +5,13 @@
 #ifndef ANALYTICS_PROTOBUF_SERVER_IMPL_H_
 #define ANALYTICS_PROTOBUF_SERVER_IMPL_H_
 
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/atomic.h>
+#include <tbb/enumerable_thread_specific.h>
 #include <tbb/mutex.h>
 
 #include <google/protobuf/descriptor.h>
@@ -16,15 +23,35 @@
 namespace protobuf {
 namespace impl {
 
+//
+// ProtobufReader
+//
+// Resolving the message type of a SelfDescribingMessage requires building
+// its FileDescriptorSet into the descriptor pool, which is done under a
+// lock. Exporters send the same FileDescriptorSet with every message, so
+// the prototype resolved for a FileDescriptorSet and type name is cached,
+// keyed by a fingerprint of the serialized FileDescriptorSet. The cache is
+// an immutable sorted vector that is replaced on insert, so lookups on the
+// hit path take no lock and the FileDescriptorSet is not even parsed.
+//
 class ProtobufReader {
  public:
     typedef boost::function<void(
         const std::string &message_name)> ParseFailureCallback;
+    static const size_t kMaxCachedPrototypes = 64;
+
     ProtobufReader();
     virtual ~ProtobufReader();
+    // The message is allocated and owned by the caller.
     virtual bool ParseSelfDescribingMessage(const uint8_t *data, size_t size,
         uint64_t *timestamp, ::google::protobuf::Message **msg,
         ParseFailureCallback cb);
+    // The message is owned by the reader and is reused for the next
+    // message of the same type read on the calling thread.
+    bool ReadSelfDescribingMessage(const uint8_t *data, size_t size,
+        uint64_t *timestamp, const ::google::protobuf::Message **msg,
+        ParseFailureCallback cb);
+    size_t CachedPrototypeCount() const;
 
  protected:
     virtual const ::google::protobuf::Message* GetPrototype(
@@ -33,9 +60,39 @@ class ProtobufReader {
  private:
     friend class ProtobufReaderTest;
 
+    struct CachedPrototype {
+        uint64_t fingerprint;
+        std::string proto_files;
+        std::string type_name;
+        const ::google::protobuf::Message *prototype;
+    };
+    typedef std::vector<const CachedPrototype *> PrototypeCache;
+    typedef std::map<const ::google::protobuf::Message *,
+        boost::shared_ptr< ::google::protobuf::Message> > MessageMap;
+
+    static bool CachedPrototypeLess(const CachedPrototype *lhs,
+        uint64_t fingerprint);
+    const ::google::protobuf::Message *ResolvePrototype(const uint8_t *data,
+        size_t size, uint64_t *timestamp, const uint8_t **message_data,
+        int *message_data_size, ParseFailureCallback cb);
+    const ::google::protobuf::Message *FindPrototype(
+        const PrototypeCache *cache, uint64_t fingerprint,
+        const uint8_t *proto_files, int proto_files_size,
+        const std::string &type_name) const;
+    const ::google::protobuf::Message *BuildPrototype(uint64_t fingerprint,
+        const uint8_t *proto_files, int proto_files_size,
+        const std::string &type_name, ParseFailureCallback cb);
+
     tbb::mutex mutex_;
     ::google::protobuf::DescriptorPool dpool_;
     ::google::protobuf::DynamicMessageFactory dmf_;
+    // Lookups load prototype_cache_ without holding mutex_; replaced
+    // caches are kept until the reader is destroyed since a lookup may
+    // still be using them.
+    tbb::atomic<const PrototypeCache *> prototype_cache_;
+    boost::ptr_vector<PrototypeCache> prototype_caches_;
+    boost::ptr_vector<CachedPrototype> cached_prototypes_;
+    tbb::enumerable_thread_specific<MessageMap> messages_;
 };
 
 void ProcessProtobufMessage(const ::google::protobuf::Message& message,
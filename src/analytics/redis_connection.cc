@@ -4,8 +4,10 @@
 
 #include "redis_connection.h"
 
+#include <cstring>
 #include <tbb/mutex.h>
 #include <boost/bind.hpp>
+#include <boost/uuid/sha1.hpp>
 #include "base/util.h"
 #include "base/logging.h"
 #include "base/parse_object.h"
@@ -17,6 +19,19 @@
 using std::string;
 using std::vector;
 
+RedisScript::RedisScript(const unsigned char *body, unsigned int len) :
+    body_(reinterpret_cast<const char *>(body), len) {
+    boost::uuids::detail::sha1 sha1;
+    sha1.process_bytes(body_.data(), body_.size());
+    unsigned int digest[5];
+    sha1.get_digest(digest);
+    char hex[41];
+    for (int i = 0; i < 5; i++) {
+        snprintf(&hex[i * 8], 9, "%08x", digest[i]);
+    }
+    sha1_.assign(hex, 40);
+}
+
 RedisAsyncConnection::RAC_CbFnsMap RedisAsyncConnection::rac_cb_fns_map_;
 tbb::mutex RedisAsyncConnection::rac_cb_fns_map_mutex_;
 
@@ -31,11 +46,14 @@ RedisAsyncConnection::RedisAsyncConnection(EventManager *evm, const std::string
     callbackNull_(0),
     callbackFailed_(0),
     callbackSucceeded_(0),
+    scriptFallbacks_(0),
     context_(NULL),
     state_(REDIS_ASYNC_CONNECTION_INIT),
     reconnect_timer_(*evm->io_service()),
     client_connect_cb_(client_connect_cb),
-    client_disconnect_cb_(client_disconnect_cb) {
+    client_disconnect_cb_(client_disconnect_cb),
+    script_cmds_in_flight_(0),
+    script_cmds_unresolved_(0) {
     boost::system::error_code ec;
     boost::asio::ip::address redis_addr(
         boost::asio::ip::address::from_string(hostname_, ec));
@@ -63,6 +81,7 @@ RedisAsyncConnection::~RedisAsyncConnection() {
       }
       redisAsyncFree(context_);
     }    
+    ClearScriptState();
     reconnect_timer_.cancel(ec);
 }
 
@@ -158,6 +177,7 @@ void RedisAsyncConnection::RAC_DisconnectCallbackProcess(const struct redisAsync
         context_ = NULL;
         client_.reset();
       }
+    ClearScriptState();
 
     if (client_disconnect_cb_)
         client_disconnect_cb_();
@@ -290,23 +310,30 @@ bool RedisAsyncConnection::RedisAsyncArgCmd(void *rpi,
         callDisconnected_++;
         return false;
     }
+    return SendArgCmd(RedisAsyncConnection::RAC_AsyncCmdCallback, rpi, args);
+}
 
+bool RedisAsyncConnection::SendArgCmd(redisCallbackFn *fn, void *privdata,
+        const vector<string> &args) {
     int argc = args.size();
     const char** argv = new const char* [argc];
+    size_t* argvlen = new size_t [argc];
     for (uint i=0; i < args.size(); i++) {
         argv[i] = args[i].c_str();
+        argvlen[i] = args[i].size();
     }
     bool status = false;
     int ret;
 
     ret = redisAsyncCommandArgv(context_,
-            RedisAsyncConnection::RAC_AsyncCmdCallback,
-            rpi,
+            fn,
+            privdata,
             argc,
             argv,
-            NULL);
+            argvlen);
 
     delete[] argv;
+    delete[] argvlen;
 
     if (REDIS_ERR == ret) {
         LOG(INFO, "Could NOT apply " << args[0] << " to Redis : ");
@@ -318,6 +345,136 @@ bool RedisAsyncConnection::RedisAsyncArgCmd(void *rpi,
     return status;
 }
 
+bool RedisAsyncConnection::RedisAsyncScriptLoad(const RedisScript &script) {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    if (state_ != REDIS_ASYNC_CONNECTION_CONNECTED) {
+        callDisconnected_++;
+        return false;
+    }
+    return SendScriptLoad(script);
+}
+
+bool RedisAsyncConnection::RedisAsyncScriptCmd(void *rpi,
+        const RedisScript &script, const vector<string> &args) {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    if (state_ != REDIS_ASYNC_CONNECTION_CONNECTED) {
+        callDisconnected_++;
+        return false;
+    }
+    ScriptCmd *cmd = new ScriptCmd(this, rpi, &script, args);
+    if (script_cmds_unresolved_) {
+        pending_script_cmds_.push_back(cmd);
+        return true;
+    }
+    if (!SendScriptCmd(cmd)) {
+        delete cmd;
+        return false;
+    }
+    return true;
+}
+
+bool RedisAsyncConnection::SendScriptLoad(const RedisScript &script) {
+    vector<string> args;
+    args.push_back("SCRIPT");
+    args.push_back("LOAD");
+    args.push_back(script.body());
+    if (!SendArgCmd(RedisAsyncConnection::RAC_AsyncCmdCallback, NULL,
+                    args)) {
+        return false;
+    }
+    loaded_scripts_.insert(std::make_pair(script.sha1(), &script));
+    return true;
+}
+
+// The SCRIPT LOAD is pipelined ahead of the first EVALSHA of the script,
+// so the EVALSHA only fails if the script cache is flushed under us. The
+// scripts should be loaded up front with RedisAsyncScriptLoad: loading one
+// later could let its commands run ahead of older commands that failed.
+bool RedisAsyncConnection::SendScriptCmd(ScriptCmd *cmd) {
+    vector<string> args;
+    args.reserve(cmd->args.size() + 2);
+    if (cmd->eval) {
+        args.push_back("EVAL");
+        args.push_back(cmd->script->body());
+    } else {
+        if (loaded_scripts_.find(cmd->script->sha1()) ==
+                loaded_scripts_.end() && !SendScriptLoad(*cmd->script)) {
+            return false;
+        }
+        args.push_back("EVALSHA");
+        args.push_back(cmd->script->sha1());
+    }
+    args.insert(args.end(), cmd->args.begin(), cmd->args.end());
+    if (!SendArgCmd(RedisAsyncConnection::RAC_AsyncScriptCmdCallback, cmd,
+                    args)) {
+        return false;
+    }
+    if (!cmd->eval) {
+        script_cmds_in_flight_++;
+    }
+    return true;
+}
+
+// Returns true if the reply is consumed here, i.e. the command has been
+// resent with EVAL or dropped because it could not be resent.
+bool RedisAsyncConnection::ScriptCmdReply(ScriptCmd *cmd,
+        const redisReply *reply) {
+    if (cmd->eval) {
+        return false;
+    }
+    assert(script_cmds_in_flight_ > 0);
+    script_cmds_in_flight_--;
+    bool consumed = false;
+    if (reply && reply->type == REDIS_REPLY_ERROR &&
+        strncmp(reply->str, "NOSCRIPT", 8) == 0) {
+        if (script_cmds_unresolved_ == 0) {
+            LOG(INFO, "Redis script cache flushed, resending with EVAL");
+            script_cmds_unresolved_ = script_cmds_in_flight_ + 1;
+        }
+        scriptFallbacks_++;
+        cmd->eval = true;
+        if (!SendScriptCmd(cmd)) {
+            RAC_StatUpdate(NULL);
+            delete cmd;
+        }
+        consumed = true;
+    }
+    if (script_cmds_unresolved_ && --script_cmds_unresolved_ == 0) {
+        // Reload all the scripts before the held commands are sent
+        std::map<std::string, const RedisScript *> scripts;
+        scripts.swap(loaded_scripts_);
+        for (std::map<std::string, const RedisScript *>::const_iterator it =
+             scripts.begin(); it != scripts.end(); ++it) {
+            SendScriptLoad(*it->second);
+        }
+        while (!pending_script_cmds_.empty()) {
+            ScriptCmd *pending = pending_script_cmds_.front();
+            pending_script_cmds_.pop_front();
+            if (!SendScriptCmd(pending)) {
+                delete pending;
+            }
+        }
+    }
+    return consumed;
+}
+
+void RedisAsyncConnection::RAC_AsyncScriptCmdCallback(redisAsyncContext *c,
+        void *r, void *privdata) {
+    ScriptCmd *cmd = reinterpret_cast<ScriptCmd *>(privdata);
+    if (cmd->rac->ScriptCmdReply(cmd, reinterpret_cast<redisReply *>(r))) {
+        return;
+    }
+    RedisAsyncConnection::RAC_AsyncCmdCallback(c, r, cmd->rpi);
+    delete cmd;
+}
+
+void RedisAsyncConnection::ClearScriptState() {
+    STLDeleteValues(&pending_script_cmds_);
+    loaded_scripts_.clear();
+    script_cmds_unresolved_ = 0;
+}
 
 bool RedisAsyncConnection::RedisAsyncCommand(void *rpi, const char *format, ...) {
     tbb::mutex::scoped_lock lock(mutex_);
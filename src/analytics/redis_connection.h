@@ -5,7 +5,10 @@
 #ifndef __REDIS_CONNECTION__H__
 #define __REDIS_CONNECTION__H__
 
+#include <deque>
+#include <map>
 #include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
@@ -15,6 +18,21 @@
 #include "hiredis/boostasio.hpp"
 #include "io/event_manager.h"
 
+/*
+ * Lua script that is run with EVALSHA, keyed by the SHA1 of its body
+ */
+class RedisScript {
+public:
+    RedisScript(const unsigned char *body, unsigned int len);
+
+    const std::string &body() const { return body_; }
+    const std::string &sha1() const { return sha1_; }
+
+private:
+    std::string body_;
+    std::string sha1_;
+};
+
 /*
  * Class for maintaining an async connection to Redis, aka RAC - redis async connection
  */
@@ -56,6 +74,13 @@ public:
     bool SetClientAsyncCmdCb(ClientAsyncCmdCbFn cb_fn);
     bool RedisAsyncCommand(void *rpi, const char *format, ...);
     bool RedisAsyncArgCmd(void *rpi, const std::vector<std::string> &args);
+    // Run the script with EVALSHA; args are numkeys followed by the keys
+    // and arguments. The script is loaded on the connection before its
+    // first use, and the command is resent with EVAL if Redis replies
+    // NOSCRIPT, without reordering it with respect to later commands.
+    bool RedisAsyncScriptCmd(void *rpi, const RedisScript &script,
+                             const std::vector<std::string> &args);
+    bool RedisAsyncScriptLoad(const RedisScript &script);
     void RAC_StatUpdate(const redisReply *reply);
 
     static RAC_CbFnsMap& rac_cb_fns_map() {
@@ -69,6 +94,7 @@ public:
     uint64_t CallbackNull() { return callbackNull_; }
     uint64_t CallbackFailed() { return callbackFailed_; }
     uint64_t CallbackSucceeded() { return callbackSucceeded_; }
+    uint64_t ScriptFallbacks() { return scriptFallbacks_; }
 
     boost::asio::ip::tcp::endpoint Endpoint() const { return endpoint_; }
 private:
@@ -89,6 +115,7 @@ private:
     uint64_t callbackNull_;
     uint64_t callbackFailed_;
     uint64_t callbackSucceeded_;
+    uint64_t scriptFallbacks_;
 
     redisAsyncContext *context_;
     //boost::scoped_ptr<redisBoostClient> client_;
@@ -124,6 +151,40 @@ private:
     /* async command callback related fields */
     static void RAC_AsyncCmdCallback(redisAsyncContext *c, void *r, void *privdata);
 
+    /*
+     * Script commands are tracked until their reply is received. Once a
+     * NOSCRIPT reply is seen, the EVALSHA commands sent before it are
+     * unresolved: each of them is resent with EVAL if it also fails, and
+     * new script commands are held in pending_script_cmds_ until all of
+     * them have replied, so that the commands run in the order they were
+     * issued. All of this runs with mutex_ held.
+     */
+    struct ScriptCmd {
+        ScriptCmd(RedisAsyncConnection *rac, void *rpi,
+                  const RedisScript *script,
+                  const std::vector<std::string> &args) :
+            rac(rac), rpi(rpi), script(script), args(args), eval(false) {
+        }
+        RedisAsyncConnection *rac;
+        void *rpi;
+        const RedisScript *script;
+        std::vector<std::string> args;
+        bool eval;
+    };
+    static void RAC_AsyncScriptCmdCallback(redisAsyncContext *c, void *r,
+                                           void *privdata);
+    bool SendArgCmd(redisCallbackFn *fn, void *privdata,
+                    const std::vector<std::string> &args);
+    bool SendScriptLoad(const RedisScript &script);
+    bool SendScriptCmd(ScriptCmd *cmd);
+    bool ScriptCmdReply(ScriptCmd *cmd, const redisReply *reply);
+    void ClearScriptState();
+
+    std::map<std::string, const RedisScript *> loaded_scripts_;
+    std::deque<ScriptCmd *> pending_script_cmds_;
+    size_t script_cmds_in_flight_;
+    size_t script_cmds_unresolved_;
+
     static RAC_CbFnsMap rac_cb_fns_map_;
     static tbb::mutex rac_cb_fns_map_mutex_;
 
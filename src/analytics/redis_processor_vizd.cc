@@ -2,6 +2,8 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <cstring>
+
 #include "base/logging.h"
 #include "base/contrail-globals.h"
 #include "base/string_util.h"
@@ -24,6 +26,48 @@ using std::map;
 using std::make_pair;
 using boost::assign::list_of;
 
+static const RedisScript uveupdate_script(uveupdate_lua, uveupdate_lua_len);
+static const RedisScript uvedelete_script(uvedelete_lua, uvedelete_lua_len);
+static const RedisScript seqnum_script(seqnum_lua, seqnum_lua_len);
+static const RedisScript delrequest_script(delrequest_lua,
+                                           delrequest_lua_len);
+
+// Run a script on a synchronous connection with EVALSHA, and with EVAL if
+// it is not in the script cache.
+static redisReply *
+SyncScriptCommand(redisContext *c, const RedisScript &script,
+                  const vector<string> &args) {
+    vector<const char *> argv;
+    vector<size_t> argvlen;
+    argv.push_back("EVALSHA");
+    argvlen.push_back(7);
+    argv.push_back(script.sha1().c_str());
+    argvlen.push_back(script.sha1().size());
+    for (size_t i = 0; i < args.size(); i++) {
+        argv.push_back(args[i].c_str());
+        argvlen.push_back(args[i].size());
+    }
+    redisReply *reply = (redisReply *) redisCommandArgv(c, argv.size(),
+        &argv[0], &argvlen[0]);
+    if (reply && reply->type == REDIS_REPLY_ERROR &&
+        strncmp(reply->str, "NOSCRIPT", 8) == 0) {
+        freeReplyObject(reply);
+        argv[0] = "EVAL";
+        argvlen[0] = 4;
+        argv[1] = script.body().c_str();
+        argvlen[1] = script.body().size();
+        reply = (redisReply *) redisCommandArgv(c, argv.size(), &argv[0],
+            &argvlen[0]);
+    }
+    return reply;
+}
+
+void
+RedisProcessorExec::LoadScripts(RedisAsyncConnection *rac) {
+    rac->RedisAsyncScriptLoad(uveupdate_script);
+    rac->RedisAsyncScriptLoad(uvedelete_script);
+}
+
 bool
 RedisProcessorExec::UVEUpdate(RedisAsyncConnection * rac, RedisProcessorIf *rpi,
                        const std::string &type, const std::string &attr,
@@ -46,9 +90,8 @@ RedisProcessorExec::UVEUpdate(RedisAsyncConnection * rac, RedisProcessorIf *rpi,
     const std::string origin_index(is_alarm ? "ALARM_ORIGINS:" : "ORIGINS:");
 
     {
-        string lua_scr(reinterpret_cast<char *>(uveupdate_lua), uveupdate_lua_len);
-        ret = rac->RedisAsyncArgCmd(rpi,
-            list_of(string("EVAL"))(lua_scr)("5")(
+        ret = rac->RedisAsyncScriptCmd(rpi, uveupdate_script,
+            list_of(string("5"))(
                 string("TYPES:") + source + ":" + node_type + ":" + module + ":" + instance_id)(
                 origin_index + key)(
                 table_index + table)(
@@ -78,9 +121,8 @@ RedisProcessorExec::UVEDelete(RedisAsyncConnection * rac, RedisProcessorIf *rpi,
     const std::string table_index(is_alarm ? "ALARM_TABLE:" : "TABLE:");
     const std::string origin_index(is_alarm ? "ALARM_ORIGINS:" : "ORIGINS:");
 
-    string lua_scr(reinterpret_cast<char *>(uvedelete_lua), uvedelete_lua_len);
-    return rac->RedisAsyncArgCmd(rpi,
-        list_of(string("EVAL"))(lua_scr)("6")(
+    return rac->RedisAsyncScriptCmd(rpi, uvedelete_script,
+        list_of(string("6"))(
             string("DEL:") + key + ":" + source + ":" + node_type + ":" +
             module + ":" + instance_id + ":" + type + ":" + seqstr.str())(
             string("VALUES:") + key + ":" + source + ":" + node_type + ":" + 
@@ -126,12 +168,9 @@ RedisProcessorExec::SyncGetSeq(const std::string & redis_ip, unsigned short redi
     }
  
 
-    string lua_scr(reinterpret_cast<char *>(seqnum_lua), seqnum_lua_len);
-
-    redisReply * reply = (redisReply *) redisCommand(c, 
-            "EVAL %s 0 %s %s %s %s %s",
-            lua_scr.c_str(), source.c_str(), node_type.c_str(),
-            module.c_str(), instance_id.c_str(), integerToString(REDIS_DB_UVE).c_str());
+    redisReply * reply = SyncScriptCommand(c, seqnum_script,
+            list_of(string("0"))(source)(node_type)(module)(instance_id)(
+                integerToString(REDIS_DB_UVE)));
 
     if (!reply) {
         LOG(INFO, "SeqQuery Error : " << c->errstr);
@@ -191,12 +230,9 @@ RedisProcessorExec::SyncDeleteUVEs(const std::string & redis_ip, unsigned short
         freeReplyObject(reply);
     }
  
-    string lua_scr(reinterpret_cast<char *>(delrequest_lua), delrequest_lua_len);
-
-    redisReply * reply = (redisReply *) redisCommand(c, 
-            "EVAL %s 0 %s %s %s %s %s",
-            lua_scr.c_str(), source.c_str(), node_type.c_str(),
-            module.c_str(), instance_id.c_str(), integerToString(REDIS_DB_UVE).c_str());
+    redisReply * reply = SyncScriptCommand(c, delrequest_script,
+            list_of(string("0"))(source)(node_type)(module)(instance_id)(
+                integerToString(REDIS_DB_UVE)));
 
     if (!reply) {
         LOG(ERROR, "SyncDeleteUVEs failed for " << generator << " : " <<
@@ -17,6 +17,10 @@ class RedisProcessorIf;
 
 class RedisProcessorExec {
 public:
+    // Load the UVE scripts into the Redis script cache, so that UVEUpdate
+    // and UVEDelete can run them with EVALSHA.
+    static void LoadScripts(RedisAsyncConnection *rac);
+
     static bool
     UVEUpdate(RedisAsyncConnection * rac, RedisProcessorIf *rpi,
                        const std::string &type, const std::string &attr,
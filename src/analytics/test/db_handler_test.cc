@@ -18,6 +18,7 @@
 #include "thrift_if_mock.h"
 #include "../vizd_table_desc.h"
 #include "sandesh/common/flow_types.h"
+#include "base/bloom_filter.h"
 
 using ::testing::Return;
 using ::testing::Field;
@@ -28,6 +29,7 @@ using ::testing::Eq;
 using ::testing::ElementsAre;
 using ::testing::Pointee;
 using ::testing::ElementsAreArray;
+using ::testing::Invoke;
 using namespace pugi;
 using namespace GenDb;
 
@@ -102,8 +104,44 @@ protected:
         static SandeshXMLMessageTestBuilder instance_;
     };
 
+    struct PartitionFilterColumn {
+        GenDb::DbDataValueVec rowkey;
+        boost::uuids::uuid id;
+        std::string value;
+    };
+
+    bool PartitionFilterWrite(GenDb::ColList *cl) {
+        EXPECT_EQ(1, cl->columns_.size());
+        PartitionFilterColumn column;
+        column.rowkey = cl->rowkey_;
+        column.id = boost::get<boost::uuids::uuid>(
+            cl->columns_[0].name->at(0));
+        column.value = boost::get<std::string>(cl->columns_[0].value->at(0));
+        partition_filters_.push_back(column);
+        return true;
+    }
+
+    void MessageInsert(uint64_t timestamp, const std::string &text) {
+        SandeshHeader hdr;
+        hdr.set_Source("127.0.0.1");
+        hdr.set_Module("VizdTest");
+        hdr.set_Timestamp(timestamp);
+        hdr.set_Type(SandeshType::SYSTEM);
+        std::string xmlmessage = "<SandeshAsyncTest2 type=\"sandesh\"><f1 type=\"string\" identifier=\"1\">" + text + "</f1></SandeshAsyncTest2>";
+        SandeshXMLMessageTest *msg = dynamic_cast<SandeshXMLMessageTest *>(
+            builder_->Create(
+                reinterpret_cast<const uint8_t *>(xmlmessage.c_str()),
+                xmlmessage.size()));
+        msg->SetHeader(hdr);
+        VizMsg vmsgp(msg, rgen_());
+        db_handler()->MessageTableInsert(&vmsgp);
+        vmsgp.msg = NULL;
+        delete msg;
+    }
+
     SandeshMessageBuilder *builder_;
     boost::uuids::random_generator rgen_;
+    std::vector<PartitionFilterColumn> partition_filters_;
 
 private:
     void DbErrorHandlerFn() {
@@ -344,6 +382,18 @@ TEST_F(DbHandlerTest, MessageTableInsertTest) {
         .Times(2)
         .WillRepeatedly(Return(true));
 
+    GenDb::DbDataValueVec filter_rowkey;
+    filter_rowkey.push_back((uint32_t)(hdr.get_Timestamp() >> g_viz_constants.RowTimeInBits));
+    filter_rowkey.push_back(g_viz_constants.MESSAGE_TABLE_KEYWORD);
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    AllOf(Field(&GenDb::ColList::cfname_, g_viz_constants.INDEX_PARTITION_FILTER_TABLE),
+                        Field(&GenDb::ColList::rowkey_, filter_rowkey),
+                        _))))
+        .Times(1)
+        .WillOnce(Return(true));
+
     EXPECT_CALL(*dbif_mock(),
             Db_AddColumnProxy(
                 Pointee(
@@ -358,6 +408,185 @@ TEST_F(DbHandlerTest, MessageTableInsertTest) {
     delete msg;
 }
 
+// The index columns of the messages of a batch that share an index row are
+// written with a single column list, and the FieldNames entries are only
+// written for the first message.
+TEST_F(DbHandlerTest, MessageTableInsertBatchTest) {
+    uint64_t T2(UTCTimestampUsec() >> g_viz_constants.RowTimeInBits);
+    std::string xmlmessage = "<SandeshAsyncTest2 type=\"sandesh\"><f2 type=\"i32\" identifier=\"2\">101</f2></SandeshAsyncTest2>";
+    std::vector<SandeshXMLMessageTest *> msgs;
+    boost::ptr_vector<VizMsg> vmsgs;
+    std::vector<const VizMsg *> batch;
+    boost::ptr_vector<GenDb::NewCol> idx_expected_vector;
+    for (int i = 0; i < 2; i++) {
+        SandeshHeader hdr;
+        hdr.set_Source("127.0.0.1");
+        hdr.set_Module("VizdTest");
+        hdr.set_Timestamp((T2 << g_viz_constants.RowTimeInBits) + i * 1000);
+        hdr.set_Type(SandeshType::SYSLOG);
+        SandeshXMLMessageTest *msg = dynamic_cast<SandeshXMLMessageTest *>(
+            builder_->Create(
+                reinterpret_cast<const uint8_t *>(xmlmessage.c_str()),
+                xmlmessage.size()));
+        msg->SetHeader(hdr);
+        msgs.push_back(msg);
+        VizMsg *vmsgp(new VizMsg(msg, rgen_()));
+        vmsgs.push_back(vmsgp);
+        batch.push_back(vmsgp);
+        idx_expected_vector.push_back(new GenDb::NewCol(
+            new DbDataValueVec(1, (uint32_t)(hdr.get_Timestamp() &
+                g_viz_constants.RowTimeInMask)),
+            new DbDataValueVec(1, vmsgp->unm), 0));
+    }
+
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    Field(&GenDb::ColList::cfname_,
+                        g_viz_constants.COLLECTOR_GLOBAL_TABLE))))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+
+    GenDb::DbDataValueVec src_idx_rowkey;
+    src_idx_rowkey.push_back((uint32_t)T2);
+    src_idx_rowkey.push_back(std::string("127.0.0.1"));
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    AllOf(Field(&GenDb::ColList::cfname_, g_viz_constants.MESSAGE_TABLE_SOURCE),
+                        Field(&GenDb::ColList::rowkey_, src_idx_rowkey),
+                        Field(&GenDb::ColList::columns_,
+                            idx_expected_vector)))))
+        .Times(1)
+        .WillOnce(Return(true));
+
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    AllOf(Field(&GenDb::ColList::cfname_,
+                            AnyOf(g_viz_constants.MESSAGE_TABLE_MODULE_ID,
+                                  g_viz_constants.MESSAGE_TABLE_CATEGORY,
+                                  g_viz_constants.MESSAGE_TABLE_MESSAGE_TYPE,
+                                  g_viz_constants.MESSAGE_TABLE_TIMESTAMP)),
+                        _,
+                        Field(&GenDb::ColList::columns_,
+                            idx_expected_vector)))))
+        .Times(4)
+        .WillRepeatedly(Return(true));
+
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    AllOf(Field(&GenDb::ColList::cfname_, g_viz_constants.STATS_TABLE_BY_STR_TAG),
+                        _,
+                        _))))
+        .Times(6)
+        .WillRepeatedly(Return(true));
+
+    db_handler()->MessageTableInsertBatch(batch);
+    for (size_t i = 0; i < msgs.size(); i++) {
+        vmsgs[i].msg = NULL;
+        delete msgs[i];
+    }
+}
+
+// The partition filter of a partition of the keyword index is written
+// empty (unsealed) with the first keyword of the partition, and sealed with
+// the Bloom filter of all its keywords once a message arrives 4 partitions
+// later. A message that arrives late for a sealed partition creates a new
+// filter for it, in a new column.
+TEST_F(DbHandlerTest, PartitionFilterTest) {
+    uint64_t T2((UTCTimestampUsec() >> g_viz_constants.RowTimeInBits) - 8);
+    EXPECT_CALL(*dbif_mock(), Db_AddColumnProxy(_))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    Field(&GenDb::ColList::cfname_,
+                        g_viz_constants.INDEX_PARTITION_FILTER_TABLE))))
+        .WillRepeatedly(Invoke(this, &DbHandlerTest::PartitionFilterWrite));
+
+    GenDb::DbDataValueVec rowkey;
+    rowkey.push_back((uint32_t)T2);
+    rowkey.push_back(g_viz_constants.MESSAGE_TABLE_KEYWORD);
+
+    MessageInsert(T2 << g_viz_constants.RowTimeInBits, "alpha beta");
+    ASSERT_EQ(1, partition_filters_.size());
+    EXPECT_EQ(rowkey, partition_filters_[0].rowkey);
+    EXPECT_EQ("", partition_filters_[0].value);
+
+    MessageInsert((T2 << g_viz_constants.RowTimeInBits) + 1000, "gamma");
+    MessageInsert((T2 + 3) << g_viz_constants.RowTimeInBits, "delta");
+    ASSERT_EQ(2, partition_filters_.size());
+
+    MessageInsert((T2 + 4) << g_viz_constants.RowTimeInBits, "epsilon");
+    ASSERT_EQ(4, partition_filters_.size());
+    EXPECT_EQ(rowkey, partition_filters_[2].rowkey);
+    EXPECT_EQ(partition_filters_[0].id, partition_filters_[2].id);
+    BloomFilter filter;
+    ASSERT_TRUE(filter.FromString(partition_filters_[2].value));
+    EXPECT_TRUE(filter.MayContain("alpha"));
+    EXPECT_TRUE(filter.MayContain("beta"));
+    EXPECT_TRUE(filter.MayContain("gamma"));
+    EXPECT_FALSE(filter.MayContain("delta"));
+    EXPECT_EQ("", partition_filters_[3].value);
+
+    MessageInsert((T2 << g_viz_constants.RowTimeInBits) + 2000, "zeta");
+    ASSERT_EQ(5, partition_filters_.size());
+    EXPECT_EQ(rowkey, partition_filters_[4].rowkey);
+    EXPECT_NE(partition_filters_[0].id, partition_filters_[4].id);
+    ASSERT_TRUE(filter.FromString(partition_filters_[4].value));
+    EXPECT_TRUE(filter.MayContain("zeta"));
+}
+
+// Late messages for a partition create at most 16 filters for it, the
+// values of later ones go to a column with the nil uuid which is never
+// sealed. Messages from the future do not seal the current partitions.
+TEST_F(DbHandlerTest, PartitionFilterLimitTest) {
+    uint64_t now_t2(UTCTimestampUsec() >> g_viz_constants.RowTimeInBits);
+    uint64_t T2(now_t2 - 8);
+    EXPECT_CALL(*dbif_mock(), Db_AddColumnProxy(_))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*dbif_mock(),
+            Db_AddColumnProxy(
+                Pointee(
+                    Field(&GenDb::ColList::cfname_,
+                        g_viz_constants.INDEX_PARTITION_FILTER_TABLE))))
+        .WillRepeatedly(Invoke(this, &DbHandlerTest::PartitionFilterWrite));
+
+    MessageInsert(T2 << g_viz_constants.RowTimeInBits, "alpha");
+    MessageInsert((T2 + 4) << g_viz_constants.RowTimeInBits, "beta");
+    for (int i = 0; i < 20; i++) {
+        MessageInsert((T2 << g_viz_constants.RowTimeInBits) + i, "gamma");
+    }
+    std::set<boost::uuids::uuid> ids;
+    size_t nil_columns = 0;
+    for (size_t i = 0; i < partition_filters_.size(); i++) {
+        if (boost::get<uint32_t>(partition_filters_[i].rowkey.at(0)) != T2)
+            continue;
+        if (partition_filters_[i].id.is_nil()) {
+            EXPECT_EQ("", partition_filters_[i].value);
+            nil_columns++;
+        } else {
+            ids.insert(partition_filters_[i].id);
+        }
+    }
+    EXPECT_EQ(16, ids.size());
+    EXPECT_EQ(5, nil_columns);
+
+    partition_filters_.clear();
+    MessageInsert(now_t2 << g_viz_constants.RowTimeInBits, "delta");
+    MessageInsert((now_t2 + 100) << g_viz_constants.RowTimeInBits,
+                  "epsilon");
+    MessageInsert((now_t2 << g_viz_constants.RowTimeInBits) + 1, "zeta");
+    for (size_t i = 0; i < partition_filters_.size(); i++) {
+        if (boost::get<uint32_t>(partition_filters_[i].rowkey.at(0)) >=
+                now_t2) {
+            EXPECT_EQ("", partition_filters_[i].value);
+        }
+    }
+}
+
 TEST_F(DbHandlerTest, ObjectTableInsertTest) {
     SandeshHeader hdr;
     hdr.set_Timestamp(UTCTimestampUsec());
@@ -556,6 +785,16 @@ TEST_F(DbHandlerTest, FlowTableInsertTest) {
 	    .WillRepeatedly(Return(true));
     }
 
+    // The first flow sample creates the partition filters of the source
+    // and destination IP index tables
+    EXPECT_CALL(*dbif_mock(),
+        Db_AddColumnProxy(
+            Pointee(
+                Field(&GenDb::ColList::cfname_,
+                      g_viz_constants.INDEX_PARTITION_FILTER_TABLE))))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+
     std::vector<std::pair<std::string, std::vector<FlowDataIpv4> > >::
         const_iterator fit;
     for (fit = flow_msgs.begin(); fit != flow_msgs.end(); fit++) {
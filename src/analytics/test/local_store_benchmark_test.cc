@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+//
+// End to end benchmark of the collector write path and the query engine
+// read path against the embedded local store, without Cassandra.
+//
+
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/random_generator.hpp>
+
+#include "testing/gunit.h"
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/time_util.h"
+#include "sandesh/sandesh_types.h"
+#include "sandesh/sandesh.h"
+#include "sandesh/sandesh_message_builder.h"
+#include "database/local/local_store_if.h"
+#include "../viz_constants.h"
+#include "../vizd_table_desc.h"
+#include "../db_handler.h"
+#include "query_engine/query.h"
+
+using namespace pugi;
+
+static const int kMessages = 10000;
+static const int kStatSamples = 10000;
+static const int kSources = 8;
+static const size_t kBatchSize = 64;
+// Partitions (T2) of the sparse keyword benchmark, within the maximum time
+// slice of a query, messages per partition, and interval between the
+// partitions with the sparse keyword
+static const int kFilterPartitions = 96;
+static const int kFilterMessages = 256;
+static const int kSparseInterval = 32;
+
+//
+// Store opened by the query engine that hides the partition filters, as if
+// the collector had not written them.
+//
+class NoPartitionFilterStoreIf : public LocalStoreIf {
+public:
+    explicit NoPartitionFilterStoreIf(const std::string &path) :
+        LocalStoreIf(path, true, "QueryEngine") {
+    }
+
+    virtual bool Db_GetMultiRow(GenDb::ColListVec& ret,
+            const std::string& cfname,
+            const std::vector<GenDb::DbDataValueVec>& key,
+            GenDb::ColumnNameRange *crange_ptr = NULL) {
+        if (cfname == g_viz_constants.INDEX_PARTITION_FILTER_TABLE) {
+            return true;
+        }
+        return LocalStoreIf::Db_GetMultiRow(ret, cfname, key, crange_ptr);
+    }
+};
+
+class LocalStoreBenchmarkTest : public ::testing::Test {
+public:
+    LocalStoreBenchmarkTest() :
+        ttl_map_(g_viz_constants.TtlValuesDefault) {
+    }
+
+    virtual void SetUp() {
+        char path[] = "/tmp/local_store_benchmark_test.XXXXXX";
+        ASSERT_TRUE(mkdtemp(path) != NULL);
+        path_ = path;
+        db_handler_.reset(new DbHandler(
+            new LocalStoreIf(path_, false, "Collector"), ttl_map_));
+        ASSERT_TRUE(db_handler_->Init(true, -1));
+    }
+
+    virtual void TearDown() {
+        db_handler_.reset();
+        std::string command("rm -rf " + path_);
+        EXPECT_EQ(0, system(command.c_str()));
+    }
+
+protected:
+    class SandeshXMLMessageTest : public SandeshXMLMessage {
+    public:
+        SandeshXMLMessageTest() {}
+        virtual ~SandeshXMLMessageTest() {}
+
+        virtual bool Parse(const uint8_t *xml_msg, size_t size) {
+            xml_parse_result result = xdoc_.load_buffer(xml_msg, size,
+                parse_default & ~parse_escapes);
+            if (!result) {
+                return false;
+            }
+            message_node_ = xdoc_.first_child();
+            message_type_ = message_node_.name();
+            size_ = size;
+            return true;
+        }
+
+        void SetHeader(const SandeshHeader &header) { header_ = header; }
+    };
+
+    static std::string Source(int index) {
+        return "10.1.1." + integerToString(index % kSources + 1);
+    }
+
+    void CreateMessages(uint64_t start_ts,
+                        std::vector<SandeshXMLMessageTest *> *msgs,
+                        boost::ptr_vector<VizMsg> *vmsgs) {
+        boost::uuids::random_generator rgen;
+        for (int i = 0; i < kMessages; i++) {
+            SandeshHeader hdr;
+            hdr.set_Source(Source(i));
+            hdr.set_Module("VizdTest");
+            hdr.set_InstanceId("0");
+            hdr.set_NodeType("Test");
+            hdr.set_Type(SandeshType::SYSLOG);
+            hdr.set_Timestamp(start_ts + i * 1000);
+            std::string xmlmessage("<SandeshAsyncTest2 type=\"sandesh\">"
+                "<f2 type=\"i32\" identifier=\"2\">" + integerToString(i) +
+                "</f2></SandeshAsyncTest2>");
+            SandeshXMLMessageTest *msg = new SandeshXMLMessageTest;
+            msg->Parse(reinterpret_cast<const uint8_t *>(xmlmessage.c_str()),
+                       xmlmessage.size());
+            msg->SetHeader(hdr);
+            msgs->push_back(msg);
+            vmsgs->push_back(new VizMsg(msg, rgen()));
+        }
+    }
+
+    // Messages over kFilterPartitions partitions starting at start_t2. The
+    // first message of each partition has the keyword "everywhere", and
+    // the first message of every kSparseInterval'th partition also has the
+    // keyword "sparse".
+    void InsertKeywordMessages(uint32_t start_t2) {
+        std::vector<SandeshXMLMessageTest *> msgs;
+        boost::ptr_vector<VizMsg> vmsgs;
+        boost::uuids::random_generator rgen;
+        for (int p = 0; p < kFilterPartitions; p++) {
+            for (int i = 0; i < kFilterMessages; i++) {
+                SandeshHeader hdr;
+                hdr.set_Source(Source(i));
+                hdr.set_Module("VizdTest");
+                hdr.set_InstanceId("0");
+                hdr.set_NodeType("Test");
+                hdr.set_Type(SandeshType::SYSTEM);
+                hdr.set_Timestamp((static_cast<uint64_t>(start_t2 + p) <<
+                    g_viz_constants.RowTimeInBits) + i * 1000);
+                std::string text("request " +
+                    integerToString(p * kFilterMessages + i) + " completed");
+                if (i == 0) {
+                    text += " everywhere";
+                    if (p % kSparseInterval == 0) {
+                        text += " sparse";
+                    }
+                }
+                std::string xmlmessage("<SandeshAsyncTest2 type=\"sandesh\">"
+                    "<f1 type=\"string\" identifier=\"1\">" + text +
+                    "</f1></SandeshAsyncTest2>");
+                SandeshXMLMessageTest *msg = new SandeshXMLMessageTest;
+                msg->Parse(
+                    reinterpret_cast<const uint8_t *>(xmlmessage.c_str()),
+                    xmlmessage.size());
+                msg->SetHeader(hdr);
+                msgs.push_back(msg);
+                vmsgs.push_back(new VizMsg(msg, rgen()));
+            }
+        }
+        std::vector<const VizMsg *> batch;
+        for (size_t i = 0; i < vmsgs.size(); i++) {
+            batch.push_back(&vmsgs[i]);
+            if (batch.size() == kBatchSize || i == vmsgs.size() - 1) {
+                db_handler_->MessageTableInsertBatch(batch);
+                batch.clear();
+            }
+        }
+        DeleteMessages(&msgs);
+    }
+
+    static void DeleteMessages(std::vector<SandeshXMLMessageTest *> *msgs) {
+        for (size_t i = 0; i < msgs->size(); i++) {
+            delete msgs->at(i);
+        }
+        msgs->clear();
+    }
+
+    // Insert the messages one at a time, as the rule engine does, or in
+    // batches of batch_size messages; returns the insert time.
+    uint64_t InsertMessages(uint64_t start_ts, size_t batch_size) {
+        std::vector<SandeshXMLMessageTest *> msgs;
+        boost::ptr_vector<VizMsg> vmsgs;
+        CreateMessages(start_ts, &msgs, &vmsgs);
+        uint64_t start = UTCTimestampUsec();
+        std::vector<const VizMsg *> batch;
+        batch.reserve(batch_size);
+        for (size_t i = 0; i < vmsgs.size(); i++) {
+            if (batch_size <= 1) {
+                db_handler_->MessageTableInsert(&vmsgs[i]);
+                continue;
+            }
+            batch.push_back(&vmsgs[i]);
+            if (batch.size() == batch_size || i == vmsgs.size() - 1) {
+                db_handler_->MessageTableInsertBatch(batch);
+                batch.clear();
+            }
+        }
+        uint64_t usecs = UTCTimestampUsec() - start;
+        DeleteMessages(&msgs);
+        return usecs;
+    }
+
+    void InsertStats(uint64_t start_ts) {
+        for (int i = 0; i < kStatSamples; i++) {
+            DbHandler::Var name(Source(i));
+            DbHandler::Var pifindex(static_cast<uint64_t>(i % 64));
+            DbHandler::AttribMap amap;
+            amap.insert(std::make_pair("name", name));
+            amap.insert(std::make_pair("flow.pifindex", pifindex));
+            DbHandler::TagMap tmap;
+            DbHandler::AttribMap amap_name_pifindex;
+            amap_name_pifindex.insert(std::make_pair("flow.pifindex",
+                                                     pifindex));
+            tmap.insert(std::make_pair("name", std::make_pair(name,
+                amap_name_pifindex)));
+            db_handler_->StatTableInsert(start_ts + i * 1000, "UFlowData",
+                                         "flow", tmap, amap);
+        }
+    }
+
+    // The query engine opens the store read-only, as it would open a
+    // separate connection to the database.
+    GenDb::GenDbIf *CreateQueryDbIf(bool partition_filters) {
+        LocalStoreIf *dbif = partition_filters ?
+            new LocalStoreIf(path_, true, "QueryEngine") :
+            new NoPartitionFilterStoreIf(path_);
+        EXPECT_TRUE(dbif->Db_Init("qe::DbHandler", -1));
+        EXPECT_TRUE(dbif->Db_SetTablespace(
+            g_viz_constants.COLLECTOR_KEYSPACE));
+        std::vector<GenDb::NewCf> tables(vizd_tables);
+        tables.insert(tables.end(), vizd_flow_tables.begin(),
+                      vizd_flow_tables.end());
+        tables.insert(tables.end(), vizd_stat_tables.begin(),
+                      vizd_stat_tables.end());
+        for (std::vector<GenDb::NewCf>::const_iterator it = tables.begin();
+             it != tables.end(); ++it) {
+            EXPECT_TRUE(dbif->Db_UseColumnfamily(*it));
+        }
+        dbif->Db_SetInitDone(true);
+        return dbif;
+    }
+
+    AnalyticsQuery *RunQuery(const std::map<std::string, std::string> &json,
+                             uint64_t *usecs, bool partition_filters = true) {
+        uint64_t start = UTCTimestampUsec();
+        AnalyticsQuery *query = new AnalyticsQuery("local-store-benchmark",
+            CreateQueryDbIf(partition_filters), json, ttl_map_, 0, 1);
+        EXPECT_EQ(QUERY_SUCCESS, query->process_query());
+        *usecs = UTCTimestampUsec() - start;
+        return query;
+    }
+
+    static std::map<std::string, std::string> Query(const std::string &table,
+            uint64_t start_ts, uint64_t end_ts, const std::string &select,
+            const std::string &where) {
+        std::map<std::string, std::string> json;
+        json["table"] = "\"" + table + "\"";
+        json["start_time"] = integerToString(start_ts);
+        json["end_time"] = integerToString(end_ts);
+        json["select_fields"] = select;
+        if (!where.empty()) {
+            json["where"] = where;
+        }
+        return json;
+    }
+
+    TtlMap ttl_map_;
+    std::string path_;
+    std::auto_ptr<DbHandler> db_handler_;
+};
+
+TEST_F(LocalStoreBenchmarkTest, MessageTable) {
+    uint64_t start_ts = UTCTimestampUsec() - 60 * 1000000ULL;
+    uint64_t insert_usecs = InsertMessages(start_ts, 1);
+    uint64_t end_ts = start_ts + kMessages * 1000;
+
+    uint64_t all_usecs;
+    std::auto_ptr<AnalyticsQuery> all(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\", \"ModuleId\", \"Messagetype\"]", ""),
+        &all_usecs));
+    ASSERT_TRUE(all->final_result.get() != NULL);
+    EXPECT_EQ(kMessages, all->final_result->size());
+
+    uint64_t source_usecs;
+    std::auto_ptr<AnalyticsQuery> source(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\", \"Messagetype\"]",
+        "[[{\"name\":\"Source\", \"value\":\"" + Source(0) +
+        "\", \"op\":1}]]"), &source_usecs));
+    ASSERT_TRUE(source->final_result.get() != NULL);
+    EXPECT_EQ(kMessages / kSources, source->final_result->size());
+
+    std::cout << "MessageTableInsert " << kMessages << " messages: "
+              << insert_usecs / 1000 << " msec; query all "
+              << all_usecs / 1000 << " msec; query by Source "
+              << source_usecs / 1000 << " msec" << std::endl;
+}
+
+// Messages per second on a single core, inserting one message at a time
+// and in batches, with all the index columns of a batch built in one pass.
+TEST_F(LocalStoreBenchmarkTest, MessageTableInsertBatch) {
+    uint64_t start_ts = UTCTimestampUsec() - 120 * 1000000ULL;
+    uint64_t single_usecs = InsertMessages(start_ts, 1);
+    uint64_t batch_start_ts = start_ts + kMessages * 1000;
+    uint64_t batch_usecs = InsertMessages(batch_start_ts, kBatchSize);
+    uint64_t end_ts = batch_start_ts + kMessages * 1000;
+
+    uint64_t all_usecs;
+    std::auto_ptr<AnalyticsQuery> all(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\"]", ""), &all_usecs));
+    ASSERT_TRUE(all->final_result.get() != NULL);
+    EXPECT_EQ(2 * kMessages, all->final_result->size());
+
+    uint64_t source_usecs;
+    std::auto_ptr<AnalyticsQuery> source(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, batch_start_ts, end_ts,
+        "[\"MessageTS\", \"Source\"]",
+        "[[{\"name\":\"Source\", \"value\":\"" + Source(0) +
+        "\", \"op\":1}]]"), &source_usecs));
+    ASSERT_TRUE(source->final_result.get() != NULL);
+    EXPECT_EQ(kMessages / kSources, source->final_result->size());
+
+    std::cout << "MessageTableInsert " << kMessages << " messages: "
+              << kMessages * 1000000ULL / std::max<uint64_t>(single_usecs, 1)
+              << " msgs/sec; MessageTableInsertBatch of " << kBatchSize
+              << ": " << kMessages * 1000000ULL / std::max<uint64_t>(batch_usecs, 1)
+              << " msgs/sec" << std::endl;
+}
+
+TEST_F(LocalStoreBenchmarkTest, StatTable) {
+    uint64_t start_ts = UTCTimestampUsec() - 60 * 1000000ULL;
+    uint64_t start = UTCTimestampUsec();
+    InsertStats(start_ts);
+    uint64_t insert_usecs = UTCTimestampUsec() - start;
+    uint64_t end_ts = start_ts + kStatSamples * 1000;
+
+    uint64_t query_usecs;
+    std::auto_ptr<AnalyticsQuery> query(RunQuery(Query(
+        "StatTable.UFlowData.flow", start_ts, end_ts,
+        "[\"T\", \"name\", \"flow.pifindex\"]",
+        "[[{\"name\":\"name\", \"value\":\"" + Source(0) +
+        "\", \"op\":1}]]"), &query_usecs));
+    ASSERT_TRUE(query->final_mresult.get() != NULL);
+    EXPECT_EQ(kStatSamples / kSources, query->final_mresult->size());
+
+    std::cout << "StatTableInsert " << kStatSamples << " samples: "
+              << insert_usecs / 1000 << " msec; query by name "
+              << query_usecs / 1000 << " msec" << std::endl;
+}
+
+// Query by Source and a keyword that is only found in a few of the
+// partitions of the time range, with and without the partition filters,
+// and by Source and a keyword that is found in every partition. With the
+// filters, the Source index is only read in the partitions with the sparse
+// keyword, and in the newest partitions, whose filters are not sealed yet.
+TEST_F(LocalStoreBenchmarkTest, MessageTableSparseKeyword) {
+    uint32_t start_t2((UTCTimestampUsec() - 3600 * 1000000ULL) >>
+        g_viz_constants.RowTimeInBits);
+    uint64_t start = UTCTimestampUsec();
+    InsertKeywordMessages(start_t2);
+    uint64_t insert_usecs = UTCTimestampUsec() - start;
+    uint64_t start_ts(static_cast<uint64_t>(start_t2) <<
+        g_viz_constants.RowTimeInBits);
+    uint64_t end_ts((static_cast<uint64_t>(start_t2 + kFilterPartitions) <<
+        g_viz_constants.RowTimeInBits) - 1);
+    std::string source_term("{\"name\":\"Source\", \"value\":\"" +
+        Source(0) + "\", \"op\":1}");
+
+    uint64_t sparse_usecs;
+    std::auto_ptr<AnalyticsQuery> sparse(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\"]", "[[" + source_term +
+        ", {\"name\":\"Keyword\", \"value\":\"sparse\", \"op\":1}]]"),
+        &sparse_usecs));
+    ASSERT_TRUE(sparse->final_result.get() != NULL);
+    EXPECT_EQ(kFilterPartitions / kSparseInterval,
+              sparse->final_result->size());
+
+    uint64_t unfiltered_usecs;
+    std::auto_ptr<AnalyticsQuery> unfiltered(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\"]", "[[" + source_term +
+        ", {\"name\":\"Keyword\", \"value\":\"sparse\", \"op\":1}]]"),
+        &unfiltered_usecs, false));
+    ASSERT_TRUE(unfiltered->final_result.get() != NULL);
+    EXPECT_EQ(kFilterPartitions / kSparseInterval,
+              unfiltered->final_result->size());
+
+    uint64_t everywhere_usecs;
+    std::auto_ptr<AnalyticsQuery> everywhere(RunQuery(Query(
+        g_viz_constants.COLLECTOR_GLOBAL_TABLE, start_ts, end_ts,
+        "[\"MessageTS\", \"Source\"]", "[[" + source_term +
+        ", {\"name\":\"Keyword\", \"value\":\"everywhere\", "
+        "\"op\":1}]]"), &everywhere_usecs));
+    ASSERT_TRUE(everywhere->final_result.get() != NULL);
+    EXPECT_EQ(kFilterPartitions, everywhere->final_result->size());
+
+    std::cout << "MessageTableInsertBatch " << kFilterPartitions *
+              kFilterMessages << " messages over " << kFilterPartitions
+              << " partitions: " << insert_usecs / 1000
+              << " msec; query by Source and sparse keyword "
+              << sparse_usecs / 1000 << " msec, without partition filters "
+              << unfiltered_usecs / 1000 << " msec; query by Source and "
+              << "keyword in every partition " << everywhere_usecs / 1000
+              << " msec" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
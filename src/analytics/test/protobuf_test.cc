@@ -2,9 +2,11 @@
  * Copyright (c) 2014 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <pthread.h>
 #include <fstream>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include <testing/gunit.h>
 
@@ -17,6 +19,7 @@
 #include <sandesh/sandesh.h>
 
 #include <base/logging.h>
+#include <base/time_util.h>
 #include <base/test/task_test_util.h>
 #include <io/test/event_manager_test.h>
 #include <io/io_types.h>
@@ -603,6 +606,168 @@ TEST_F(ProtobufReaderTest, ParseFail) {
     ASSERT_TRUE(msg == NULL);
 }
 
+// Create and serialize a SelfDescribingMessage for TestMessage or
+// TestMessageBase, as an exporter would send it.
+static std::string CreateSelfDescribingMessageString(bool base_message) {
+    boost::scoped_array<uint8_t> data(new uint8_t[kTestMessageBufferSize]);
+    int serialized_data_size(0);
+    if (base_message) {
+        CreateAndSerializeTestMessageBase(data.get(), kTestMessageBufferSize,
+            &serialized_data_size);
+    } else {
+        CreateAndSerializeTestMessage(data.get(), kTestMessageBufferSize,
+            &serialized_data_size);
+    }
+    boost::scoped_array<uint8_t> sdm_data(
+        new uint8_t[kSelfDescribingMessageBufferSize]);
+    int serialized_sdm_data_size(0);
+    CreateAndSerializeSelfDescribingMessage(
+        base_message ? "TestMessageBase" : "TestMessage", sdm_data.get(),
+        kSelfDescribingMessageBufferSize, &serialized_sdm_data_size,
+        base_message ? tme_desc_file_.c_str() : tm_desc_file_.c_str(),
+        data.get(), (size_t) serialized_data_size);
+    return std::string(reinterpret_cast<const char *>(sdm_data.get()),
+        serialized_sdm_data_size);
+}
+
+TEST_F(ProtobufReaderTest, PrototypeCache) {
+    std::string tm_sdm(CreateSelfDescribingMessageString(false));
+    std::string tmb_sdm(CreateSelfDescribingMessageString(true));
+    protobuf::impl::ProtobufReader reader;
+    EXPECT_EQ(0, reader.CachedPrototypeCount());
+    uint64_t timestamp;
+    const Message *msg1 = NULL;
+    bool success = reader.ReadSelfDescribingMessage(
+        reinterpret_cast<const uint8_t *>(tm_sdm.c_str()), tm_sdm.size(),
+        &timestamp, &msg1, NULL);
+    ASSERT_TRUE(success);
+    ASSERT_TRUE(msg1 != NULL);
+    EXPECT_EQ(123456789, timestamp);
+    EXPECT_TRUE((VerifyTestMessage<TestMessage, TestMessageInner>(msg1,
+        msg1->GetDescriptor())));
+    EXPECT_EQ(1, reader.CachedPrototypeCount());
+    // Same FileDescriptorSet and type, the message is reused
+    const Message *msg2 = NULL;
+    success = reader.ReadSelfDescribingMessage(
+        reinterpret_cast<const uint8_t *>(tm_sdm.c_str()), tm_sdm.size(),
+        &timestamp, &msg2, NULL);
+    ASSERT_TRUE(success);
+    EXPECT_EQ(msg1, msg2);
+    EXPECT_EQ(1, reader.CachedPrototypeCount());
+    // Messages allocated for the caller share the cached prototype
+    Message *msg3 = NULL;
+    success = reader.ParseSelfDescribingMessage(
+        reinterpret_cast<const uint8_t *>(tm_sdm.c_str()), tm_sdm.size(),
+        &timestamp, &msg3, NULL);
+    ASSERT_TRUE(success);
+    EXPECT_NE(msg1, msg3);
+    EXPECT_EQ(msg1->GetDescriptor(), msg3->GetDescriptor());
+    EXPECT_EQ(1, reader.CachedPrototypeCount());
+    delete msg3;
+    // Different FileDescriptorSet
+    const Message *msg4 = NULL;
+    success = reader.ReadSelfDescribingMessage(
+        reinterpret_cast<const uint8_t *>(tmb_sdm.c_str()), tmb_sdm.size(),
+        &timestamp, &msg4, NULL);
+    ASSERT_TRUE(success);
+    EXPECT_TRUE(VerifyTestMessageBase(msg4, msg4->GetDescriptor()));
+    EXPECT_EQ(2, reader.CachedPrototypeCount());
+    // Failures are not cached
+    boost::scoped_array<uint8_t> data(new uint8_t[kTestMessageBufferSize]);
+    int serialized_data_size(0);
+    CreateAndSerializeTestMessage(data.get(), kTestMessageBufferSize,
+        &serialized_data_size);
+    boost::scoped_array<uint8_t> sdm_data(
+        new uint8_t[kSelfDescribingMessageBufferSize]);
+    int serialized_sdm_data_size(0);
+    CreateAndSerializeSelfDescribingMessage("TestMessageFail", sdm_data.get(),
+        kSelfDescribingMessageBufferSize, &serialized_sdm_data_size,
+        tm_desc_file_.c_str(), data.get(), (size_t) serialized_data_size);
+    const Message *msg5 = NULL;
+    success = reader.ReadSelfDescribingMessage(sdm_data.get(),
+        serialized_sdm_data_size, &timestamp, &msg5, NULL);
+    EXPECT_FALSE(success);
+    EXPECT_TRUE(msg5 == NULL);
+    EXPECT_EQ(2, reader.CachedPrototypeCount());
+}
+
+class ProtobufReaderReplayThread {
+ public:
+    ProtobufReaderReplayThread(protobuf::impl::ProtobufReader *reader,
+        const std::vector<std::string> *stream, int messages) :
+        reader_(reader),
+        stream_(stream),
+        messages_(messages),
+        failures_(0) {
+    }
+    static void *ThreadRun(void *objp) {
+        ProtobufReaderReplayThread *obj =
+            reinterpret_cast<ProtobufReaderReplayThread *>(objp);
+        obj->Replay();
+        return NULL;
+    }
+    void Start() {
+        int res = pthread_create(&thread_id_, NULL, &ThreadRun, this);
+        assert(res == 0);
+    }
+    void Join() {
+        int res = pthread_join(thread_id_, NULL);
+        assert(res == 0);
+    }
+    int failures() const { return failures_; }
+
+ private:
+    void Replay() {
+        for (int i = 0; i < messages_; i++) {
+            const std::string &sdm(stream_->at(i % stream_->size()));
+            uint64_t timestamp;
+            const Message *msg = NULL;
+            if (!reader_->ReadSelfDescribingMessage(
+                    reinterpret_cast<const uint8_t *>(sdm.c_str()),
+                    sdm.size(), &timestamp, &msg, NULL)) {
+                failures_++;
+            }
+        }
+    }
+
+    protobuf::impl::ProtobufReader *reader_;
+    const std::vector<std::string> *stream_;
+    int messages_;
+    int failures_;
+    pthread_t thread_id_;
+};
+
+// Replay a stream of SelfDescribingMessages from two exporters through the
+// reader from several threads, as the UDP server threads would.
+TEST_F(ProtobufReaderTest, ReplayBenchmark) {
+    static const int kReplayThreads = 4;
+    static const int kReplayMessages = 50000;
+    std::vector<std::string> stream;
+    stream.push_back(CreateSelfDescribingMessageString(false));
+    stream.push_back(CreateSelfDescribingMessageString(true));
+    protobuf::impl::ProtobufReader reader;
+    boost::ptr_vector<ProtobufReaderReplayThread> threads;
+    for (int i = 0; i < kReplayThreads; i++) {
+        threads.push_back(new ProtobufReaderReplayThread(&reader, &stream,
+            kReplayMessages));
+    }
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < kReplayThreads; i++) {
+        threads[i].Start();
+    }
+    for (int i = 0; i < kReplayThreads; i++) {
+        threads[i].Join();
+        EXPECT_EQ(0, threads[i].failures());
+    }
+    uint64_t usecs = std::max<uint64_t>(UTCTimestampUsec() - start, 1);
+    EXPECT_EQ(stream.size(), reader.CachedPrototypeCount());
+    std::cout << "ProtobufReader " << kReplayThreads << " threads, "
+              << kReplayThreads * kReplayMessages << " messages: "
+              << usecs / 1000 << " msec, "
+              << kReplayThreads * kReplayMessages * 1000000ULL / usecs
+              << " msgs/sec" << std::endl;
+}
+
 TEST_F(ProtobufReaderTest, ProtobufLogLevelTest) {
     log4cplus::LogLevel level;
     level = protobuf::impl::Protobuf2log4Level(LOGLEVEL_INFO);
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <tbb/mutex.h>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+#include "io/test/event_manager_test.h"
+#include "analytics/redis_connection.h"
+
+using std::string;
+using std::vector;
+using boost::assign::list_of;
+
+namespace {
+
+static const int kUVEUpdates = 20000;
+
+//
+// Stand-in for redis-server that understands just enough of the protocol
+// to run the UVE scripts: SCRIPT LOAD, SCRIPT FLUSH, EVAL and EVALSHA. The
+// scripts themselves are not run; each successful EVAL or EVALSHA records
+// its last argument, and replies with an integer.
+//
+class MockRedisServer;
+
+class MockRedisSession : public TcpSession {
+public:
+    MockRedisSession(MockRedisServer *server, Socket *socket);
+
+protected:
+    virtual void OnRead(Buffer buffer);
+
+private:
+    bool ParseCommand(size_t *offset, vector<string> *args);
+    bool ParseLength(size_t *offset, char type, size_t *length);
+    void Execute(const vector<string> &args, string *reply);
+
+    MockRedisServer *server_;
+    string input_;
+};
+
+class MockRedisServer : public TcpServer {
+public:
+    explicit MockRedisServer(EventManager *evm)
+        : TcpServer(evm), script_loads_(0), noscripts_(0) {
+    }
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new MockRedisSession(this, socket);
+    }
+
+    string AddScript(const string &body, bool load) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        RedisScript script(
+            reinterpret_cast<const unsigned char *>(body.data()),
+            body.size());
+        scripts_.insert(script.sha1());
+        if (load) {
+            script_loads_++;
+        }
+        return script.sha1();
+    }
+    void ScriptFlush() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        scripts_.clear();
+    }
+    bool ScriptExists(const string &sha1) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return scripts_.find(sha1) != scripts_.end();
+    }
+    void Run(const string &arg) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        runs_.push_back(arg);
+    }
+    void NoScript() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        noscripts_++;
+    }
+
+    vector<string> runs() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return runs_;
+    }
+    size_t run_count() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return runs_.size();
+    }
+    void clear_runs() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        runs_.clear();
+    }
+    int script_loads() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return script_loads_;
+    }
+    int noscripts() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return noscripts_;
+    }
+
+private:
+    tbb::mutex mutex_;
+    std::set<string> scripts_;
+    vector<string> runs_;
+    int script_loads_;
+    int noscripts_;
+};
+
+MockRedisSession::MockRedisSession(MockRedisServer *server, Socket *socket)
+    : TcpSession(server, socket), server_(server) {
+}
+
+bool MockRedisSession::ParseLength(size_t *offset, char type,
+                                   size_t *length) {
+    if (*offset >= input_.size()) {
+        return false;
+    }
+    assert(input_[*offset] == type);
+    size_t end = input_.find("\r\n", *offset);
+    if (end == string::npos) {
+        return false;
+    }
+    *length = strtoul(input_.c_str() + *offset + 1, NULL, 10);
+    *offset = end + 2;
+    return true;
+}
+
+// Parse a multi-bulk command starting at offset. Returns false if the
+// command has not been received completely.
+bool MockRedisSession::ParseCommand(size_t *offset, vector<string> *args) {
+    size_t pos = *offset;
+    size_t argc;
+    if (!ParseLength(&pos, '*', &argc)) {
+        return false;
+    }
+    args->clear();
+    for (size_t i = 0; i < argc; i++) {
+        size_t len;
+        if (!ParseLength(&pos, '$', &len) || pos + len + 2 > input_.size()) {
+            return false;
+        }
+        args->push_back(input_.substr(pos, len));
+        pos += len + 2;
+    }
+    *offset = pos;
+    return true;
+}
+
+void MockRedisSession::Execute(const vector<string> &args, string *reply) {
+    if (args[0] == "SCRIPT" && args[1] == "LOAD") {
+        string sha1(server_->AddScript(args[2], true));
+        *reply += "$" + integerToString(sha1.size()) + "\r\n" + sha1 + "\r\n";
+    } else if (args[0] == "SCRIPT" && args[1] == "FLUSH") {
+        server_->ScriptFlush();
+        *reply += "+OK\r\n";
+    } else if (args[0] == "EVAL" || args[0] == "EVALSHA") {
+        if (args[0] == "EVAL") {
+            server_->AddScript(args[1], false);
+        } else if (!server_->ScriptExists(args[1])) {
+            server_->NoScript();
+            *reply += "-NOSCRIPT No matching script. Please use EVAL.\r\n";
+            return;
+        }
+        server_->Run(args.back());
+        *reply += ":1\r\n";
+    } else {
+        *reply += "+OK\r\n";
+    }
+}
+
+void MockRedisSession::OnRead(Buffer buffer) {
+    input_.append(reinterpret_cast<const char *>(BufferData(buffer)),
+                  BufferSize(buffer));
+    size_t offset = 0;
+    vector<string> args;
+    string reply;
+    while (ParseCommand(&offset, &args)) {
+        Execute(args, &reply);
+    }
+    input_.erase(0, offset);
+    if (!reply.empty()) {
+        Send(reinterpret_cast<const u_int8_t *>(reply.data()), reply.size(),
+             NULL);
+    }
+}
+
+// Stand-in for the UVE update script, of about the same size.
+static string UVEUpdateScriptBody() {
+    string body("-- uveupdate\n");
+    while (body.size() < 900) {
+        body += "-- redis.call('hset', KEYS[5], ARGV[6], ARGV[9])\n";
+    }
+    body += "return 1\n";
+    return body;
+}
+
+class RedisConnectionTest : public ::testing::Test {
+protected:
+    RedisConnectionTest()
+        : evm_(new EventManager()),
+          body_(UVEUpdateScriptBody()),
+          script_(reinterpret_cast<const unsigned char *>(body_.data()),
+                  body_.size()) {
+    }
+
+    virtual void SetUp() {
+        server_ = new MockRedisServer(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+        server_->Initialize(0);
+        task_util::WaitForIdle();
+        thread_->Start();
+        rac_.reset(new RedisAsyncConnection(evm_.get(), "127.0.0.1",
+                                            server_->GetPort()));
+        rac_->RAC_Connect();
+        TASK_UTIL_EXPECT_TRUE(rac_->IsConnUp());
+    }
+
+    virtual void TearDown() {
+        server_->Shutdown();
+        server_->ClearSessions();
+        TASK_UTIL_EXPECT_FALSE(rac_->IsConnUp());
+        task_util::WaitForIdle();
+        rac_.reset();
+        TcpServerManager::DeleteServer(server_);
+        server_ = NULL;
+        evm_->Shutdown();
+        thread_->Join();
+        task_util::WaitForIdle();
+    }
+
+    // Arguments of a UVE update, ending with the sequence number.
+    static vector<string> UVEUpdateArgs(int seq) {
+        string generator("host1:Compute:contrail-vrouter-agent:0");
+        string key("ObjectVRouter:host1");
+        return list_of(string("5"))(
+            string("TYPES:") + generator)(
+            string("ORIGINS:") + key)(
+            string("TABLE:ObjectVRouter"))(
+            string("UVES:") + generator + ":VrouterStatsAgent")(
+            string("VALUES:") + key + ":" + generator +
+                ":VrouterStatsAgent")(
+            "host1")("Compute")("contrail-vrouter-agent")("0")(
+            "VrouterStatsAgent")("phy_if_stats")(key)(
+            "<element type=\"struct\">...</element>")(
+            integerToString(seq));
+    }
+
+    uint64_t RunUVEUpdates(bool evalsha) {
+        uint64_t replies = rac_->CallbackSucceeded();
+        int script_loads = server_->script_loads();
+        uint64_t start = UTCTimestampUsec();
+        for (int seq = 0; seq < kUVEUpdates; seq++) {
+            if (evalsha) {
+                EXPECT_TRUE(rac_->RedisAsyncScriptCmd(NULL, script_,
+                                                      UVEUpdateArgs(seq)));
+            } else {
+                vector<string> args(UVEUpdateArgs(seq));
+                args.insert(args.begin(), body_);
+                args.insert(args.begin(), "EVAL");
+                EXPECT_TRUE(rac_->RedisAsyncArgCmd(NULL, args));
+            }
+        }
+        TASK_UTIL_EXPECT_EQ(replies + kUVEUpdates +
+            server_->script_loads() - script_loads,
+            rac_->CallbackSucceeded());
+        return UTCTimestampUsec() - start;
+    }
+
+    void VerifyOrder(int count) {
+        vector<string> runs(server_->runs());
+        ASSERT_EQ((size_t) count, runs.size());
+        for (int seq = 0; seq < count; seq++) {
+            EXPECT_EQ(integerToString(seq), runs[seq]);
+        }
+    }
+
+    std::auto_ptr<EventManager> evm_;
+    std::auto_ptr<ServerThread> thread_;
+    MockRedisServer *server_;
+    std::auto_ptr<RedisAsyncConnection> rac_;
+    string body_;
+    RedisScript script_;
+};
+
+TEST_F(RedisConnectionTest, ScriptSha1) {
+    const unsigned char body[] = "return 1";
+    RedisScript script(body, sizeof(body) - 1);
+    EXPECT_EQ("e0e1f9fabfc9d4800c877a703b823ac0578ff8db", script.sha1());
+}
+
+// The script is loaded once, ahead of the first EVALSHA.
+TEST_F(RedisConnectionTest, ScriptLoad) {
+    RunUVEUpdates(true);
+    VerifyOrder(kUVEUpdates);
+    EXPECT_EQ(1, server_->script_loads());
+    EXPECT_EQ(0, server_->noscripts());
+    EXPECT_EQ(0, rac_->ScriptFallbacks());
+}
+
+// Commands that fail with NOSCRIPT after the script cache is flushed are
+// resent with EVAL, and still run in the order they were issued.
+TEST_F(RedisConnectionTest, NoScriptFallback) {
+    EXPECT_TRUE(rac_->RedisAsyncScriptLoad(script_));
+    TASK_UTIL_EXPECT_EQ(1, rac_->CallbackSucceeded());
+    EXPECT_TRUE(rac_->RedisAsyncArgCmd(NULL,
+        list_of(string("SCRIPT"))("FLUSH")));
+    TASK_UTIL_EXPECT_EQ(2, rac_->CallbackSucceeded());
+
+    for (int seq = 0; seq < kUVEUpdates; seq++) {
+        EXPECT_TRUE(rac_->RedisAsyncScriptCmd(NULL, script_,
+                                              UVEUpdateArgs(seq)));
+    }
+    TASK_UTIL_EXPECT_EQ(kUVEUpdates, server_->run_count());
+    VerifyOrder(kUVEUpdates);
+    EXPECT_LT(0, server_->noscripts());
+    EXPECT_EQ(server_->noscripts(), rac_->ScriptFallbacks());
+    EXPECT_EQ(0, rac_->CallbackFailed());
+}
+
+// Compare the rate of pipelined UVE updates sent with EVAL and EVALSHA.
+TEST_F(RedisConnectionTest, UVEUpdateBenchmark) {
+    uint64_t eval_usecs = RunUVEUpdates(false);
+    VerifyOrder(kUVEUpdates);
+    server_->clear_runs();
+    uint64_t evalsha_usecs = RunUVEUpdates(true);
+    VerifyOrder(kUVEUpdates);
+
+    std::cout << kUVEUpdates << " UVE updates: EVAL "
+              << kUVEUpdates * 1000000ULL / (eval_usecs ? eval_usecs : 1)
+              << " updates/sec, EVALSHA "
+              << kUVEUpdates * 1000000ULL /
+                 (evalsha_usecs ? evalsha_usecs : 1)
+              << " updates/sec" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
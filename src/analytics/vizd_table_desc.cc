@@ -147,6 +147,14 @@ void init_vizd_tables() {
                       (GenDb::DbDataType::Unsigned32Type),
                       boost::assign::list_of
                       (GenDb::DbDataType::LexicalUUIDType)))
+        (GenDb::NewCf(g_viz_constants.INDEX_PARTITION_FILTER_TABLE,
+                      boost::assign::list_of
+                      (GenDb::DbDataType::Unsigned32Type)
+                      (GenDb::DbDataType::UTF8Type),
+                      boost::assign::list_of
+                      (GenDb::DbDataType::LexicalUUIDType),
+                      boost::assign::list_of
+                      (GenDb::DbDataType::AsciiType)))
         ;
 
 /* flow records table and flow series table are created in the code path itself
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/bloom_filter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace std;
+
+static const size_t kMaxHashes = 16;
+
+BloomFilter::BloomFilter() : nhashes_(0) {
+}
+
+//
+// Use the number of bits and hash functions that minimize the false
+// positive rate for nkeys keys: m = -n ln(p) / ln(2)^2 and k = m / n ln(2).
+//
+BloomFilter::BloomFilter(size_t nkeys, double fpp) {
+    nkeys = max(nkeys, static_cast<size_t>(1));
+    double nbits = ceil(-1.0 * nkeys * log(fpp) / (M_LN2 * M_LN2));
+    blocks_.resize(max(static_cast<size_t>(nbits + 63) / 64,
+                       static_cast<size_t>(1)));
+    nhashes_ = static_cast<size_t>(round(size() * M_LN2 / nkeys));
+    nhashes_ = min(max(nhashes_, static_cast<size_t>(1)), kMaxHashes);
+}
+
+uint64_t BloomFilter::Hash(const string &key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); i++) {
+        hash ^= static_cast<uint8_t>(key[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//
+// The positions of a key are h1 + i * h2 for i in [0, nhashes), where the
+// second hash is derived from the first one with the finalizer of
+// MurmurHash3.
+//
+static uint64_t SecondHash(uint64_t h1) {
+    uint64_t h2 = h1;
+    h2 ^= h2 >> 33;
+    h2 *= 0xff51afd7ed558ccdULL;
+    h2 ^= h2 >> 33;
+    return h2 | 1;
+}
+
+void BloomFilter::Add(const string &key) {
+    if (blocks_.empty())
+        return;
+    uint64_t h1 = Hash(key);
+    uint64_t h2 = SecondHash(h1);
+    for (size_t i = 0; i < nhashes_; i++) {
+        size_t pos = (h1 + i * h2) % size();
+        blocks_[pos / 64] |= 1ULL << (pos % 64);
+    }
+}
+
+bool BloomFilter::MayContain(const string &key) const {
+    if (blocks_.empty())
+        return false;
+    uint64_t h1 = Hash(key);
+    uint64_t h2 = SecondHash(h1);
+    for (size_t i = 0; i < nhashes_; i++) {
+        size_t pos = (h1 + i * h2) % size();
+        if ((blocks_[pos / 64] & (1ULL << (pos % 64))) == 0)
+            return false;
+    }
+    return true;
+}
+
+string BloomFilter::ToString() const {
+    static const char kHexDigits[] = "0123456789abcdef";
+    string str;
+    str.reserve(4 + blocks_.size() * 16);
+    char prefix[8];
+    snprintf(prefix, sizeof(prefix), "%zu:", nhashes_);
+    str.append(prefix);
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            str.push_back(kHexDigits[(blocks_[i] >> shift) & 0xf]);
+        }
+    }
+    return str;
+}
+
+//
+// Initialize the filter from the string representation returned by
+// ToString. Returns false, leaving the filter empty, if the string is not
+// valid.
+//
+bool BloomFilter::FromString(const string &str) {
+    blocks_.clear();
+    nhashes_ = 0;
+
+    size_t colon = str.find(':');
+    if (colon == string::npos || colon == 0)
+        return false;
+    char *end;
+    unsigned long nhashes = strtoul(str.c_str(), &end, 10);
+    size_t nhex = str.size() - colon - 1;
+    if (end != str.c_str() + colon || nhashes == 0 ||
+        nhashes > kMaxHashes || nhex == 0 || nhex % 16 != 0)
+        return false;
+
+    vector<uint64_t> blocks(nhex / 16);
+    for (size_t i = 0; i < nhex; i++) {
+        char c = str[colon + 1 + i];
+        uint64_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            return false;
+        }
+        blocks[i / 16] = (blocks[i / 16] << 4) | digit;
+    }
+    blocks_.swap(blocks);
+    nhashes_ = nhashes;
+    return true;
+}
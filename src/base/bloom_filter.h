@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_bloom_filter_h
+#define ctrlplane_bloom_filter_h
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+//
+// BloomFilter is a set of strings that may return false positives, but
+// never false negatives, from MayContain. It is sized for an expected
+// number of keys and false positive rate when it is created, and uses
+// double hashing of a 64 bit FNV-1a hash, so that the bit positions of a
+// key are the same on every platform and the filter can be persisted with
+// ToString and read back with FromString by another process.
+//
+class BloomFilter {
+public:
+    BloomFilter();
+    BloomFilter(size_t nkeys, double fpp);
+
+    void Add(const std::string &key);
+    bool MayContain(const std::string &key) const;
+
+    size_t size() const { return blocks_.size() * 64; }
+    size_t nhashes() const { return nhashes_; }
+
+    // "<nhashes>:<bits in hex>"
+    std::string ToString() const;
+    bool FromString(const std::string &str);
+
+private:
+    friend class BloomFilterTest;
+
+    static uint64_t Hash(const std::string &key);
+
+    std::vector<uint64_t> blocks_;
+    size_t nhashes_;
+};
+
+#endif
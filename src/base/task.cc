@@ -3,6 +3,7 @@
  */
 
 #include <assert.h>
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <iostream>
@@ -93,6 +94,8 @@ public:
     TaskEntry *ActiveEntryInPolicy();
     bool DeferOnPolicyFail(Task *t);
     void RunTask(Task *t);
+    void TaskStarted(Task *t, TaskGroup *group);
+    bool DeferOnDispatch(TaskGroup *group, Task *t);
     void RunDeferQ();
     void RunCombinedDeferQ();
     void RunWaitQ();
@@ -128,6 +131,7 @@ private:
     int             task_id_;
     int             task_instance_;
     int             run_count_; // # of tasks running
+    int             ready_count_; // # of tasks in the ready queue
 
     Task            *run_task_; // Task currently running
     TaskWaitQ       waitq_;     // Tasks waiting to run on some condition
@@ -157,6 +161,12 @@ struct TaskDeferEntryCmp {
 // run_count_   : Number of tasks running in context of this task-group
 // deferq_      : Tasks deferred till run_count_ on this task becomes 0
 // task_entry_  : Default TaskEntry used for task without an instance
+// readyq_      : Tasks that met the policies, waiting for a thread to run.
+//                Tasks in readyq_ do not count against the policies until
+//                they are dispatched, when the policies are checked again
+// priority_    : Priority class of the group
+// weight_      : Number of tasks dispatched in a turn of the group
+// credit_      : Number of tasks left to dispatch in the current turn
 class TaskGroup {
 public:
     TaskGroup(int task_id);
@@ -202,6 +212,10 @@ private:
     
     // Vector of Task Group policies
     typedef std::vector<TaskGroup *> TaskGroupPolicyList;
+    // List of Task's in readyq_
+    typedef boost::intrusive::member_hook<Task,
+            boost::intrusive::list_member_hook<>, &Task::waitq_hook_> ReadyQHook;
+    typedef boost::intrusive::list<Task, ReadyQHook> TaskReadyQ;
     typedef boost::intrusive::member_hook<TaskEntry, 
         boost::intrusive::set_member_hook<>, 
         &TaskEntry::task_defer_node> TaskDeferListOption;
@@ -219,6 +233,10 @@ private:
     TaskDeferList           deferq_;    // Tasks deferred till run_count_ is 0
     TaskEntry               *task_entry_;// Task entry for instance(-1)
     TaskEntryList           task_entry_db_;  // task-entries in this group
+    TaskReadyQ              readyq_;    // Tasks waiting for a thread
+    TaskScheduler::Priority priority_;
+    int                     weight_;
+    int                     credit_;
 
     TaskStats               stats_;
     DISALLOW_COPY_AND_ASSIGN(TaskGroup);
@@ -303,9 +321,10 @@ int TaskScheduler::GetThreadCount(int thread_count) {
 // part of tbb. So, initialize TBB with one thread more than its default
 TaskScheduler::TaskScheduler(int task_count) : 
     task_scheduler_(GetThreadCount(task_count) + 1),
-    running_(true), seqno_(0), id_max_(0), enqueue_count_(0), done_count_(0),
-    cancel_count_(0) {
+    running_(true), seqno_(0), id_max_(0), dispatch_count_(0),
+    enqueue_count_(0), done_count_(0), cancel_count_(0) {
     hw_thread_count_ = GetThreadCount(task_count);
+    dispatch_limit_ = hw_thread_count_;
     task_group_db_.resize(TaskScheduler::kVectorGrowSize);
     stop_entry_ = new TaskEntry(-1);
 }
@@ -417,12 +436,68 @@ void TaskScheduler::SetPolicy(int task_id, TaskPolicy &policy) {
     }
 }
 
+void TaskScheduler::SetPriority(int task_id, Priority priority, int weight) {
+    tbb::mutex::scoped_lock     lock(mutex_);
+
+    assert(priority < PRIORITY_MAX);
+    assert(weight > 0);
+    TaskGroup *group = GetTaskGroup(task_id);
+
+    // Move the ready tasks of the group to the new priority class
+    int ready_count = group->readyq_.size();
+    if (ready_count) {
+        DeleteFromReadyList(group);
+        priority_class_[group->priority_].ready_count -= ready_count;
+    }
+    group->priority_ = priority;
+    group->weight_ = weight;
+    if (ready_count) {
+        AddToReadyList(group);
+        priority_class_[group->priority_].ready_count += ready_count;
+    }
+}
+
+TaskScheduler::Priority TaskScheduler::GetPriority(int task_id) {
+    tbb::mutex::scoped_lock     lock(mutex_);
+
+    return GetTaskGroup(task_id)->priority_;
+}
+
+int TaskScheduler::GetReadyCount(Priority priority) {
+    tbb::mutex::scoped_lock     lock(mutex_);
+
+    return priority_class_[priority].ready_count;
+}
+
+std::string TaskScheduler::GetPriorityName(Priority priority) {
+    switch (priority) {
+    case HIGH:
+        return "high";
+    case NORMAL:
+        return "normal";
+    case LOW:
+        return "low";
+    default:
+        break;
+    }
+    return "ERROR";
+}
+
+void TaskScheduler::SetMaxThreadCount(int n) {
+    tbb::mutex::scoped_lock     lock(mutex_);
+
+    assert(n > 0);
+    dispatch_limit_ = n;
+    DispatchReadyTasks();
+}
+
 // Enqueue a Task for running. Starts task if all policy rules are met else 
 // puts task in waitq
 void TaskScheduler::Enqueue(Task *t) {
     tbb::mutex::scoped_lock     lock(mutex_);
 
     EnqueueUnLocked(t);
+    DispatchReadyTasks();
 }
 
 void TaskScheduler::EnqueueUnLocked(Task *t) {
@@ -471,8 +546,9 @@ void TaskScheduler::EnqueueUnLocked(Task *t) {
 TaskScheduler::CancelReturnCode TaskScheduler::Cancel(Task *t) {
     tbb::mutex::scoped_lock  lock(mutex_);
 
-    // If the task is in RUN state, mark the task for cancellation and return.
-    if (t->state_ == Task::RUN) {
+    // If the task is in READY/RUN state, mark the task for cancellation and
+    // return.
+    if (t->state_ == Task::READY || t->state_ == Task::RUN) {
         t->task_cancel_ = true;
     } else if (t->state_ == Task::WAIT) {
         TaskEntry *entry = QueryTaskEntry(t->GetTaskId(), t->GetTaskInstance());
@@ -518,11 +594,103 @@ TaskScheduler::CancelReturnCode TaskScheduler::Cancel(Task *t) {
     return QUEUED;
 }
 
+// Add a Task, that met its policies, to the ready queue of its TaskGroup.
+// The ready tasks are not dispatched here, since this runs while the
+// deferq_ lists are walked and dispatch may move entries between them. The
+// callers of EnqueueUnLocked and TaskEntry::TaskExited dispatch once done.
+void TaskScheduler::ScheduleTask(TaskGroup *group, Task *t) {
+    t->SetState(Task::READY);
+    if (group->readyq_.empty()) {
+        AddToReadyList(group);
+    }
+    group->readyq_.push_back(*t);
+    priority_class_[group->priority_].ready_count++;
+}
+
+// The group takes its turn after the other groups of its class
+void TaskScheduler::AddToReadyList(TaskGroup *group) {
+    group->credit_ = group->weight_;
+    priority_class_[group->priority_].ready_groups.push_back(group);
+}
+
+void TaskScheduler::DeleteFromReadyList(TaskGroup *group) {
+    std::deque<TaskGroup *> &groups =
+        priority_class_[group->priority_].ready_groups;
+    groups.erase(std::find(groups.begin(), groups.end(), group));
+}
+
+// Take the next Task to run from the ready queues. The highest priority
+// class with ready tasks is picked unless a lower class has been passed
+// over kMaxStarvation times. Within the class, the group whose turn it is
+// gives its first task, and passes the turn on once it has given weight_
+// tasks.
+Task *TaskScheduler::NextReadyTask() {
+    int selected = PRIORITY_MAX;
+    for (int i = 0; i < PRIORITY_MAX; i++) {
+        if (priority_class_[i].ready_count == 0) {
+            continue;
+        }
+        if (selected == PRIORITY_MAX) {
+            selected = i;
+        } else if (priority_class_[i].passed_count >= kMaxStarvation) {
+            selected = i;
+            break;
+        }
+    }
+    if (selected == PRIORITY_MAX) {
+        return NULL;
+    }
+
+    for (int i = 0; i < PRIORITY_MAX; i++) {
+        if (i != selected && priority_class_[i].ready_count) {
+            priority_class_[i].passed_count++;
+        }
+    }
+
+    PriorityClass &pclass = priority_class_[selected];
+    pclass.passed_count = 0;
+    pclass.ready_count--;
+    TaskGroup *group = pclass.ready_groups.front();
+    Task *t = &group->readyq_.front();
+    group->readyq_.pop_front();
+    if (group->readyq_.empty()) {
+        pclass.ready_groups.pop_front();
+    } else if (--group->credit_ == 0) {
+        pclass.ready_groups.pop_front();
+        AddToReadyList(group);
+    }
+    return t;
+}
+
+// Hand ready tasks to tbb as long as there are fewer than dispatch_limit_
+// tasks running, so that the tasks of higher priority do not queue in tbb
+// behind those of lower priority. A task starts counting against the
+// policies here, so a ready task of a lower class does not hold up the
+// tasks it excludes; one that is now excluded by a running task is deferred.
+void TaskScheduler::DispatchReadyTasks() {
+    while (dispatch_count_ < dispatch_limit_) {
+        Task *t = NextReadyTask();
+        if (t == NULL) {
+            break;
+        }
+        TaskGroup *group = QueryTaskGroup(t->GetTaskId());
+        TaskEntry *entry = group->QueryTaskEntry(t->GetTaskInstance());
+        entry->ready_count_--;
+        if (entry->DeferOnDispatch(group, t)) {
+            continue;
+        }
+        entry->TaskStarted(t, group);
+        dispatch_count_++;
+        t->StartTask();
+    }
+}
+
 // Method invoked on exit of a Task.
 // Exit of a task can potentially start tasks in pendingq.
 void TaskScheduler::OnTaskExit(Task *t) {
     tbb::mutex::scoped_lock lock(mutex_);
     done_count_++;
+    dispatch_count_--;
 
     TaskEntry *entry = QueryTaskEntry(t->GetTaskId(), t->GetTaskInstance());
     entry->TaskExited(t, GetTaskGroup(t->GetTaskId()));
@@ -538,14 +706,17 @@ void TaskScheduler::OnTaskExit(Task *t) {
             t->OnTaskCancel();
         }
         delete t;
+        DispatchReadyTasks();
         return;
     }
 
-    // Task is being recycled, reset the state, seq_no and TBB task handle
+    // Task is being recycled, reset the state, seq_no and TBB task handle.
+    // It is queued behind the ready tasks of its group.
     t->task_impl_ = NULL;
     t->SetSeqNo(0);
     t->state_ = Task::INIT;
     EnqueueUnLocked(t);
+    DispatchReadyTasks();
 }
 
 void TaskScheduler::Stop() {
@@ -561,6 +732,7 @@ void TaskScheduler::Start() {
 
     // Run all tasks that may be suspended
     stop_entry_->RunDeferQ();
+    DispatchReadyTasks();
     return;
 }
 
@@ -591,7 +763,7 @@ bool TaskScheduler::IsEmpty(bool running_only) {
         if ((group = *it) == NULL) {
             continue;
         }
-        if (group->TaskRunCount()) {
+        if (group->TaskRunCount() || !group->readyq_.empty()) {
             return false;
         }
         if ((false == running_only) && (false == group->IsWaitQEmpty())) {
@@ -806,7 +978,7 @@ void TaskScheduler::SetThreadAmpFactor(int n) {
 ////////////////////////////////////////////////////////////////////////////
 
 TaskGroup::TaskGroup(int task_id) : task_id_(task_id), policy_set_(false), 
-    run_count_(0) {
+    run_count_(0), priority_(TaskScheduler::NORMAL), weight_(1), credit_(0) {
     task_entry_db_.resize(TaskGroup::kVectorGrowSize);
     task_entry_ = new TaskEntry(task_id);
     memset(&stats_, 0, sizeof(stats_));
@@ -815,6 +987,7 @@ TaskGroup::TaskGroup(int task_id) : task_id_(task_id), policy_set_(false),
 TaskGroup::~TaskGroup() {
     policy_.clear();
     deferq_.clear();
+    readyq_.clear();
 
     delete task_entry_;
     task_entry_ = NULL;
@@ -990,8 +1163,8 @@ TaskStats *TaskGroup::GetTaskStats(int task_instance) {
 ////////////////////////////////////////////////////////////////////////////
 
 TaskEntry::TaskEntry(int task_id, int task_instance) : task_id_(task_id),
-    task_instance_(task_instance), run_count_(0), run_task_(NULL),
-    waitq_(), deferq_task_entry_(NULL), deferq_task_group_(NULL) {
+    task_instance_(task_instance), run_count_(0), ready_count_(0),
+    run_task_(NULL), waitq_(), deferq_task_entry_(NULL), deferq_task_group_(NULL) {
     // When a new TaskEntry is created, adds an implicit rule into policyq_ to
     // ensure that only one Task of an instance is run at a time
     if (task_instance != -1) {
@@ -1003,7 +1176,7 @@ TaskEntry::TaskEntry(int task_id, int task_instance) : task_id_(task_id),
 }
 
 TaskEntry::TaskEntry(int task_id) : task_id_(task_id),
-    task_instance_(-1), run_count_(0), run_task_(NULL),
+    task_instance_(-1), run_count_(0), ready_count_(0), run_task_(NULL),
     deferq_task_entry_(NULL), deferq_task_group_(NULL) {
     memset(&stats_, 0, sizeof(stats_));
     // allocate memory for deferq
@@ -1033,9 +1206,16 @@ TaskEntry *TaskEntry::ActiveEntryInPolicy() {
 }
 
 bool TaskEntry::DeferOnPolicyFail(Task *task) {
-    TaskEntry *policy_entry;
+    TaskEntry *policy_entry = ActiveEntryInPolicy();
+
+    // A task of the instance waiting in the ready queue excludes the other
+    // tasks of the instance, as it would once running. The entry waits in
+    // its own deferq_ for that task to exit.
+    if (policy_entry == NULL && task_instance_ != -1 && ready_count_ != 0) {
+        policy_entry = this;
+    }
 
-    if ((policy_entry = ActiveEntryInPolicy()) != NULL) {
+    if (policy_entry != NULL) {
         // TaskEntry is inserted in the deferq_ based on the Task seqno. 
         // deferq_ comparison function uses the seqno of the first Task queued
         // in the waitq_. Therefore, add the Task to waitq_ before adding
@@ -1077,22 +1257,65 @@ void TaskEntry::DeleteFromDeferQ(TaskEntry &entry) {
     entry.deferq_task_entry_ = NULL;
 }
 
-// Start a single task.
-// If there are more entries in waitq_ add them to deferq_
+// Start a single task, by adding it to the ready queue of its group.
 void TaskEntry::RunTask (Task *t) {
-    stats_.run_count_++;
-    if (t->GetTaskInstance() != -1) {
+    ready_count_++;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    TaskGroup *group = scheduler->QueryTaskGroup(t->GetTaskId());
+    scheduler->ScheduleTask(group, t);
+}
+
+// A task taken from the ready queue is handed to tbb
+void TaskEntry::TaskStarted(Task *t, TaskGroup *group) {
+    if (task_instance_ != -1) {
         assert(run_task_ == NULL);
         assert (run_count_ == 0);
         run_task_ = t;
     }
 
+    stats_.run_count_++;
     run_count_++;
-    TaskScheduler *scheduler = TaskScheduler::GetInstance();
-    TaskGroup *group = scheduler->QueryTaskGroup(t->GetTaskId());
     group->TaskStarted();
+}
+
+// Check the policies of a task taken from the ready queue, as a running task
+// may exclude it now. On a violation, put the task back in waitq_, in the
+// order of enqueue, and move the TaskEntry to the deferq_ of the running
+// task that excludes it. A TaskEntry waiting for the scheduler to start
+// stays in its deferq_.
+bool TaskEntry::DeferOnDispatch(TaskGroup *group, Task *t) {
+    TaskGroup *policy_group = group->ActiveGroupInPolicy();
+    TaskEntry *policy_entry = NULL;
+    if (policy_group == NULL) {
+        policy_entry = ActiveEntryInPolicy();
+        if (policy_entry == NULL) {
+            return false;
+        }
+    }
 
-    t->StartTask();
+    TaskEntry *stop_entry = TaskScheduler::GetInstance()->stop_entry_;
+    bool stopped = (deferq_task_entry_ == stop_entry);
+    if (deferq_task_group_) {
+        deferq_task_group_->DeleteFromDeferQ(*this);
+    } else if (deferq_task_entry_) {
+        deferq_task_entry_->DeleteFromDeferQ(*this);
+    }
+
+    TaskWaitQ::iterator it = waitq_.begin();
+    while (it != waitq_.end() && it->GetSeqno() < t->GetSeqno()) {
+        ++it;
+    }
+    t->SetState(Task::WAIT);
+    waitq_.insert(it, *t);
+
+    if (stopped) {
+        stop_entry->AddToDeferQ(this);
+    } else if (policy_group) {
+        policy_group->AddToDeferQ(this);
+    } else {
+        policy_entry->AddToDeferQ(this);
+    }
+    return true;
 }
 
 void TaskEntry::RunWaitQ() {
@@ -1215,6 +1438,7 @@ void TaskEntry::TaskExited(Task *t, TaskGroup *group) {
 }
 
 void TaskEntry::ClearQueues() {
+    ready_count_ = 0;
     deferq_->clear();
     policyq_.clear();
     waitq_.clear();
@@ -1304,6 +1528,9 @@ void TaskGroup::GetSandeshData(SandeshTaskGroup *resp) const {
         }
     }
     resp->set_task_entry_list(list);
+    resp->set_priority(TaskScheduler::GetPriorityName(priority_));
+    resp->set_weight(weight_);
+    resp->set_ready_count(readyq_.size());
 
     std::vector<SandeshTaskPolicyEntry> policy_list;
     for (TaskGroupPolicyList::const_iterator it = policy_.begin();
@@ -1335,4 +1562,15 @@ void TaskScheduler::GetSandeshData(SandeshTaskScheduler *resp) {
         list.push_back(resp_group);
     }
     resp->set_task_group_list(list);
+
+    std::vector<SandeshTaskPriority> priority_list;
+    for (int i = 0; i < PRIORITY_MAX; i++) {
+        SandeshTaskPriority resp_priority;
+        resp_priority.set_priority(GetPriorityName(static_cast<Priority>(i)));
+        resp_priority.set_ready_count(priority_class_[i].ready_count);
+        resp_priority.set_passed_count(priority_class_[i].passed_count);
+        priority_list.push_back(resp_priority);
+    }
+    resp->set_priority_list(priority_list);
+    resp->set_dispatch_limit(dispatch_limit_);
 }
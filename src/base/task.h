@@ -27,12 +27,22 @@
 //
 // When there are multiple tasks ready to run, they are scheduled in their
 // order of enqueue
+//
+// Tasks that are ready to run wait in the ready queue of their task group
+// until a thread is free. Each task group belongs to a priority class;
+// ready tasks of a higher class are dispatched ahead of those of lower
+// classes, and the groups of a class take turns, each dispatching as many
+// tasks as its weight in a turn. A class that is passed over kMaxStarvation
+// times in a row while it has ready tasks gets the next dispatch. A task
+// counts against the exclusion policies only once it is dispatched, and its
+// policies are checked again at that point.
 
 #ifndef ctrlplane_task_h
 #define ctrlplane_task_h
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/intrusive/list.hpp>
+#include <deque>
 #include <map>
 #include <vector>
 #include <tbb/mutex.h>
@@ -69,6 +79,7 @@ public:
     enum State {
         INIT,
         WAIT,
+        READY,          // In the ready queue, waiting for a thread
         RUN
     };
 
@@ -100,6 +111,7 @@ public:
 
 private:
     friend class TaskEntry;
+    friend class TaskGroup;
     friend class TaskScheduler;
     friend class TaskImpl;
     void SetSeqNo(uint64_t seqno) {seqno_ = seqno;};
@@ -115,7 +127,8 @@ private:
     uint64_t            seqno_;
     bool                task_recycle_;
     bool                task_cancel_;
-    // Hook in intrusive list for TaskEntry::waitq_
+    // Hook in intrusive list for TaskEntry::waitq_ and the ready queue of
+    // the TaskGroup
     boost::intrusive::list_member_hook<> waitq_hook_;
 
     DISALLOW_COPY_AND_ASSIGN(Task);
@@ -150,9 +163,26 @@ public:
     };
     CancelReturnCode Cancel(Task *task);
 
+    // Priority classes, highest first
+    enum Priority {
+        HIGH,
+        NORMAL,
+        LOW,
+        PRIORITY_MAX
+    };
+
     // Set the task exclusion policy.
     void SetPolicy(int task_id, TaskPolicy &policy);
 
+    // Set the priority class of a task group and its weight, the number of
+    // tasks it dispatches in its turn among the groups of the class.
+    // Task groups are NORMAL with a weight of 1 by default.
+    void SetPriority(int task_id, Priority priority, int weight = 1);
+    Priority GetPriority(int task_id);
+    // Number of tasks of the class waiting for a thread to run on
+    int GetReadyCount(Priority priority);
+    static std::string GetPriorityName(Priority priority);
+
     bool GetRunStatus() { return running_; };
     int GetTaskId(const std::string &name);
     std::string GetTaskName(int task_id) const;
@@ -186,7 +216,7 @@ public:
     uint64_t enqueue_count() const { return enqueue_count_; }
     uint64_t done_count() const { return done_count_; }
     uint64_t cancel_count() const { return cancel_count_; }
-    // Force number of threads
+    // Force number of threads that run tasks at a time
     void SetMaxThreadCount(int n);
     void GetSandeshData(SandeshTaskScheduler *resp);
 
@@ -196,10 +226,21 @@ public:
 
 private:
     friend class ConcurrencyScope;
+    friend class TaskEntry;
     typedef std::vector<TaskGroup *> TaskGroupDb;
     typedef std::map<std::string, int> TaskIdMap;
 
+    // Task groups of a priority class with tasks in their ready queue, in
+    // the order of their turn
+    struct PriorityClass {
+        PriorityClass() : ready_count(0), passed_count(0) { }
+        std::deque<TaskGroup *> ready_groups;
+        int ready_count;        // #Tasks in ready queues
+        int passed_count;       // #Dispatches from other classes in a row
+    };
+
     static const int        kVectorGrowSize = 16;
+    static const int        kMaxStarvation = 16;
     static boost::scoped_ptr<TaskScheduler> singleton_;
 
     // XXX
@@ -212,6 +253,12 @@ private:
 
     int CountThreadsPerPid(pid_t pid);
 
+    void ScheduleTask(TaskGroup *group, Task *t);
+    void AddToReadyList(TaskGroup *group);
+    void DeleteFromReadyList(TaskGroup *group);
+    Task *NextReadyTask();
+    void DispatchReadyTasks();
+
     TaskEntry               *stop_entry_;
 
     tbb::task_scheduler_init task_scheduler_;
@@ -225,6 +272,9 @@ private:
     int                     id_max_;
 
     int                     hw_thread_count_;
+    int                     dispatch_limit_;    // #Tasks run at a time
+    int                     dispatch_count_;    // #Tasks handed to tbb
+    PriorityClass           priority_class_[PRIORITY_MAX];
 
     uint64_t                enqueue_count_;
     uint64_t                done_count_;
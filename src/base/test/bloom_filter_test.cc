@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/bloom_filter.h"
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+class BloomFilterTest : public ::testing::Test {
+protected:
+    vector<uint64_t> &get_blocks(BloomFilter &filter) {
+        return filter.blocks_;
+    }
+};
+
+TEST_F(BloomFilterTest, Empty) {
+    BloomFilter filter;
+    EXPECT_EQ(0, filter.size());
+    EXPECT_FALSE(filter.MayContain("key"));
+    filter.Add("key");
+    EXPECT_FALSE(filter.MayContain("key"));
+}
+
+TEST_F(BloomFilterTest, Size) {
+    BloomFilter filter(1000, 0.01);
+    EXPECT_EQ(9600, filter.size());
+    EXPECT_EQ(7, filter.nhashes());
+
+    BloomFilter one(0, 0.01);
+    EXPECT_EQ(64, one.size());
+}
+
+// Keys that were added are always found, and the false positive rate for
+// keys that were not is close to the requested rate.
+TEST_F(BloomFilterTest, FalsePositiveRate) {
+    const int kKeys = 10000;
+    BloomFilter filter(kKeys, 0.01);
+    for (int i = 0; i < kKeys; i++) {
+        filter.Add("key-" + integerToString(i));
+    }
+    for (int i = 0; i < kKeys; i++) {
+        EXPECT_TRUE(filter.MayContain("key-" + integerToString(i)));
+    }
+    int false_positives = 0;
+    for (int i = kKeys; i < 11 * kKeys; i++) {
+        if (filter.MayContain("key-" + integerToString(i)))
+            false_positives++;
+    }
+    EXPECT_LT(false_positives, 10 * kKeys * 0.02);
+}
+
+TEST_F(BloomFilterTest, ToString) {
+    BloomFilter filter(32, 0.5);
+    ASSERT_EQ(1, get_blocks(filter).size());
+    EXPECT_EQ(1, filter.nhashes());
+    get_blocks(filter)[0] = 0x0123456789abcdefULL;
+    EXPECT_EQ("1:0123456789abcdef", filter.ToString());
+}
+
+TEST_F(BloomFilterTest, FromString) {
+    BloomFilter filter(100, 0.01);
+    for (int i = 0; i < 100; i++) {
+        filter.Add(integerToString(i));
+    }
+    BloomFilter copy;
+    EXPECT_TRUE(copy.FromString(filter.ToString()));
+    EXPECT_EQ(filter.size(), copy.size());
+    EXPECT_EQ(filter.nhashes(), copy.nhashes());
+    EXPECT_EQ(get_blocks(filter), get_blocks(copy));
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(copy.MayContain(integerToString(i)));
+    }
+}
+
+TEST_F(BloomFilterTest, FromStringInvalid) {
+    BloomFilter filter;
+    EXPECT_FALSE(filter.FromString(""));
+    EXPECT_FALSE(filter.FromString(":0123456789abcdef"));
+    EXPECT_FALSE(filter.FromString("0:0123456789abcdef"));
+    EXPECT_FALSE(filter.FromString("17:0123456789abcdef"));
+    EXPECT_FALSE(filter.FromString("x:0123456789abcdef"));
+    EXPECT_FALSE(filter.FromString("1:"));
+    EXPECT_FALSE(filter.FromString("1:0123456789abcde"));
+    EXPECT_FALSE(filter.FromString("1:0123456789abcdeg"));
+    EXPECT_EQ(0, filter.size());
+    EXPECT_TRUE(filter.FromString("1:0123456789abcdef"));
+    EXPECT_EQ(64, filter.size());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
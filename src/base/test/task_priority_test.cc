@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+// Records the order in which the tasks start
+class RunLog {
+public:
+    void Add(const string &name) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        names_.push_back(name);
+    }
+    vector<string> names() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return names_;
+    }
+
+private:
+    tbb::mutex mutex_;
+    vector<string> names_;
+};
+
+class LogTask : public Task {
+public:
+    LogTask(int task_id, const string &name, RunLog *log)
+        : Task(task_id), name_(name), log_(log) {
+    }
+    virtual bool Run() {
+        log_->Add(name_);
+        return true;
+    }
+
+private:
+    string name_;
+    RunLog *log_;
+};
+
+// Holds the thread it runs on until released
+class BlockTask : public Task {
+public:
+    BlockTask(int task_id, tbb::atomic<bool> *running,
+              tbb::atomic<bool> *release, int instance = -1)
+        : Task(task_id, instance), running_(running), release_(release) {
+    }
+    virtual bool Run() {
+        *running_ = true;
+        while (!*release_) {
+            usleep(1000);
+        }
+        return true;
+    }
+
+private:
+    tbb::atomic<bool> *running_;
+    tbb::atomic<bool> *release_;
+};
+
+// Records an overlap if a task it excludes, or another task of its instance,
+// runs at the same time
+class ExclusiveTask : public Task {
+public:
+    ExclusiveTask(int task_id, tbb::atomic<int> *active,
+                  tbb::atomic<int> *excluded, tbb::atomic<bool> *overlap,
+                  tbb::atomic<int> *done, int instance = -1)
+        : Task(task_id, instance), active_(active), excluded_(excluded),
+          overlap_(overlap), done_(done) {
+    }
+    virtual bool Run() {
+        int active = active_->fetch_and_increment();
+        if (GetTaskInstance() != -1 && active != 0) {
+            *overlap_ = true;
+        }
+        if (*excluded_ != 0) {
+            *overlap_ = true;
+        }
+        usleep(1000);
+        active_->fetch_and_decrement();
+        done_->fetch_and_increment();
+        return true;
+    }
+
+private:
+    tbb::atomic<int> *active_;
+    tbb::atomic<int> *excluded_;
+    tbb::atomic<bool> *overlap_;
+    tbb::atomic<int> *done_;
+};
+
+// A table walk, that runs for chunk_usec at a time until done
+class WalkTask : public Task {
+public:
+    WalkTask(int task_id, int instance, int chunks, uint64_t chunk_usec)
+        : Task(task_id, instance), chunks_(chunks), chunk_usec_(chunk_usec) {
+    }
+    virtual bool Run() {
+        uint64_t start = ClockMonotonicUsec();
+        while (ClockMonotonicUsec() - start < chunk_usec_) {
+        }
+        return (--chunks_ == 0);
+    }
+
+private:
+    int chunks_;
+    uint64_t chunk_usec_;
+};
+
+// Measures the time from the enqueue of the task to its start
+class KeepaliveTask : public Task {
+public:
+    KeepaliveTask(int task_id, tbb::atomic<uint64_t> *max_latency)
+        : Task(task_id), enqueue_time_(ClockMonotonicUsec()),
+          max_latency_(max_latency) {
+    }
+    virtual bool Run() {
+        uint64_t latency = ClockMonotonicUsec() - enqueue_time_;
+        uint64_t max_latency = *max_latency_;
+        while (latency > max_latency) {
+            if (max_latency_->compare_and_swap(latency, max_latency) ==
+                max_latency) {
+                break;
+            }
+            max_latency = *max_latency_;
+        }
+        return true;
+    }
+
+private:
+    uint64_t enqueue_time_;
+    tbb::atomic<uint64_t> *max_latency_;
+};
+
+class TaskPriorityTest : public ::testing::Test {
+protected:
+    TaskPriorityTest() : scheduler_(TaskScheduler::GetInstance()) {
+        running_ = false;
+        release_ = false;
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        scheduler_->SetMaxThreadCount(scheduler_->HardwareThreadCount());
+    }
+
+    int TaskId(const string &name) {
+        return scheduler_->GetTaskId(name);
+    }
+
+    // Run the scheduler with a single thread, held by a BlockTask, so that
+    // the tasks enqueued next wait in the ready queues.
+    void Block() {
+        scheduler_->SetMaxThreadCount(1);
+        running_ = false;
+        release_ = false;
+        scheduler_->Enqueue(new BlockTask(TaskId("test::Block"), &running_,
+                                          &release_));
+        TASK_UTIL_EXPECT_TRUE(running_);
+    }
+
+    void Release() {
+        release_ = true;
+        task_util::WaitForIdle();
+    }
+
+    void Log(const string &group, const string &name) {
+        scheduler_->Enqueue(new LogTask(TaskId(group), name, &log_));
+    }
+
+    TaskScheduler *scheduler_;
+    tbb::atomic<bool> running_;
+    tbb::atomic<bool> release_;
+    RunLog log_;
+};
+
+// Ready tasks of higher priority classes run first, and in the order of
+// enqueue within a group
+TEST_F(TaskPriorityTest, Priority) {
+    scheduler_->SetPriority(TaskId("test::High"), TaskScheduler::HIGH);
+    scheduler_->SetPriority(TaskId("test::Low"), TaskScheduler::LOW);
+    EXPECT_EQ(TaskScheduler::HIGH,
+              scheduler_->GetPriority(TaskId("test::High")));
+    EXPECT_EQ(TaskScheduler::NORMAL,
+              scheduler_->GetPriority(TaskId("test::Normal")));
+
+    Block();
+    Log("test::Low", "L1");
+    Log("test::Normal", "N1");
+    Log("test::High", "H1");
+    Log("test::Low", "L2");
+    Log("test::Normal", "N2");
+    Log("test::High", "H2");
+    EXPECT_EQ(2, scheduler_->GetReadyCount(TaskScheduler::HIGH));
+    EXPECT_EQ(2, scheduler_->GetReadyCount(TaskScheduler::NORMAL));
+    EXPECT_EQ(2, scheduler_->GetReadyCount(TaskScheduler::LOW));
+    Release();
+
+    vector<string> expected = boost::assign::list_of
+        ("H1")("H2")("N1")("N2")("L1")("L2");
+    EXPECT_EQ(expected, log_.names());
+    EXPECT_EQ(0, scheduler_->GetReadyCount(TaskScheduler::HIGH));
+    EXPECT_EQ(0, scheduler_->GetReadyCount(TaskScheduler::NORMAL));
+    EXPECT_EQ(0, scheduler_->GetReadyCount(TaskScheduler::LOW));
+}
+
+// Groups of a class take turns, each running as many tasks as its weight
+TEST_F(TaskPriorityTest, Weight) {
+    scheduler_->SetPriority(TaskId("test::Heavy"), TaskScheduler::NORMAL, 3);
+
+    Block();
+    for (int i = 0; i < 5; i++) {
+        Log("test::Heavy", "A");
+        Log("test::Light", "B");
+    }
+    Release();
+
+    vector<string> expected = boost::assign::list_of
+        ("A")("A")("A")("B")("A")("A")("B")("B")("B")("B");
+    EXPECT_EQ(expected, log_.names());
+}
+
+// A lower class gets a turn after it has been passed over kMaxStarvation
+// times
+TEST_F(TaskPriorityTest, Starvation) {
+    scheduler_->SetPriority(TaskId("test::High"), TaskScheduler::HIGH);
+    scheduler_->SetPriority(TaskId("test::Low"), TaskScheduler::LOW);
+
+    Block();
+    Log("test::Low", "L");
+    for (int i = 0; i < 40; i++) {
+        Log("test::High", "H");
+    }
+    Release();
+
+    vector<string> names = log_.names();
+    ASSERT_EQ(41U, names.size());
+    EXPECT_EQ(16, find(names.begin(), names.end(), "L") - names.begin());
+}
+
+// Tasks in the ready queue do not count against the policies, so a task of
+// a higher class is not held up by ready tasks of a lower class that it
+// excludes
+TEST_F(TaskPriorityTest, Policy) {
+    TaskPolicy policy = boost::assign::list_of
+        (TaskExclusion(TaskId("test::ExcludeLow")));
+    scheduler_->SetPolicy(TaskId("test::ExcludeHigh"), policy);
+    scheduler_->SetPriority(TaskId("test::ExcludeHigh"), TaskScheduler::HIGH);
+    scheduler_->SetPriority(TaskId("test::ExcludeLow"), TaskScheduler::LOW);
+
+    Block();
+    Log("test::ExcludeLow", "L1");
+    Log("test::ExcludeHigh", "H1");
+    Log("test::ExcludeLow", "L2");
+    EXPECT_EQ(1, scheduler_->GetReadyCount(TaskScheduler::HIGH));
+    EXPECT_EQ(2, scheduler_->GetReadyCount(TaskScheduler::LOW));
+    Release();
+
+    vector<string> expected = boost::assign::list_of("H1")("L1")("L2");
+    EXPECT_EQ(expected, log_.names());
+}
+
+// Policies are checked again when ready tasks are dispatched, so tasks that
+// exclude each other do not run at the same time when there are threads for
+// all of them
+TEST_F(TaskPriorityTest, PolicyOnDispatch) {
+    TaskPolicy policy = boost::assign::list_of
+        (TaskExclusion(TaskId("test::ExclusiveLow")));
+    scheduler_->SetPolicy(TaskId("test::ExclusiveHigh"), policy);
+    scheduler_->SetPriority(TaskId("test::ExclusiveHigh"),
+                            TaskScheduler::HIGH);
+    scheduler_->SetPriority(TaskId("test::ExclusiveLow"), TaskScheduler::LOW);
+
+    tbb::atomic<int> active[2];
+    active[0] = active[1] = 0;
+    tbb::atomic<bool> overlap;
+    overlap = false;
+    tbb::atomic<int> done;
+    done = 0;
+
+    Block();
+    for (int i = 0; i < 10; i++) {
+        const char *group = (i % 2) ? "test::ExclusiveHigh" :
+                                      "test::ExclusiveLow";
+        scheduler_->Enqueue(new ExclusiveTask(TaskId(group), &active[i % 2],
+            &active[1 - i % 2], &overlap, &done));
+    }
+    EXPECT_EQ(5, scheduler_->GetReadyCount(TaskScheduler::HIGH));
+    EXPECT_EQ(5, scheduler_->GetReadyCount(TaskScheduler::LOW));
+    scheduler_->SetMaxThreadCount(4);
+    Release();
+
+    EXPECT_EQ(10, done);
+    EXPECT_FALSE(overlap);
+}
+
+// The exit of a task walks the deferq_ of its group and of its instance.
+// The tasks started by the walk wait in the ready queues until the walk is
+// done, and then are dispatched without overlapping.
+TEST_F(TaskPriorityTest, DeferQWalk) {
+    TaskPolicy policy = boost::assign::list_of
+        (TaskExclusion(TaskId("test::DeferPeer")));
+    scheduler_->SetPolicy(TaskId("test::DeferInstance"), policy);
+    scheduler_->SetMaxThreadCount(4);
+
+    tbb::atomic<int> active[2];
+    active[0] = active[1] = 0;
+    tbb::atomic<bool> overlap;
+    overlap = false;
+    tbb::atomic<int> done;
+    done = 0;
+
+    running_ = false;
+    release_ = false;
+    scheduler_->Enqueue(new BlockTask(TaskId("test::DeferInstance"),
+                                      &running_, &release_, 0));
+    TASK_UTIL_EXPECT_TRUE(running_);
+
+    // Tasks of the instance wait in the deferq_ of the instance, and those
+    // of the peer in the deferq_ of the group
+    for (int i = 0; i < 10; i++) {
+        if (i % 2) {
+            scheduler_->Enqueue(new ExclusiveTask(TaskId("test::DeferPeer"),
+                &active[1], &active[0], &overlap, &done));
+        } else {
+            scheduler_->Enqueue(new ExclusiveTask(
+                TaskId("test::DeferInstance"), &active[0], &active[1],
+                &overlap, &done, 0));
+        }
+    }
+    EXPECT_EQ(0, scheduler_->GetReadyCount(TaskScheduler::NORMAL));
+    Release();
+
+    EXPECT_EQ(10, done);
+    EXPECT_FALSE(overlap);
+    EXPECT_TRUE(scheduler_->IsEmpty());
+}
+
+// Keepalives are not held up by long table walks of a lower class
+TEST_F(TaskPriorityTest, KeepaliveLatency) {
+    const int kWalks = scheduler_->HardwareThreadCount() * 16;
+    const int kKeepalives = 50;
+    const uint64_t kChunkUsec = 5000;
+    scheduler_->SetPriority(TaskId("test::Keepalive"), TaskScheduler::HIGH);
+
+    for (int i = 0; i < kWalks; i++) {
+        scheduler_->Enqueue(new WalkTask(TaskId("db::DBTable"), i, 20,
+                                         kChunkUsec));
+    }
+    tbb::atomic<uint64_t> max_latency;
+    max_latency = 0;
+    for (int i = 0; i < kKeepalives; i++) {
+        scheduler_->Enqueue(new KeepaliveTask(TaskId("test::Keepalive"),
+                                              &max_latency));
+        usleep(kChunkUsec);
+    }
+    EXPECT_LT(0, scheduler_->GetReadyCount(TaskScheduler::NORMAL));
+    task_util::WaitForIdle();
+
+    // A keepalive waits for a walk chunk to finish, rather than for the
+    // walks ahead of it
+    uint64_t latency = max_latency;
+    cout << "Max keepalive latency " << latency << " usec" << endl;
+    EXPECT_GT(kChunkUsec * 4, latency);
+}
+
+int main(int argc, char *argv[]) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <sys/resource.h>
+#include <iostream>
+#include <vector>
+#include <boost/bind.hpp>
+#include "tbb/atomic.h"
+#include "io/test/event_manager_test.h"
+#include "base/test/task_test_util.h"
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "base/timer.h"
+#include "base/timer_wheel.h"
+#include "testing/gunit.h"
+
+using namespace std;
+using tbb::atomic;
+
+static atomic<int> timer_count_;
+
+static bool TimerCb() {
+    timer_count_.fetch_and_increment();
+    return false;
+}
+
+static bool PeriodicTimerCb() {
+    timer_count_.fetch_and_increment();
+    return true;
+}
+
+static bool CountdownTimerCb() {
+    return timer_count_.fetch_and_decrement() > 1;
+}
+
+static bool RescheduleTimerCb(Timer *timer) {
+    timer_count_.fetch_and_increment();
+    if (timer->time() == 10) {
+        timer->Reschedule(50);
+        return true;
+    }
+    return false;
+}
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    TimerWheelTest() : evm_(new EventManager()) {
+    }
+
+    virtual void SetUp() {
+        wheel_.reset(new TimerWheel(*evm_->io_service(), 1));
+        thread_.reset(new ServerThread(evm_.get()));
+        thread_->Start();
+        timer_count_ = 0;
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+        task_util::WaitForIdle();
+        wheel_.reset();
+    }
+
+    Timer *CreateTimer(const string &name) {
+        return TimerManager::CreateTimer(wheel_.get(), name);
+    }
+
+    auto_ptr<EventManager> evm_;
+    auto_ptr<ServerThread> thread_;
+    auto_ptr<TimerWheel> wheel_;
+};
+
+TEST_F(TimerWheelTest, Basic) {
+    // Coarse ticks so that all timers expire on the same tick.
+    wheel_.reset(new TimerWheel(*evm_->io_service(), 100));
+    vector<Timer *> timers;
+    for (int i = 0; i < 5; i++) {
+        timers.push_back(CreateTimer("Basic"));
+        timers.back()->Start(20, TimerCb);
+    }
+    TASK_UTIL_EXPECT_EQ(5, timer_count_);
+    TASK_UTIL_EXPECT_EQ(0, wheel_->size());
+    task_util::WaitForIdle();
+
+    // All timers expired on the same tick and ran in a single task.
+    EXPECT_EQ(5, wheel_->expired());
+    EXPECT_EQ(1, wheel_->tasks());
+    for (size_t i = 0; i < timers.size(); i++) {
+        EXPECT_FALSE(timers[i]->running());
+        EXPECT_TRUE(TimerManager::DeleteTimer(timers[i]));
+    }
+}
+
+TEST_F(TimerWheelTest, Periodic) {
+    Timer *timer = CreateTimer("Periodic");
+    timer_count_ = 10;
+    timer->Start(5, CountdownTimerCb);
+    TASK_UTIL_EXPECT_EQ(0, timer_count_);
+    task_util::WaitForIdle();
+    EXPECT_FALSE(timer->running());
+    EXPECT_EQ(10, wheel_->expired());
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer));
+}
+
+TEST_F(TimerWheelTest, Cancel) {
+    Timer *timer = CreateTimer("Cancel");
+    timer->Start(20, TimerCb);
+    EXPECT_EQ(1, wheel_->size());
+    EXPECT_TRUE(timer->Cancel());
+    EXPECT_EQ(0, wheel_->size());
+    usleep(50000);
+    task_util::WaitForIdle();
+    EXPECT_EQ(0, timer_count_);
+
+    timer->Start(20, TimerCb);
+    TASK_UTIL_EXPECT_EQ(1, timer_count_);
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer));
+}
+
+// Deleting a running timer releases the reference held by the wheel.
+TEST_F(TimerWheelTest, DeleteRunning) {
+    Timer *timer = CreateTimer("Delete");
+    timer->Start(10000, TimerCb);
+    EXPECT_EQ(1, wheel_->size());
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer));
+    EXPECT_EQ(0, wheel_->size());
+}
+
+// Restarting a running timer is a no-op, as with ASIO backed timers.
+TEST_F(TimerWheelTest, StartRunning) {
+    Timer *timer = CreateTimer("StartRunning");
+    timer->Start(20, TimerCb);
+    timer->Start(20, TimerCb);
+    EXPECT_EQ(1, wheel_->size());
+    TASK_UTIL_EXPECT_EQ(1, timer_count_);
+    task_util::WaitForIdle();
+    EXPECT_EQ(1, timer_count_);
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer));
+}
+
+TEST_F(TimerWheelTest, Reschedule) {
+    Timer *timer = CreateTimer("Reschedule");
+    timer->Start(10, boost::bind(&RescheduleTimerCb, timer));
+    TASK_UTIL_EXPECT_EQ(2, timer_count_);
+    EXPECT_EQ(50, timer->time());
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer));
+}
+
+// Timers beyond the first level cascade down before they expire, in order
+// of their timeout.
+TEST_F(TimerWheelTest, Cascade) {
+    Timer *timer1 = CreateTimer("Cascade-1");
+    Timer *timer2 = CreateTimer("Cascade-2");
+    uint64_t start = ClockMonotonicUsec();
+    timer1->Start(300, TimerCb);
+    timer2->Start(600, TimerCb);
+    TASK_UTIL_EXPECT_EQ(1, timer_count_);
+    EXPECT_LE(300000, ClockMonotonicUsec() - start);
+    EXPECT_TRUE(timer2->running());
+    TASK_UTIL_EXPECT_EQ(2, timer_count_);
+    EXPECT_LE(600000, ClockMonotonicUsec() - start);
+    EXPECT_LE(1, wheel_->cascaded());
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer1));
+    EXPECT_TRUE(TimerManager::DeleteTimer(timer2));
+}
+
+//
+// Run kTimers periodic timers for kDurationMsec on either backend and
+// report the number of expirations, tasks and the cpu time of the process.
+//
+class TimerWheelBenchmark : public TimerWheelTest {
+protected:
+    static const int kTimers = 100000;
+    static const int kIntervalMsec = 100;
+    static const int kDurationMsec = 2000;
+
+    static uint64_t CpuUsec() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+
+    void Run(const string &backend, bool use_wheel) {
+        vector<Timer *> timers;
+        for (int i = 0; i < kTimers; i++) {
+            if (use_wheel) {
+                timers.push_back(CreateTimer("Benchmark"));
+            } else {
+                timers.push_back(TimerManager::CreateTimer(
+                    *evm_->io_service(), "Benchmark"));
+            }
+        }
+
+        uint64_t cpu = CpuUsec();
+        for (int i = 0; i < kTimers; i++) {
+            timers[i]->Start(kIntervalMsec, PeriodicTimerCb);
+        }
+        usleep(kDurationMsec * 1000);
+        for (int i = 0; i < kTimers; i++) {
+            TimerManager::DeleteTimer(timers[i]);
+        }
+        task_util::WaitForIdle();
+        cpu = CpuUsec() - cpu;
+
+        cout << backend << ": " << kTimers << " timers of " << kIntervalMsec
+             << " msec for " << kDurationMsec << " msec, " << timer_count_
+             << " expirations";
+        if (use_wheel) {
+            cout << " in " << wheel_->tasks() << " tasks";
+        }
+        cout << ", " << cpu << " usec cpu" << endl;
+        EXPECT_LT(0, timer_count_);
+    }
+};
+
+TEST_F(TimerWheelBenchmark, Asio) {
+    Run("asio", false);
+}
+
+TEST_F(TimerWheelBenchmark, Wheel) {
+    Run("wheel", true);
+    EXPECT_GT(wheel_->expired() / 100, wheel_->tasks());
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    int result = RUN_ALL_TESTS();
+    task_util::WaitForIdle();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
@@ -2,6 +2,13 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <pthread.h>
+#include <set>
+#include <vector>
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+
+#include "base/time_util.h"
 #include "testing/gunit.h"
 #include "base/trace.h"
 
@@ -10,6 +17,245 @@ namespace {
 class TraceTest : public ::testing::Test {
 };
 
+// Counts the entries not deleted yet
+struct TraceInt {
+    explicit TraceInt(int v) : value(v) { live++; }
+    ~TraceInt() { live--; }
+    int value;
+    static tbb::atomic<int> live;
+};
+
+tbb::atomic<int> TraceInt::live;
+
+static const size_t kBufSize = 64;
+
+class TraceBufferTest : public ::testing::Test {
+protected:
+    // A single thread can fill the buffer
+    TraceBufferTest() : trace_buf_("TraceBufferTest", kBufSize, true, 1) {
+    }
+
+    void ReadCb(TraceInt *entry, bool more, std::vector<int> *values,
+                std::vector<bool> *mores) {
+        values->push_back(entry->value);
+        mores->push_back(more);
+    }
+
+    std::vector<int> Read(const std::string &context, int count) {
+        std::vector<int> values;
+        std::vector<bool> mores;
+        trace_buf_.TraceRead(context, count,
+            boost::bind(&TraceBufferTest::ReadCb, this, _1, _2, &values,
+                        &mores));
+        // more is set unless the entry is the newest in the buffer
+        for (size_t i = 0; i + 1 < mores.size(); i++) {
+            EXPECT_TRUE(mores[i]);
+        }
+        return values;
+    }
+
+    TraceBuffer<TraceInt> trace_buf_;
+};
+
+struct Writer {
+    Writer() : trace_buf(NULL), id(0), count(0), record(false) { }
+
+    TraceBuffer<TraceInt> *trace_buf;
+    int id;
+    int count;
+    bool record;
+    std::vector<uint32_t> seqnos;
+};
+
+static void *WriteTraces(void *arg) {
+    Writer *writer = static_cast<Writer *>(arg);
+    for (int i = 0; i < writer->count; i++) {
+        uint32_t seqno =
+            writer->trace_buf->TraceWrite(new TraceInt(writer->id));
+        if (writer->record) {
+            writer->seqnos.push_back(seqno);
+        }
+    }
+    return NULL;
+}
+
+static void CountEntry(size_t *count) {
+    (*count)++;
+}
+
+static void RunWriters(std::vector<Writer> *writers) {
+    std::vector<pthread_t> threads(writers->size());
+    for (size_t i = 0; i < writers->size(); i++) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, &WriteTraces,
+                                    &(*writers)[i]));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// Entries are read back oldest first, and only the last kBufSize are kept
+TEST_F(TraceBufferTest, Wrap) {
+    EXPECT_TRUE(Read("ctx", 0).empty());
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(static_cast<uint32_t>(i + 1),
+                  trace_buf_.TraceWrite(new TraceInt(i)));
+    }
+    std::vector<int> values = Read("ctx", 0);
+    ASSERT_EQ(10U, values.size());
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(i, values[i]);
+    }
+    trace_buf_.TraceReadDone("ctx");
+
+    int total = kBufSize * 3 + 10;
+    for (int i = 10; i < total; i++) {
+        trace_buf_.TraceWrite(new TraceInt(i));
+    }
+    values = Read("ctx", 0);
+    ASSERT_EQ(kBufSize, values.size());
+    for (size_t i = 0; i < kBufSize; i++) {
+        EXPECT_EQ(static_cast<int>(total - kBufSize + i), values[i]);
+    }
+    trace_buf_.TraceReadDone("ctx");
+}
+
+// A read context resumes where the previous read stopped, or from the
+// oldest entry if that has been overwritten
+TEST_F(TraceBufferTest, ReadContext) {
+    for (int i = 0; i < 20; i++) {
+        trace_buf_.TraceWrite(new TraceInt(i));
+    }
+    std::vector<int> values = Read("ctx", 8);
+    ASSERT_EQ(8U, values.size());
+    EXPECT_EQ(0, values.front());
+    values = Read("ctx", 8);
+    ASSERT_EQ(8U, values.size());
+    EXPECT_EQ(8, values.front());
+    values = Read("other", 5);
+    ASSERT_EQ(5U, values.size());
+    EXPECT_EQ(0, values.front());
+
+    values = Read("ctx", 8);
+    ASSERT_EQ(4U, values.size());
+    EXPECT_EQ(16, values.front());
+    EXPECT_TRUE(Read("ctx", 8).empty());
+
+    for (int i = 20; i < 20 + static_cast<int>(kBufSize); i++) {
+        trace_buf_.TraceWrite(new TraceInt(i));
+    }
+    values = Read("ctx", 1);
+    ASSERT_EQ(1U, values.size());
+    EXPECT_EQ(20, values.front());
+    values = Read("other", 1);
+    ASSERT_EQ(1U, values.size());
+    EXPECT_EQ(20, values.front());
+
+    trace_buf_.TraceReadDone("ctx");
+    values = Read("ctx", 1);
+    ASSERT_EQ(1U, values.size());
+    EXPECT_EQ(20, values.front());
+    trace_buf_.TraceReadDone("ctx");
+    trace_buf_.TraceReadDone("other");
+}
+
+// Writers in many threads get distinct sequence numbers, and the entries of
+// each writer are read back in the order written
+TEST_F(TraceBufferTest, ConcurrentWrite) {
+    std::vector<Writer> writers(8);
+    for (size_t i = 0; i < writers.size(); i++) {
+        writers[i].trace_buf = &trace_buf_;
+        writers[i].id = i;
+        writers[i].count = 1000;
+        writers[i].record = true;
+    }
+    RunWriters(&writers);
+
+    std::set<uint32_t> seqnos;
+    for (size_t i = 0; i < writers.size(); i++) {
+        seqnos.insert(writers[i].seqnos.begin(), writers[i].seqnos.end());
+    }
+    EXPECT_EQ(8000U, seqnos.size());
+    EXPECT_EQ(1U, *seqnos.begin());
+    EXPECT_EQ(8000U, *seqnos.rbegin());
+
+    std::vector<int> values = Read("ctx", 0);
+    EXPECT_EQ(kBufSize, values.size());
+    trace_buf_.TraceReadDone("ctx");
+}
+
+// Reads run while writers overwrite the entries being read
+TEST_F(TraceBufferTest, ConcurrentRead) {
+    std::vector<Writer> writers(4);
+    for (size_t i = 0; i < writers.size(); i++) {
+        writers[i].trace_buf = &trace_buf_;
+        writers[i].id = i;
+        writers[i].count = 100000;
+    }
+    std::vector<pthread_t> threads(writers.size());
+    for (size_t i = 0; i < writers.size(); i++) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, &WriteTraces,
+                                    &writers[i]));
+    }
+    for (int i = 0; i < 1000; i++) {
+        std::vector<int> values = Read("ctx", 0);
+        EXPECT_GE(kBufSize, values.size());
+        for (size_t j = 0; j < values.size(); j++) {
+            EXPECT_GT(4, values[j]);
+        }
+        trace_buf_.TraceReadDone("ctx");
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+    EXPECT_EQ(kBufSize, Read("ctx", 0).size());
+    trace_buf_.TraceReadDone("ctx");
+
+    // The entries retired during the reads are deleted once they are done,
+    // leaving only those in the segments of the writers
+    EXPECT_EQ(static_cast<int>(writers.size() * kBufSize), TraceInt::live);
+}
+
+// Each thread writes to a ring of size / concurrency entries, and a thread
+// beyond concurrency adds a ring of the same size
+TEST_F(TraceTest, SegmentSize) {
+    {
+        TraceBuffer<TraceInt> trace_buf("SegmentSize", kBufSize, true, 4);
+        std::vector<Writer> writers(5);
+        for (size_t i = 0; i < writers.size(); i++) {
+            writers[i].trace_buf = &trace_buf;
+            writers[i].id = i;
+            writers[i].count = 1000;
+        }
+        RunWriters(&writers);
+        EXPECT_EQ(static_cast<int>(kBufSize + kBufSize / 4), TraceInt::live);
+
+        size_t count = 0;
+        trace_buf.TraceRead("ctx", 0, boost::bind(&CountEntry, &count));
+        EXPECT_EQ(kBufSize, count);
+    }
+    EXPECT_EQ(0, TraceInt::live);
+}
+
+// Trace writes per second with 16 concurrent writers
+TEST_F(TraceTest, ConcurrentWriteRate) {
+    TraceBuffer<TraceInt> trace_buf("ConcurrentWriteRate", 10000, true);
+    std::vector<Writer> writers(16);
+    for (size_t i = 0; i < writers.size(); i++) {
+        writers[i].trace_buf = &trace_buf;
+        writers[i].id = i;
+        writers[i].count = 100000;
+    }
+    uint64_t start = ClockMonotonicUsec();
+    RunWriters(&writers);
+    uint64_t usec = ClockMonotonicUsec() - start;
+    uint64_t writes = writers.size() * writers[0].count;
+    std::cout << writers.size() << " writers: " << writes << " writes in "
+              << usec / 1000 << " msec, "
+              << writes * 1000000 / (usec ? usec : 1) << " writes/sec"
+              << std::endl;
+}
+
 class TraceStruct {
     char data[4096];
 };
@@ -4,6 +4,7 @@
 
 #include "base/timer.h"
 #include "base/timer_impl.h"
+#include "base/timer_wheel.h"
 
 class Timer::TimerTask : public Task {
 public:
@@ -86,12 +87,36 @@ Timer::Timer(boost::asio::io_service &service, const std::string &name,
           task_id_(task_id),
           task_instance_(task_instance),
           seq_no_(0),
-          delete_on_completion_(delete_on_completion) {
+          delete_on_completion_(delete_on_completion),
+          wheel_(NULL),
+          wheel_expiry_(0),
+          wheel_seq_no_(0),
+          wheel_time_(0) {
+    refcount_ = 0;
+}
+
+Timer::Timer(TimerWheel *wheel, const std::string &name,
+          int task_id, int task_instance, bool delete_on_completion)
+        : name_(name),
+          handler_(NULL),
+          error_handler_(NULL),
+          state_(Init),
+          timer_task_(NULL),
+          time_(0),
+          task_id_(task_id),
+          task_instance_(task_instance),
+          seq_no_(0),
+          delete_on_completion_(delete_on_completion),
+          wheel_(wheel),
+          wheel_expiry_(0),
+          wheel_seq_no_(0),
+          wheel_time_(0) {
     refcount_ = 0;
 }
 
 Timer::~Timer() {
     assert(state_ != Running && state_ != Fired);
+    assert(!wheel_hook_.is_linked());
 }
 
 //
@@ -114,6 +139,12 @@ bool Timer::Start(int time, Handler handler, ErrorHandler error_handler) {
     handler_ = handler;
     seq_no_++;
     error_handler_ = error_handler;
+    if (wheel_) {
+        SetState(Running);
+        wheel_->Add(this, time, seq_no_);
+        return true;
+    }
+
     boost::system::error_code ec;
     impl_->expires_from_now(time, ec);
     if (ec) {
@@ -141,6 +172,8 @@ bool Timer::Reschedule(int time)
 
 // Cancel a running timer
 bool Timer::Cancel() {
+    // Reference held by the wheel, released after the mutex
+    TimerPtr wheel_reference;
     tbb::mutex::scoped_lock lock(mutex_);
 
     // A fired timer cannot be cancelled
@@ -157,6 +190,12 @@ bool Timer::Cancel() {
         timer_task_ = NULL;
     }
 
+    // Timers that already expired on the wheel are skipped by the wheel
+    // task as they are no longer running.
+    if (wheel_) {
+        wheel_reference = wheel_->Remove(this);
+    }
+
     SetState(Cancelled);
     return true;
 }
@@ -186,6 +225,34 @@ void Timer::StartTimerTask(TimerPtr reference, int time, uint32_t seq_no,
     TaskScheduler::GetInstance()->Enqueue(timer_task_);
 }
 
+//
+// Invoke the user callback of a timer that expired on a TimerWheel, unless
+// the timer was cancelled, or cancelled and started again, since.
+//
+void Timer::RunWheelTimer(uint32_t seq_no, int time) {
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        if (state_ != Running || seq_no_ != seq_no) {
+            return;
+        }
+        time_ = time;
+        SetState(Fired);
+    }
+
+    bool restart = handler_();
+
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        SetState(Init);
+    }
+
+    if (restart) {
+        Start(time_, handler_, error_handler_);
+    } else if (delete_on_completion_) {
+        TimerManager::DeleteTimer(this);
+    }
+}
+
 //
 // TimerManager class routines
 //
@@ -201,6 +268,15 @@ Timer *TimerManager::CreateTimer(
     return timer;
 }
 
+Timer *TimerManager::CreateTimer(
+            TimerWheel *wheel, const std::string &name,
+            int task_id, int task_instance, bool delete_on_completion) {
+    Timer *timer = new Timer(wheel, name, task_id, task_instance,
+                             delete_on_completion);
+    AddTimer(timer);
+    return timer;
+}
+
 void TimerManager::AddTimer(Timer *timer) {
     tbb::mutex::scoped_lock lock(mutex_);
     timer_ref_.insert(TimerPtr(timer));
@@ -24,6 +24,11 @@
 //    Cancels the timer and triggers deletion of the timer. Application should
 //    not access the timer after its deleted
 //
+//  Timers are backed either by their own ASIO timer, or by a TimerWheel
+//  shared by many timers (see base/timer_wheel.h). The wheel dispatches the
+//  timers that expire on the same tick in a single task per task-id and
+//  instance, which is much cheaper for large numbers of periodic timers.
+//
 //  Concurrency aspects:
 //  - Timer is allocated by application
 //  - Applications must call TimerManager::DeleteTimer() to delete the timer
@@ -43,12 +48,14 @@
 #include <boost/intrusive_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/asio.hpp>
+#include <boost/intrusive/list.hpp>
 #include <boost/system/error_code.hpp>
 #include <set>
 
 #include <base/task.h>
 
 class TimerImpl;
+class TimerWheel;
 
 class Timer {
 private:
@@ -62,6 +69,8 @@ public:
 
     Timer(boost::asio::io_service &service, const std::string &name,
           int task_id, int task_instance, bool delete_on_completion = false);
+    Timer(TimerWheel *wheel, const std::string &name,
+          int task_id, int task_instance, bool delete_on_completion = false);
     virtual ~Timer();
 
     // Start a timer
@@ -124,6 +133,7 @@ public:
 private:
     friend class TimerManager;
     friend class TimerTest;
+    friend class TimerWheel;
 
     friend void intrusive_ptr_add_ref(Timer *timer);
     friend void intrusive_ptr_release(Timer *timer);
@@ -141,6 +151,9 @@ private:
                         int time, uint32_t seq_no,
                         const boost::system::error_code &ec);
 
+    // Invoked in the task of the TimerWheel tick on which the timer expired.
+    void RunWheelTimer(uint32_t seq_no, int time);
+
     void SetState(TimerState s) { state_ = s; }
     static int GetTimerInstanceId() { return -1; }
     static int GetTimerTaskId() {
@@ -166,6 +179,14 @@ private:
     uint32_t seq_no_;
     bool delete_on_completion_;
     tbb::atomic<int> refcount_;
+
+    // Set for timers backed by a TimerWheel. The remaining fields are
+    // protected by the mutex of the wheel.
+    TimerWheel *wheel_;
+    boost::intrusive::list_member_hook<> wheel_hook_;
+    uint64_t wheel_expiry_;
+    uint32_t wheel_seq_no_;
+    int wheel_time_;
 };
 
 inline void intrusive_ptr_add_ref(Timer *timer) {
@@ -198,6 +219,11 @@ public:
                               int task_id = Timer::GetTimerTaskId(),
                               int task_instance = Timer::GetTimerInstanceId(),
                               bool delete_on_completion = false);
+    static Timer *CreateTimer(TimerWheel *wheel,
+                              const std::string &name,
+                              int task_id = Timer::GetTimerTaskId(),
+                              int task_instance = Timer::GetTimerInstanceId(),
+                              bool delete_on_completion = false);
     static bool DeleteTimer(Timer *Timer);
 
 private:
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/timer_wheel.h"
+
+#include <map>
+#include <boost/bind.hpp>
+
+#include "base/time_util.h"
+#include "base/timer_impl.h"
+
+using namespace std;
+
+//
+// Task that runs the callbacks of all timers with the same task-id and
+// instance that expired on a tick.
+//
+class TimerWheel::TimerWheelTask : public Task {
+public:
+    TimerWheelTask(int task_id, int task_instance)
+        : Task(task_id, task_instance) {
+    }
+
+    void Append(const ExpiredTimer &timer) {
+        timers_.push_back(timer);
+    }
+
+    virtual bool Run() {
+        for (ExpiredList::iterator iter = timers_.begin();
+             iter != timers_.end(); ++iter) {
+            iter->timer->RunWheelTimer(iter->seq_no, iter->time);
+        }
+        return true;
+    }
+
+private:
+    ExpiredList timers_;
+    DISALLOW_COPY_AND_ASSIGN(TimerWheelTask);
+};
+
+TimerWheel::TimerWheel(boost::asio::io_service &service, int tick_msec)
+    : tick_msec_(tick_msec > 0 ? tick_msec : kDefaultTickMsec),
+      start_usec_(ClockMonotonicUsec()),
+      impl_(new TimerImpl(service)),
+      ticking_(false),
+      current_(0),
+      size_(0) {
+    ticks_ = 0;
+    expired_ = 0;
+    tasks_ = 0;
+    cascaded_ = 0;
+}
+
+TimerWheel::~TimerWheel() {
+    Shutdown();
+}
+
+void TimerWheel::Shutdown() {
+    ExpiredList timers;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        boost::system::error_code ec;
+        impl_->cancel(ec);
+        ticking_ = false;
+        for (uint64_t index = 0; index < kLevel0Size; index++) {
+            while (!level0_[index].empty()) {
+                Timer *timer = &level0_[index].front();
+                level0_[index].pop_front();
+                timers.push_back(ExpiredTimer(timer));
+            }
+        }
+        for (int level = 0; level < kLevels; level++) {
+            for (uint64_t index = 0; index < kLevelSize; index++) {
+                while (!levels_[level][index].empty()) {
+                    Timer *timer = &levels_[level][index].front();
+                    levels_[level][index].pop_front();
+                    timers.push_back(ExpiredTimer(timer));
+                }
+            }
+        }
+        size_ = 0;
+    }
+
+    // The timers stay in the running state and are never fired.
+}
+
+size_t TimerWheel::size() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return size_;
+}
+
+// The tick in which the current time falls.
+uint64_t TimerWheel::CurrentTick() const {
+    return (ClockMonotonicUsec() - start_usec_) / (tick_msec_ * 1000);
+}
+
+//
+// Add a timer to expire after time msec. The wheel holds a reference to
+// the timer until it expires or is removed.
+//
+void TimerWheel::Add(Timer *timer, int time, uint32_t seq_no) {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    // An empty wheel restarts at the next tick.
+    if (!ticking_ && size_ == 0) {
+        current_ = CurrentTick() + 1;
+    }
+
+    if (timer->wheel_hook_.is_linked()) {
+        Unlink(timer);
+    } else {
+        intrusive_ptr_add_ref(timer);
+        size_++;
+    }
+
+    // Round up so that the timer never expires early, even if the tick
+    // handler is running late.
+    uint64_t ticks = (time + tick_msec_ - 1) / tick_msec_;
+    uint64_t base = max(current_, CurrentTick() + 1);
+    timer->wheel_expiry_ = base + min(ticks, kMaxTicks - (base - current_));
+    timer->wheel_seq_no_ = seq_no;
+    timer->wheel_time_ = time;
+    Insert(timer);
+
+    if (!ticking_) {
+        StartTick();
+    }
+}
+
+TimerWheel::TimerPtr TimerWheel::Remove(Timer *timer) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (!timer->wheel_hook_.is_linked()) {
+        return TimerPtr();
+    }
+    Unlink(timer);
+    size_--;
+
+    // Adopt the reference held by the wheel.
+    return TimerPtr(timer, false);
+}
+
+// Unlink the timer from whichever slot it is in.
+void TimerWheel::Unlink(Timer *timer) {
+    TimerList::node_ptr node = TimerList::value_traits::to_node_ptr(*timer);
+    TimerList::node_algorithms::unlink(node);
+    TimerList::node_algorithms::init(node);
+}
+
+//
+// Insert the timer in the slot of the lowest level that covers its expiry.
+//
+void TimerWheel::Insert(Timer *timer) {
+    uint64_t expiry = timer->wheel_expiry_;
+    uint64_t delta = expiry - current_;
+    if (delta < kLevel0Size) {
+        level0_[expiry & (kLevel0Size - 1)].push_back(*timer);
+        return;
+    }
+
+    int shift = kLevel0Bits;
+    for (int level = 0; level < kLevels; level++) {
+        if (delta < (1ULL << (shift + kLevelBits)) || level == kLevels - 1) {
+            levels_[level][(expiry >> shift) & (kLevelSize - 1)].push_back(
+                *timer);
+            return;
+        }
+        shift += kLevelBits;
+    }
+}
+
+//
+// Re-insert the timers of a slot of a level, when the level below it has
+// completed a turn.
+//
+void TimerWheel::Cascade(int level, uint64_t index) {
+    TimerList list;
+    list.swap(levels_[level][index]);
+    while (!list.empty()) {
+        Timer *timer = &list.front();
+        list.pop_front();
+        Insert(timer);
+        cascaded_++;
+    }
+}
+
+//
+// Collect the timers that expire on tick current_ and move to the next.
+//
+void TimerWheel::Expire(ExpiredList *expired) {
+    uint64_t index = current_ & (kLevel0Size - 1);
+    if (index == 0) {
+        int shift = kLevel0Bits;
+        for (int level = 0; level < kLevels; level++) {
+            uint64_t level_index = (current_ >> shift) & (kLevelSize - 1);
+            Cascade(level, level_index);
+            if (level_index != 0) {
+                break;
+            }
+            shift += kLevelBits;
+        }
+    }
+
+    TimerList &slot = level0_[index];
+    while (!slot.empty()) {
+        Timer *timer = &slot.front();
+        slot.pop_front();
+        size_--;
+        expired->push_back(ExpiredTimer(timer));
+    }
+    current_++;
+    ticks_++;
+}
+
+void TimerWheel::StartTick() {
+    uint64_t now = ClockMonotonicUsec() - start_usec_;
+    uint64_t next = current_ * tick_msec_ * 1000;
+    int delay = next > now ? (next - now + 999) / 1000 : 0;
+
+    boost::system::error_code ec;
+    impl_->expires_from_now(delay, ec);
+    if (ec) {
+        ticking_ = false;
+        return;
+    }
+    ticking_ = true;
+    impl_->async_wait(boost::bind(&TimerWheel::TickHandler, this,
+                                  boost::asio::placeholders::error));
+}
+
+//
+// Concurrency: called in the context of the ASIO thread.
+//
+// Process all ticks up to the current time, and keep ticking as long as
+// there are timers on the wheel.
+//
+void TimerWheel::TickHandler(const boost::system::error_code &ec) {
+    if (ec && ec.value() == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    ExpiredList expired;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        if (!ticking_) {
+            return;
+        }
+        uint64_t tick = CurrentTick();
+        while (current_ <= tick) {
+            Expire(&expired);
+        }
+        if (size_) {
+            StartTick();
+        } else {
+            ticking_ = false;
+        }
+    }
+
+    Dispatch(&expired);
+}
+
+//
+// Enqueue a task for each task-id and instance of the expired timers.
+//
+void TimerWheel::Dispatch(ExpiredList *expired) {
+    if (expired->empty()) {
+        return;
+    }
+    expired_ += expired->size();
+
+    typedef map<pair<int, int>, TimerWheelTask *> TaskMap;
+    TaskMap tasks;
+    for (ExpiredList::iterator iter = expired->begin();
+         iter != expired->end(); ++iter) {
+        pair<int, int> key(iter->timer->task_id_,
+                           iter->timer->task_instance_);
+        TaskMap::iterator loc = tasks.find(key);
+        if (loc == tasks.end()) {
+            loc = tasks.insert(make_pair(key,
+                new TimerWheelTask(key.first, key.second))).first;
+        }
+        loc->second->Append(*iter);
+    }
+
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    for (TaskMap::iterator iter = tasks.begin(); iter != tasks.end();
+         ++iter) {
+        scheduler->Enqueue(iter->second);
+        tasks_++;
+    }
+}
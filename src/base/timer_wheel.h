@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+//  Hierarchical timer wheel backend for Timer.
+//
+//  A TimerWheel drives any number of timers from a single ASIO timer that
+//  ticks every tick_msec milliseconds while any of its timers is running.
+//  Timer expiry is rounded up to the next tick.
+//
+//  Timers are kept in a hierarchy of hashed wheels: 256 slots of one tick
+//  followed by 4 levels of 64 slots, each slot of a level spanning a full
+//  turn of the level below. Starting and cancelling a timer is O(1), and
+//  timers move down a level at most once per level as their expiry gets
+//  closer (cascading).
+//
+//  All timers that expire on a tick are dispatched with a single task per
+//  task-id and instance, instead of a task per timer, so that thousands of
+//  periodic timers (e.g. BFD or keepalive timers) do not dominate the
+//  scheduler.
+//
+//  Timers are created on a wheel with TimerManager::CreateTimer(wheel, ...)
+//  and otherwise used like ASIO backed timers. The wheel must outlive its
+//  timers and the io_service must not run the wheel after it is deleted.
+//
+
+#ifndef BASE_TIMER_WHEEL_H_
+#define BASE_TIMER_WHEEL_H_
+
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/intrusive/list.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <tbb/mutex.h>
+
+#include "base/timer.h"
+#include "base/util.h"
+
+class TimerImpl;
+
+class TimerWheel {
+public:
+    static const int kDefaultTickMsec = 10;
+
+    explicit TimerWheel(boost::asio::io_service &service,
+                        int tick_msec = kDefaultTickMsec);
+    ~TimerWheel();
+
+    // Cancel the ASIO timer and release all timers on the wheel.
+    void Shutdown();
+
+    int tick_msec() const { return tick_msec_; }
+
+    // Number of timers running on the wheel.
+    size_t size() const;
+
+    // Statistics
+    uint64_t ticks() const { return ticks_; }
+    uint64_t expired() const { return expired_; }
+    uint64_t tasks() const { return tasks_; }
+    uint64_t cascaded() const { return cascaded_; }
+
+private:
+    friend class Timer;
+    class TimerWheelTask;
+
+    typedef boost::intrusive_ptr<Timer> TimerPtr;
+    typedef boost::intrusive::member_hook<Timer,
+        boost::intrusive::list_member_hook<>, &Timer::wheel_hook_> TimerHook;
+    // Timers are unlinked without knowing their slot, so the slots do not
+    // keep a count.
+    typedef boost::intrusive::list<Timer, TimerHook,
+        boost::intrusive::constant_time_size<false> > TimerList;
+
+    struct ExpiredTimer {
+        ExpiredTimer(Timer *timer)
+            : timer(timer, false), seq_no(timer->wheel_seq_no_),
+              time(timer->wheel_time_) {
+        }
+        TimerPtr timer;
+        uint32_t seq_no;
+        int time;
+    };
+    typedef std::vector<ExpiredTimer> ExpiredList;
+
+    static const int kLevel0Bits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevels = 4;
+    static const uint64_t kLevel0Size = 1 << kLevel0Bits;
+    static const uint64_t kLevelSize = 1 << kLevelBits;
+    static const uint64_t kMaxTicks =
+        (1ULL << (kLevel0Bits + kLevels * kLevelBits)) - 1;
+
+    // Called by Timer with the mutex of the timer held.
+    void Add(Timer *timer, int time, uint32_t seq_no);
+    TimerPtr Remove(Timer *timer);
+
+    static void Unlink(Timer *timer);
+    void Insert(Timer *timer);
+    void Cascade(int level, uint64_t index);
+    void Expire(ExpiredList *expired);
+    uint64_t CurrentTick() const;
+    void StartTick();
+    void TickHandler(const boost::system::error_code &ec);
+    void Dispatch(ExpiredList *expired);
+
+    int tick_msec_;
+    uint64_t start_usec_;
+    boost::scoped_ptr<TimerImpl> impl_;
+
+    // mutex_ protects the wheel and the wheel fields of its timers
+    mutable tbb::mutex mutex_;
+    bool ticking_;
+    uint64_t current_;          // next tick to process
+    size_t size_;
+    TimerList level0_[kLevel0Size];
+    TimerList levels_[kLevels][kLevelSize];
+
+    tbb::atomic<uint64_t> ticks_;
+    tbb::atomic<uint64_t> expired_;
+    tbb::atomic<uint64_t> tasks_;
+    tbb::atomic<uint64_t> cascaded_;
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+#endif  // BASE_TIMER_WHEEL_H_
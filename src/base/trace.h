@@ -5,33 +5,61 @@
 #ifndef __TRACE_H__
 #define __TRACE_H__
 
+#include <tbb/atomic.h>
+#include <tbb/enumerable_thread_specific.h>
 #include <tbb/mutex.h>
+#include <tbb/task_scheduler_init.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <stdexcept>
 #include <boost/function.hpp>
-#include <boost/ptr_container/ptr_circular_buffer.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include "base/util.h"
 
+// TraceBuffer keeps the last size trace entries written to it.
+//
+// Each thread that writes to the buffer appends to its own segment, a ring
+// of slots allocated on its first write, so that writers neither take a
+// lock nor share anything other than the counter that orders the entries.
+// The entries themselves are allocated by the callers of TraceWrite, and
+// owned by the buffer from then on. TraceRead merges the segments in that
+// order and returns the last size entries.
+//
+// A segment has size / concurrency slots, where concurrency defaults to the
+// number of hardware threads, so the buffer holds about size entries when
+// that many threads write to it. Each additional writing thread adds a
+// segment of the same size, and a buffer written by fewer threads keeps
+// fewer entries.
+//
+// An entry that is overwritten while a read is in progress is retired by
+// the writer, as the reader may be looking at it, and deleted when the read
+// is done.
 template<typename TraceEntryT>
 class TraceBuffer {
 public:
-    TraceBuffer(const std::string& buf_name, size_t size, bool trace_enable) 
+    TraceBuffer(const std::string& buf_name, size_t size, bool trace_enable,
+                size_t concurrency = 0)
         : trace_buf_name_(buf_name), 
-          trace_buf_size_(size),
-          trace_buf_(trace_buf_size_),
-          write_index_(0),
-          read_index_(0),
-          wrap_(false),
-          seqno_(0) {
+          trace_buf_size_(size) {
+        if (concurrency == 0) {
+            concurrency = tbb::task_scheduler_init::default_num_threads();
+        }
+        segment_size_ = std::max((size + concurrency - 1) / concurrency,
+                                 static_cast<size_t>(1));
         trace_enable_ = trace_enable;
+        order_ = 0;
+        readers_ = 0;
     }
 
     ~TraceBuffer() {
         read_context_map_.clear();
-        trace_buf_.clear();
+        DeleteRetired();
+        for (typename SegmentList::iterator it = segments_.begin();
+             it != segments_.end(); ++it) {
+            delete *it;
+        }
     }
 
     std::string Name() {
@@ -55,91 +83,65 @@ public:
     }
 
     uint32_t TraceWrite(TraceEntryT *trace_entry) {
-        tbb::mutex::scoped_lock lock(mutex_);
-       
-        // Add the trace
-        trace_buf_.push_back(trace_entry);
-
-        // Once the trace buffer is wrapped, increment the read index
-        if (wrap_) {
-            if (++read_index_ == trace_buf_size_) {
-                read_index_ = 0;
-            }
-        }
-
-        // Increment the write_index_ and reset upon reaching trace_buf_size_
-        if (++write_index_ == trace_buf_size_) {
-            write_index_ = 0;
-            wrap_ = true;
-        }
-        
-        // Trace messages could be read in batches instead of reading 
-        // the entire trace buffer in one shot. Therefore, trace messages
-        // could be added between subsequent read requests. If the 
-        // read_index_ [points to the oldest message in the trace buffer] 
-        // becomes same as the read index [points to the position in the 
-        // trace buffer from where the next trace message should be read] 
-        // stored in the read context, then there is no need to remember the
-        // read context. 
-        ReadContextMap::iterator it = read_context_map_.begin();
-        ReadContextMap::iterator next = it; 
-        for (int i = 0, cnt = read_context_map_.size(); i < cnt; 
-             i++, it = next) {
-            ++next;
-            if (*it->second.get() == read_index_) {
-                read_context_map_.erase(it); 
-            }
+        uint64_t order = order_.fetch_and_increment() + 1;
+        Segment *segment = LocalSegment();
+
+        // Invalidate the slot while it changes, for the readers
+        Slot &slot = segment->slots[segment->next];
+        slot.order = 0;
+        TraceEntryT *old_entry = slot.entry.fetch_and_store(trace_entry);
+        slot.order = order;
+        if (++segment->next == segment_size_) {
+            segment->next = 0;
         }
 
-        // Reset seqno_ if it reaches max value
-        if (++seqno_  > kMaxSeqno) {
-            seqno_ = kMinSeqno;
+        // A reader that started before the slot changed may be using the
+        // entry; one that starts later does not see it.
+        if (readers_ == 0) {
+            delete old_entry;
+        } else if (old_entry) {
+            tbb::mutex::scoped_lock lock(retired_mutex_);
+            retired_.push_back(old_entry);
         }
 
-        return seqno_; 
+        // Reserve 0 and max(uint32_t)
+        return ((order - 1) % kMaxSeqno) + kMinSeqno;
     }
 
     void TraceRead(const std::string& context, const int count, 
             boost::function<void (TraceEntryT *, bool)> cb) {
         tbb::mutex::scoped_lock lock(mutex_);
-        if (trace_buf_.empty()) {
+        readers_.fetch_and_increment();
+        EntryList entries;
+        Collect(&entries);
+        if (entries.empty()) {
             // No message in the trace buffer
+            ReadDone();
             return;
         }
 
-        // if count = 0, then set the cnt equal to the size of trace_buf_
-        int cnt = count ? count : trace_buf_.size();
-
-        int *read_index_ptr;
-        typename ContainerType::iterator it;
+        // Trace messages could be read in batches instead of reading the
+        // entire trace buffer in one shot. The read context remembers the
+        // last message read, so that the next read starts after it, or
+        // from the oldest message if it has been overwritten since.
+        typename EntryList::iterator it = entries.begin();
         ReadContextMap::iterator context_it = 
             read_context_map_.find(context);
         if (context_it != read_context_map_.end()) {
-            // If the read context is present, manipulate the position
-            // from where we wanna start
-            read_index_ptr = context_it->second.get();
-            int offset = *read_index_ptr - read_index_;
-            offset = offset > 0 ? offset : trace_buf_size_ + offset; 
-            it = trace_buf_.begin() + offset;
+            it = std::upper_bound(entries.begin(), entries.end(),
+                Entry(context_it->second, NULL), EntryCompare());
         } else {
-            // Create read context
-            boost::shared_ptr<int> read_context(new int(read_index_));
-            read_index_ptr = read_context.get();
-            read_context_map_.insert(std::make_pair(context, read_context));
-            it = trace_buf_.begin();
+            context_it = read_context_map_.insert(
+                std::make_pair(context, 0)).first;
         }
 
-        int i;
-        typename ContainerType::iterator next = it;
-        for (i = 0; (it != trace_buf_.end()) && (i < cnt); i++, it = next) {
-            ++next;
-            cb(&(*it), next != trace_buf_.end());
+        // if count = 0, then read all the messages
+        int cnt = count ? count : entries.size();
+        for (int i = 0; (it != entries.end()) && (i < cnt); i++, ++it) {
+            cb(it->second, (it + 1) != entries.end());
+            context_it->second = it->first;
         }
-
-        // Update the read index in the read context
-        int offset = *read_index_ptr + i;
-        *read_index_ptr = offset >= trace_buf_size_ ? 
-            offset - trace_buf_size_ : offset;
+        ReadDone();
     }
 
     void TraceReadDone(const std::string& context) {
@@ -152,25 +154,108 @@ public:
     }
 
 private:
-    typedef boost::ptr_circular_buffer<TraceEntryT> ContainerType;
-    typedef std::map<const std::string, boost::shared_ptr<int> > 
-        ReadContextMap;
+    // order is 0 while the entry in the slot changes
+    struct Slot {
+        Slot() {
+            entry = NULL;
+            order = 0;
+        }
+
+        tbb::atomic<TraceEntryT *> entry;
+        tbb::atomic<uint64_t> order;
+    };
+
+    // Written only by the thread that owns it
+    struct Segment {
+        explicit Segment(size_t size) : slots(size), next(0) {
+        }
+
+        ~Segment() {
+            for (size_t i = 0; i < slots.size(); i++) {
+                delete slots[i].entry;
+            }
+        }
+
+        std::vector<Slot> slots;
+        size_t next;
+    };
+
+    typedef std::vector<Segment *> SegmentList;
+    typedef std::vector<TraceEntryT *> RetiredList;
+    typedef tbb::enumerable_thread_specific<Segment *> LocalSegmentMap;
+    typedef std::pair<uint64_t, TraceEntryT *> Entry;
+    typedef std::vector<Entry> EntryList;
+    typedef std::map<const std::string, uint64_t> ReadContextMap;
+
+    struct EntryCompare {
+        bool operator()(const Entry &lhs, const Entry &rhs) const {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    Segment *LocalSegment() {
+        typename LocalSegmentMap::reference segment = local_segment_.local();
+        if (segment == NULL) {
+            segment = new Segment(segment_size_);
+            tbb::mutex::scoped_lock lock(segment_mutex_);
+            segments_.push_back(segment);
+        }
+        return segment;
+    }
+
+    // Readers are serialized, so none is using the retired entries once the
+    // count drops to 0. An entry retired by a writer that saw the read in
+    // progress after that is deleted when the next read is done.
+    void ReadDone() {
+        readers_.fetch_and_decrement();
+        DeleteRetired();
+    }
+
+    void DeleteRetired() {
+        tbb::mutex::scoped_lock lock(retired_mutex_);
+        for (size_t i = 0; i < retired_.size(); i++) {
+            delete retired_[i];
+        }
+        retired_.clear();
+    }
+
+    // Gather the last trace_buf_size_ entries, in the order written
+    void Collect(EntryList *entries) {
+        tbb::mutex::scoped_lock lock(segment_mutex_);
+        for (typename SegmentList::iterator it = segments_.begin();
+             it != segments_.end(); ++it) {
+            std::vector<Slot> &slots = (*it)->slots;
+            for (size_t i = 0; i < slots.size(); i++) {
+                uint64_t order = slots[i].order;
+                TraceEntryT *entry = slots[i].entry;
+                if (order && entry && order == slots[i].order) {
+                    entries->push_back(std::make_pair(order, entry));
+                }
+            }
+        }
+        std::sort(entries->begin(), entries->end(), EntryCompare());
+        if (entries->size() > trace_buf_size_) {
+            entries->erase(entries->begin(),
+                           entries->end() - trace_buf_size_);
+        }
+    }
 
     std::string trace_buf_name_;
-    int trace_buf_size_;
-    ContainerType trace_buf_;
+    size_t trace_buf_size_;
+    size_t segment_size_;
     tbb::atomic<bool> trace_enable_;
-    int write_index_; // points to the position in the trace buffer, 
-                      // where the next trace message would be added
-    int read_index_; // points to the position of the oldest 
-                     // trace message in the trace buffer
-    bool wrap_; // indicates if the trace buffer is wrapped
+    tbb::atomic<uint64_t> order_; // orders the entries across the segments
+    tbb::atomic<int> readers_;    // reads in progress
+    LocalSegmentMap local_segment_;
+    SegmentList segments_;
+    tbb::mutex segment_mutex_;    // guards segments_
+    RetiredList retired_;         // entries overwritten during a read
+    tbb::mutex retired_mutex_;    // guards retired_
     ReadContextMap read_context_map_; // stores the read context  
-    uint32_t seqno_;
-    tbb::mutex mutex_;
+    tbb::mutex mutex_;            // serializes the readers
     
     // Reserve 0 and max(uint32_t)
-    static const uint32_t kMaxSeqno = ((2 ^ 32) - 1) - 1;
+    static const uint32_t kMaxSeqno = 0xFFFFFFFE;
     static const uint32_t kMinSeqno = 1;
 
     DISALLOW_COPY_AND_ASSIGN(TraceBuffer);
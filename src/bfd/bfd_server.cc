@@ -12,10 +12,23 @@
 #include <boost/foreach.hpp>
 
 #include "base/logging.h"
+#include "base/task.h"
 #include "io/event_manager.h"
 
 namespace BFD {
 
+Server::Server(EventManager *evm, Connection *communicator) :
+        evm_(evm),
+        communicator_(communicator),
+        timer_wheel_(*evm->io_service(), kTimerWheelTickMsec),
+        session_manager_(evm, &timer_wheel_) {
+    // Session timers are not to wait behind table walks and other bulk
+    // work, or the peers detect the sessions down.
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->SetPriority(scheduler->GetTaskId(Session::kTaskName),
+                           TaskScheduler::HIGH);
+}
+
 Session* Server::GetSession(const ControlPacket *packet) {
     if (packet->receiver_discriminator)
         return session_manager_.SessionByDiscriminator(
@@ -29,6 +42,16 @@ Session *Server::SessionByAddress(const boost::asio::ip::address &address) {
     return session_manager_.SessionByAddress(address);
 }
 
+Session *Server::SessionByDiscriminator(Discriminator discriminator) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return session_manager_.SessionByDiscriminator(discriminator);
+}
+
+size_t Server::session_count() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return session_manager_.size();
+}
+
 ResultCode Server::ProcessControlPacket(const ControlPacket *packet) {
     tbb::mutex::scoped_lock lock(mutex_);
 
@@ -72,13 +95,21 @@ ResultCode Server::RemoveSessionReference(const boost::asio::ip::address
     return session_manager_.RemoveSessionReference(remoteHost);
 }
 
+Server::SessionManager::SessionManager(EventManager *evm, TimerWheel *wheel)
+        : evm_(evm), wheel_(wheel) {
+    // Discriminator 0 is reserved.
+    discriminators_.set(0);
+}
+
 Session* Server::SessionManager::SessionByDiscriminator(
     Discriminator discriminator) {
-    DiscriminatorSessionMap::const_iterator it =
-            by_discriminator_.find(discriminator);
-    if (it == by_discriminator_.end())
+    size_t index = DiscriminatorIndex(discriminator);
+    if (index >= by_discriminator_.size())
         return NULL;
-    return it->second;
+    Session *session = by_discriminator_[index];
+    if (session == NULL || session->local_discriminator() != discriminator)
+        return NULL;
+    return session;
 }
 
 Session* Server::SessionManager::SessionByAddress(
@@ -99,9 +130,12 @@ ResultCode Server::SessionManager::RemoveSessionReference(
         return kResultCode_UnknownSession;
     }
 
-    if (!--refcounts_[session]) {
-        by_discriminator_.erase(session->local_discriminator());
+    Discriminator discriminator = session->local_discriminator();
+    size_t index = DiscriminatorIndex(discriminator);
+    if (!--refcounts_[index]) {
+        by_discriminator_[index] = NULL;
         by_address_.erase(session->remote_host());
+        FreeDiscriminator(discriminator);
         delete session;
     }
 
@@ -116,23 +150,26 @@ ResultCode Server::SessionManager::ConfigureSession(
     Session *session = SessionByAddress(remoteHost);
     if (session) {
         session->UpdateConfig(config);
-        refcounts_[session]++;
+        Discriminator discriminator = session->local_discriminator();
+        size_t index = DiscriminatorIndex(discriminator);
+        refcounts_[index]++;
 
         LOG(INFO, __func__ << ": Reference count incremented: "
                   << session->remote_host() << "/"
-                  << session->local_discriminator() << ","
-                  << refcounts_[session] << " refs");
+                  << discriminator << ","
+                  << refcounts_[index] << " refs");
 
         return kResultCode_Ok;
     }
 
-    *assignedDiscriminator = GenerateUniqueDiscriminator();
+    *assignedDiscriminator = AllocateDiscriminator();
     session = new Session(*assignedDiscriminator, remoteHost, evm_, config,
-                          communicator);
+                          communicator, wheel_);
 
-    by_discriminator_[*assignedDiscriminator] = session;
+    size_t index = DiscriminatorIndex(*assignedDiscriminator);
+    by_discriminator_[index] = session;
     by_address_[remoteHost] = session;
-    refcounts_[session] = 1;
+    refcounts_[index] = 1;
 
     LOG(INFO, __func__ << ": New session configured: " << remoteHost << "/"
               << *assignedDiscriminator);
@@ -140,31 +177,33 @@ ResultCode Server::SessionManager::ConfigureSession(
     return kResultCode_Ok;
 }
 
-Discriminator Server::SessionManager::GenerateUniqueDiscriminator() {
-    class DiscriminatorGenerator {
-     public:
-        DiscriminatorGenerator() {
-            next_ = random()%0x1000000 + 1;
-        }
-
-        Discriminator Next() {
-            return next_.fetch_and_increment();
-        }
-
-     private:
-        tbb::atomic<Discriminator> next_;
-    };
-
-    static DiscriminatorGenerator generator;
+// Allocate the lowest free index, growing the session array if all are in
+// use, and combine it with the current generation of the index.
+Discriminator Server::SessionManager::AllocateDiscriminator() {
+    size_t index = discriminators_.find_first_clear();
+    assert(index <= kIndexMask);
+    discriminators_.set(index);
+    if (index >= by_discriminator_.size()) {
+        by_discriminator_.resize(index + 1, NULL);
+        refcounts_.resize(index + 1, 0);
+        generations_.resize(index + 1, 0);
+    }
+    return (generations_[index] << kIndexBits) | index;
+}
 
-    return generator.Next();
+void Server::SessionManager::FreeDiscriminator(Discriminator discriminator) {
+    size_t index = DiscriminatorIndex(discriminator);
+    discriminators_.reset(index);
+    generations_[index] = (generations_[index] + 1) & kGenerationMask;
 }
 
 Server::SessionManager::~SessionManager() {
-    for (DiscriminatorSessionMap::iterator it = by_discriminator_.begin();
+    for (DiscriminatorSessionVector::iterator it = by_discriminator_.begin();
          it != by_discriminator_.end(); ++it) {
-        it->second->Stop();
-        delete it->second;
+        if (*it == NULL)
+            continue;
+        (*it)->Stop();
+        delete *it;
     }
 }
 }  // namespace BFD
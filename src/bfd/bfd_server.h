@@ -10,8 +10,12 @@
 #include <tbb/mutex.h>
 
 #include <map>
+#include <vector>
 #include <boost/asio/ip/address.hpp>
 
+#include "base/bitset.h"
+#include "base/timer_wheel.h"
+
 class EventManager;
 
 namespace BFD {
@@ -21,12 +25,16 @@ class ControlPacket;
 class SessionConfig;
 
 // This class manages sessions with other BFD peers.
+//
+// The transmit and detection timers of all sessions run on a single
+// TimerWheel, so that the sessions whose timers expire on the same tick
+// are serviced by one task and their packets leave in one batch.
 class Server {
  public:
-    Server(EventManager *evm, Connection *communicator) :
-        evm_(evm),
-        communicator_(communicator),
-        session_manager_(evm) {}
+    // Timer resolution of the sessions.
+    static const int kTimerWheelTickMsec = 1;
+
+    Server(EventManager *evm, Connection *communicator);
 
     ResultCode ProcessControlPacket(const ControlPacket *packet);
 
@@ -42,11 +50,13 @@ class Server {
     ResultCode RemoveSessionReference(const boost::asio::ip::address
                                       &remoteHost);
     Session *SessionByAddress(const boost::asio::ip::address &address);
+    Session *SessionByDiscriminator(Discriminator discriminator);
+    size_t session_count();
 
  private:
     class SessionManager : boost::noncopyable {
      public:
-        explicit SessionManager(EventManager *evm) : evm_(evm) {}
+        SessionManager(EventManager *evm, TimerWheel *wheel);
         ~SessionManager();
 
         // see: Server::ConfigureSession
@@ -63,19 +73,39 @@ class Server {
 
         Session *SessionByDiscriminator(Discriminator discriminator);
         Session *SessionByAddress(const boost::asio::ip::address &address);
+        size_t size() const { return by_address_.size(); }
 
      private:
-        typedef std::map<Discriminator, Session*> DiscriminatorSessionMap;
+        // Sessions are kept in a flat array. The low kIndexBits of the
+        // local discriminator of a session are its index in the array,
+        // allocated as the lowest free index, and the high bits are the
+        // generation of the index, which is bumped when the index is
+        // freed. Packets for a removed session, still in flight or sent
+        // by a peer that did not notice the removal yet, then do not match
+        // a new session that reuses the index.
+        typedef std::vector<Session*> DiscriminatorSessionVector;
         typedef std::map<boost::asio::ip::address, Session*>
                 AddressSessionMap;
-        typedef std::map<Session*, unsigned int> RefcountMap;
+        typedef std::vector<unsigned int> RefcountVector;
+        typedef std::vector<Discriminator> GenerationVector;
+
+        static const int kIndexBits = 20;
+        static const Discriminator kIndexMask = (1 << kIndexBits) - 1;
+        static const Discriminator kGenerationMask = 0xffffffff >> kIndexBits;
 
-        Discriminator GenerateUniqueDiscriminator();
+        static size_t DiscriminatorIndex(Discriminator discriminator) {
+            return discriminator & kIndexMask;
+        }
+        Discriminator AllocateDiscriminator();
+        void FreeDiscriminator(Discriminator discriminator);
 
         EventManager *evm_;
-        DiscriminatorSessionMap by_discriminator_;
+        TimerWheel *wheel_;
+        DiscriminatorSessionVector by_discriminator_;
+        BitSet discriminators_;
         AddressSessionMap by_address_;
-        RefcountMap refcounts_;
+        RefcountVector refcounts_;
+        GenerationVector generations_;
     };
 
     Session *GetSession(const ControlPacket *packet);
@@ -83,6 +113,7 @@ class Server {
     tbb::mutex mutex_;
     EventManager *evm_;
     Connection *communicator_;
+    TimerWheel timer_wheel_;
     SessionManager session_manager_;
 };
 
@@ -14,19 +14,21 @@
 #include <algorithm>
 
 #include "base/logging.h"
+#include "base/task.h"
 
 namespace BFD {
 
+const char *Session::kTaskName = "bfd::Session";
+
 Session::Session(Discriminator localDiscriminator,
         boost::asio::ip::address remoteHost,
         EventManager *evm,
-        const SessionConfig &config, Connection *communicator) :
+        const SessionConfig &config, Connection *communicator,
+        TimerWheel *wheel) :
         localDiscriminator_(localDiscriminator),
         remoteHost_(remoteHost),
-        sendTimer_(TimerManager::CreateTimer(*evm->io_service(),
-                                             "BFD TX timer")),
-        recvTimer_(TimerManager::CreateTimer(*evm->io_service(),
-                                             "BFD RX timeout")),
+        sendTimer_(CreateTimer(evm, wheel, "BFD TX timer")),
+        recvTimer_(CreateTimer(evm, wheel, "BFD RX timeout")),
         currentConfig_(config),
         nextConfig_(config),
         sm_(CreateStateMachine(evm)),
@@ -43,6 +45,14 @@ Session::~Session() {
     Stop();
 }
 
+Timer *Session::CreateTimer(EventManager *evm, TimerWheel *wheel,
+                            const std::string &name) {
+    int task_id = TaskScheduler::GetInstance()->GetTaskId(kTaskName);
+    if (wheel)
+        return TimerManager::CreateTimer(wheel, name, task_id);
+    return TimerManager::CreateTimer(*evm->io_service(), name, task_id);
+}
+
 bool Session::SendTimerExpired() {
     LOG(DEBUG, __func__);
     tbb::mutex::scoped_lock lock(mutex_);
@@ -139,6 +149,7 @@ void Session::PreparePacket(const SessionConfig &config,
 ResultCode Session::ProcessControlPacket(const ControlPacket *packet) {
     tbb::mutex::scoped_lock lock(mutex_);
 
+    BFDState old_state = local_state_non_locking();
     remoteSession_.discriminator = packet->sender_discriminator;
     if (remoteSession_.minRxInterval != packet->required_min_rx_interval) {
         // TODO(bfd) schedule timer based on previous packet
@@ -169,6 +180,13 @@ ResultCode Session::ProcessControlPacket(const ControlPacket *packet) {
         ScheduleRecvDeadlineTimer();
     }
 
+    // Switch between the idle and the negotiated transmit interval right
+    // away rather than after the pending transmission.
+    if (local_state_non_locking() != old_state) {
+        sendTimer_->Cancel();
+        ScheduleSendTimer();
+    }
+
     return kResultCode_Ok;
 }
 
@@ -14,6 +14,7 @@
 #include <boost/asio/ip/address.hpp>
 
 #include "base/timer.h"
+#include "base/timer_wheel.h"
 #include "tbb/mutex.h"
 #include "io/event_manager.h"
 
@@ -44,11 +45,17 @@ struct BFDRemoteSessionState {
 
 class Session {
  public:
+    // Task the timers of the sessions run in.
+    static const char *kTaskName;
+
+    // The timers of the session run on [wheel] if given, or on their own
+    // ASIO timers otherwise.
     Session(Discriminator localDiscriminator,
             boost::asio::ip::address remoteHost,
             EventManager *evm,
             const SessionConfig &config,
-            Connection *communicator);
+            Connection *communicator,
+            TimerWheel *wheel = NULL);
     ~Session();
 
     void Stop();
@@ -77,6 +84,8 @@ class Session {
  private:
     typedef std::map<ClientId, StateMachine::ChangeCb> Callbacks;
 
+    static Timer *CreateTimer(EventManager *evm, TimerWheel *wheel,
+                              const std::string &name);
     bool SendTimerExpired();
     bool RecvTimerExpired();
     void ScheduleSendTimer();
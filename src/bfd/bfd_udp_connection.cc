@@ -7,17 +7,37 @@
 #include "bfd/bfd_control_packet.h"
 #include "bfd/bfd_common.h"
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include <cstring>
 #include <boost/asio.hpp>
+#include <boost/bind.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/random.hpp>
 
 #include "base/logging.h"
+#include "io/event_manager.h"
+
+using boost::asio::ip::udp;
 
 namespace BFD {
 
 UDPConnectionManager::UDPRecvServer::UDPRecvServer(EventManager *evm,
-                                       int recvPort) : UdpServer(evm) {
-    Initialize(recvPort);
+                                       int recvPort, StatsPtr stats)
+        : UdpServer(evm), stats_(stats),
+          buffer_(kBatchSize * kPacketBufferSize) {
+    if (!Initialize(recvPort))
+        return;
+    boost::system::error_code ec;
+    socket()->non_blocking(true, ec);
+    if (ec) {
+        LOG(ERROR, "Unable to set BFD receive socket non-blocking: "
+                   << ec.message());
+        Shutdown();
+    }
 }
 
 void UDPConnectionManager::UDPRecvServer::RegisterCallback(
@@ -25,24 +45,103 @@ void UDPConnectionManager::UDPRecvServer::RegisterCallback(
     this->callback_ = callback;
 }
 
-void UDPConnectionManager::UDPRecvServer::HandleReceive(
-        boost::asio::const_buffer &recv_buffer,
-        boost::asio::ip::udp::endpoint remote_endpoint,
-        std::size_t bytes_transferred,
-        const boost::system::error_code& error) {
-    LOG(DEBUG, __func__);
+// Wait for the socket to become readable, without a receive buffer, so that
+// the queued datagrams can be drained in batches. The handler holds a
+// reference to the server so that it outlives the pending receive.
+void UDPConnectionManager::UDPRecvServer::StartReceiveBatch() {
+    socket()->async_receive(boost::asio::null_buffers(),
+        boost::bind(&UDPRecvServer::HandleReadable, this, UdpServerPtr(this),
+                    boost::asio::placeholders::error));
+}
+
+void UDPConnectionManager::UDPRecvServer::HandleReadable(
+        UdpServerPtr server, const boost::system::error_code &error) {
+    if (error) {
+        if (error != boost::asio::error::operation_aborted) {
+            LOG(ERROR, __func__ << " Receive failed: " << error.message());
+        }
+        return;
+    }
+    if (GetServerState() != OK)
+        return;
+
+    for (int i = 0; i < kMaxRecvBatches; ++i) {
+        if (ReceiveBatch() < kBatchSize)
+            break;
+    }
+    StartReceiveBatch();
+}
+
+// Receive up to kBatchSize datagrams. Returns the number received.
+int UDPConnectionManager::UDPRecvServer::ReceiveBatch() {
+    uint8_t *buffer = &buffer_[0];
+    int count = 0;
+
+#if defined(__linux__)
+    struct mmsghdr msgs[kBatchSize];
+    struct iovec iovecs[kBatchSize];
+    udp::endpoint endpoints[kBatchSize];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatchSize; ++i) {
+        iovecs[i].iov_base = buffer + i * kPacketBufferSize;
+        iovecs[i].iov_len = kPacketBufferSize;
+        msgs[i].msg_hdr.msg_name = endpoints[i].data();
+        msgs[i].msg_hdr.msg_namelen = endpoints[i].capacity();
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    count = recvmmsg(socket()->native_handle(), msgs, kBatchSize, MSG_DONTWAIT,
+                     NULL);
+    if (count <= 0) {
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            stats_->rx_errors++;
+        }
+        return 0;
+    }
+    stats_->rx_batches++;
+    for (int i = 0; i < count; ++i) {
+        endpoints[i].resize(msgs[i].msg_hdr.msg_namelen);
+        HandleControlPacket(buffer + i * kPacketBufferSize, msgs[i].msg_len,
+                            endpoints[i]);
+    }
+#else
+    for (; count < kBatchSize; ++count) {
+        udp::endpoint remote;
+        boost::system::error_code ec;
+        std::size_t length = socket()->receive_from(
+            boost::asio::buffer(buffer, kPacketBufferSize), remote, 0, ec);
+        if (ec) {
+            if (ec != boost::asio::error::would_block) {
+                stats_->rx_errors++;
+            }
+            break;
+        }
+        HandleControlPacket(buffer, length, remote);
+    }
+    if (count)
+        stats_->rx_batches++;
+#endif
+
+    return count;
+}
 
-    if (bytes_transferred != (std::size_t)kMinimalPacketLength) {
-        LOG(ERROR, __func__ <<  "Wrong packet size: " << bytes_transferred);
+void UDPConnectionManager::UDPRecvServer::HandleControlPacket(
+        const uint8_t *data, std::size_t length,
+        const udp::endpoint &remote_endpoint) {
+    stats_->rx_packets++;
+
+    if (length != (std::size_t)kMinimalPacketLength) {
+        LOG(ERROR, __func__ <<  "Wrong packet size: " << length);
+        stats_->rx_errors++;
         return;
     }
 
     boost::scoped_ptr<ControlPacket> controlPacket(
-            ParseControlPacket(
-                boost::asio::buffer_cast<const uint8_t *>(recv_buffer),
-                bytes_transferred));
+            ParseControlPacket(data, length));
     if (controlPacket == NULL) {
         LOG(ERROR, __func__ <<  "Unable to parse packet");
+        stats_->rx_errors++;
     } else {
         controlPacket->sender_host = remote_endpoint.address();
         if (callback_)
@@ -51,8 +150,10 @@ void UDPConnectionManager::UDPRecvServer::HandleReceive(
 }
 
 UDPConnectionManager::UDPCommunicator::UDPCommunicator(EventManager *evm,
-                                                       int remotePort)
-                                : UdpServer(evm), remotePort_(remotePort) {
+                                                       int remotePort,
+                                                       StatsPtr stats)
+        : UdpServer(evm), remotePort_(remotePort), stats_(stats),
+          flush_pending_(false) {
     boost::random::uniform_int_distribution<> dist(kSendPortMin, kSendPortMax);
     for (int i = 0; i < 100 && GetServerState() != OK; ++i) {
         int localPort = dist(randomGen);
@@ -69,32 +170,108 @@ UDPConnectionManager::UDPCommunicator::UDPCommunicator(EventManager *evm,
     }
 }
 
+// Encode the packet and queue it for the next flush. The posted flush holds
+// a reference to the communicator so that it outlives the manager.
 void UDPConnectionManager::UDPCommunicator::SendPacket(
     const boost::asio::ip::address &dstAddr, const ControlPacket *packet) {
+    tbb::mutex::scoped_lock lock(mutex_);
 
-    boost::asio::mutable_buffer send =
-        AllocateBuffer(kMinimalPacketLength);  // Packet without auth data
-    int pktSize = EncodeControlPacket(packet,
-                                      boost::asio::buffer_cast<uint8_t *>(send),
-                                      kMinimalPacketLength);
-    if (pktSize != kMinimalPacketLength) {
+    pending_.resize(pending_.size() + 1);
+    PendingPacket &pending = pending_.back();
+    pending.length = EncodeControlPacket(packet, pending.data,
+                                         kMinimalPacketLength);
+    if (pending.length != kMinimalPacketLength) {
         LOG(ERROR, "Unable to encode packet");
-    } else {
-        boost::asio::ip::udp::endpoint dstEndpoint(dstAddr, remotePort_);
-        StartSend(dstEndpoint, pktSize, send);
+        pending_.pop_back();
+        stats_->tx_errors++;
+        return;
+    }
+    pending.endpoint = udp::endpoint(dstAddr, remotePort_);
+
+    if (!flush_pending_) {
+        flush_pending_ = true;
+        event_manager()->io_service()->post(
+            boost::bind(&UDPCommunicator::Flush, this, UdpServerPtr(this)));
+    }
+}
+
+void UDPConnectionManager::UDPCommunicator::Flush(UdpServerPtr server) {
+    PendingPackets packets;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        packets.swap(pending_);
+        flush_pending_ = false;
+    }
+    if (GetServerState() != OK)
+        return;
+
+    for (std::size_t i = 0; i < packets.size(); i += kBatchSize) {
+        int count = std::min(packets.size() - i, (std::size_t)kBatchSize);
+        SendBatch(&packets[i], count);
+    }
+}
+
+void UDPConnectionManager::UDPCommunicator::SendBatch(PendingPacket *packets,
+                                                      int count) {
+#if defined(__linux__)
+    struct mmsghdr msgs[kBatchSize];
+    struct iovec iovecs[kBatchSize];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < count; ++i) {
+        iovecs[i].iov_base = packets[i].data;
+        iovecs[i].iov_len = packets[i].length;
+        msgs[i].msg_hdr.msg_name = packets[i].endpoint.data();
+        msgs[i].msg_hdr.msg_namelen = packets[i].endpoint.size();
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // sendmmsg fails if the first of the messages can not be sent, skip
+    // just that one and go on with the rest.
+    int sent = 0;
+    int errors = 0;
+    while (sent < count) {
+        int result = sendmmsg(socket()->native_handle(), msgs + sent,
+                              count - sent, MSG_DONTWAIT);
+        if (result <= 0) {
+            LOG(ERROR, __func__ << " Unable to send packet to "
+                       << packets[sent].endpoint << ": " << strerror(errno));
+            sent++;
+            errors++;
+            continue;
+        }
+        sent += result;
+        stats_->tx_batches++;
+    }
+    stats_->tx_packets += sent - errors;
+    stats_->tx_errors += errors;
+#else
+    for (int i = 0; i < count; ++i) {
+        boost::system::error_code ec;
+        socket()->send_to(boost::asio::buffer(packets[i].data,
+                                            packets[i].length),
+                        packets[i].endpoint, 0, ec);
+        if (ec) {
+            stats_->tx_errors++;
+        } else {
+            stats_->tx_packets++;
+        }
     }
+    stats_->tx_batches++;
+#endif
 }
 
 UDPConnectionManager::UDPConnectionManager(EventManager *evm,  int recvPort,
                                            int remotePort)
-          : udpRecv_(new BFD::UDPConnectionManager::UDPRecvServer(evm,
-                     recvPort)),
+          : stats_(new Stats),
+            udpRecv_(new BFD::UDPConnectionManager::UDPRecvServer(evm,
+                     recvPort, stats_)),
             udpSend_(new BFD::UDPConnectionManager::UDPCommunicator(evm,
-                     remotePort)) {
+                     remotePort, stats_)) {
     if (udpRecv_->GetServerState() != UDPRecvServer::OK)
         LOG(ERROR, "Unable to listen on port " << recvPort);
     else
-        udpRecv_->StartReceive();
+        udpRecv_->StartReceiveBatch();
 }
 
 void UDPConnectionManager::SendPacket(const boost::asio::ip::address &dstAddr,
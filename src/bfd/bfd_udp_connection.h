@@ -7,15 +7,49 @@
 
 #include "bfd/bfd_connection.h"
 
+#include <vector>
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
 
 #include "io/udp_server.h"
 
 namespace BFD {
+
+// Sends and receives BFD control packets over UDP.
+//
+// Packets are received in batches: when the receive socket becomes readable
+// all queued datagrams are drained with recvmmsg(2). Packets sent while
+// servicing timers are queued and flushed with sendmmsg(2) from a single
+// handler, so that all the packets of a timer tick leave in one system call.
+//
+// The receive and send servers are UdpServers, held by the handlers queued
+// on them through UdpServerPtr, so they are deleted once the last handler is
+// done after the manager is gone. The counters are shared with them for the
+// same reason, and updated from the io threads.
 class UDPConnectionManager : public Connection {
  public:
     typedef boost::function<void(const ControlPacket *)> RecvCallback;
 
+    struct Stats {
+        Stats() {
+            rx_packets = 0;
+            rx_batches = 0;
+            rx_errors = 0;
+            tx_packets = 0;
+            tx_batches = 0;
+            tx_errors = 0;
+        }
+        tbb::atomic<uint64_t> rx_packets;
+        tbb::atomic<uint64_t> rx_batches;
+        tbb::atomic<uint64_t> rx_errors;
+        tbb::atomic<uint64_t> tx_packets;
+        tbb::atomic<uint64_t> tx_batches;
+        tbb::atomic<uint64_t> tx_errors;
+    };
+
     UDPConnectionManager(EventManager *evm, int recvPort = kRecvPortDefault,
                          int remotePort = kRecvPortDefault);
     ~UDPConnectionManager();
@@ -24,31 +58,66 @@ class UDPConnectionManager : public Connection {
     virtual void SendPacket(const boost::asio::ip::address &dstAddr,
                             const ControlPacket *packet);
 
+    const Stats &stats() const { return *stats_; }
+
  private:
     static const int kRecvPortDefault = 3784;
     static const int kSendPortMin = 49152;
     static const int kSendPortMax = 65535;
 
-    class UDPRecvServer : public UdpServer {
-        boost::optional<RecvCallback> callback_;
+    // Maximum number of datagrams per recvmmsg/sendmmsg call.
+    static const int kBatchSize = 64;
+    // Large enough for a control packet with authentication data.
+    static const int kPacketBufferSize = 128;
+    // Maximum number of receive batches per readable event, so that a
+    // flood of packets does not starve the other handlers.
+    static const int kMaxRecvBatches = 16;
 
+    typedef boost::shared_ptr<Stats> StatsPtr;
+
+    StatsPtr stats_;
+
+    class UDPRecvServer : public UdpServer {
      public:
-        UDPRecvServer(EventManager *evm, int recvPort);
+        UDPRecvServer(EventManager *evm, int recvPort, StatsPtr stats);
         void RegisterCallback(RecvCallback callback);
-        void HandleReceive(boost::asio::const_buffer &recv_buffer,
-                boost::asio::ip::udp::endpoint remote_endpoint,
-                std::size_t bytes_transferred,
-                const boost::system::error_code& error);
+        void StartReceiveBatch();
+
+     private:
+        void HandleReadable(UdpServerPtr server,
+                            const boost::system::error_code &error);
+        int ReceiveBatch();
+        void HandleControlPacket(const uint8_t *data, std::size_t length,
+                                 const boost::asio::ip::udp::endpoint &remote);
+
+        boost::optional<RecvCallback> callback_;
+        StatsPtr stats_;
+        std::vector<uint8_t> buffer_;
     } *udpRecv_;
 
     class UDPCommunicator : public UdpServer {
-        const int remotePort_;
-
      public:
-        UDPCommunicator(EventManager *evm, int remotePort);
-        virtual void SendPacket(const boost::asio::ip::address &dstAddr,
-                                const ControlPacket *packet);
+        UDPCommunicator(EventManager *evm, int remotePort, StatsPtr stats);
+        void SendPacket(const boost::asio::ip::address &dstAddr,
+                        const ControlPacket *packet);
         // TODO(bfd) add multiple instances to randomize source port (RFC5881)
+
+     private:
+        struct PendingPacket {
+            boost::asio::ip::udp::endpoint endpoint;
+            int length;
+            uint8_t data[kPacketBufferSize];
+        };
+        typedef std::vector<PendingPacket> PendingPackets;
+
+        void Flush(UdpServerPtr server);
+        void SendBatch(PendingPacket *packets, int count);
+
+        const int remotePort_;
+        StatsPtr stats_;
+        tbb::mutex mutex_;
+        PendingPackets pending_;
+        bool flush_pending_;
     } *udpSend_;
 };
 }  // namespace BFD
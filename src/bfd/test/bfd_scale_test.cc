@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bfd/bfd_server.h"
+#include "bfd/bfd_session.h"
+#include "bfd/bfd_udp_connection.h"
+#include "bfd/bfd_control_packet.h"
+#include "bfd/test/bfd_test_utils.h"
+
+#include <sys/resource.h>
+#include <iostream>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <testing/gunit.h>
+
+#include "base/logging.h"
+#include "base/test/task_test_util.h"
+#include "base/time_util.h"
+
+using namespace BFD;
+using namespace std;
+
+static const int kSessions = 2000;
+static const int kIntervalMsec = 50;
+static const int kMultiplier = 3;
+static const int kSteadyStateMsec = 5000;
+static const int kServerPort = 13784;
+static const int kPeerPort = 13785;
+
+//
+// Runs kSessions sessions at kIntervalMsec over loopback against a peer
+// that answers each control packet, and reports the cpu time per session
+// and how accurately the sessions detect the loss of the peer.
+//
+// The sessions are addressed to 127.1.0.0/16, all of which loops back to
+// the peer socket. The peer answers with the discriminator of the session
+// so that its replies are matched by discriminator rather than by address.
+//
+class ScaleTest : public ::testing::Test {
+ public:
+    ScaleTest()
+        : connection_(&evm_, kServerPort, kPeerPort),
+          peer_(&evm_, kPeerPort, kServerPort),
+          server_(&evm_, &connection_),
+          last_rx_usec_(kSessions + 1, 0),
+          down_usec_(kSessions + 1, 0) {
+        reflect_ = true;
+        connection_.RegisterCallback(
+            boost::bind(&ScaleTest::ProcessControlPacket, this, _1));
+        peer_.RegisterCallback(boost::bind(&ScaleTest::Reflect, this, _1));
+    }
+
+    static uint64_t CpuUsec() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+
+    static boost::asio::ip::address SessionAddress(int index) {
+        boost::asio::ip::address_v4::bytes_type bytes;
+        bytes[0] = 127;
+        bytes[1] = 1;
+        bytes[2] = index >> 8;
+        bytes[3] = index & 0xff;
+        return boost::asio::ip::address_v4(bytes);
+    }
+
+    // Record the last time each session heard from the peer.
+    void ProcessControlPacket(const ControlPacket *packet) {
+        if (packet->receiver_discriminator < last_rx_usec_.size()) {
+            last_rx_usec_[packet->receiver_discriminator] =
+                ClockMonotonicUsec();
+        }
+        server_.ProcessControlPacket(packet);
+    }
+
+    // Answer as a peer that brings the session up.
+    void Reflect(const ControlPacket *packet) {
+        if (!reflect_)
+            return;
+
+        ControlPacket reply;
+        reply.poll = false;
+        reply.final = packet->poll;
+        reply.state = packet->state == kDown ? kInit : kUp;
+        reply.sender_discriminator = packet->sender_discriminator;
+        reply.receiver_discriminator = packet->sender_discriminator;
+        reply.detection_time_multiplier = kMultiplier;
+        reply.desired_min_tx_interval =
+            boost::posix_time::milliseconds(kIntervalMsec);
+        reply.required_min_rx_interval =
+            boost::posix_time::milliseconds(kIntervalMsec);
+        peer_.SendPacket(packet->sender_host, &reply);
+    }
+
+    void StateChanged(Discriminator discriminator, const BFDState &state) {
+        if (state == kDown && !reflect_)
+            down_usec_[discriminator] = ClockMonotonicUsec();
+    }
+
+    EventManager evm_;
+    UDPConnectionManager connection_;
+    UDPConnectionManager peer_;
+    Server server_;
+    tbb::atomic<bool> reflect_;
+    vector<uint64_t> last_rx_usec_;
+    vector<uint64_t> down_usec_;
+};
+
+TEST_F(ScaleTest, Sessions) {
+    SessionConfig config;
+    config.desiredMinTxInterval =
+        boost::posix_time::milliseconds(kIntervalMsec);
+    config.requiredMinRxInterval =
+        boost::posix_time::milliseconds(kIntervalMsec);
+    config.detectionTimeMultiplier = kMultiplier;
+
+    vector<Session *> sessions;
+    for (int i = 0; i < kSessions; ++i) {
+        Discriminator discriminator;
+        ASSERT_EQ(kResultCode_Ok, server_.ConfigureSession(SessionAddress(i),
+                                  config, &discriminator));
+        ASSERT_LT(discriminator, down_usec_.size());
+        Session *session = server_.SessionByDiscriminator(discriminator);
+        session->RegisterChangeCallback(0,
+            boost::bind(&ScaleTest::StateChanged, this, discriminator, _1));
+        sessions.push_back(session);
+    }
+
+    EventManagerThread thread(&evm_);
+
+    int up = 0;
+    for (int i = 0; i < 200 && up != kSessions; ++i) {
+        usleep(100000);
+        up = 0;
+        for (int j = 0; j < kSessions; ++j) {
+            if (sessions[j]->local_state() == kUp)
+                up++;
+        }
+    }
+    ASSERT_EQ(kSessions, up);
+
+    // Steady state.
+    const UDPConnectionManager::Stats &stats = connection_.stats();
+    uint64_t tx_packets = stats.tx_packets;
+    uint64_t tx_batches = stats.tx_batches;
+    uint64_t rx_packets = stats.rx_packets;
+    uint64_t rx_batches = stats.rx_batches;
+    uint64_t cpu = CpuUsec();
+    usleep(kSteadyStateMsec * 1000);
+    cpu = CpuUsec() - cpu;
+    tx_packets = stats.tx_packets - tx_packets;
+    tx_batches = stats.tx_batches - tx_batches;
+    rx_packets = stats.rx_packets - rx_packets;
+    rx_batches = stats.rx_batches - rx_batches;
+    uint64_t errors = stats.tx_errors + stats.rx_errors;
+
+    cout << kSessions << " sessions at " << kIntervalMsec << " msec: "
+         << cpu / kSessions * 1000 / kSteadyStateMsec
+         << " usec cpu per session-second (server and peer), "
+         << tx_packets << " packets sent in " << tx_batches << " batches, "
+         << rx_packets << " packets received in " << rx_batches
+         << " batches, " << errors << " errors" << endl;
+    EXPECT_EQ(0, errors);
+    EXPECT_LT(tx_batches, tx_packets);
+    EXPECT_LT(rx_batches, rx_packets);
+
+    // Silence the peer and measure the detection time of every session
+    // against the last packet it received.
+    reflect_ = false;
+    uint64_t detection_usec = kIntervalMsec * kMultiplier * 1000;
+    int down = 0;
+    for (int i = 0; i < 100 && down != kSessions; ++i) {
+        usleep(10000);
+        down = 0;
+        for (int j = 0; j < kSessions; ++j) {
+            if (sessions[j]->local_state() == kDown)
+                down++;
+        }
+    }
+    ASSERT_EQ(kSessions, down);
+
+    int64_t error_sum = 0, error_max = 0;
+    for (size_t i = 1; i < down_usec_.size(); ++i) {
+        int64_t error = down_usec_[i] - last_rx_usec_[i] - detection_usec;
+        error_sum += error;
+        error_max = max(error_max, error);
+        EXPECT_LE(0, error);
+    }
+    cout << "Detection time " << detection_usec << " usec: mean error "
+         << error_sum / kSessions << " usec, max error " << error_max
+         << " usec" << endl;
+    EXPECT_GT(detection_usec / 2, error_max);
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    // Per packet logs would dominate the measurement.
+    SetLoggingDisabled(true);
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -236,6 +236,44 @@ TEST_F(ServerTest, RefCount) {
     em.Shutdown();
 }
 
+// A session configured again after its removal gets the same slot with a
+// new discriminator, packets for the old discriminator do not match it.
+TEST_F(ServerTest, DiscriminatorReuse) {
+    EventManager em;
+    TestCommunicatorManager communicationManager(em.io_service());
+
+    const boost::asio::ip::address addr1 =
+        boost::asio::ip::address::from_string("1.1.1.1");
+    const boost::asio::ip::address addr2 =
+        boost::asio::ip::address::from_string("2.2.2.2");
+
+    boost::scoped_ptr<Connection> communicator1(
+        new TestCommunicator(&communicationManager, addr1));
+    Server server1(&em, communicator1.get());
+    SessionConfig config1;
+    config1.desiredMinTxInterval = boost::posix_time::milliseconds(300);
+    config1.requiredMinRxInterval = boost::posix_time::milliseconds(500);
+    config1.detectionTimeMultiplier = 5;
+
+    Discriminator disc1;
+    server1.ConfigureSession(addr2, config1, &disc1);
+    ASSERT_NE(static_cast<Session *>(NULL),
+              server1.SessionByDiscriminator(disc1));
+    server1.RemoveSessionReference(addr2);
+    EXPECT_EQ(static_cast<Session *>(NULL),
+              server1.SessionByDiscriminator(disc1));
+
+    Discriminator disc2;
+    server1.ConfigureSession(addr2, config1, &disc2);
+    EXPECT_NE(disc1, disc2);
+    EXPECT_EQ(static_cast<Session *>(NULL),
+              server1.SessionByDiscriminator(disc1));
+    EXPECT_EQ(server1.SessionByAddress(addr2),
+              server1.SessionByDiscriminator(disc2));
+
+    em.Shutdown();
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
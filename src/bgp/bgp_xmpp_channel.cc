@@ -2203,29 +2203,33 @@ void BgpXmppChannel::ReceiveUpdate(const XmppStanza::XmppMessage *msg) {
                 XmlBase *impl = msg->dom.get();
                 stats_[RX].rt_updates++;
                 XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl);
+
+                // All items in a publish share the address family encoded
+                // in the associate/dissociate node id. Agents may publish
+                // many items in one message, so parse it once up front.
+                string id(iq->as_node.c_str());
+                char *str = const_cast<char *>(id.c_str());
+                char *saveptr;
+                char *af_str = strtok_r(str, "/", &saveptr);
+                char *safi_str = strtok_r(NULL, "/", &saveptr);
+                if (!af_str || !safi_str)
+                    return;
+                int af = atoi(af_str);
+                int safi = atoi(safi_str);
+
                 for (xml_node item = pugi->FindNode("item"); item;
                     item = item.next_sibling()) {
                     if (strcmp(item.name(), "item") != 0) continue;
 
-                        string id(iq->as_node.c_str());
-                        char *str = const_cast<char *>(id.c_str());
-                        char *saveptr;
-                        char *af = strtok_r(str, "/", &saveptr);
-                        char *safi = strtok_r(NULL, "/", &saveptr);
-
-                        if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Unicast) {
-                            ProcessItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::IPv6 &&
-                                   atoi(safi) == BgpAf::Unicast) {
-                            ProcessInet6Item(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Mcast) {
-                            ProcessMcastItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::L2Vpn &&
-                                   atoi(safi) == BgpAf::Enet) {
-                            ProcessEnetItem(iq->node, item, iq->is_as_node);
-                        }
+                    if (af == BgpAf::IPv4 && safi == BgpAf::Unicast) {
+                        ProcessItem(iq->node, item, iq->is_as_node);
+                    } else if (af == BgpAf::IPv6 && safi == BgpAf::Unicast) {
+                        ProcessInet6Item(iq->node, item, iq->is_as_node);
+                    } else if (af == BgpAf::IPv4 && safi == BgpAf::Mcast) {
+                        ProcessMcastItem(iq->node, item, iq->is_as_node);
+                    } else if (af == BgpAf::L2Vpn && safi == BgpAf::Enet) {
+                        ProcessEnetItem(iq->node, item, iq->is_as_node);
+                    }
                 }
             }
         }
@@ -66,6 +66,11 @@ void ControlNode::SetDefaultSchedulingPolicy() {
         sm_policy);
     scheduler->SetPolicy(scheduler->GetTaskId("xmpp::StateMachine"),
         sm_policy);
+    // Keepalives and session events are not to wait behind table walks.
+    scheduler->SetPriority(scheduler->GetTaskId("bgp::StateMachine"),
+        TaskScheduler::HIGH);
+    scheduler->SetPriority(scheduler->GetTaskId("xmpp::StateMachine"),
+        TaskScheduler::HIGH);
 
     // Policy for bgp::PeerMembership Task.
     TaskPolicy peer_membership_policy = boost::assign::list_of
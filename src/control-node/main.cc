@@ -36,6 +36,7 @@
 #include "ifmap/ifmap_sandesh_context.h"
 #include "ifmap/ifmap_server.h"
 #include "ifmap/ifmap_server_parser.h"
+#include "ifmap/ifmap_snapshot.h"
 #include "ifmap/ifmap_xmpp.h"
 #include "io/event_manager.h"
 #include "sandesh/common/vns_constants.h"
@@ -85,6 +86,7 @@ static XmppServer *CreateXmppServer(EventManager *evm, Options *options,
     xmpp_cfg->FromAddr = XmppInit::kControlNodeJID;
     xmpp_cfg->auth_enabled = options->xmpp_auth_enabled();
     xmpp_cfg->tcp_hold_time = options->tcp_hold_time();
+    xmpp_cfg->compression_level = options->xmpp_compression_level();
 
     if (xmpp_cfg->auth_enabled) {
         xmpp_cfg->path_to_server_cert = options->xmpp_server_cert();
@@ -643,6 +645,24 @@ int main(int argc, char *argv[]) {
         evm.io_service());
     ifmap_server.set_ifmap_manager(ifmap_manager);
 
+    // Restore the configuration checkpointed by a previous run, so that
+    // agents can be served before the download from the IFMap server
+    // completes. The restored entries are reconciled against the server
+    // by the stale entries cleanup after the first connection.
+    boost::scoped_ptr<IFMapSnapshot> ifmap_snapshot;
+    if (!options.ifmap_snapshot_file().empty()) {
+        ifmap_snapshot.reset(
+            new IFMapSnapshot(&ifmap_server, options.ifmap_snapshot_file()));
+        ifmap_snapshot->Load(&config_db, ifmap_parser);
+        if (ifmap_snapshot->loaded_records() != 0) {
+            ifmap_manager->channel()->SetWarmStart();
+        }
+        ifmap_parser->set_snapshot(ifmap_snapshot.get());
+        ifmap_server.set_snapshot(ifmap_snapshot.get());
+        ifmap_snapshot->StartCheckpointTimer(
+            options.ifmap_snapshot_interval() * 1000);
+    }
+
     // Determine if the number of connections is as expected. At the moment,
     // consider connections to collector, discovery server and IFMap (irond)
     // servers as critical to the normal functionality of control-node.
@@ -750,6 +770,11 @@ int main(int argc, char *argv[]) {
     // Event loop.
     evm.Run();
 
+    if (ifmap_snapshot) {
+        ifmap_snapshot->StopCheckpointTimer();
+        ifmap_parser->set_snapshot(NULL);
+        ifmap_server.set_snapshot(NULL);
+    }
     ShutdownServers(&bgp_peer_manager, ds_client, node_info_log_timer.get());
     return 0;
 }
@@ -131,6 +131,10 @@ void Options::Initialize(EventManager &evm,
              opt::value<string>()->default_value(
              "/etc/contrail/ssl/private/control-node-privkey.pem"),
              "XMPP Server ssl private key")
+        ("DEFAULT.xmpp_compression_level",
+             opt::value<int>()->default_value(0),
+             "zlib compression level of XMPP streams without authentication, "
+             "0 disables compression")
         ("DEFAULT.sandesh_send_rate_limit",
               opt::value<uint32_t>()->default_value(
               Sandesh::get_send_rate_limit()),
@@ -149,6 +153,10 @@ void Options::Initialize(EventManager &evm,
         ("IFMAP.server_url",
              opt::value<string>()->default_value(ifmap_server_url_),
              "IFMAP server URL")
+        ("IFMAP.snapshot_file", opt::value<string>()->default_value(""),
+             "File used to checkpoint IFMAP configuration for warm start")
+        ("IFMAP.snapshot_interval", opt::value<int>()->default_value(300),
+             "Interval in seconds between IFMAP configuration checkpoints")
         ("IFMAP.user", opt::value<string>()->default_value("control-node"),
              "IFMAP server username")
         ;
@@ -266,6 +274,8 @@ bool Options::Process(int argc, char *argv[],
     GetOptValue<bool>(var_map, xmpp_auth_enable_, "DEFAULT.xmpp_auth_enable");
     GetOptValue<string>(var_map, xmpp_server_cert_, "DEFAULT.xmpp_server_cert");
     GetOptValue<string>(var_map, xmpp_server_key_, "DEFAULT.xmpp_server_key");
+    GetOptValue<int>(var_map, xmpp_compression_level_,
+                     "DEFAULT.xmpp_compression_level");
     GetOptValue<uint32_t>(var_map, sandesh_ratelimit_,
                               "DEFAULT.sandesh_send_rate_limit");
 
@@ -277,6 +287,9 @@ bool Options::Process(int argc, char *argv[],
     GetOptValue<string>(var_map, ifmap_server_url_, "IFMAP.server_url");
     GetOptValue<string>(var_map, ifmap_user_, "IFMAP.user");
     GetOptValue<string>(var_map, ifmap_certs_store_, "IFMAP.certs_store");
+    GetOptValue<string>(var_map, ifmap_snapshot_file_, "IFMAP.snapshot_file");
+    GetOptValue<int>(var_map, ifmap_snapshot_interval_,
+                     "IFMAP.snapshot_interval");
 
     return true;
 }
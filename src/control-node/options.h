@@ -36,10 +36,19 @@ public:
     const std::string ifmap_password() const { return ifmap_password_; }
     const std::string ifmap_user() const { return ifmap_user_; }
     const std::string ifmap_certs_store() const { return ifmap_certs_store_; }
+    const std::string ifmap_snapshot_file() const {
+        return ifmap_snapshot_file_;
+    }
+    const int ifmap_snapshot_interval() const {
+        return ifmap_snapshot_interval_;
+    }
     const uint16_t xmpp_port() const { return xmpp_port_; }
     const bool xmpp_auth_enabled() const { return xmpp_auth_enable_; }
     const std::string xmpp_server_cert() const { return xmpp_server_cert_; }
     const std::string xmpp_server_key() const { return xmpp_server_key_; }
+    const int xmpp_compression_level() const {
+        return xmpp_compression_level_;
+    }
     const bool test_mode() const { return test_mode_; }
     const bool collectors_configured() const { return collectors_configured_; }
     const int tcp_hold_time() const { return tcp_hold_time_; }
@@ -86,10 +95,13 @@ private:
     std::string ifmap_password_;
     std::string ifmap_user_;
     std::string ifmap_certs_store_;
+    std::string ifmap_snapshot_file_;
+    int ifmap_snapshot_interval_;
     uint16_t xmpp_port_;
     bool xmpp_auth_enable_;
     std::string xmpp_server_cert_;
     std::string xmpp_server_key_;
+    int xmpp_compression_level_;
     bool test_mode_;
     bool collectors_configured_;
     int tcp_hold_time_;
@@ -75,6 +75,8 @@ TEST_F(OptionsTest, NoArguments) {
     EXPECT_EQ(options_.ifmap_password(), "control-node");
     EXPECT_EQ(options_.ifmap_user(), "control-node");
     EXPECT_EQ(options_.ifmap_certs_store(), "");
+    EXPECT_EQ(options_.ifmap_snapshot_file(), "");
+    EXPECT_EQ(options_.ifmap_snapshot_interval(), 300);
     EXPECT_EQ(options_.xmpp_port(), default_xmpp_port);
     EXPECT_EQ(options_.test_mode(), false);
     EXPECT_EQ(options_.sandesh_send_rate_limit(), 0);
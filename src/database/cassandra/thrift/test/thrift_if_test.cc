@@ -9,6 +9,7 @@
 #include "testing/gunit.h"
 
 #include "base/logging.h"
+#include "base/time_util.h"
 #include "../thrift_if_impl.h"
 
 using namespace GenDb;
@@ -60,7 +61,45 @@ protected:
             ThriftIfImpl::ThriftIfStats::THRIFTIF_STATS_ERR_READ_COLUMN);
     }
 
+    void UpdateStatsCfWriteLatency(const std::string &cfname,
+        uint64_t latency_usecs) {
+        stats_.UpdateCfWriteLatency(cfname, latency_usecs);
+    }
+    bool AsyncAddColumn(GenDb::ColList *cl) {
+        ThriftIfImpl::ThriftIfColList qentry;
+        qentry.gendb_cl = cl;
+        return impl_.Db_AsyncAddColumn(qentry);
+    }
+    bool IsBatchFull(uint64_t now) const {
+        return impl_.Db_IsBatchFull(now);
+    }
+    size_t batch_rows() const {
+        return impl_.mutation_map_.size();
+    }
+    // Mutations of the first column family for the row key
+    const std::vector<org::apache::cassandra::Mutation> *row_mutations(
+        const GenDb::DbDataValueVec &rowkey) const {
+        std::string key;
+        DbDataValueVecToString(key, rowkey.size() != 1, rowkey);
+        ThriftIfImpl::CassandraMutationMap::const_iterator it =
+            impl_.mutation_map_.find(key);
+        if (it == impl_.mutation_map_.end() || it->second.size() != 1) {
+            return NULL;
+        }
+        return &it->second.begin()->second;
+    }
+    size_t batch_mutations() const {
+        return impl_.batch_mutations_;
+    }
+    uint64_t batch_start_usecs() const {
+        return impl_.batch_start_usecs_;
+    }
+    static uint64_t max_batch_latency_usecs() {
+        return ThriftIfImpl::kMaxBatchLatencyUsecs;
+    }
+
     ThriftIfImpl::ThriftIfStats stats_;
+    ThriftIfImpl impl_;
 };
 
 TEST_F(ThriftIfTest, EncodeDecodeString) {
@@ -399,6 +438,71 @@ TEST_F(ThriftIfTest, Stats) {
     EXPECT_EQ(edbe_diffs, adbe_diffs);
 }
 
+TEST_F(ThriftIfTest, WriteLatencyStats) {
+    const std::string cfname("FakeColumnFamily");
+    UpdateStatsCfWriteLatency(cfname, 100);
+    UpdateStatsCfWriteLatency(cfname, 2000);
+    UpdateStatsCfWriteLatency(cfname, 3000);
+    UpdateStatsCfWriteLatency(cfname, 10 * 1000 * 1000);
+    std::vector<GenDb::DbTableInfo> vdbti;
+    GenDb::DbErrors dbe;
+    GetStats(&vdbti, &dbe);
+    ASSERT_EQ(1, vdbti.size());
+    std::vector<uint64_t> ehistogram = boost::assign::list_of
+        (1)(0)(2)(0)(0)(0)(0)(1);
+    EXPECT_EQ(ehistogram, vdbti[0].get_write_latency_histogram());
+    // Histogram is reset on every Get
+    vdbti.clear();
+    UpdateStatsCfWrite(cfname);
+    GetStats(&vdbti, &dbe);
+    ASSERT_EQ(1, vdbti.size());
+    EXPECT_FALSE(vdbti[0].__isset.write_latency_histogram);
+}
+
+static GenDb::ColList *CreateColList(const std::string &cfname,
+    uint32_t rowkey, const std::vector<uint32_t> &names,
+    const std::string &value) {
+    GenDb::ColList *cl(new GenDb::ColList);
+    cl->cfname_ = cfname;
+    cl->rowkey_.push_back(rowkey);
+    for (size_t i = 0; i < names.size(); i++) {
+        cl->columns_.push_back(new GenDb::NewCol(
+            new GenDb::DbDataValueVec(1, names[i]),
+            new GenDb::DbDataValueVec(1, value), 0));
+    }
+    return cl;
+}
+
+// Writes to the same row key and column family are merged into one
+// mutation list, and repeated writes to the same column are coalesced
+// keeping the latest value.
+TEST_F(ThriftIfTest, BatchCoalesce) {
+    const std::string cfname("FakeColumnFamily");
+    std::vector<uint32_t> names1 = boost::assign::list_of(1)(2)(3);
+    std::vector<uint32_t> names2 = boost::assign::list_of(3)(4);
+    EXPECT_FALSE(IsBatchFull(UTCTimestampUsec()));
+    EXPECT_TRUE(AsyncAddColumn(CreateColList(cfname, 1, names1, "first")));
+    EXPECT_TRUE(AsyncAddColumn(CreateColList(cfname, 1, names2, "second")));
+    EXPECT_TRUE(AsyncAddColumn(CreateColList(cfname, 2, names2, "third")));
+    ASSERT_EQ(2, batch_rows());
+    EXPECT_EQ(6, batch_mutations());
+
+    const std::vector<org::apache::cassandra::Mutation> *mutations(
+        row_mutations(GenDb::DbDataValueVec(1, (uint32_t)1)));
+    ASSERT_TRUE(mutations != NULL);
+    ASSERT_EQ(4, mutations->size());
+    std::string expected_value;
+    DbDataValueVecToString(expected_value, false,
+        GenDb::DbDataValueVec(1, std::string("second")));
+    EXPECT_EQ(expected_value,
+        mutations->at(2).column_or_supercolumn.column.value);
+
+    // The batch is full once it is older than the latency bound
+    EXPECT_FALSE(IsBatchFull(batch_start_usecs()));
+    EXPECT_TRUE(IsBatchFull(batch_start_usecs() +
+        max_batch_latency_usecs()));
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
@@ -10,6 +10,7 @@
 #include <sys/socket.h>
 #include <errno.h>
 #include <string.h>
+#include <set>
 
 #include <base/parse_object.h>
 #include <sandesh/sandesh_constants.h>
@@ -865,6 +866,9 @@ ThriftIfImpl::ThriftIfImpl(GenDb::GenDbIf::DbErrorHandler errhandler,
     task_instance_(-1),
     prev_task_instance_(-1),
     task_instance_initialized_(false),
+    batch_mutations_(0),
+    batch_bytes_(0),
+    batch_start_usecs_(0),
     cassandra_user_(cassandra_user),
     cassandra_password_(cassandra_password) {
     // reduce connection timeout
@@ -881,7 +885,10 @@ ThriftIfImpl::ThriftIfImpl() :
     only_sync_(false),
     task_instance_(-1),
     prev_task_instance_(-1),
-    task_instance_initialized_(false) {
+    task_instance_initialized_(false),
+    batch_mutations_(0),
+    batch_bytes_(0),
+    batch_start_usecs_(0) {
     db_init_done_ = false;
 }
 
@@ -1355,6 +1362,9 @@ bool ThriftIfImpl::Db_AsyncAddColumn(ThriftIfColList &cl) {
         return true;
     }
     uint64_t ts(UTCTimestampUsec());
+    if (mutation_map_.empty()) {
+        batch_start_usecs_ = ts;
+    }
     std::string cfname(new_colp->cfname_);
     // Does the row key exist in the Cassandra mutation map ?
     std::string key_value;
@@ -1408,7 +1418,8 @@ bool ThriftIfImpl::Db_AsyncAddColumn(ThriftIfColList &cl) {
             }
             c_or_sc.__set_column(c);
             mutation.__set_column_or_supercolumn(c_or_sc);
-            mutations.push_back(mutation);
+            Db_AddMutation(&mutations, col_name,
+                col_name.size() + col_value.size(), mutation);
         } else if (it->cftype_ == GenDb::NewCf::COLUMN_FAMILY_NOSQL) {
             THRIFTIF_EXPECT_TRUE_ELSE_RETURN_FALSE(
                 cftype != GenDb::NewCf::COLUMN_FAMILY_SQL);
@@ -1429,7 +1440,8 @@ bool ThriftIfImpl::Db_AsyncAddColumn(ThriftIfColList &cl) {
             }
             c_or_sc.__set_column(c);
             mutation.__set_column_or_supercolumn(c_or_sc);
-            mutations.push_back(mutation);
+            Db_AddMutation(&mutations, col_name,
+                col_name.size() + col_value.size(), mutation);
         } else {
             stats_.IncrementErrors(
                 ThriftIfStats::THRIFTIF_STATS_ERR_WRITE_COLUMN);
@@ -1443,17 +1455,79 @@ bool ThriftIfImpl::Db_AsyncAddColumn(ThriftIfColList &cl) {
     // Allocated when enqueued, free it after processing
     delete new_colp;
     cl.gendb_cl = NULL;
+    // Send the batch if it is full
+    if (Db_IsBatchFull(UTCTimestampUsec())) {
+        Db_FlushBatch();
+    }
     return true;
 }
 
-void ThriftIfImpl::Db_BatchAddColumn(bool done) {
+void ThriftIfImpl::Db_AddMutation(MutationList *mutations,
+        const std::string &col_name, size_t col_size,
+        const cassandra::Mutation &mutation) {
+    // A later write to the same column in the batch replaces the earlier
+    // one, Cassandra would only keep the latest anyway
+    ColumnIndexMap &column_index(mutation_index_[mutations]);
+    std::pair<ColumnIndexMap::iterator, bool> ret(column_index.insert(
+        std::make_pair(col_name, mutations->size())));
+    if (ret.second) {
+        mutations->push_back(mutation);
+        batch_mutations_++;
+    } else {
+        (*mutations)[ret.first->second] = mutation;
+    }
+    batch_bytes_ += col_size;
+}
+
+bool ThriftIfImpl::Db_IsBatchFull(uint64_t now) const {
+    if (mutation_map_.empty()) {
+        return false;
+    }
+    return batch_mutations_ >= kMaxBatchMutations ||
+        batch_bytes_ >= kMaxBatchBytes ||
+        now - batch_start_usecs_ >= kMaxBatchLatencyUsecs;
+}
+
+void ThriftIfImpl::Db_FlushBatch() {
+    if (mutation_map_.empty()) {
+        return;
+    }
+    uint64_t start(UTCTimestampUsec());
     THRIFTIF_BEGIN_TRY {
         client_->batch_mutate(mutation_map_,
             org::apache::cassandra::ConsistencyLevel::ONE);
     } THRIFTIF_END_TRY_LOG_INTERNAL(integerToString(mutation_map_.size()),
           false, false, true, ThriftIfStats::THRIFTIF_STATS_ERR_WRITE_BATCH_COLUMN,
           ThriftIfStats::THRIFTIF_STATS_CF_OP_NONE)
+    uint64_t latency(UTCTimestampUsec() - start);
+    // Account the batch latency to each column family in the batch
+    std::set<std::string> cfnames;
+    for (CassandraMutationMap::const_iterator it = mutation_map_.begin();
+         it != mutation_map_.end(); it++) {
+        for (CFMutationMap::const_iterator cf_it = it->second.begin();
+             cf_it != it->second.end(); cf_it++) {
+            cfnames.insert(cf_it->first);
+        }
+    }
+    {
+        tbb::mutex::scoped_lock lock(smutex_);
+        for (std::set<std::string>::const_iterator it = cfnames.begin();
+             it != cfnames.end(); it++) {
+            stats_.UpdateCfWriteLatency(*it, latency);
+        }
+    }
     mutation_map_.clear();
+    mutation_index_.clear();
+    batch_mutations_ = 0;
+    batch_bytes_ = 0;
+}
+
+void ThriftIfImpl::Db_BatchAddColumn(bool done) {
+    // Keep accumulating while the queue runner is only yielding, unless
+    // the batch is full
+    if (done || Db_IsBatchFull(UTCTimestampUsec())) {
+        Db_FlushBatch();
+    }
 }
 
 bool ThriftIfImpl::Db_AddColumn(std::auto_ptr<GenDb::ColList> cl) {
@@ -1709,6 +1783,11 @@ void ThriftIfImpl::ThriftIfStats::UpdateCf(const std::string &cfname, bool write
     cf_stats_.Update(cfname, write, fail);
 }
 
+void ThriftIfImpl::ThriftIfStats::UpdateCfWriteLatency(
+    const std::string &cfname, uint64_t latency_usecs) {
+    cf_stats_.UpdateWriteLatency(cfname, latency_usecs);
+}
+
 void ThriftIfImpl::ThriftIfStats::IncrementErrors(ThriftIfImpl::ThriftIfStats::ErrorType type) {
     switch (type) {
     case ThriftIfStats::THRIFTIF_STATS_ERR_WRITE_TABLESPACE:
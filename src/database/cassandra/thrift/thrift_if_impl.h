@@ -89,6 +89,13 @@ class ThriftIfImpl {
         GenDb::ColList *gendb_cl;
     };
 
+    typedef std::vector<org::apache::cassandra::Mutation> MutationList;
+    typedef std::map<std::string, MutationList> CFMutationMap;
+    typedef std::map<std::string, CFMutationMap> CassandraMutationMap;
+    typedef boost::unordered_map<std::string, size_t> ColumnIndexMap;
+    typedef boost::unordered_map<const MutationList *, ColumnIndexMap>
+        MutationIndexMap;
+
     // Init/Uninit
     bool Db_IsInitDone() const;
     // Column family
@@ -99,6 +106,10 @@ class ThriftIfImpl {
     bool Db_AsyncAddColumn(ThriftIfColList &cl);
     bool Db_AsyncAddColumnLocked(ThriftIfColList &cl);
     void Db_BatchAddColumn(bool done);
+    void Db_AddMutation(MutationList *mutations, const std::string &col_name,
+        size_t col_size, const org::apache::cassandra::Mutation &mutation);
+    bool Db_IsBatchFull(uint64_t now) const;
+    void Db_FlushBatch();
     bool DB_IsCfSchemaChanged(org::apache::cassandra::CfDef *cfdef,
                               org::apache::cassandra::CfDef *newcfdef);
     // Encode and decode
@@ -152,6 +163,8 @@ class ThriftIfImpl {
         };
         void IncrementErrors(ErrorType type);
         void UpdateCf(const std::string &cf_name, bool write, bool fail);
+        void UpdateCfWriteLatency(const std::string &cf_name,
+            uint64_t latency_usecs);
         void Get(std::vector<GenDb::DbTableInfo> *vdbti, GenDb::DbErrors *dbe);
         GenDb::DbTableStatistics cf_stats_;
         Errors db_errors_;
@@ -170,6 +183,12 @@ class ThriftIfImpl {
     void UpdateCfReadFailStats(const std::string &cf_name);
 
     static const size_t kQueueSize = 200 * 1024 * 1024; // 200 MB
+    // Write batches are sent when they reach kMaxBatchMutations mutations,
+    // kMaxBatchBytes bytes of column names and values, or are older than
+    // kMaxBatchLatencyUsecs, or else when the queue is drained
+    static const size_t kMaxBatchMutations = 4096;
+    static const size_t kMaxBatchBytes = 4 * 1024 * 1024; // 4 MB
+    static const uint64_t kMaxBatchLatencyUsecs = 100000; // 100 ms
     typedef WorkQueue<ThriftIfColList> ThriftIfQueue;
     friend class WorkQueue<ThriftIfColList>;
     typedef boost::tuple<bool, size_t, GenDb::GenDbIf::DbQueueWaterMarkCb>
@@ -196,10 +215,13 @@ class ThriftIfImpl {
     int task_instance_;
     int prev_task_instance_;
     bool task_instance_initialized_;
-    typedef std::vector<org::apache::cassandra::Mutation> MutationList;
-    typedef std::map<std::string, MutationList> CFMutationMap;
-    typedef std::map<std::string, CFMutationMap> CassandraMutationMap;
     CassandraMutationMap mutation_map_;
+    // Index of the mutation of each column name in the batch, per row key
+    // and column family, used to coalesce writes to the same column
+    MutationIndexMap mutation_index_;
+    size_t batch_mutations_;
+    size_t batch_bytes_;
+    uint64_t batch_start_usecs_;
     mutable tbb::mutex smutex_;
     ThriftIfStats stats_;
     std::vector<DbQueueWaterMarkInfo> q_wm_info_;
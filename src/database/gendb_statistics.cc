@@ -2,10 +2,17 @@
 // Copyright (c) 2014 Juniper Networks, Inc. All rights reserved.
 //
 
+#include <algorithm>
+
 #include "gendb_statistics.h"
 
 namespace GenDb {
 
+const size_t DbTableStatistics::kNumLatencyBuckets;
+const uint64_t DbTableStatistics::kLatencyBucketUsecs[] = {
+    250, 1000, 4000, 16000, 64000, 256000, 1000000
+};
+
 void GenDb::DbTableStatistics::TableStats::Update(bool write, bool fail) {
     if (write) {
         if (fail) {
@@ -22,6 +29,17 @@ void GenDb::DbTableStatistics::TableStats::Update(bool write, bool fail) {
     }
 }
 
+void GenDb::DbTableStatistics::TableStats::UpdateWriteLatency(
+    uint64_t latency_usecs) {
+    if (write_latency_histogram_.empty()) {
+        write_latency_histogram_.resize(kNumLatencyBuckets);
+    }
+    size_t bucket = std::upper_bound(kLatencyBucketUsecs,
+        kLatencyBucketUsecs + kNumLatencyBuckets - 1, latency_usecs) -
+        kLatencyBucketUsecs;
+    write_latency_histogram_[bucket]++;
+}
+
 void GenDb::DbTableStatistics::TableStats::Get(const std::string &table_name,
     DbTableInfo *info) const {
     info->set_table_name(table_name);
@@ -29,17 +47,29 @@ void GenDb::DbTableStatistics::TableStats::Get(const std::string &table_name,
     info->set_read_fails(num_read_fails_);
     info->set_writes(num_writes_);
     info->set_write_fails(num_write_fails_);
+    if (!write_latency_histogram_.empty()) {
+        info->set_write_latency_histogram(write_latency_histogram_);
+    }
 }
 
 // DbTableStatistics
-void GenDb::DbTableStatistics::Update(const std::string &table_name,
-    bool write, bool fail) {
+GenDb::DbTableStatistics::TableStats *
+GenDb::DbTableStatistics::LocateTableStats(const std::string &table_name) {
     TableStatsMap::iterator it = table_stats_map_.find(table_name);
     if (it == table_stats_map_.end()) {
         it = (table_stats_map_.insert(table_name, new TableStats)).first;
     }
-    TableStats *table_stats = it->second;
-    table_stats->Update(write, fail);
+    return it->second;
+}
+
+void GenDb::DbTableStatistics::Update(const std::string &table_name,
+    bool write, bool fail) {
+    LocateTableStats(table_name)->Update(write, fail);
+}
+
+void GenDb::DbTableStatistics::UpdateWriteLatency(
+    const std::string &table_name, uint64_t latency_usecs) {
+    LocateTableStats(table_name)->UpdateWriteLatency(latency_usecs);
 }
 
 void GenDb::DbTableStatistics::Get(std::vector<GenDb::DbTableInfo> *vdbti) {
@@ -5,6 +5,7 @@
 #ifndef GENDB_GENDB_STATISTICS_H__
 #define GENDB_GENDB_STATISTICS_H__
 
+#include <vector>
 #include <boost/ptr_container/ptr_map.hpp>
 #include "gendb_types.h"
 
@@ -14,7 +15,13 @@ class DbTableStatistics {
  public:
     DbTableStatistics() {
     }
+    static const size_t kNumLatencyBuckets = 8;
+    // Upper bounds of the latency buckets, the last bucket is unbounded
+    static const uint64_t kLatencyBucketUsecs[kNumLatencyBuckets - 1];
+
     void Update(const std::string &table_name, bool write, bool fail);
+    void UpdateWriteLatency(const std::string &table_name,
+        uint64_t latency_usecs);
     void Get(std::vector<GenDb::DbTableInfo> *vdbti);
 
  private:
@@ -26,6 +33,7 @@ class DbTableStatistics {
             num_write_fails_(0) {
         }
         void Update(bool write, bool fail);
+        void UpdateWriteLatency(uint64_t latency_usecs);
         void Get(const std::string &table_name,
             GenDb::DbTableInfo *dbti) const;
 
@@ -33,8 +41,11 @@ class DbTableStatistics {
         uint64_t num_read_fails_;
         uint64_t num_writes_;
         uint64_t num_write_fails_;
+        std::vector<uint64_t> write_latency_histogram_;
     };
 
+    TableStats *LocateTableStats(const std::string &table_name);
+
     typedef boost::ptr_map<const std::string, TableStats> TableStatsMap;
     TableStatsMap table_stats_map_;
 };
@@ -0,0 +1,767 @@
+//
+// Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+//
+
+#include <database/local/local_store_if.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/foreach.hpp>
+
+#include <base/logging.h>
+#include <base/time_util.h>
+
+using GenDb::DbDataValue;
+using GenDb::DbDataValueVec;
+
+#define LOCALSTORE_LOG_ERR(_Msg)                                          \
+    do {                                                                  \
+        LOG(ERROR, name_ << ": " << __func__ << ":" << __FILE__ << ":" << \
+            __LINE__ << ": " << _Msg);                                    \
+    } while (false)
+
+#define LOCALSTORE_LOG_ERR_RETURN_FALSE(_Msg)                             \
+    do {                                                                  \
+        LOCALSTORE_LOG_ERR(_Msg);                                         \
+        return false;                                                     \
+    } while (false)
+
+static const char kLogMagic[4] = { 'G', 'D', 'B', 'L' };
+static const size_t kLogHeaderSize = sizeof(kLogMagic) + sizeof(uint32_t);
+
+static uint32_t NowSeconds() {
+    return UTCTimestampUsec() / 1000000;
+}
+
+//
+// Log encoding. A record is a u32 payload length followed by the payload:
+// column family name, column family type, row key and the columns, each
+// column being its name, value and expiry time. Values are encoded as
+// their variant type index followed by the value in host byte order.
+//
+template <typename T>
+static void EncodeInteger(std::string *buffer, T value) {
+    buffer->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void EncodeString(std::string *buffer, const std::string &value) {
+    EncodeInteger<uint32_t>(buffer, value.size());
+    buffer->append(value);
+}
+
+class LogValueEncoder : public boost::static_visitor<> {
+ public:
+    explicit LogValueEncoder(std::string *buffer) : buffer_(buffer) {
+    }
+    template <typename T>
+    void operator()(const T &value) const {
+        EncodeInteger<T>(buffer_, value);
+    }
+    void operator()(const std::string &value) const {
+        EncodeString(buffer_, value);
+    }
+    void operator()(const boost::blank &value) const {
+    }
+    void operator()(const boost::uuids::uuid &value) const {
+        buffer_->append(reinterpret_cast<const char *>(value.data),
+                        value.size());
+    }
+
+ private:
+    std::string *buffer_;
+};
+
+static void EncodeValueVec(std::string *buffer, const DbDataValueVec &vec) {
+    EncodeInteger<uint32_t>(buffer, vec.size());
+    LogValueEncoder encoder(buffer);
+    BOOST_FOREACH(const DbDataValue &value, vec) {
+        EncodeInteger<uint8_t>(buffer, value.which());
+        boost::apply_visitor(encoder, value);
+    }
+}
+
+// Bounds checked decoder over a log buffer.
+class LogReader {
+ public:
+    LogReader(const char *data, size_t size)
+        : data_(data), size_(size), offset_(0) {
+    }
+
+    bool Read(void *value, size_t length) {
+        if (size_ - offset_ < length) {
+            return false;
+        }
+        memcpy(value, data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+
+    template <typename T>
+    bool ReadValue(DbDataValue *value) {
+        T number;
+        if (!Read(&number, sizeof(number))) {
+            return false;
+        }
+        *value = number;
+        return true;
+    }
+
+    bool ReadString(std::string *value) {
+        uint32_t length;
+        if (!Read(&length, sizeof(length)) || size_ - offset_ < length) {
+            return false;
+        }
+        value->assign(data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+
+    bool ReadValueVec(DbDataValueVec *vec) {
+        uint32_t count;
+        if (!Read(&count, sizeof(count))) {
+            return false;
+        }
+        vec->resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t type;
+            if (!Read(&type, sizeof(type))) {
+                return false;
+            }
+            DbDataValue &value((*vec)[i]);
+            bool success = true;
+            switch (type) {
+            case GenDb::DB_VALUE_BLANK:
+                break;
+            case GenDb::DB_VALUE_STRING: {
+                std::string str;
+                success = ReadString(&str);
+                value = str;
+                break;
+            }
+            case GenDb::DB_VALUE_UINT64:
+                success = ReadValue<uint64_t>(&value);
+                break;
+            case GenDb::DB_VALUE_UINT32:
+                success = ReadValue<uint32_t>(&value);
+                break;
+            case GenDb::DB_VALUE_UUID: {
+                boost::uuids::uuid uuid;
+                success = Read(uuid.data, uuid.size());
+                value = uuid;
+                break;
+            }
+            case GenDb::DB_VALUE_UINT8:
+                success = ReadValue<uint8_t>(&value);
+                break;
+            case GenDb::DB_VALUE_UINT16:
+                success = ReadValue<uint16_t>(&value);
+                break;
+            case GenDb::DB_VALUE_DOUBLE:
+                success = ReadValue<double>(&value);
+                break;
+            default:
+                success = false;
+                break;
+            }
+            if (!success) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Skip(size_t length) {
+        if (size_ - offset_ < length) {
+            return false;
+        }
+        offset_ += length;
+        return true;
+    }
+
+    size_t offset() const { return offset_; }
+    size_t remaining() const { return size_ - offset_; }
+
+ private:
+    const char *data_;
+    size_t size_;
+    size_t offset_;
+};
+
+static bool WriteAll(int fd, const std::string &buffer) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t result = write(fd, buffer.data() + written,
+                               buffer.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+static void EncodeRecord(std::string *buffer, const std::string &payload) {
+    EncodeInteger<uint32_t>(buffer, payload.size());
+    buffer->append(payload);
+}
+
+//
+// LocalStoreIf
+//
+LocalStoreIf::LocalStoreIf(const std::string &path, bool read_only,
+        const std::string &name)
+    : path_(path), read_only_(read_only), name_(name), init_done_(false),
+      fd_(-1), inode_(0), log_offset_(0),
+      compaction_threshold_(kDefaultCompactionThreshold), compactions_(0) {
+}
+
+LocalStoreIf::~LocalStoreIf() {
+    CloseTablespace();
+}
+
+// Init/Uninit
+bool LocalStoreIf::Db_Init(const std::string& task_id, int task_instance) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (!read_only_ && mkdir(path_.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(path_ << ": mkdir FAILED: " <<
+            strerror(errno));
+    }
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(path_ << ": NOT A DIRECTORY");
+    }
+    return true;
+}
+
+void LocalStoreIf::Db_Uninit(const std::string& task_id, int task_instance) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    Db_UninitUnlocked(task_id, task_instance);
+}
+
+void LocalStoreIf::Db_UninitUnlocked(const std::string& task_id,
+        int task_instance) {
+    CloseTablespace();
+    init_done_ = false;
+}
+
+void LocalStoreIf::Db_SetInitDone(bool init_done) {
+    init_done_ = init_done;
+}
+
+// Tablespace
+std::string LocalStoreIf::LogFileName(const std::string &tablespace) const {
+    return path_ + "/" + tablespace + ".log";
+}
+
+bool LocalStoreIf::Db_AddTablespace(const std::string& tablespace,
+        const std::string& replication_factor) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (read_only_) {
+        errors_.write_tablespace_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace << ": READ ONLY");
+    }
+    std::string filename(LogFileName(tablespace));
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        errors_.write_tablespace_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(filename << ": open FAILED: " <<
+            strerror(errno));
+    }
+    struct stat st;
+    bool success = fstat(fd, &st) == 0;
+    if (success && st.st_size == 0) {
+        std::string header(kLogMagic, sizeof(kLogMagic));
+        EncodeInteger<uint32_t>(&header, kVersion);
+        success = WriteAll(fd, header);
+    }
+    close(fd);
+    if (!success) {
+        errors_.write_tablespace_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(filename << ": header write FAILED");
+    }
+    tablespaces_.insert(tablespace);
+    return true;
+}
+
+bool LocalStoreIf::Db_SetTablespace(const std::string& tablespace) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (tablespace_ == tablespace && fd_ >= 0) {
+        return true;
+    }
+    if (!OpenTablespace(tablespace)) {
+        errors_.read_tablespace_fails++;
+        return false;
+    }
+    return true;
+}
+
+bool LocalStoreIf::Db_AddSetTablespace(const std::string& tablespace,
+        const std::string& replication_factor) {
+    if (!read_only_ && !Db_AddTablespace(tablespace, replication_factor)) {
+        return false;
+    }
+    return Db_SetTablespace(tablespace);
+}
+
+bool LocalStoreIf::Db_FindTablespace(const std::string& tablespace) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (tablespaces_.find(tablespace) != tablespaces_.end()) {
+        return true;
+    }
+    struct stat st;
+    return stat(LogFileName(tablespace).c_str(), &st) == 0;
+}
+
+bool LocalStoreIf::OpenTablespace(const std::string &tablespace) {
+    CloseTablespace();
+    std::string filename(LogFileName(tablespace));
+    int flags = read_only_ ? O_RDONLY : (O_RDWR | O_APPEND);
+    fd_ = open(filename.c_str(), flags);
+    if (fd_ < 0) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(filename << ": open FAILED: " <<
+            strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        CloseTablespace();
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(filename << ": stat FAILED");
+    }
+    inode_ = st.st_ino;
+    tablespace_ = tablespace;
+    tablespaces_.insert(tablespace);
+    if (!Replay()) {
+        CloseTablespace();
+        return false;
+    }
+    return true;
+}
+
+void LocalStoreIf::CloseTablespace() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = -1;
+    inode_ = 0;
+    log_offset_ = 0;
+    tables_.clear();
+}
+
+//
+// Apply the records appended to the log since log_offset_. A trailing
+// partial record, left behind by a writer that is still appending or that
+// crashed mid-write, is not consumed; the writer truncates it.
+//
+bool LocalStoreIf::Replay() {
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace_ << ": stat FAILED");
+    }
+    size_t size = st.st_size;
+    if (size <= log_offset_) {
+        return true;
+    }
+    std::vector<char> buffer(size - log_offset_);
+    ssize_t result = pread(fd_, &buffer[0], buffer.size(), log_offset_);
+    if (result < 0) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace_ << ": read FAILED: " <<
+            strerror(errno));
+    }
+    LogReader reader(&buffer[0], result);
+    if (log_offset_ == 0) {
+        char magic[sizeof(kLogMagic)];
+        uint32_t version;
+        if (!reader.Read(magic, sizeof(magic)) ||
+            !reader.Read(&version, sizeof(version)) ||
+            memcmp(magic, kLogMagic, sizeof(magic)) != 0 ||
+            version != kVersion) {
+            LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace_ <<
+                ": Invalid log header");
+        }
+    }
+    uint32_t now = NowSeconds();
+    size_t consumed = reader.offset();
+    while (reader.remaining() >= sizeof(uint32_t)) {
+        uint32_t length;
+        reader.Read(&length, sizeof(length));
+        if (reader.remaining() < length) {
+            break;
+        }
+        if (!Apply(&buffer[reader.offset()], length, now)) {
+            LOCALSTORE_LOG_ERR(tablespace_ << ": Record decode FAILED at " <<
+                log_offset_ + consumed);
+        }
+        reader.Skip(length);
+        consumed = reader.offset();
+    }
+    log_offset_ += consumed;
+    if (!read_only_ && log_offset_ < size) {
+        LOCALSTORE_LOG_ERR(tablespace_ << ": Truncating partial record at " <<
+            log_offset_);
+        if (ftruncate(fd_, log_offset_) != 0) {
+            LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace_ <<
+                ": truncate FAILED: " << strerror(errno));
+        }
+    }
+    return true;
+}
+
+// Pick up the writes made through another instance sharing the log.
+bool LocalStoreIf::Refresh() {
+    if (!read_only_) {
+        return true;
+    }
+    if (fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    if (stat(LogFileName(tablespace_).c_str(), &st) != 0) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(tablespace_ << ": stat FAILED");
+    }
+    if (st.st_ino != inode_) {
+        // The log was compacted, reload it.
+        return OpenTablespace(tablespace_);
+    }
+    return Replay();
+}
+
+bool LocalStoreIf::Apply(const char *data, size_t size, uint32_t now) {
+    LogReader reader(data, size);
+    std::string cfname;
+    uint8_t cftype;
+    DbDataValueVec rowkey;
+    uint32_t count;
+    if (!reader.ReadString(&cfname) ||
+        !reader.Read(&cftype, sizeof(cftype)) ||
+        !reader.ReadValueVec(&rowkey) ||
+        !reader.Read(&count, sizeof(count))) {
+        return false;
+    }
+    Row &row(tables_[cfname][rowkey]);
+    for (uint32_t i = 0; i < count; i++) {
+        DbDataValueVec name;
+        Cell cell;
+        if (!reader.ReadValueVec(&name) ||
+            !reader.ReadValueVec(&cell.value) ||
+            !reader.Read(&cell.expiry, sizeof(cell.expiry))) {
+            return false;
+        }
+        if (cell.expiry && cell.expiry <= now) {
+            row.erase(name);
+            continue;
+        }
+        Cell &entry(row[name]);
+        entry.cftype = static_cast<GenDb::NewCf::ColumnFamilyType>(cftype);
+        entry.value.swap(cell.value);
+        entry.expiry = cell.expiry;
+    }
+    return true;
+}
+
+// Column family
+bool LocalStoreIf::Db_AddColumnfamily(const GenDb::NewCf& cf) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (fd_ < 0) {
+        errors_.write_column_family_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cf.cfname_ << ": NO TABLESPACE");
+    }
+    column_families_.insert(cf.cfname_);
+    return true;
+}
+
+bool LocalStoreIf::Db_UseColumnfamily(const GenDb::NewCf& cf) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (fd_ < 0) {
+        errors_.read_column_family_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cf.cfname_ << ": NO TABLESPACE");
+    }
+    column_families_.insert(cf.cfname_);
+    return true;
+}
+
+// Column
+bool LocalStoreIf::AddColumnList(const GenDb::ColList &cl) {
+    if (read_only_ || fd_ < 0 ||
+        column_families_.find(cl.cfname_) == column_families_.end()) {
+        errors_.write_column_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cl.cfname_ << ": NOT WRITABLE");
+    }
+    if (cl.columns_.empty()) {
+        return true;
+    }
+    uint32_t now = NowSeconds();
+    GenDb::NewCf::ColumnFamilyType cftype = cl.columns_[0].cftype_;
+    std::string payload;
+    EncodeString(&payload, cl.cfname_);
+    EncodeInteger<uint8_t>(&payload, cftype);
+    EncodeValueVec(&payload, cl.rowkey_);
+    EncodeInteger<uint32_t>(&payload, cl.columns_.size());
+    BOOST_FOREACH(const GenDb::NewCol &col, cl.columns_) {
+        if (col.cftype_ != cftype) {
+            errors_.write_column_fails++;
+            LOCALSTORE_LOG_ERR_RETURN_FALSE(cl.cfname_ <<
+                ": Mixed column types");
+        }
+        EncodeValueVec(&payload, *col.name);
+        EncodeValueVec(&payload, *col.value);
+        EncodeInteger<uint32_t>(&payload, col.ttl > 0 ? now + col.ttl : 0);
+    }
+    std::string record;
+    EncodeRecord(&record, payload);
+    if (!WriteAll(fd_, record)) {
+        errors_.write_column_fails++;
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cl.cfname_ << ": write FAILED: " <<
+            strerror(errno));
+    }
+    log_offset_ += record.size();
+
+    Row &row(tables_[cl.cfname_][cl.rowkey_]);
+    BOOST_FOREACH(const GenDb::NewCol &col, cl.columns_) {
+        Cell &cell(row[*col.name]);
+        cell.cftype = cftype;
+        cell.value = *col.value;
+        cell.expiry = col.ttl > 0 ? now + col.ttl : 0;
+    }
+
+    if (log_offset_ >= compaction_threshold_) {
+        CompactInternal();
+        // Don't compact again before the log has doubled in size.
+        if (log_offset_ * 2 > compaction_threshold_) {
+            compaction_threshold_ = log_offset_ * 2;
+        }
+    }
+    return true;
+}
+
+bool LocalStoreIf::Db_AddColumn(std::auto_ptr<GenDb::ColList> cl) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    bool success = init_done_ && AddColumnList(*cl);
+    UpdateStats(cl->cfname_, true, !success);
+    return success;
+}
+
+bool LocalStoreIf::Db_AddColumnSync(std::auto_ptr<GenDb::ColList> cl) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    bool success = AddColumnList(*cl);
+    UpdateStats(cl->cfname_, true, !success);
+    return success;
+}
+
+//
+// Rewrite the log with one record per row holding its live columns, then
+// atomically replace the old log. Readers notice the new inode and reload.
+//
+bool LocalStoreIf::CompactInternal() {
+    if (read_only_ || fd_ < 0) {
+        return false;
+    }
+    uint32_t now = NowSeconds();
+    std::string buffer(kLogMagic, sizeof(kLogMagic));
+    EncodeInteger<uint32_t>(&buffer, kVersion);
+    for (TableMap::iterator tit = tables_.begin(); tit != tables_.end();
+         ++tit) {
+        Table &table(tit->second);
+        for (Table::iterator rit = table.begin(), rnext = rit;
+             rit != table.end(); rit = rnext) {
+            ++rnext;
+            Row &row(rit->second);
+            for (Row::iterator cit = row.begin(), cnext = cit;
+                 cit != row.end(); cit = cnext) {
+                ++cnext;
+                if (cit->second.expiry && cit->second.expiry <= now) {
+                    row.erase(cit);
+                }
+            }
+            if (row.empty()) {
+                table.erase(rit);
+                continue;
+            }
+            std::string payload;
+            EncodeString(&payload, tit->first);
+            EncodeInteger<uint8_t>(&payload, row.begin()->second.cftype);
+            EncodeValueVec(&payload, rit->first);
+            EncodeInteger<uint32_t>(&payload, row.size());
+            for (Row::const_iterator cit = row.begin(); cit != row.end();
+                 ++cit) {
+                EncodeValueVec(&payload, cit->first);
+                EncodeValueVec(&payload, cit->second.value);
+                EncodeInteger<uint32_t>(&payload, cit->second.expiry);
+            }
+            EncodeRecord(&buffer, payload);
+        }
+    }
+
+    std::string filename(LogFileName(tablespace_));
+    std::string tmpname(filename + ".tmp");
+    int fd = open(tmpname.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND,
+                  0644);
+    if (fd < 0) {
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(tmpname << ": open FAILED: " <<
+            strerror(errno));
+    }
+    struct stat st;
+    if (!WriteAll(fd, buffer) || fsync(fd) != 0 || fstat(fd, &st) != 0 ||
+        rename(tmpname.c_str(), filename.c_str()) != 0) {
+        close(fd);
+        unlink(tmpname.c_str());
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(filename << ": compaction FAILED: " <<
+            strerror(errno));
+    }
+    close(fd_);
+    fd_ = fd;
+    inode_ = st.st_ino;
+    log_offset_ = buffer.size();
+    compactions_++;
+    return true;
+}
+
+bool LocalStoreIf::Compact() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return CompactInternal();
+}
+
+size_t LocalStoreIf::LogSize() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return log_offset_;
+}
+
+// Read
+void LocalStoreIf::GetSlice(GenDb::ColList *ret, const Row &row,
+        const GenDb::ColumnNameRange &crange, uint32_t now) const {
+    Row::const_iterator it = crange.start_.empty() ? row.begin() :
+        row.lower_bound(crange.start_);
+    uint32_t count = 0;
+    for (; it != row.end() && count < crange.count; ++it) {
+        if (!crange.finish_.empty() && crange.finish_ < it->first) {
+            break;
+        }
+        const Cell &cell(it->second);
+        if (cell.expiry && cell.expiry <= now) {
+            continue;
+        }
+        if (cell.cftype == GenDb::NewCf::COLUMN_FAMILY_SQL) {
+            ret->columns_.push_back(new GenDb::NewCol(
+                boost::get<std::string>(it->first.at(0)),
+                cell.value.at(0), 0));
+        } else {
+            ret->columns_.push_back(new GenDb::NewCol(
+                new DbDataValueVec(it->first),
+                new DbDataValueVec(cell.value), 0));
+        }
+        count++;
+    }
+}
+
+bool LocalStoreIf::Db_GetRow(GenDb::ColList& ret, const std::string& cfname,
+        const DbDataValueVec& rowkey) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (!Refresh() ||
+        column_families_.find(cfname) == column_families_.end()) {
+        errors_.read_column_family_fails++;
+        UpdateStats(cfname, false, true);
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cfname << ": NOT FOUND");
+    }
+    ret.cfname_ = cfname;
+    ret.rowkey_ = rowkey;
+    TableMap::const_iterator tit = tables_.find(cfname);
+    if (tit != tables_.end()) {
+        Table::const_iterator rit = tit->second.find(rowkey);
+        if (rit != tit->second.end()) {
+            GetSlice(&ret, rit->second, GenDb::ColumnNameRange(),
+                     NowSeconds());
+        }
+    }
+    UpdateStats(cfname, false, false);
+    return true;
+}
+
+bool LocalStoreIf::Db_GetMultiRow(GenDb::ColListVec& ret,
+        const std::string& cfname,
+        const std::vector<DbDataValueVec>& rowkeys,
+        GenDb::ColumnNameRange *crange_ptr) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (!Refresh() ||
+        column_families_.find(cfname) == column_families_.end()) {
+        errors_.read_column_family_fails++;
+        UpdateStats(cfname, false, true);
+        LOCALSTORE_LOG_ERR_RETURN_FALSE(cfname << ": NOT FOUND");
+    }
+    // Without a column range, return the first columns of each row, as
+    // the default Cassandra slice does.
+    GenDb::ColumnNameRange default_range;
+    const GenDb::ColumnNameRange &crange(crange_ptr ? *crange_ptr :
+                                         default_range);
+    uint32_t now = NowSeconds();
+    TableMap::const_iterator tit = tables_.find(cfname);
+    BOOST_FOREACH(const DbDataValueVec &rowkey, rowkeys) {
+        std::auto_ptr<GenDb::ColList> col_list(new GenDb::ColList);
+        col_list->cfname_ = cfname;
+        col_list->rowkey_ = rowkey;
+        if (tit != tables_.end()) {
+            Table::const_iterator rit = tit->second.find(rowkey);
+            if (rit != tit->second.end()) {
+                GetSlice(col_list.get(), rit->second, crange, now);
+            }
+        }
+        ret.push_back(col_list);
+    }
+    UpdateStats(cfname, false, false);
+    return true;
+}
+
+// Queue
+bool LocalStoreIf::Db_GetQueueStats(uint64_t *queue_count,
+        uint64_t *enqueues) const {
+    *queue_count = 0;
+    *enqueues = 0;
+    return true;
+}
+
+void LocalStoreIf::Db_SetQueueWaterMark(bool high, size_t queue_count,
+        DbQueueWaterMarkCb cb) {
+}
+
+void LocalStoreIf::Db_ResetQueueWaterMarks() {
+}
+
+// Stats
+void LocalStoreIf::UpdateStats(const std::string &cfname, bool write,
+        bool fail) {
+    stats_.Update(cfname, write, fail);
+}
+
+void LocalStoreIf::Errors::Get(GenDb::DbErrors *db_errors) const {
+    db_errors->set_write_tablespace_fails(write_tablespace_fails);
+    db_errors->set_read_tablespace_fails(read_tablespace_fails);
+    db_errors->set_write_table_fails(write_column_family_fails);
+    db_errors->set_read_table_fails(read_column_family_fails);
+    db_errors->set_write_column_fails(write_column_fails);
+    db_errors->set_write_batch_column_fails(0);
+    db_errors->set_read_column_fails(read_column_fails);
+}
+
+bool LocalStoreIf::Db_GetStats(std::vector<GenDb::DbTableInfo> *vdbti,
+        GenDb::DbErrors *dbe) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    // Report the statistics since the previous call
+    stats_.Get(vdbti);
+    errors_.Get(dbe);
+    errors_ = Errors();
+    return true;
+}
+
+// Connection
+std::string LocalStoreIf::Db_GetHost() const {
+    return "127.0.0.1";
+}
+
+int LocalStoreIf::Db_GetPort() const {
+    return 0;
+}
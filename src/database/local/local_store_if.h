@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+//
+
+#ifndef DATABASE_LOCAL_LOCAL_STORE_IF_H_
+#define DATABASE_LOCAL_LOCAL_STORE_IF_H_
+
+#include <sys/types.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <tbb/mutex.h>
+
+#include <database/gendb_if.h>
+#include <database/gendb_statistics.h>
+
+//
+// Embedded GenDbIf implementation.
+//
+// Each tablespace is stored in a single append-only log file under the
+// store directory, <path>/<tablespace>.log, and is kept in memory as one
+// sorted key space per column family: rows are ordered by row key and the
+// columns of a row by column name, comparing the DbDataValue components in
+// order, the same way Cassandra compares composite keys and names. Every
+// Db_AddColumn appends one record to the log and applies it to the memory
+// tables, so writes are synchronous and there is no write queue.
+//
+// Columns written with a TTL carry an absolute expiry time. Expired columns
+// are skipped by reads and dropped when the log is compacted. The log is
+// compacted by rewriting it with only the live columns once it grows past
+// the compaction threshold.
+//
+// A store opened read-only (e.g. by the query engine) shares the log with
+// the writer: before each read it replays the records appended since the
+// previous read, and reloads the log entirely after a compaction.
+//
+class LocalStoreIf : public GenDb::GenDbIf {
+ public:
+    static const uint32_t kVersion = 1;
+    static const size_t kDefaultCompactionThreshold = 64 * 1024 * 1024;
+
+    LocalStoreIf(const std::string &path, bool read_only,
+        const std::string &name);
+    virtual ~LocalStoreIf();
+    // Init/Uninit
+    virtual bool Db_Init(const std::string& task_id, int task_instance);
+    virtual void Db_Uninit(const std::string& task_id, int task_instance);
+    virtual void Db_UninitUnlocked(const std::string& task_id,
+        int task_instance);
+    virtual void Db_SetInitDone(bool);
+    // Tablespace
+    virtual bool Db_AddTablespace(const std::string& tablespace,
+        const std::string& replication_factor);
+    virtual bool Db_SetTablespace(const std::string& tablespace);
+    virtual bool Db_AddSetTablespace(const std::string& tablespace,
+        const std::string& replication_factor = "1");
+    virtual bool Db_FindTablespace(const std::string& tablespace);
+    // Column family
+    virtual bool Db_AddColumnfamily(const GenDb::NewCf& cf);
+    virtual bool Db_UseColumnfamily(const GenDb::NewCf& cf);
+    // Column
+    virtual bool Db_AddColumn(std::auto_ptr<GenDb::ColList> cl);
+    virtual bool Db_AddColumnSync(std::auto_ptr<GenDb::ColList> cl);
+    // Read
+    virtual bool Db_GetRow(GenDb::ColList& ret, const std::string& cfname,
+        const GenDb::DbDataValueVec& rowkey);
+    virtual bool Db_GetMultiRow(GenDb::ColListVec& ret,
+        const std::string& cfname,
+        const std::vector<GenDb::DbDataValueVec>& key,
+        GenDb::ColumnNameRange *crange_ptr = NULL);
+    // Queue
+    virtual bool Db_GetQueueStats(uint64_t *queue_count,
+        uint64_t *enqueues) const;
+    virtual void Db_SetQueueWaterMark(bool high, size_t queue_count,
+        DbQueueWaterMarkCb cb);
+    virtual void Db_ResetQueueWaterMarks();
+    // Stats
+    virtual bool Db_GetStats(std::vector<GenDb::DbTableInfo> *vdbti,
+        GenDb::DbErrors *dbe);
+    // Connection
+    virtual std::string Db_GetHost() const;
+    virtual int Db_GetPort() const;
+
+    // Rewrite the log of the current tablespace with only live columns.
+    bool Compact();
+    void set_compaction_threshold(size_t threshold) {
+        compaction_threshold_ = threshold;
+    }
+    size_t LogSize() const;
+    uint64_t compactions() const { return compactions_; }
+
+ private:
+    struct Cell {
+        Cell() : cftype(GenDb::NewCf::COLUMN_FAMILY_NOSQL), expiry(0) {
+        }
+        GenDb::NewCf::ColumnFamilyType cftype;
+        GenDb::DbDataValueVec value;
+        uint32_t expiry;
+    };
+    typedef std::map<GenDb::DbDataValueVec, Cell> Row;
+    typedef std::map<GenDb::DbDataValueVec, Row> Table;
+    typedef std::map<std::string, Table> TableMap;
+
+    std::string LogFileName(const std::string &tablespace) const;
+    bool OpenTablespace(const std::string &tablespace);
+    void CloseTablespace();
+    bool Replay();
+    bool Refresh();
+    bool Apply(const char *data, size_t size, uint32_t now);
+    bool AddColumnList(const GenDb::ColList &cl);
+    bool CompactInternal();
+    void GetSlice(GenDb::ColList *ret, const Row &row,
+        const GenDb::ColumnNameRange &crange, uint32_t now) const;
+    void UpdateStats(const std::string &cfname, bool write, bool fail);
+
+    struct Errors {
+        Errors() : write_tablespace_fails(0), read_tablespace_fails(0),
+            write_column_family_fails(0), read_column_family_fails(0),
+            write_column_fails(0), read_column_fails(0) {
+        }
+        void Get(GenDb::DbErrors *db_errors) const;
+        uint64_t write_tablespace_fails;
+        uint64_t read_tablespace_fails;
+        uint64_t write_column_family_fails;
+        uint64_t read_column_family_fails;
+        uint64_t write_column_fails;
+        uint64_t read_column_fails;
+    };
+
+    std::string path_;
+    bool read_only_;
+    std::string name_;
+    bool init_done_;
+    mutable tbb::mutex mutex_;
+    std::set<std::string> tablespaces_;
+    std::string tablespace_;
+    std::set<std::string> column_families_;
+    TableMap tables_;
+    int fd_;
+    ino_t inode_;
+    size_t log_offset_;
+    size_t compaction_threshold_;
+    uint64_t compactions_;
+    GenDb::DbTableStatistics stats_;
+    Errors errors_;
+};
+
+#endif  // DATABASE_LOCAL_LOCAL_STORE_IF_H_
@@ -0,0 +1,296 @@
+//
+// Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/random_generator.hpp>
+
+#include <base/logging.h>
+#include <base/string_util.h>
+
+#include "testing/gunit.h"
+#include <database/gendb_if.h>
+#include <database/local/local_store_if.h>
+
+using GenDb::DbDataValue;
+using GenDb::DbDataValueVec;
+
+static const std::string kTablespace("TestKeyspace");
+static const std::string kNoSqlCf("NoSqlTable");
+static const std::string kSqlCf("SqlTable");
+
+class LocalStoreIfTest : public ::testing::Test {
+ protected:
+    LocalStoreIfTest() {
+        char path[] = "/tmp/local_store_if_test.XXXXXX";
+        EXPECT_TRUE(mkdtemp(path) != NULL);
+        path_ = path;
+    }
+
+    ~LocalStoreIfTest() {
+        std::string command("rm -rf " + path_);
+        EXPECT_EQ(0, system(command.c_str()));
+    }
+
+    static GenDb::NewCf NoSqlCf() {
+        return GenDb::NewCf(kNoSqlCf,
+            GenDb::DbDataTypeVec(1, GenDb::DbDataType::Unsigned32Type),
+            GenDb::DbDataTypeVec(2, GenDb::DbDataType::Unsigned32Type),
+            GenDb::DbDataTypeVec(1, GenDb::DbDataType::AsciiType));
+    }
+
+    static GenDb::NewCf SqlCf() {
+        GenDb::NewCf::SqlColumnMap columns;
+        columns["name"] = GenDb::DbDataType::AsciiType;
+        columns["count"] = GenDb::DbDataType::Unsigned64Type;
+        return GenDb::NewCf(kSqlCf,
+            GenDb::DbDataTypeVec(1, GenDb::DbDataType::LexicalUUIDType),
+            columns);
+    }
+
+    LocalStoreIf *CreateStore(bool read_only) {
+        LocalStoreIf *store = new LocalStoreIf(path_, read_only,
+                                               "LocalStoreIfTest");
+        EXPECT_TRUE(store->Db_Init("", -1));
+        EXPECT_TRUE(store->Db_AddSetTablespace(kTablespace));
+        if (read_only) {
+            EXPECT_TRUE(store->Db_UseColumnfamily(NoSqlCf()));
+            EXPECT_TRUE(store->Db_UseColumnfamily(SqlCf()));
+        } else {
+            EXPECT_TRUE(store->Db_AddColumnfamily(NoSqlCf()));
+            EXPECT_TRUE(store->Db_AddColumnfamily(SqlCf()));
+        }
+        store->Db_SetInitDone(true);
+        return store;
+    }
+
+    static DbDataValueVec Key(uint32_t key) {
+        return DbDataValueVec(1, key);
+    }
+
+    static DbDataValueVec Name(uint32_t first, uint32_t second) {
+        DbDataValueVec name;
+        name.push_back(first);
+        name.push_back(second);
+        return name;
+    }
+
+    static bool AddColumn(LocalStoreIf *store, uint32_t key, uint32_t first,
+                          uint32_t second, const std::string &value,
+                          int ttl = 0) {
+        std::auto_ptr<GenDb::ColList> cl(new GenDb::ColList);
+        cl->cfname_ = kNoSqlCf;
+        cl->rowkey_ = Key(key);
+        cl->columns_.push_back(new GenDb::NewCol(
+            new DbDataValueVec(Name(first, second)),
+            new DbDataValueVec(1, value), ttl));
+        return store->Db_AddColumn(cl);
+    }
+
+    static std::string GetValue(const GenDb::NewCol &col) {
+        return boost::get<std::string>(col.value->at(0));
+    }
+
+    std::string path_;
+};
+
+TEST_F(LocalStoreIfTest, GetRow) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    EXPECT_TRUE(AddColumn(store.get(), 1, 2, 1, "b"));
+    EXPECT_TRUE(AddColumn(store.get(), 1, 1, 2, "a"));
+    EXPECT_TRUE(AddColumn(store.get(), 2, 1, 1, "c"));
+    // Overwrite
+    EXPECT_TRUE(AddColumn(store.get(), 1, 2, 1, "d"));
+
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kNoSqlCf, Key(1)));
+    EXPECT_EQ(kNoSqlCf, result.cfname_);
+    EXPECT_EQ(Key(1), result.rowkey_);
+    ASSERT_EQ(2, result.columns_.size());
+    EXPECT_EQ(Name(1, 2), *result.columns_[0].name);
+    EXPECT_EQ("a", GetValue(result.columns_[0]));
+    EXPECT_EQ(Name(2, 1), *result.columns_[1].name);
+    EXPECT_EQ("d", GetValue(result.columns_[1]));
+
+    // Unknown column family
+    GenDb::ColList unknown;
+    EXPECT_FALSE(store->Db_GetRow(unknown, "UnknownTable", Key(1)));
+}
+
+TEST_F(LocalStoreIfTest, GetMultiRowSlice) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    for (uint32_t i = 0; i < 10; i++) {
+        EXPECT_TRUE(AddColumn(store.get(), 1, i, 0, "a"));
+        EXPECT_TRUE(AddColumn(store.get(), 1, i, 1, "b"));
+        EXPECT_TRUE(AddColumn(store.get(), 2, i, 0, "c"));
+    }
+
+    std::vector<DbDataValueVec> keys;
+    keys.push_back(Key(1));
+    keys.push_back(Key(2));
+    keys.push_back(Key(3));
+    // A prefix start name sorts before the names it is a prefix of, and a
+    // prefix finish name after them.
+    GenDb::ColumnNameRange crange;
+    crange.start_ = DbDataValueVec(1, (uint32_t)3);
+    crange.finish_ = Name(5, 0);
+    GenDb::ColListVec result;
+    EXPECT_TRUE(store->Db_GetMultiRow(result, kNoSqlCf, keys, &crange));
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(Key(1), result[0].rowkey_);
+    ASSERT_EQ(5, result[0].columns_.size());
+    EXPECT_EQ(Name(3, 0), *result[0].columns_[0].name);
+    EXPECT_EQ(Name(5, 0), *result[0].columns_[4].name);
+    EXPECT_EQ(Key(2), result[1].rowkey_);
+    EXPECT_EQ(3, result[1].columns_.size());
+    EXPECT_EQ(Key(3), result[2].rowkey_);
+    EXPECT_TRUE(result[2].columns_.empty());
+
+    // Count limit
+    crange.finish_.clear();
+    crange.count = 4;
+    result.clear();
+    EXPECT_TRUE(store->Db_GetMultiRow(result, kNoSqlCf, keys, &crange));
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(4, result[0].columns_.size());
+    EXPECT_EQ(Name(4, 1), *result[0].columns_[3].name);
+}
+
+TEST_F(LocalStoreIfTest, SqlColumnFamily) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    boost::uuids::uuid uuid = boost::uuids::random_generator()();
+    std::auto_ptr<GenDb::ColList> cl(new GenDb::ColList);
+    cl->cfname_ = kSqlCf;
+    cl->rowkey_ = DbDataValueVec(1, uuid);
+    cl->columns_.push_back(new GenDb::NewCol("name", std::string("vn1"), 0));
+    cl->columns_.push_back(new GenDb::NewCol("count", (uint64_t)10, 0));
+    EXPECT_TRUE(store->Db_AddColumnSync(cl));
+
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kSqlCf, DbDataValueVec(1, uuid)));
+    ASSERT_EQ(2, result.columns_.size());
+    EXPECT_EQ(GenDb::NewCf::COLUMN_FAMILY_SQL, result.columns_[0].cftype_);
+    EXPECT_EQ("count", boost::get<std::string>(
+        result.columns_[0].name->at(0)));
+    EXPECT_EQ(10, boost::get<uint64_t>(result.columns_[0].value->at(0)));
+    EXPECT_EQ("vn1", GetValue(result.columns_[1]));
+}
+
+TEST_F(LocalStoreIfTest, Ttl) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    EXPECT_TRUE(AddColumn(store.get(), 1, 1, 0, "expires", 1));
+    EXPECT_TRUE(AddColumn(store.get(), 1, 2, 0, "persists"));
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kNoSqlCf, Key(1)));
+    EXPECT_EQ(2, result.columns_.size());
+
+    sleep(2);
+    GenDb::ColList expired;
+    EXPECT_TRUE(store->Db_GetRow(expired, kNoSqlCf, Key(1)));
+    ASSERT_EQ(1, expired.columns_.size());
+    EXPECT_EQ("persists", GetValue(expired.columns_[0]));
+
+    // Compaction drops the expired column
+    size_t size = store->LogSize();
+    EXPECT_TRUE(store->Compact());
+    EXPECT_GT(size, store->LogSize());
+}
+
+TEST_F(LocalStoreIfTest, Reopen) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    for (uint32_t i = 0; i < 100; i++) {
+        EXPECT_TRUE(AddColumn(store.get(), i % 10, i, 0, "value"));
+    }
+    store.reset();
+    // Simulate a crash in the middle of appending a record
+    std::string filename(path_ + "/" + kTablespace + ".log");
+    FILE *log = fopen(filename.c_str(), "a");
+    ASSERT_TRUE(log != NULL);
+    uint32_t length = 1000;
+    fwrite(&length, sizeof(length), 1, log);
+    fwrite("partial", 7, 1, log);
+    fclose(log);
+
+    store.reset(CreateStore(false));
+    EXPECT_TRUE(AddColumn(store.get(), 0, 1000, 0, "value"));
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kNoSqlCf, Key(0)));
+    EXPECT_EQ(11, result.columns_.size());
+    GenDb::ColList result9;
+    EXPECT_TRUE(store->Db_GetRow(result9, kNoSqlCf, Key(9)));
+    EXPECT_EQ(10, result9.columns_.size());
+}
+
+TEST_F(LocalStoreIfTest, Compaction) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    store->set_compaction_threshold(64 * 1024);
+    // Overwrite the same few columns until the log is compacted
+    for (uint32_t i = 0; i < 10000; i++) {
+        EXPECT_TRUE(AddColumn(store.get(), 1, i % 16, 0,
+                              integerToString(i)));
+    }
+    EXPECT_LT(0, store->compactions());
+    EXPECT_GT(64 * 1024, store->LogSize());
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kNoSqlCf, Key(1)));
+    ASSERT_EQ(16, result.columns_.size());
+    EXPECT_EQ("9999", GetValue(result.columns_[15]));
+
+    store.reset(CreateStore(false));
+    GenDb::ColList reopened;
+    EXPECT_TRUE(store->Db_GetRow(reopened, kNoSqlCf, Key(1)));
+    ASSERT_EQ(16, reopened.columns_.size());
+    EXPECT_EQ("9999", GetValue(reopened.columns_[15]));
+}
+
+// A read-only store sees the writes made through another instance, also
+// across a compaction.
+TEST_F(LocalStoreIfTest, ReadOnly) {
+    std::auto_ptr<LocalStoreIf> writer(CreateStore(false));
+    EXPECT_TRUE(AddColumn(writer.get(), 1, 1, 0, "a"));
+    std::auto_ptr<LocalStoreIf> reader(CreateStore(true));
+    EXPECT_FALSE(AddColumn(reader.get(), 1, 2, 0, "b"));
+
+    GenDb::ColList result;
+    EXPECT_TRUE(reader->Db_GetRow(result, kNoSqlCf, Key(1)));
+    EXPECT_EQ(1, result.columns_.size());
+
+    EXPECT_TRUE(AddColumn(writer.get(), 1, 2, 0, "b"));
+    GenDb::ColList appended;
+    EXPECT_TRUE(reader->Db_GetRow(appended, kNoSqlCf, Key(1)));
+    EXPECT_EQ(2, appended.columns_.size());
+
+    EXPECT_TRUE(AddColumn(writer.get(), 1, 2, 0, "c"));
+    EXPECT_TRUE(writer->Compact());
+    GenDb::ColList compacted;
+    EXPECT_TRUE(reader->Db_GetRow(compacted, kNoSqlCf, Key(1)));
+    ASSERT_EQ(2, compacted.columns_.size());
+    EXPECT_EQ("c", GetValue(compacted.columns_[1]));
+}
+
+TEST_F(LocalStoreIfTest, Stats) {
+    std::auto_ptr<LocalStoreIf> store(CreateStore(false));
+    EXPECT_TRUE(AddColumn(store.get(), 1, 1, 0, "a"));
+    GenDb::ColList result;
+    EXPECT_TRUE(store->Db_GetRow(result, kNoSqlCf, Key(1)));
+    std::vector<GenDb::DbTableInfo> vdbti;
+    GenDb::DbErrors dbe;
+    EXPECT_TRUE(store->Db_GetStats(&vdbti, &dbe));
+    ASSERT_EQ(1, vdbti.size());
+    EXPECT_EQ(kNoSqlCf, vdbti[0].get_table_name());
+    EXPECT_EQ(1, vdbti[0].get_reads());
+    EXPECT_EQ(1, vdbti[0].get_writes());
+    // Statistics are reset on every call
+    vdbti.clear();
+    EXPECT_TRUE(store->Db_GetStats(&vdbti, &dbe));
+    EXPECT_TRUE(vdbti.empty());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
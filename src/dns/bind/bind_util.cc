@@ -519,6 +519,38 @@ int BindUtil::BuildDnsUpdate(uint8_t *buf, Operation op, uint16_t xid,
     return len;
 }
 
+// Upper bound on the length of a DNS update built by BuildDnsUpdate, without
+// the updates; names are written uncompressed.
+uint16_t BindUtil::DnsUpdateHeaderLength(const std::string &domain,
+                                         const std::string &zone) {
+    // header, zone section and the view in the additional section
+    return sizeof(dnshdr) + (zone.size() + 2 + 4) +
+           (sizeof("view") + 1 + 4 + 4 + 2 + 1 + sizeof("view=") - 1 +
+            domain.size());
+}
+
+// Upper bound on the length of an update for the item in a DNS update
+uint16_t BindUtil::DnsUpdateItemLength(const DnsItem &item) {
+    uint16_t length = item.name.size() + 2 + 4 + 4 + 2;
+    switch (item.type) {
+        case DNS_A_RECORD:
+            return length + 4;
+
+        case DNS_AAAA_RECORD:
+            return length + 16;
+
+        case DNS_TYPE_SOA:
+            return length + item.soa.primary_ns.size() + 2 +
+                   item.soa.mailbox.size() + 2 + 20;
+
+        case DNS_MX_RECORD:
+            return length + 2 + item.data.size() + 2;
+
+        default:
+            return length + item.data.size() + 2;
+    }
+}
+
 bool BindUtil::IsIPv4(std::string name, uint32_t &addr) {
     boost::system::error_code ec; 
     boost::asio::ip::address_v4 address(boost::asio::ip::address_v4::
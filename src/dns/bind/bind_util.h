@@ -289,6 +289,9 @@ public:
                               const std::string &domain, 
                               const std::string &zone, 
                               const DnsItems &items);
+    static uint16_t DnsUpdateHeaderLength(const std::string &domain,
+                                          const std::string &zone);
+    static uint16_t DnsUpdateItemLength(const DnsItem &item);
     static uint8_t *AddQuestionSection(uint8_t *ptr, const std::string &name, 
                                        uint16_t type, uint16_t cl, 
                                        uint16_t &length);
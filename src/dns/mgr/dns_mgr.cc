@@ -2,6 +2,7 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <set>
 #include <cmn/dns.h>
 #include <bind/bind_util.h>
 #include <mgr/dns_mgr.h>
@@ -12,10 +13,30 @@
 
 uint16_t DnsManager::g_trans_id_;
 
+namespace {
+
+// Orders the items of DNS updates by record, irrespective of class and ttl,
+// so that an add and a delete of the same record match
+struct DnsItemCompare {
+    bool operator()(const DnsItem *lhs, const DnsItem *rhs) const {
+        if (lhs->type != rhs->type)
+            return lhs->type < rhs->type;
+        int result = lhs->name.compare(rhs->name);
+        if (result)
+            return result < 0;
+        return lhs->data < rhs->data;
+    }
+};
+typedef std::set<const DnsItem *, DnsItemCompare> ItemSet;
+
+}  // namespace
+
 DnsManager::DnsManager()
     : bind_status_(boost::bind(&DnsManager::BindEventHandler, this, _1)),
       pending_done_queue_(TaskScheduler::GetInstance()->GetTaskId("dns::Config"), 0,
-                          boost::bind(&DnsManager::PendingDone, this, _1)) {
+                          boost::bind(&DnsManager::PendingDone, this, _1)),
+      update_trigger_(boost::bind(&DnsManager::SendPendingUpdates, this),
+                      TaskScheduler::GetInstance()->GetTaskId("dns::Config"), 0) {
     std::vector<BindResolver::DnsServer> bind_servers;
     bind_servers.push_back(BindResolver::DnsServer("127.0.0.1",
                                                    Dns::GetDnsPort()));
@@ -299,28 +320,80 @@ bool DnsManager::SendRecordUpdate(BindUtil::Operation op,
     return true;
 }
 
+// Queue the items for an update to the view / zone. Items are added to the
+// last update queued for the view / zone when possible, so that a burst of
+// record changes is sent to named in a few updates rather than one per record.
 void DnsManager::SendUpdate(BindUtil::Operation op, const std::string &view,
                             const std::string &zone, DnsItems &items) {
-    uint8_t *pkt = new uint8_t[BindResolver::max_pkt_size];
-    uint16_t xid = GetTransId();
-    int len = BindUtil::BuildDnsUpdate(pkt, op, xid, view, zone, items);
-    if (BindResolver::Resolver()->DnsSend(pkt, 0, len)) {
-        DNS_BIND_TRACE(DnsBindTrace, "DNS Update sent for DNS record; xid = " <<
-                   xid << "; View = " << view << "; Zone = " << zone << "; " <<
-                   DnsItemsToString(items));
-        AddPendingList(xid, view, zone, items, op);
+    ViewZone key(view, zone);
+    for (DnsItems::iterator it = items.begin(); it != items.end(); ++it) {
+        uint32_t length = BindUtil::DnsUpdateItemLength(*it);
+        UpdateQueueMap::iterator qit = update_queue_map_.find(key);
+        if (qit == update_queue_map_.end() || qit->second->op != op ||
+            qit->second->length + length > kMaxUpdatePacketSize) {
+            UpdateQueue::iterator update =
+                update_queue_.insert(update_queue_.end(),
+                                     PendingList(0, view, zone, DnsItems(), op));
+            update->length = BindUtil::DnsUpdateHeaderLength(view, zone);
+            update_queue_map_[key] = update;
+            qit = update_queue_map_.find(key);
+        }
+        qit->second->items.push_back(*it);
+        qit->second->length += length;
     }
+    update_trigger_.Set();
+}
+
+// Send the queued updates, while there are less than kMaxPendingUpdates
+// updates awaiting a response from named. The rest are sent as responses
+// are received.
+bool DnsManager::SendPendingUpdates() {
+    while (!update_queue_.empty() && pending_map_.size() < kMaxPendingUpdates) {
+        PendingList &update = update_queue_.front();
+        uint8_t *pkt = new uint8_t[update.length];
+        uint16_t xid = GetTransId();
+        int len = BindUtil::BuildDnsUpdate(pkt, update.op, xid, update.view,
+                                           update.zone, update.items);
+        if (BindResolver::Resolver()->DnsSend(pkt, 0, len)) {
+            DNS_BIND_TRACE(DnsBindTrace, "DNS Update sent for " <<
+                       update.items.size() << " DNS records; xid = " <<
+                       xid << "; View = " << update.view << "; Zone = " <<
+                       update.zone << ";");
+            AddPendingList(xid, update.view, update.zone, update.items,
+                           update.op);
+        }
+        DeleteQueuedUpdate(update_queue_.begin());
+    }
+    return true;
+}
+
+DnsManager::UpdateQueue::iterator
+DnsManager::DeleteQueuedUpdate(UpdateQueue::iterator it) {
+    UpdateQueueMap::iterator qit =
+        update_queue_map_.find(ViewZone(it->view, it->zone));
+    if (qit != update_queue_map_.end() && qit->second == it)
+        update_queue_map_.erase(qit);
+    return update_queue_.erase(it);
+}
+
+uint32_t DnsManager::UpdateLength(const std::string &view,
+                                  const std::string &zone,
+                                  const DnsItems &items) {
+    uint32_t length = BindUtil::DnsUpdateHeaderLength(view, zone);
+    for (DnsItems::const_iterator it = items.begin(); it != items.end(); ++it)
+        length += BindUtil::DnsUpdateItemLength(*it);
+    return length;
 }
 
 void DnsManager::SendRetransmit(uint16_t xid, BindUtil::Operation op,
                                 const std::string &view,
                                 const std::string &zone, DnsItems &items) {
-    uint8_t *pkt = new uint8_t[BindResolver::max_pkt_size];
+    uint8_t *pkt = new uint8_t[UpdateLength(view, zone, items)];
     int len = BindUtil::BuildDnsUpdate(pkt, op, xid, view, zone, items);
     if (BindResolver::Resolver()->DnsSend(pkt, 0, len)) {
-        DNS_BIND_TRACE(DnsBindTrace, "DNS retransmit sent for DNS record; xid = " <<
-                   xid << "; View = " << view << "; Zone = " << zone << "; " <<
-                   DnsItemsToString(items));
+        DNS_BIND_TRACE(DnsBindTrace, "DNS retransmit sent for " <<
+                   items.size() << " DNS records; xid = " << xid <<
+                   "; View = " << view << "; Zone = " << zone << ";");
     }
 }
 
@@ -369,6 +442,8 @@ void DnsManager::HandleUpdateResponse(uint8_t *pkt) {
 
 bool DnsManager::PendingDone(uint16_t xid) {
     DeletePendingList(xid);
+    if (!update_queue_.empty())
+        update_trigger_.Set();
     return true;
 }
 
@@ -386,6 +461,8 @@ void DnsManager::ResendAllRecords() {
             it++;
         }
     }
+    if (!update_queue_.empty())
+        update_trigger_.Set();
 }
 
 void DnsManager::AddPendingList(uint16_t xid, const std::string &view,
@@ -412,11 +489,25 @@ void DnsManager::AddPendingList(uint16_t xid, const std::string &view,
 void DnsManager::UpdatePendingList(const std::string &view,
                                    const std::string &zone,
                                    const DnsItems &items) {
+    ItemSet item_set;
+    for (DnsItems::const_iterator it = items.begin(); it != items.end(); ++it)
+        item_set.insert(&(*it));
+
     for (PendingListMap::iterator it = pending_map_.begin();
          it != pending_map_.end(); ) {
-        if (it->second.view == view &&
-            it->second.zone == zone &&
-            it->second.items == items)
+        if (it->second.view != view || it->second.zone != zone) {
+            it++;
+            continue;
+        }
+        DnsItems &pending = it->second.items;
+        for (DnsItems::iterator item = pending.begin();
+             item != pending.end(); ) {
+            if (item_set.find(&(*item)) != item_set.end())
+                pending.erase(item++);
+            else
+                item++;
+        }
+        if (pending.empty())
             pending_map_.erase(it++);
         else
             it++;
@@ -429,6 +520,8 @@ void DnsManager::DeletePendingList(uint16_t xid) {
 
 void DnsManager::ClearPendingList() {
     pending_map_.clear();
+    update_queue_.clear();
+    update_queue_map_.clear();
 }
 
 // Remove entries from pending list, upon a view delete
@@ -440,6 +533,13 @@ void DnsManager::PendingListViewDelete(const VirtualDnsConfig *config) {
         else
             it++;
     }
+    for (UpdateQueue::iterator it = update_queue_.begin();
+         it != update_queue_.end(); ) {
+        if (it->view == config->GetViewName())
+            it = DeleteQueuedUpdate(it);
+        else
+            it++;
+    }
 }
 
 bool DnsManager::CheckZoneDelete(ZoneList &zones, PendingList &pend) {
@@ -464,6 +564,13 @@ void DnsManager::PendingListZoneDelete(const Subnet &subnet,
         else
             it++;
     }
+    for (UpdateQueue::iterator it = update_queue_.begin();
+         it != update_queue_.end(); ) {
+        if (it->view == config->GetViewName() && CheckZoneDelete(zones, *it))
+            it = DeleteQueuedUpdate(it);
+        else
+            it++;
+    }
 }
 
 void DnsManager::StartPendingTimer() {
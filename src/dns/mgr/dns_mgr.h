@@ -5,6 +5,7 @@
 #ifndef __dns_manager_h__
 #define __dns_manager_h__
 
+#include <list>
 #include <tbb/mutex.h>
 #include <mgr/dns_oper.h>
 #include <bind/named_config.h>
@@ -20,6 +21,10 @@ public:
     static const int max_records_per_sandesh = 200;
     static const uint32_t kPendingRecordRetransmitTime = 3000; // milliseconds
     static const uint32_t kMaxRetransmitCount = 32;
+    // named reads update requests over UDP into a 4K buffer
+    static const uint32_t kMaxUpdatePacketSize = 4096;
+    // number of updates sent to named that are awaiting a response
+    static const uint32_t kMaxPendingUpdates = 64;
 
     struct PendingList {
         uint16_t xid;
@@ -28,6 +33,7 @@ public:
         DnsItems items;
         BindUtil::Operation op;
         uint32_t retransmit_count;
+        uint32_t length;
 
         PendingList(uint16_t id, const std::string &v, const std::string &z,
                     const DnsItems &it, BindUtil::Operation o) {
@@ -38,11 +44,18 @@ public:
             items = it;
             op = o;
             retransmit_count = 0;
+            length = 0;
         }
     };
     typedef std::map<uint16_t, PendingList> PendingListMap;
     typedef std::pair<uint16_t, PendingList> PendingListPair;
 
+    // Updates waiting to be sent, in order; the map points to the last
+    // update queued for a view / zone, to which further items are added
+    typedef std::list<PendingList> UpdateQueue;
+    typedef std::pair<std::string, std::string> ViewZone;
+    typedef std::map<ViewZone, UpdateQueue::iterator> UpdateQueueMap;
+
     DnsManager();
     virtual ~DnsManager();
     void Initialize(DB *config_db, DBGraph *config_graph,
@@ -76,9 +89,15 @@ public:
 
 private:
     friend class DnsBindTest;
+    friend class DnsUpdateTest;
 
     bool SendRecordUpdate(BindUtil::Operation op, 
                           const VirtualDnsRecordConfig *config);
+    bool SendPendingUpdates();
+    UpdateQueue::iterator DeleteQueuedUpdate(UpdateQueue::iterator it);
+    static uint32_t UpdateLength(const std::string &view,
+                                 const std::string &zone,
+                                 const DnsItems &items);
     bool PendingDone(uint16_t xid);
     void ResendRecord(uint16_t xid);
     void ResendAllRecords();
@@ -111,6 +130,9 @@ private:
     PendingListMap pending_map_;
     Timer *pending_timer_;
     WorkQueue<uint16_t> pending_done_queue_;
+    UpdateQueue update_queue_;
+    UpdateQueueMap update_queue_map_;
+    TaskTrigger update_trigger_;
 
     DISALLOW_COPY_AND_ASSIGN(DnsManager);
 };
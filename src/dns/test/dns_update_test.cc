@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <sstream>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "db/db.h"
+#include "db/db_graph.h"
+#include "db/test/db_test_util.h"
+#include "ifmap/ifmap_link_table.h"
+#include "ifmap/test/ifmap_test_util.h"
+#include "io/event_manager.h"
+#include "io/test/event_manager_test.h"
+#include "schema/vnc_cfg_types.h"
+#include "cmn/dns.h"
+#include "bind/bind_util.h"
+#include "bind/bind_resolver.h"
+#include "bind/named_config.h"
+#include "cfg/dns_config.h"
+#include "cfg/dns_config_parser.h"
+#include "mgr/dns_mgr.h"
+#include "testing/gunit.h"
+
+using namespace std;
+using boost::asio::ip::udp;
+
+static const uint32_t kRecords = 10000;
+
+class NamedConfigTest : public NamedConfig {
+public:
+    NamedConfigTest(const std::string &conf_dir, const std::string &conf_file) :
+                    NamedConfig(conf_dir, conf_file, "/var/log/named/bind.log",
+                                "rndc.conf", "xvysmOR8lnUQRBcunkC6vg==", "100M") {}
+    static void Init() {
+        assert(singleton_ == NULL);
+        singleton_ = new NamedConfigTest(".", "named.conf");
+        singleton_->Reset();
+    }
+    static void Shutdown() {
+        delete singleton_;
+        singleton_ = NULL;
+        remove("./named.conf");
+        remove("./rndc.conf");
+    }
+    virtual void UpdateNamedConf(const VirtualDnsConfig *updated_vdns) {
+        CreateNamedConf(updated_vdns);
+    }
+    std::string GetZoneFileName(const std::string &vdns,
+                                const std::string &name) {
+        if (name.size() && name.at(name.size() - 1) == '.')
+            return (name + "zone");
+        else
+            return (name + ".zone");
+    }
+    std::string GetZoneFilePath(const std::string &vdns,
+                                const string &name) {
+         return (named_config_dir_ + GetZoneFileName("", name));
+    }
+    std::string GetResolveFile() { return ""; }
+};
+
+// Answers DNS updates in place of named, counting the updates and the
+// records in them.
+class NamedStandIn {
+public:
+    explicit NamedStandIn(boost::asio::io_service &io)
+        : socket_(io, udp::endpoint(boost::asio::ip::address_v4::loopback(),
+                                    0)) {
+        updates_ = 0;
+        records_ = 0;
+        respond_ = true;
+        StartReceive();
+    }
+
+    void Shutdown() {
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+
+    uint16_t port() const { return socket_.local_endpoint().port(); }
+    uint64_t updates() const { return updates_; }
+    uint64_t records() const { return records_; }
+    void set_respond(bool respond) { respond_ = respond; }
+
+private:
+    void StartReceive() {
+        socket_.async_receive_from(boost::asio::buffer(buf_, sizeof(buf_)),
+            remote_, boost::bind(&NamedStandIn::HandleReceive, this,
+                                 boost::asio::placeholders::error));
+    }
+
+    void HandleReceive(const boost::system::error_code &error) {
+        if (error)
+            return;
+
+        DnsUpdateData data;
+        if (BindUtil::ParseDnsUpdate(buf_, data)) {
+            records_ += data.items.size();
+            updates_++;
+            if (respond_) {
+                dnshdr *dns = (dnshdr *) buf_;
+                BindUtil::BuildDnsHeader(dns, ntohs(dns->xid),
+                                         DNS_QUERY_RESPONSE, DNS_OPCODE_UPDATE,
+                                         0, 0, 0, 0);
+                boost::system::error_code ec;
+                socket_.send_to(boost::asio::buffer(buf_, sizeof(dnshdr)),
+                                remote_, 0, ec);
+            }
+        }
+        StartReceive();
+    }
+
+    udp::socket socket_;
+    udp::endpoint remote_;
+    uint8_t buf_[DnsManager::kMaxUpdatePacketSize];
+    tbb::atomic<uint64_t> updates_;
+    tbb::atomic<uint64_t> records_;
+    tbb::atomic<bool> respond_;
+};
+
+class DnsUpdateTest : public ::testing::Test {
+protected:
+    DnsUpdateTest() : parser_(&db_) {
+    }
+
+    virtual void SetUp() {
+        IFMapLinkTable_Init(&db_, &db_graph_);
+        vnc_cfg_Server_ModuleInit(&db_, &db_graph_);
+        NamedConfigTest::Init();
+        Dns::SetDnsManager(&dns_manager_);
+        dns_manager_.config_mgr_.Initialize(&db_, &db_graph_);
+        // named is up as long as the test says so
+        dns_manager_.bind_status_.status_timer_->Cancel();
+        dns_manager_.bind_status_.named_pid_ = 0;
+
+        named_.reset(new NamedStandIn(*Dns::GetEventManager()->io_service()));
+        BindResolver::Resolver()->SetupResolver(
+            BindResolver::DnsServer("127.0.0.1", named_->port()), 0);
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        named_->Shutdown();
+        dns_manager_.bind_status_.named_pid_ = -1;
+        dns_manager_.Shutdown();
+        NamedConfigTest::Shutdown();
+        task_util::WaitForIdle();
+        db_util::Clear(&db_);
+    }
+
+    // A virtual DNS with kRecords A records
+    static string RecordsConfig() {
+        ostringstream config;
+        config << "<config>"
+               << "<virtual-DNS name='test-DNS' domain='default-domain'>"
+               << "<domain-name>contrail.juniper.net</domain-name>"
+               << "<dynamic-records-from-client>0</dynamic-records-from-client>"
+               << "<record-order>random</record-order>"
+               << "<default-ttl-seconds>60</default-ttl-seconds>"
+               << "<next-virtual-DNS>juniper.net</next-virtual-DNS>"
+               << "</virtual-DNS>";
+        for (uint32_t i = 0; i < kRecords; i++) {
+            config << "<virtual-DNS-record name='record" << i
+                   << "' dns='test-DNS'>"
+                   << "<record-name>host" << i << "</record-name>"
+                   << "<record-type>A</record-type>"
+                   << "<record-class>IN</record-class>"
+                   << "<record-data>10." << (i >> 16) << "."
+                   << ((i >> 8) & 0xff) << "." << (i & 0xff)
+                   << "</record-data>"
+                   << "<record-ttl-seconds>60</record-ttl-seconds>"
+                   << "</virtual-DNS-record>";
+        }
+        config << "</config>";
+        return config.str();
+    }
+
+    void DeleteConfig(string content) {
+        named_->set_respond(true);
+        boost::replace_all(content, "<config>", "<delete>");
+        boost::replace_all(content, "</config>", "</delete>");
+        EXPECT_TRUE(parser_.Parse(content));
+        task_util::WaitForIdle();
+    }
+
+    size_t PendingUpdates() { return dns_manager_.pending_map_.size(); }
+    size_t QueuedUpdates() { return dns_manager_.update_queue_.size(); }
+    void CancelRetransmit() { dns_manager_.CancelPendingTimer(); }
+
+    void Retransmit() {
+        task_util::TaskSchedulerStop();
+        dns_manager_.ResendAllRecords();
+        task_util::TaskSchedulerStart();
+    }
+
+    // Restart named, as seen by the DnsManager, which sends all the records
+    // to it again.
+    void RestartNamed() {
+        task_util::TaskSchedulerStop();
+        dns_manager_.BindEventHandler(BindStatus::Down);
+        dns_manager_.BindEventHandler(BindStatus::Up);
+        task_util::TaskSchedulerStart();
+    }
+
+    static void Report(const string &what, uint64_t records, uint64_t updates,
+                       uint64_t usec) {
+        cout << what << ": " << records << " records in " << updates
+             << " updates, " << usec / 1000 << " msec, "
+             << records * 1000000 / (usec ? usec : 1) << " records/sec"
+             << endl;
+    }
+
+    DB db_;
+    DBGraph db_graph_;
+    DnsManager dns_manager_;
+    DnsConfigParser parser_;
+    boost::scoped_ptr<NamedStandIn> named_;
+};
+
+namespace {
+
+// Records are sent to named in updates of many records, both when they are
+// configured and when named restarts.
+TEST_F(DnsUpdateTest, Batched) {
+    string content = RecordsConfig();
+    uint64_t start = ClockMonotonicUsec();
+    EXPECT_TRUE(parser_.Parse(content));
+    TASK_UTIL_EXPECT_EQ(kRecords, named_->records());
+    task_util::WaitForIdle();
+    Report("Config", named_->records(), named_->updates(),
+           ClockMonotonicUsec() - start);
+    EXPECT_GT(kRecords / 10, named_->updates());
+    EXPECT_EQ(0, PendingUpdates());
+
+    uint64_t records = named_->records();
+    uint64_t updates = named_->updates();
+    start = ClockMonotonicUsec();
+    RestartNamed();
+    TASK_UTIL_EXPECT_EQ(records + kRecords, named_->records());
+    task_util::WaitForIdle();
+    Report("Restart", named_->records() - records,
+           named_->updates() - updates, ClockMonotonicUsec() - start);
+    EXPECT_GT(kRecords / 50, named_->updates() - updates);
+    EXPECT_EQ(0, PendingUpdates());
+    EXPECT_EQ(0, QueuedUpdates());
+
+    DeleteConfig(content);
+}
+
+// No more than kMaxPendingUpdates updates await a response from named; the
+// rest are sent as responses arrive.
+TEST_F(DnsUpdateTest, Window) {
+    const uint32_t window = DnsManager::kMaxPendingUpdates;
+    CancelRetransmit();
+    named_->set_respond(false);
+    string content = RecordsConfig();
+    EXPECT_TRUE(parser_.Parse(content));
+    TASK_UTIL_EXPECT_EQ(window, named_->updates());
+    task_util::WaitForIdle();
+    EXPECT_EQ(window, named_->updates());
+    EXPECT_EQ(window, PendingUpdates());
+    EXPECT_LT(0, QueuedUpdates());
+
+    // Once the pending updates are answered, the rest are sent.
+    named_->set_respond(true);
+    Retransmit();
+    TASK_UTIL_EXPECT_EQ(0, QueuedUpdates());
+    TASK_UTIL_EXPECT_EQ(0, PendingUpdates());
+    EXPECT_LE(kRecords, named_->records());
+
+    DeleteConfig(content);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Dns::Init();
+    ServerThread thread(Dns::GetEventManager());
+    thread.Start();
+    ::testing::InitGoogleTest(&argc, argv);
+    int error = RUN_ALL_TESTS();
+    Dns::GetEventManager()->Shutdown();
+    thread.Join();
+    TaskScheduler::GetInstance()->Terminate();
+    return error;
+}
@@ -180,6 +180,14 @@ public:
         end_of_rib_computed_ = value;
     }
     bool end_of_rib_computed() const { return end_of_rib_computed_; }
+    // Called before the first connection when the config DB was restored
+    // from a snapshot. Agents are served the restored config right away and
+    // the first connection is handled as a reconnection, so that entries
+    // not refreshed by the server are removed by the stale entries cleanup.
+    void SetWarmStart() {
+        connection_status_ = DOWN;
+        set_end_of_rib_computed(true);
+    }
     bool EndOfRibTimerRunning();
 
 private:
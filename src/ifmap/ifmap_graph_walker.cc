@@ -7,6 +7,7 @@
 #include <boost/bind.hpp>
 #include "base/logging.h"
 #include "base/task_trigger.h"
+#include "base/time_util.h"
 #include "db/db_graph.h"
 #include "db/db_table.h"
 #include "ifmap/ifmap_client.h"
@@ -69,7 +70,14 @@ IFMapGraphWalker::IFMapGraphWalker(DBGraph *graph, IFMapExporter *exporter)
       link_delete_walk_trigger_(new TaskTrigger(
                         boost::bind(&IFMapGraphWalker::LinkDeleteWalk, this),
                         TaskScheduler::GetInstance()->GetTaskId("db::DBTable"), 0)),
-      walk_client_index_(BitSet::npos) {
+      walk_nodes_visited_(0),
+      walk_interest_removed_(0),
+      walk_usecs_(0),
+      link_delete_batches_(0),
+      link_delete_walks_(0),
+      link_delete_nodes_visited_(0),
+      link_delete_interest_removed_(0),
+      link_delete_usecs_(0) {
     traversal_white_list_.reset(new IFMapTypenameWhiteList());
     AddNodesToWhitelist();
     AddLinksToWhitelist();
@@ -118,8 +126,15 @@ void IFMapGraphWalker::LinkAdd(IFMapNode *lnode, const BitSet &lhs,
     }
 }
 
-void IFMapGraphWalker::LinkRemove(const BitSet &bset) {
+void IFMapGraphWalker::LinkRemove(IFMapNode *lnode, IFMapNode *rnode,
+                                  const BitSet &bset) {
     OrLinkDeleteClients(bset);          // link_delete_clients_ | bset
+    link_delete_endpoints_.insert(
+        std::make_pair(std::string(lnode->table()->Typename()),
+                       lnode->name()));
+    link_delete_endpoints_.insert(
+        std::make_pair(std::string(rnode->table()->Typename()),
+                       rnode->name()));
     link_delete_walk_trigger_->Set();
 }
 
@@ -133,66 +148,173 @@ bool IFMapGraphWalker::FilterNeighbor(IFMapNode *lnode, IFMapNode *rnode) {
     return false;
 }
 
-void IFMapGraphWalker::RecomputeInterest(DBGraphVertex *vertex, int bit) {
-    IFMapNode *node = static_cast<IFMapNode *>(vertex);
-    IFMapNodeState *state = exporter_->NodeStateLocate(node);
-    state->nmask_set(bit);
-    UpdateNewReachableNodesTracker(bit, state);
+bool IFMapGraphWalker::HasInterest(IFMapNode *node, int client_index) {
+    IFMapNodeState *state = exporter_->NodeStateLookup(node);
+    return (state != NULL && state->interest().test(client_index));
+}
+
+bool IFMapGraphWalker::IsTraversable(IFMapNode *source, IFMapNode *target,
+                                     const DBGraphEdge *edge) const {
+    if (edge->IsDeleted() || target->IsDeleted()) {
+        return false;
+    }
+    return (traversal_white_list_->VertexFilter(target) &&
+            traversal_white_list_->EdgeFilter(source, target, edge));
+}
+
+// Recompute the interest of a client after the links whose endpoints are
+// listed have been deleted. Only the nodes that are reachable from these
+// endpoints can have lost reachability from the client's virtual-router:
+// 1. Collect the candidates i.e. the endpoints and the nodes reachable from
+//    them that have the client's interest bit set.
+// 2. Seed the candidates that are still reachable: the virtual-router and
+//    the candidates that can be reached from a node outside the candidate
+//    set that has the interest bit set.
+// 3. Propagate reachability from the seeds within the candidate set.
+// The candidates that are not reached lose the client's interest bit.
+void IFMapGraphWalker::LinkDeleteWalkClient(int client_index,
+    IFMapNode *root, const std::vector<IFMapNode *> &endpoints) {
+    NodeSet candidates;
+    std::vector<IFMapNode *> queue;
+    for (std::vector<IFMapNode *>::const_iterator iter = endpoints.begin();
+         iter != endpoints.end(); ++iter) {
+        IFMapNode *node = *iter;
+        if (HasInterest(node, client_index) &&
+            candidates.insert(node).second) {
+            queue.push_back(node);
+        }
+    }
+    while (!queue.empty()) {
+        IFMapNode *node = queue.back();
+        queue.pop_back();
+        walk_nodes_visited_++;
+        for (DBGraphVertex::edge_iterator iter = node->edge_list_begin(graph_);
+             iter != node->edge_list_end(graph_); ++iter) {
+            IFMapNode *target = static_cast<IFMapNode *>(iter.target());
+            if (IsTraversable(node, target, iter.operator->()) &&
+                HasInterest(target, client_index) &&
+                candidates.insert(target).second) {
+                queue.push_back(target);
+            }
+        }
+    }
+
+    for (NodeSet::iterator iter = candidates.begin();
+         iter != candidates.end(); ++iter) {
+        IFMapNode *node = *iter;
+        if (node == root) {
+            queue.push_back(node);
+            continue;
+        }
+        for (DBGraphVertex::edge_iterator e_iter =
+             node->edge_list_begin(graph_);
+             e_iter != node->edge_list_end(graph_); ++e_iter) {
+            IFMapNode *source = static_cast<IFMapNode *>(e_iter.target());
+            if (candidates.count(source) == 0 && !source->IsDeleted() &&
+                traversal_white_list_->VertexFilter(source) &&
+                IsTraversable(source, node, e_iter.operator->()) &&
+                HasInterest(source, client_index)) {
+                queue.push_back(node);
+                break;
+            }
+        }
+    }
+
+    NodeSet reachable;
+    for (std::vector<IFMapNode *>::iterator iter = queue.begin();
+         iter != queue.end(); ++iter) {
+        reachable.insert(*iter);
+    }
+    while (!queue.empty()) {
+        IFMapNode *node = queue.back();
+        queue.pop_back();
+        exporter_->NodeStateLookup(node)->nmask_set(client_index);
+        for (DBGraphVertex::edge_iterator iter = node->edge_list_begin(graph_);
+             iter != node->edge_list_end(graph_); ++iter) {
+            IFMapNode *target = static_cast<IFMapNode *>(iter.target());
+            if (candidates.count(target) != 0 &&
+                IsTraversable(node, target, iter.operator->()) &&
+                reachable.insert(target).second) {
+                queue.push_back(target);
+            }
+        }
+    }
+
+    walk_interest_removed_ += candidates.size() - reachable.size();
+    for (NodeSet::iterator iter = candidates.begin();
+         iter != candidates.end(); ++iter) {
+        IFMapNode *node = *iter;
+        CleanupInterest(client_index, node, exporter_->NodeStateLookup(node));
+    }
 }
 
 bool IFMapGraphWalker::LinkDeleteWalk() {
-    if (link_delete_clients_.empty()) {
-        walk_client_index_ = BitSet::npos;
-        return true;
+    if (walk_clients_.empty()) {
+        if (link_delete_clients_.empty()) {
+            link_delete_endpoints_.clear();
+            return true;
+        }
+        // Start a new batch. Link deletes received from here on are
+        // collected for the next one.
+        walk_clients_ = link_delete_clients_;
+        link_delete_clients_.clear();
+        walk_endpoints_.swap(link_delete_endpoints_);
+        link_delete_endpoints_.clear();
+        walk_nodes_visited_ = 0;
+        walk_interest_removed_ = 0;
+        walk_usecs_ = 0;
     }
 
+    uint64_t start = UTCTimestampUsec();
     IFMapServer *server = exporter_->server();
-    size_t i;
-
-    // Get the index of the client we want to start with.
-    if (walk_client_index_ == BitSet::npos) {
-        i = link_delete_clients_.find_first();
-    } else {
-        // walk_client_index_ was the last client that we finished processing.
-        i = link_delete_clients_.find_next(walk_client_index_);
+    std::vector<IFMapNode *> endpoints;
+    for (NodeKeySet::const_iterator iter = walk_endpoints_.begin();
+         iter != walk_endpoints_.end(); ++iter) {
+        IFMapTable *table =
+            IFMapTable::FindTable(server->database(), iter->first);
+        IFMapNode *node = table ? table->FindNode(iter->second) : NULL;
+        if ((node != NULL) && node->IsVertexValid() &&
+            traversal_white_list_->VertexFilter(node)) {
+            endpoints.push_back(node);
+        }
     }
+
+    IFMapTable *vr_table = IFMapTable::FindTable(server->database(),
+                                                 "virtual-router");
     int count = 0;
     BitSet done_set;
-    while (i != BitSet::npos) {
+    for (size_t i = walk_clients_.find_first(); i != BitSet::npos;
+         i = walk_clients_.find_next(i)) {
         IFMapClient *client = server->GetClient(i);
         assert(client);
-        AddNewReachableNodesTracker(client->index());
-
-        IFMapTable *table = IFMapTable::FindTable(server->database(),
-                                                  "virtual-router");
-        IFMapNode *node = table->FindNode(client->identifier());
-        if ((node != NULL) && node->IsVertexValid()) {
-            graph_->Visit(node,
-                boost::bind(&IFMapGraphWalker::RecomputeInterest, this, _1, i),
-                0, *traversal_white_list_.get());
+        IFMapNode *root = vr_table->FindNode(client->identifier());
+        if ((root != NULL) && !root->IsVertexValid()) {
+            root = NULL;
         }
+        LinkDeleteWalkClient(i, root, endpoints);
         done_set.set(i);
+        link_delete_walks_++;
         if (++count == kMaxLinkDeleteWalks) {
-            // client 'i' has been processed. If 'i' is the last bit set, we
-            // will return true below. Else we will return false and there
-            // is atleast one more bit left to process.
             break;
         }
-
-        i = link_delete_clients_.find_next(i);
     }
     // Remove the subset of clients that we have finished processing.
-    ResetLinkDeleteClients(done_set);
+    walk_clients_.Reset(done_set);
+    walk_usecs_ += UTCTimestampUsec() - start;
 
-    LinkDeleteWalkBatchEnd(done_set);
-
-    if (link_delete_clients_.empty()) {
-        walk_client_index_ = BitSet::npos;
-        return true;
-    } else {
-        walk_client_index_ = i;
+    if (!walk_clients_.empty()) {
         return false;
     }
+
+    link_delete_batches_++;
+    link_delete_nodes_visited_ += walk_nodes_visited_;
+    link_delete_interest_removed_ += walk_interest_removed_;
+    link_delete_usecs_ += walk_usecs_;
+    IFMAP_DEBUG(IFMapLinkDeleteWalkInfo, link_delete_walks_,
+                walk_endpoints_.size(), walk_nodes_visited_,
+                walk_interest_removed_, walk_usecs_);
+    walk_endpoints_.clear();
+    return link_delete_clients_.empty();
 }
 
 void IFMapGraphWalker::OrLinkDeleteClients(const BitSet &bset) {
@@ -201,6 +323,7 @@ void IFMapGraphWalker::OrLinkDeleteClients(const BitSet &bset) {
 
 void IFMapGraphWalker::ResetLinkDeleteClients(const BitSet &bset) {
     link_delete_clients_.Reset(bset);
+    walk_clients_.Reset(bset);
 }
 
 void IFMapGraphWalker::CleanupInterest(int client_index, IFMapNode *node,
@@ -234,95 +357,6 @@ void IFMapGraphWalker::CleanupInterest(int client_index, IFMapNode *node,
     }
 }
 
-// Cleanup all the graph nodes that were reachable before this link delete.
-// After this link delete, these nodes may still be reachable. But, its
-// also possible that the link delete has made them unreachable.
-void IFMapGraphWalker::OldReachableNodesCleanupInterest(int client_index) {
-    IFMapState *state = NULL;
-    IFMapNode *node = NULL;
-    IFMapExporter::Cs_citer iter =
-        exporter_->ClientConfigTrackerBegin(client_index);
-    IFMapExporter::Cs_citer end_iter =
-        exporter_->ClientConfigTrackerEnd(client_index);
-
-    while (iter != end_iter) {
-        state = *iter;
-        // Get the iterator to the next element before calling
-        // CleanupInterest() since the state might be removed from the
-        // client's config-tracker, thereby invalidating the iterator of the
-        // container we are iterating over.
-        ++iter;
-        if (state->IsNode()) {
-            node = state->GetIFMapNode();
-            assert(node);
-            IFMapNodeState *nstate = exporter_->NodeStateLookup(node);
-            assert(state == nstate);
-            CleanupInterest(client_index, node, nstate);
-        }
-    }
-}
-
-// Cleanup all the graph nodes that were not reachable before the link delete
-// but are reachable now. Note, we store nodes in new_reachable_nodes_tracker_
-// only if we visited them during the graph-walk via RecomputeInterest() and if
-// their interest bit was not set i.e. they were not reachable before we
-// started the walk.
-void IFMapGraphWalker::NewReachableNodesCleanupInterest(int client_index) {
-    IFMapState *state = NULL;
-    IFMapNode *node = NULL;
-    ReachableNodesSet *rnset = new_reachable_nodes_tracker_.at(client_index);
-
-    for (Rns_citer iter = rnset->begin(); iter != rnset->end(); ++iter) {
-        state = *iter;
-        assert(state->IsNode());
-        node = state->GetIFMapNode();
-        assert(node);
-        IFMapNodeState *nstate = exporter_->NodeStateLookup(node);
-        assert(state == nstate);
-        CleanupInterest(client_index, node, nstate);
-    }
-    DeleteNewReachableNodesTracker(client_index);
-}
-
-void IFMapGraphWalker::LinkDeleteWalkBatchEnd(const BitSet &done_set) {
-    for (size_t i = done_set.find_first(); i != BitSet::npos;
-            i = done_set.find_next(i)) {
-        // Examine all the nodes that were reachable before the link delete.
-        OldReachableNodesCleanupInterest(i);
-        // Examine all the nodes that were not reachable before the link
-        // delete but are now reachable.
-        NewReachableNodesCleanupInterest(i);
-    }
-}
-
-void IFMapGraphWalker::AddNewReachableNodesTracker(int client_index) {
-    if (client_index >= (int)new_reachable_nodes_tracker_.size()) {
-        new_reachable_nodes_tracker_.resize(client_index + 1, NULL);
-    }
-    assert(new_reachable_nodes_tracker_[client_index] == NULL);
-    ReachableNodesSet *rnset = new ReachableNodesSet();
-    new_reachable_nodes_tracker_[client_index] = rnset;
-}
-
-void IFMapGraphWalker::DeleteNewReachableNodesTracker(int client_index) {
-    ReachableNodesSet *rnset = new_reachable_nodes_tracker_.at(client_index);
-    assert(rnset);
-    delete rnset;
-    new_reachable_nodes_tracker_[client_index] = NULL;
-}
-
-// Keep track of this node if it was unreachable earlier.
-void IFMapGraphWalker::UpdateNewReachableNodesTracker(int client_index,
-                                                      IFMapState *state) {
-    ReachableNodesSet *rnset = new_reachable_nodes_tracker_.at(client_index);
-    assert(rnset);
-    // If the interest is not set, the node was not reachable earlier but is
-    // reachable now.
-    if (!state->interest().test(client_index)) {
-        rnset->insert(state);
-    }
-}
-
 const IFMapTypenameWhiteList &IFMapGraphWalker::get_traversal_white_list()
         const {
     return *traversal_white_list_.get();
@@ -5,6 +5,10 @@
 #ifndef __ctrlplane__ifmap_graph_walker__
 #define __ctrlplane__ifmap_graph_walker__
 
+#include <set>
+#include <string>
+#include <vector>
+
 #include "base/bitset.h"
 #include "base/queue_task.h"
 
@@ -20,12 +24,15 @@ struct IFMapTypenameFilter;
 struct IFMapTypenameWhiteList;
 
 // Computes the interest graph for the ifmap clients (i.e. vnc agent).
+//
+// Link adds propagate the interest of each endpoint to the nodes reachable
+// through the new link that do not have it yet. Link deletes are batched:
+// the endpoints of the deleted links and the affected clients are collected
+// until the link delete walk runs, and the interest of each affected client
+// is then recomputed incrementally, starting at the endpoints of the deleted
+// links rather than at the client's virtual-router.
 class IFMapGraphWalker {
 public:
-    typedef std::set<IFMapState *> ReachableNodesSet;
-    typedef ReachableNodesSet::const_iterator Rns_citer;
-    typedef std::vector<ReachableNodesSet *> ReachableNodesTracker;
-
     IFMapGraphWalker(DBGraph *graph, IFMapExporter *exporter);
     ~IFMapGraphWalker();
 
@@ -34,38 +41,66 @@ public:
     // list.
     void LinkAdd(IFMapNode *lnode, const BitSet &lhs,
                  IFMapNode *rnode, const BitSet &rhs);
-    void LinkRemove(const BitSet &bset);
+    void LinkRemove(IFMapNode *lnode, IFMapNode *rnode, const BitSet &bset);
 
     bool FilterNeighbor(IFMapNode *lnode, IFMapNode *rnode);
     const IFMapTypenameWhiteList &get_traversal_white_list() const;
     void ResetLinkDeleteClients(const BitSet &bset);
 
+    uint64_t link_delete_batches() const { return link_delete_batches_; }
+    uint64_t link_delete_walks() const { return link_delete_walks_; }
+    uint64_t link_delete_nodes_visited() const {
+        return link_delete_nodes_visited_;
+    }
+    uint64_t link_delete_interest_removed() const {
+        return link_delete_interest_removed_;
+    }
+    uint64_t link_delete_usecs() const { return link_delete_usecs_; }
+
 private:
-    static const int kMaxLinkDeleteWalks = 1;
+    static const int kMaxLinkDeleteWalks = 16;
+
+    // Deleted link endpoints are tracked by type and name since the nodes
+    // may be deleted before the link delete walk runs.
+    typedef std::pair<std::string, std::string> NodeKey;
+    typedef std::set<NodeKey> NodeKeySet;
+    typedef std::set<IFMapNode *> NodeSet;
 
     void ProcessLinkAdd(IFMapNode *lnode, IFMapNode *rnode, const BitSet &bset);
     void JoinVertex(DBGraphVertex *vertex, const BitSet &bset);
-    void RecomputeInterest(DBGraphVertex *vertex, int bit);
     void CleanupInterest(int client_index, IFMapNode *node,
                          IFMapNodeState *state);
     void AddNodesToWhitelist();
     void AddLinksToWhitelist();
     bool LinkDeleteWalk();
-    void LinkDeleteWalkBatchEnd(const BitSet &done_set);
+    void LinkDeleteWalkClient(int client_index, IFMapNode *root,
+                              const std::vector<IFMapNode *> &endpoints);
+    bool HasInterest(IFMapNode *node, int client_index);
+    bool IsTraversable(IFMapNode *source, IFMapNode *target,
+                       const DBGraphEdge *edge) const;
     void OrLinkDeleteClients(const BitSet &bset);
-    void AddNewReachableNodesTracker(int client_index);
-    void DeleteNewReachableNodesTracker(int client_index);
-    void UpdateNewReachableNodesTracker(int client_index, IFMapState *state);
-    void OldReachableNodesCleanupInterest(int client_index);
-    void NewReachableNodesCleanupInterest(int client_index);
 
     DBGraph *graph_;
     IFMapExporter *exporter_;
     boost::scoped_ptr<TaskTrigger> link_delete_walk_trigger_;
     std::auto_ptr<IFMapTypenameWhiteList> traversal_white_list_;
+
+    // Clients and endpoints of link deletes received since the current
+    // batch started.
     BitSet link_delete_clients_;
-    size_t walk_client_index_;
-    ReachableNodesTracker new_reachable_nodes_tracker_;
+    NodeKeySet link_delete_endpoints_;
+    // Clients and endpoints of the batch being walked.
+    BitSet walk_clients_;
+    NodeKeySet walk_endpoints_;
+    uint64_t walk_nodes_visited_;
+    uint64_t walk_interest_removed_;
+    uint64_t walk_usecs_;
+
+    uint64_t link_delete_batches_;
+    uint64_t link_delete_walks_;
+    uint64_t link_delete_nodes_visited_;
+    uint64_t link_delete_interest_removed_;
+    uint64_t link_delete_usecs_;
 };
 
 #endif /* defined(__ctrlplane__ifmap_graph_walker__) */
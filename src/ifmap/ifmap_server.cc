@@ -23,6 +23,7 @@
 #include "ifmap/ifmap_node.h"
 #include "ifmap/ifmap_server_table.h"
 #include "ifmap/ifmap_server_show_types.h"
+#include "ifmap/ifmap_snapshot.h"
 #include "ifmap/ifmap_log_types.h"
 #include "ifmap/ifmap_table.h"
 #include "ifmap/ifmap_update_queue.h"
@@ -191,7 +192,7 @@ IFMapServer::IFMapServer(DB *db, DBGraph *graph,
           work_queue_(TaskScheduler::GetInstance()->GetTaskId("db::DBTable"), 0,
                       boost::bind(&IFMapServer::ClientWorker, this, _1)),
           io_service_(io_service), ifmap_manager_(NULL),
-          ifmap_channel_manager_(NULL) {
+          ifmap_channel_manager_(NULL), snapshot_(NULL) {
 }
 
 IFMapServer::~IFMapServer() {
@@ -371,6 +372,9 @@ bool IFMapServer::ClientNameToIndex(const std::string &id, int *index) {
 }
 
 bool IFMapServer::ProcessStaleEntriesTimeout() {
+    if (snapshot_) {
+        snapshot_->PurgeStale(get_ifmap_channel_sequence_number());
+    }
     IFMapStaleEntriesCleaner *cleaner =
         new IFMapStaleEntriesCleaner(db_, graph_, this);
     TaskScheduler *scheduler = TaskScheduler::GetInstance();
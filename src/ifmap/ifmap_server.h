@@ -33,6 +33,7 @@ class IFMapServerShowIndexMap;
 class IFMapTableListEntry;
 class IFMapNodeTableListShowEntry;
 class IFMapServerInfoUI;
+class IFMapSnapshot;
 
 class IFMapServer {
 public:
@@ -80,6 +81,8 @@ public:
     IFMapChannelManager *get_ifmap_channel_manager() {
         return ifmap_channel_manager_;
     }
+    void set_snapshot(IFMapSnapshot *snapshot) { snapshot_ = snapshot; }
+    IFMapSnapshot *snapshot() { return snapshot_; }
 
     void ProcessVmSubscribe(std::string vr_name, std::string vm_uuid,
                             bool subscribe, bool has_vms);
@@ -138,6 +141,7 @@ private:
     boost::asio::io_service *io_service_;
     IFMapManager *ifmap_manager_;
     IFMapChannelManager *ifmap_channel_manager_;
+    IFMapSnapshot *snapshot_;
 };
 
 #endif /* defined(__ctrlplane__ifmap_server__) */
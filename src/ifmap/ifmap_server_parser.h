@@ -12,6 +12,7 @@
 struct AutogenProperty;
 class DB;
 struct DBRequest;
+class IFMapSnapshot;
 
 namespace pugi {
 class xml_document;
@@ -26,6 +27,8 @@ public:
     typedef std::map<std::string, MetadataParseFn> MetadataParseMap;
     typedef std::list<struct DBRequest *> RequestList;
 
+    IFMapServerParser() : snapshot_(NULL) { }
+
     // Called for each resultItem element in the IF-MAP notification.
     bool ParseResultItem(const pugi::xml_node &parent, bool add_change,
                          RequestList *list) const;
@@ -41,7 +44,13 @@ public:
     static IFMapServerParser *GetInstance(const std::string &module);
     static void DeleteInstance(const std::string &module);
 
+    // When set, every accepted metadata element is also recorded in the
+    // snapshot.
+    void set_snapshot(IFMapSnapshot *snapshot) { snapshot_ = snapshot; }
+    IFMapSnapshot *snapshot() { return snapshot_; }
+
 private:
+    friend class IFMapSnapshot;
     typedef std::map<std::string, IFMapServerParser *> ModuleMap;
     static ModuleMap module_map_;
 
@@ -49,6 +58,7 @@ private:
                        struct DBRequest *result) const;
 
     MetadataParseMap metadata_map_;
+    IFMapSnapshot *snapshot_;
 };
 
 #endif
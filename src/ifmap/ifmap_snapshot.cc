@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "ifmap/ifmap_snapshot.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <pugixml/pugixml.hpp>
+
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/timer.h"
+#include "db/db.h"
+#include "ifmap/client/ifmap_manager.h"
+#include "ifmap/ifmap_log.h"
+#include "ifmap/ifmap_log_types.h"
+#include "ifmap/ifmap_server.h"
+#include "ifmap/ifmap_server_parser.h"
+#include "ifmap/ifmap_server_table.h"
+
+using std::string;
+using std::vector;
+
+static const char kSnapshotMagic[4] = { 'I', 'F', 'M', 'S' };
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sequence_number;
+    uint64_t count;
+};
+
+static void EncodeString(string *buffer, const string &value) {
+    uint32_t length = value.size();
+    buffer->append(reinterpret_cast<const char *>(&length), sizeof(length));
+    buffer->append(value);
+}
+
+// Bounds checked reader over the mapped snapshot file.
+class SnapshotReader {
+public:
+    SnapshotReader(const char *data, size_t size)
+        : data_(data), size_(size), offset_(0) {
+    }
+
+    bool Read(void *value, size_t length) {
+        if (size_ - offset_ < length) {
+            return false;
+        }
+        memcpy(value, data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+
+    bool ReadString(string *value) {
+        uint32_t length;
+        if (!Read(&length, sizeof(length)) || size_ - offset_ < length) {
+            return false;
+        }
+        value->assign(data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+    size_t offset_;
+};
+
+// Writes a checkpoint of the snapshot.
+class IFMapSnapshot::WriteTask : public Task {
+public:
+    explicit WriteTask(IFMapSnapshot *snapshot)
+        : Task(TaskScheduler::GetInstance()->GetTaskId("ifmap::Snapshot"), 0),
+          snapshot_(snapshot) {
+    }
+
+    virtual bool Run() {
+        snapshot_->Write();
+        snapshot_->WriteTaskDone();
+        return true;
+    }
+
+private:
+    IFMapSnapshot *snapshot_;
+};
+
+IFMapSnapshot::IFMapSnapshot(IFMapServer *server, const string &filename)
+    : server_(server), filename_(filename), checkpoint_timer_(NULL),
+      write_task_(NULL),
+      sequence_number_(0), dirty_(false), checkpoints_(0),
+      last_checkpoint_usecs_(0), load_usecs_(0), loaded_records_(0) {
+}
+
+IFMapSnapshot::~IFMapSnapshot() {
+    StopCheckpointTimer();
+}
+
+string IFMapSnapshot::RecordKey(const Record &record) {
+    string key = record.id_type + ":" + record.id_name + "|";
+    if (!record.peer_name.empty()) {
+        key += record.peer_type + ":" + record.peer_name + "|";
+    }
+    key += record.metadata;
+    return key;
+}
+
+void IFMapSnapshot::Update(const DBRequest *request,
+                           const pugi::xml_node &meta) {
+    const IFMapTable::RequestKey *key =
+        static_cast<const IFMapTable::RequestKey *>(request->key.get());
+    const IFMapServerTable::RequestData *data =
+        static_cast<const IFMapServerTable::RequestData *>(
+            request->data.get());
+    if (key == NULL || data == NULL) {
+        return;
+    }
+
+    Record record;
+    record.id_type = key->id_type;
+    record.id_name = key->id_name;
+    record.peer_type = data->id_type;
+    record.peer_name = data->id_name;
+    record.metadata = data->metadata;
+    record.sequence_number = sequence_number_;
+    string record_key = RecordKey(record);
+
+    tbb::mutex::scoped_lock lock(mutex_);
+    dirty_ = true;
+    if (request->oper == DBRequest::DB_ENTRY_DELETE) {
+        records_.erase(record_key);
+        return;
+    }
+
+    std::ostringstream content;
+    meta.print(content, "", pugi::format_raw);
+    record.content = content.str();
+    records_[record_key] = record;
+}
+
+void IFMapSnapshot::PurgeStale(uint64_t sequence_number) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (RecordMap::iterator iter = records_.begin(), next = iter;
+         iter != records_.end(); iter = next) {
+        ++next;
+        if (iter->second.sequence_number < sequence_number) {
+            records_.erase(iter);
+            dirty_ = true;
+        }
+    }
+}
+
+size_t IFMapSnapshot::Size() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return records_.size();
+}
+
+bool IFMapSnapshot::Write() {
+    uint64_t start = UTCTimestampUsec();
+
+    // Encode under the lock and write the file outside of it so that the
+    // parser is only held up for the duration of a memory copy.
+    string buffer;
+    SnapshotHeader header;
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kVersion;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        header.sequence_number = sequence_number_;
+        header.count = records_.size();
+        buffer.append(reinterpret_cast<const char *>(&header),
+                      sizeof(header));
+        for (int links = 0; links < 2; ++links) {
+            for (RecordMap::const_iterator iter = records_.begin();
+                 iter != records_.end(); ++iter) {
+                const Record &record = iter->second;
+                if (record.peer_name.empty() == (links != 0)) {
+                    continue;
+                }
+                EncodeString(&buffer, record.id_type);
+                EncodeString(&buffer, record.id_name);
+                EncodeString(&buffer, record.peer_type);
+                EncodeString(&buffer, record.peer_name);
+                EncodeString(&buffer, record.metadata);
+                EncodeString(&buffer, record.content);
+            }
+        }
+        dirty_ = false;
+    }
+
+    string tmpname = filename_ + ".tmp";
+    std::ofstream file(tmpname.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    if (!file || rename(tmpname.c_str(), filename_.c_str()) != 0) {
+        IFMAP_WARN(IFMapSnapshotError, "Unable to write snapshot", filename_);
+        unlink(tmpname.c_str());
+        tbb::mutex::scoped_lock lock(mutex_);
+        dirty_ = true;
+        return false;
+    }
+
+    checkpoints_++;
+    last_checkpoint_usecs_ = UTCTimestampUsec() - start;
+    IFMAP_DEBUG(IFMapSnapshotInfo, "Checkpoint", filename_,
+                header.sequence_number, header.count,
+                last_checkpoint_usecs_ / 1000);
+    return true;
+}
+
+bool IFMapSnapshot::LoadRecord(DB *db, IFMapServerParser *parser,
+                               Record *record) {
+    pugi::xml_document xdoc;
+    pugi::xml_parse_result result =
+        xdoc.load_buffer(record->content.data(), record->content.size());
+    if (!result || !xdoc.first_child()) {
+        return false;
+    }
+
+    std::auto_ptr<DBRequest> request(new DBRequest);
+    request->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+    IFMapTable::RequestKey *key = new IFMapTable::RequestKey();
+    request->key.reset(key);
+    key->id_type = record->id_type;
+    key->id_name = record->id_name;
+    key->id_seq_num = 0;
+    if (!record->peer_name.empty()) {
+        IFMapServerTable::RequestData *data =
+            new IFMapServerTable::RequestData();
+        request->data.reset(data);
+        data->id_type = record->peer_type;
+        data->id_name = record->peer_name;
+    }
+    if (!parser->ParseMetadata(xdoc.first_child(), request.get())) {
+        return false;
+    }
+    parser->SetOrigin(request.get());
+
+    IFMapTable *table = IFMapTable::FindTable(db, key->id_type);
+    if (table == NULL) {
+        IFMAP_TRACE(IFMapTblNotFoundTrace, "Cant find table", key->id_type);
+        return false;
+    }
+    table->Enqueue(request.get());
+    record->sequence_number = 0;
+    return true;
+}
+
+bool IFMapSnapshot::Load(DB *db, IFMapServerParser *parser) {
+    uint64_t start = UTCTimestampUsec();
+    int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        IFMAP_WARN(IFMapSnapshotError, "Invalid snapshot", filename_);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        IFMAP_WARN(IFMapSnapshotError, "Unable to map snapshot", filename_);
+        return false;
+    }
+
+    SnapshotReader reader(static_cast<const char *>(addr), size);
+    SnapshotHeader header;
+    reader.Read(&header, sizeof(header));
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+        header.version != kVersion) {
+        munmap(addr, size);
+        IFMAP_WARN(IFMapSnapshotError, "Snapshot version mismatch",
+                   filename_);
+        return false;
+    }
+
+    // Decode the whole file before enqueuing any of the records, so that a
+    // truncated snapshot does not leave a partial config behind, which the
+    // stale entries cleanup would not reconcile.
+    vector<Record> records;
+    records.reserve(std::min(header.count,
+        static_cast<uint64_t>(size / (6 * sizeof(uint32_t)))));
+    for (uint64_t i = 0; i < header.count; ++i) {
+        records.push_back(Record());
+        Record &record = records.back();
+        if (!reader.ReadString(&record.id_type) ||
+            !reader.ReadString(&record.id_name) ||
+            !reader.ReadString(&record.peer_type) ||
+            !reader.ReadString(&record.peer_name) ||
+            !reader.ReadString(&record.metadata) ||
+            !reader.ReadString(&record.content)) {
+            munmap(addr, size);
+            IFMAP_WARN(IFMapSnapshotError, "Truncated snapshot", filename_);
+            return false;
+        }
+    }
+    munmap(addr, size);
+
+    size_t count = 0;
+    tbb::mutex::scoped_lock lock(mutex_);
+    for (vector<Record>::iterator iter = records.begin();
+         iter != records.end(); ++iter) {
+        if (!LoadRecord(db, parser, &*iter)) {
+            continue;
+        }
+        records_[RecordKey(*iter)] = *iter;
+        count++;
+    }
+
+    loaded_records_ = count;
+    load_usecs_ = UTCTimestampUsec() - start;
+    IFMAP_DEBUG(IFMapSnapshotInfo, "Load", filename_, header.sequence_number,
+                count, load_usecs_ / 1000);
+    return true;
+}
+
+bool IFMapSnapshot::CheckpointTimerExpired() {
+    // Don't checkpoint a partial download on a cold start. After a warm
+    // start the restored graph is complete, and remains a superset of the
+    // server's state until the stale entries are purged.
+    IFMapManager *manager = server_->get_ifmap_manager();
+    if (manager != NULL && !manager->GetEndOfRibComputed()) {
+        return true;
+    }
+    tbb::mutex::scoped_lock lock(mutex_);
+    if (dirty_ && write_task_ == NULL) {
+        write_task_ = new WriteTask(this);
+        TaskScheduler::GetInstance()->Enqueue(write_task_);
+    }
+    return true;
+}
+
+void IFMapSnapshot::WriteTaskDone() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    write_task_ = NULL;
+}
+
+void IFMapSnapshot::StartCheckpointTimer(int interval_msec) {
+    if (checkpoint_timer_ == NULL) {
+        checkpoint_timer_ = TimerManager::CreateTimer(
+            *server_->io_service(), "IFMap snapshot checkpoint timer",
+            TaskScheduler::GetInstance()->GetTaskId("ifmap::StateMachine"), 0);
+    }
+    checkpoint_timer_->Start(interval_msec,
+        boost::bind(&IFMapSnapshot::CheckpointTimerExpired, this));
+}
+
+void IFMapSnapshot::StopCheckpointTimer() {
+    if (checkpoint_timer_ == NULL) {
+        return;
+    }
+    checkpoint_timer_->Cancel();
+    TimerManager::DeleteTimer(checkpoint_timer_);
+    checkpoint_timer_ = NULL;
+
+    // Wait for a checkpoint that is being written.
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    while (true) {
+        {
+            tbb::mutex::scoped_lock lock(mutex_);
+            if (write_task_ == NULL) {
+                break;
+            }
+            if (scheduler->Cancel(write_task_) == TaskScheduler::CANCELLED) {
+                write_task_ = NULL;
+                break;
+            }
+        }
+        usleep(1000);
+    }
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __ctrlplane__ifmap_snapshot__
+#define __ctrlplane__ifmap_snapshot__
+
+#include <map>
+#include <string>
+
+#include <tbb/mutex.h>
+
+class DB;
+struct DBRequest;
+class IFMapServer;
+class IFMapServerParser;
+class Task;
+class Timer;
+
+namespace pugi {
+class xml_node;
+}  // namespace pugi
+
+//
+// Local checkpoint of the configuration received from the IF-MAP server.
+//
+// Every property and link metadata element accepted by the IFMapServerParser
+// is recorded, keyed by its identifier(s) and metadata name, along with the
+// raw metadata XML fragment and the IF-MAP channel sequence number it was
+// received with. The record set is periodically written to a compact binary
+// file which is loaded into the config DB at startup, so that the config
+// graph is available to agents before the IF-MAP server download completes.
+// Entries restored from the snapshot carry sequence number 0 and are
+// reconciled by the regular stale entries cleanup once the first session to
+// the IF-MAP server has been established. The periodic checkpoint is written
+// from the ifmap::Snapshot task, off the ifmap::StateMachine task that runs
+// the checkpoint timer.
+//
+// File layout (host byte order):
+//   Header: magic "IFMS", u32 version, u64 sequence number, u64 record count.
+//   Record: u32 length + bytes for each of id_type, id_name, peer_type,
+//           peer_name, metadata and content. Property records have empty
+//           peer_type and peer_name. Property records precede link records.
+//
+class IFMapSnapshot {
+public:
+    static const uint32_t kVersion = 1;
+    static const int kDefaultCheckpointInterval = 300000;  // milliseconds
+
+    IFMapSnapshot(IFMapServer *server, const std::string &filename);
+    ~IFMapSnapshot();
+
+    // Called by the parser for every metadata element it accepts.
+    void Update(const DBRequest *request, const pugi::xml_node &meta);
+
+    // Remove the records that were not refreshed by the IF-MAP server since
+    // the connection identified by sequence_number was established.
+    void PurgeStale(uint64_t sequence_number);
+
+    // Write the record set to the snapshot file. The file is written to a
+    // temporary path and renamed so that a crash never leaves a truncated
+    // snapshot behind.
+    bool Write();
+
+    // Load the snapshot file into the config DB. Returns false if the file
+    // does not exist or is not a valid snapshot, in which case nothing is
+    // loaded.
+    bool Load(DB *db, IFMapServerParser *parser);
+
+    void StartCheckpointTimer(int interval_msec);
+    void StopCheckpointTimer();
+
+    const std::string &filename() const { return filename_; }
+    void set_sequence_number(uint64_t sequence_number) {
+        sequence_number_ = sequence_number;
+    }
+    uint64_t sequence_number() const { return sequence_number_; }
+    size_t Size() const;
+    uint64_t checkpoints() const { return checkpoints_; }
+    uint64_t last_checkpoint_usecs() const { return last_checkpoint_usecs_; }
+    uint64_t load_usecs() const { return load_usecs_; }
+    size_t loaded_records() const { return loaded_records_; }
+
+private:
+    struct Record {
+        std::string id_type;
+        std::string id_name;
+        std::string peer_type;
+        std::string peer_name;
+        std::string metadata;
+        std::string content;
+        uint64_t sequence_number;
+    };
+    typedef std::map<std::string, Record> RecordMap;
+    class WriteTask;
+
+    static std::string RecordKey(const Record &record);
+    bool CheckpointTimerExpired();
+    void WriteTaskDone();
+    bool LoadRecord(DB *db, IFMapServerParser *parser, Record *record);
+
+    IFMapServer *server_;
+    std::string filename_;
+    Timer *checkpoint_timer_;
+    Task *write_task_;
+    mutable tbb::mutex mutex_;
+    RecordMap records_;
+    uint64_t sequence_number_;
+    bool dirty_;
+    uint64_t checkpoints_;
+    uint64_t last_checkpoint_usecs_;
+    uint64_t load_usecs_;
+    size_t loaded_records_;
+};
+
+#endif /* defined(__ctrlplane__ifmap_snapshot__) */
@@ -7,16 +7,20 @@
 #include <fstream>
 
 #include "base/logging.h"
+#include "base/time_util.h"
+#include "base/util.h"
 #include "base/test/task_test_util.h"
 #include "control-node/control_node.h"
 #include "db/db.h"
 #include "db/db_graph.h"
 #include "io/event_manager.h"
 #include "ifmap/ifmap_client.h"
+#include "ifmap/ifmap_exporter.h"
 #include "ifmap/ifmap_link_table.h"
 #include "ifmap/ifmap_server.h"
 #include "ifmap/ifmap_server_parser.h"
 #include "ifmap/ifmap_table.h"
+#include "ifmap/ifmap_update.h"
 #include "ifmap/ifmap_util.h"
 #include "ifmap/ifmap_whitelist.h"
 #include "ifmap/test/ifmap_client_mock.h"
@@ -61,6 +65,15 @@ protected:
         return content;
     }
 
+    size_t InterestCount(const string &type, const string &name) {
+        IFMapNode *node = ifmap_test_util::IFMapNodeLookup(&db_, type, name);
+        if (node == NULL) {
+            return 0;
+        }
+        IFMapNodeState *state = server_.exporter()->NodeStateLookup(node);
+        return (state != NULL) ? state->interest().count() : 0;
+    }
+
     DB db_;
     DBGraph db_graph_;
     EventManager evm_;
@@ -685,6 +698,86 @@ TEST_F(IFMapGraphWalkerTest, PopulateWhiteList) {
     }
 }
 
+// Synthetic graph with kNumVrouters virtual-routers, each with a
+// virtual-machine and an interface in a shared virtual-network, which has a
+// shared access-control-list. Deleting the virtual-network to acl link
+// should only revisit the two endpoints of the link for each client rather
+// than walk the graph from each virtual-router.
+TEST_F(IFMapGraphWalkerTest, SharedLinkDelete) {
+    static const int kNumVrouters = 5000;
+    vector<IFMapClientMock *> clients;
+    for (int i = 0; i < kNumVrouters; ++i) {
+        ostringstream id;
+        id << i;
+        ifmap_test_util::IFMapMsgLink(&db_, "virtual-router", "vr" + id.str(),
+            "virtual-machine", "vm" + id.str(),
+            "virtual-router-virtual-machine");
+        ifmap_test_util::IFMapMsgLink(&db_, "virtual-machine-interface",
+            "vmi" + id.str(), "virtual-machine", "vm" + id.str(),
+            "virtual-machine-interface-virtual-machine");
+        ifmap_test_util::IFMapMsgLink(&db_, "virtual-machine-interface",
+            "vmi" + id.str(), "virtual-network", "vn-shared",
+            "virtual-machine-interface-virtual-network");
+        IFMapClientMock *client = new IFMapClientMock("vr" + id.str());
+        clients.push_back(client);
+        server_.AddClient(client);
+    }
+    ifmap_test_util::IFMapMsgLink(&db_, "virtual-network", "vn-shared",
+        "access-control-list", "acl-shared",
+        "virtual-network-access-control-list");
+    // Keep the acl node around after the virtual-network link is deleted.
+    ifmap_test_util::IFMapMsgLink(&db_, "security-group", "sg-shared",
+        "access-control-list", "acl-shared",
+        "security-group-access-control-list");
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(kNumVrouters,
+                        InterestCount("virtual-network", "vn-shared"));
+    TASK_UTIL_EXPECT_EQ(kNumVrouters,
+                        InterestCount("access-control-list", "acl-shared"));
+
+    IFMapGraphWalker *walker = server_.exporter()->walker();
+    uint64_t walks = walker->link_delete_walks();
+    uint64_t visited = walker->link_delete_nodes_visited();
+    uint64_t removed = walker->link_delete_interest_removed();
+    uint64_t usecs = walker->link_delete_usecs();
+    uint64_t start = UTCTimestampUsec();
+    ifmap_test_util::IFMapMsgUnlink(&db_, "virtual-network", "vn-shared",
+        "access-control-list", "acl-shared",
+        "virtual-network-access-control-list");
+    task_util::WaitForIdle();
+    uint64_t elapsed = UTCTimestampUsec() - start;
+
+    TASK_UTIL_EXPECT_EQ(0, InterestCount("access-control-list", "acl-shared"));
+    EXPECT_EQ(kNumVrouters, InterestCount("virtual-network", "vn-shared"));
+    EXPECT_EQ(kNumVrouters, walker->link_delete_walks() - walks);
+    EXPECT_EQ(2 * kNumVrouters,
+              walker->link_delete_nodes_visited() - visited);
+    EXPECT_EQ(kNumVrouters, walker->link_delete_interest_removed() - removed);
+    cout << "Link delete for " << kNumVrouters << " clients: "
+         << walker->link_delete_nodes_visited() - visited
+         << " nodes visited, walk " << (walker->link_delete_usecs() - usecs)
+         << " usec, total " << elapsed / 1000 << " msec" << endl;
+
+    // Removing the vm from vr0 should only remove the interest of vr0 in
+    // the nodes that are no longer reachable from vr0.
+    ifmap_test_util::IFMapMsgUnlink(&db_, "virtual-router", "vr0",
+        "virtual-machine", "vm0", "virtual-router-virtual-machine");
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(0, InterestCount("virtual-machine", "vm0"));
+    EXPECT_EQ(0, InterestCount("virtual-machine-interface", "vmi0"));
+    EXPECT_EQ(kNumVrouters - 1,
+              InterestCount("virtual-network", "vn-shared"));
+    EXPECT_EQ(1, InterestCount("virtual-machine", "vm1"));
+    EXPECT_EQ(1, InterestCount("virtual-router", "vr0"));
+
+    for (vector<IFMapClientMock *>::iterator iter = clients.begin();
+         iter != clients.end(); ++iter) {
+        server_.DeleteClient(*iter);
+    }
+    task_util::WaitForIdle();
+    STLDeleteValues(&clients);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     LoggingInit();
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "ifmap/ifmap_snapshot.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sstream>
+
+#include "base/logging.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "control-node/control_node.h"
+#include "db/db.h"
+#include "db/db_graph.h"
+#include "io/event_manager.h"
+#include "ifmap/ifmap_link_table.h"
+#include "ifmap/ifmap_server.h"
+#include "ifmap/ifmap_server_parser.h"
+#include "ifmap/ifmap_table.h"
+#include "ifmap/test/ifmap_test_util.h"
+
+#include "schema/vnc_cfg_types.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+static const char *kSnapshotFile = "ifmap_snapshot_test.snapshot";
+static const int kNumObjects = 5000;
+
+class IFMapSnapshotTest : public ::testing::Test {
+  protected:
+    IFMapSnapshotTest()
+            : server_(&db_, &graph_, evm_.io_service()), parser_(NULL) {
+    }
+
+    virtual void SetUp() {
+        IFMapLinkTable_Init(&db_, &graph_);
+        parser_ = IFMapServerParser::GetInstance("vnc_cfg");
+        vnc_cfg_ParserInit(parser_);
+        vnc_cfg_Server_ModuleInit(&db_, &graph_);
+        IFMapLinkTable_Init(&warm_db_, &warm_graph_);
+        vnc_cfg_Server_ModuleInit(&warm_db_, &warm_graph_);
+        server_.Initialize();
+        snapshot_.reset(new IFMapSnapshot(&server_, kSnapshotFile));
+        parser_->set_snapshot(snapshot_.get());
+    }
+
+    virtual void TearDown() {
+        parser_->set_snapshot(NULL);
+        snapshot_.reset();
+        remove(kSnapshotFile);
+        server_.Shutdown();
+        task_util::WaitForIdle();
+        IFMapLinkTable_Clear(&db_);
+        IFMapTable::ClearTables(&db_);
+        IFMapLinkTable_Clear(&warm_db_);
+        IFMapTable::ClearTables(&warm_db_);
+        task_util::WaitForIdle();
+        db_.Clear();
+        warm_db_.Clear();
+        parser_->MetadataClear("vnc_cfg");
+        task_util::WaitForIdle();
+        evm_.Shutdown();
+    }
+
+    static string Identity(const string &type, const string &name) {
+        return "<identity name=\"contrail:" + type + ":" + name +
+            "\" type=\"other\" other-type-definition=\"extended\"/>";
+    }
+
+    static string Metadata(const string &name, const string &content) {
+        return "<metadata><contrail:" + name +
+            " xmlns:contrail=\"http://www.contrailsystems.com/vnc_cfg.xsd\""
+            " ifmap-cardinality=\"singleValue\">" + content +
+            "</contrail:" + name + "></metadata>";
+    }
+
+    static string IdPerms(int index) {
+        ostringstream oss;
+        oss << "<uuid><uuid-mslong>" << 7154778764020240000ULL + index
+            << "</uuid-mslong><uuid-lslong>" << 13082342935312119000ULL + index
+            << "</uuid-lslong></uuid>";
+        return oss.str();
+    }
+
+    // Build a pollResult with count virtual-networks, virtual-routers and
+    // virtual-machines, and a virtual-router to virtual-machine link for
+    // each virtual-machine.
+    static string BuildConfig(const string &result, int start, int count) {
+        ostringstream oss;
+        oss << "<ns3:Envelope xmlns:ns2=\"http://www.trustedcomputinggroup.org"
+               "/2010/IFMAP/2\" xmlns:ns3=\"http://www.w3.org/2003/05/"
+               "soap-envelope\"><ns3:Body><ns2:response><pollResult><"
+            << result << " name=\"root\">";
+        for (int i = start; i < start + count; ++i) {
+            ostringstream oss_id;
+            oss_id << i;
+            string id = oss_id.str();
+            oss << "<resultItem>" << Identity("virtual-network", "vn" + id)
+                << Metadata("id-perms", IdPerms(i)) << "</resultItem>";
+            oss << "<resultItem>" << Identity("virtual-router", "vr" + id)
+                << Metadata("id-perms", IdPerms(i)) << "</resultItem>";
+            oss << "<resultItem>" << Identity("virtual-machine", "vm" + id)
+                << Metadata("id-perms", IdPerms(i)) << "</resultItem>";
+            oss << "<resultItem>" << Identity("virtual-router", "vr" + id)
+                << Identity("virtual-machine", "vm" + id)
+                << Metadata("virtual-router-virtual-machine", "")
+                << "</resultItem>";
+        }
+        oss << "</" << result << "></pollResult></ns2:response></ns3:Body>"
+               "</ns3:Envelope>";
+        return oss.str();
+    }
+
+    size_t TableSize(DB *db, const string &type) {
+        return IFMapTable::FindTable(db, type)->Size();
+    }
+
+    DB db_;
+    DBGraph graph_;
+    DB warm_db_;
+    DBGraph warm_graph_;
+    EventManager evm_;
+    IFMapServer server_;
+    IFMapServerParser *parser_;
+    boost::scoped_ptr<IFMapSnapshot> snapshot_;
+};
+
+// Compare the time taken to populate the config DB from a full download
+// with the time taken to restore the same config from the snapshot.
+TEST_F(IFMapSnapshotTest, WarmStart) {
+    string message = BuildConfig("searchResult", 0, kNumObjects);
+
+    uint64_t start = UTCTimestampUsec();
+    parser_->Receive(&db_, message.data(), message.size(), 0);
+    task_util::WaitForIdle();
+    uint64_t cold_usecs = UTCTimestampUsec() - start;
+    EXPECT_EQ(kNumObjects, TableSize(&db_, "virtual-network"));
+    EXPECT_EQ(kNumObjects, graph_.edge_count());
+    EXPECT_EQ(4 * kNumObjects, snapshot_->Size());
+
+    EXPECT_TRUE(snapshot_->Write());
+    EXPECT_EQ(1, snapshot_->checkpoints());
+
+    IFMapSnapshot warm_snapshot(&server_, kSnapshotFile);
+    start = UTCTimestampUsec();
+    EXPECT_TRUE(warm_snapshot.Load(&warm_db_, parser_));
+    task_util::WaitForIdle();
+    uint64_t warm_usecs = UTCTimestampUsec() - start;
+    EXPECT_EQ(4 * kNumObjects, warm_snapshot.loaded_records());
+    EXPECT_EQ(4 * kNumObjects, warm_snapshot.Size());
+
+    EXPECT_EQ(TableSize(&db_, "virtual-network"),
+              TableSize(&warm_db_, "virtual-network"));
+    EXPECT_EQ(TableSize(&db_, "virtual-router"),
+              TableSize(&warm_db_, "virtual-router"));
+    EXPECT_EQ(TableSize(&db_, "virtual-machine"),
+              TableSize(&warm_db_, "virtual-machine"));
+    EXPECT_EQ(graph_.edge_count(), warm_graph_.edge_count());
+    IFMapNode *vn = ifmap_test_util::IFMapNodeLookup(&warm_db_,
+        "virtual-network", "vn1");
+    ASSERT_TRUE(vn != NULL);
+    EXPECT_TRUE(vn->Find(IFMapOrigin(IFMapOrigin::MAP_SERVER)) != NULL);
+
+    cout << "Config with " << 4 * kNumObjects << " records: download "
+         << cold_usecs / 1000 << " msec, snapshot load "
+         << warm_usecs / 1000 << " msec, checkpoint "
+         << snapshot_->last_checkpoint_usecs() / 1000 << " msec" << endl;
+}
+
+// Deleted metadata is removed from the snapshot, and records that are not
+// refreshed after a reconnection are purged.
+TEST_F(IFMapSnapshotTest, UpdateAndPurge) {
+    string message = BuildConfig("updateResult", 0, 10);
+    parser_->Receive(&db_, message.data(), message.size(), 1);
+    task_util::WaitForIdle();
+    EXPECT_EQ(40, snapshot_->Size());
+
+    message = BuildConfig("deleteResult", 0, 2);
+    parser_->Receive(&db_, message.data(), message.size(), 1);
+    task_util::WaitForIdle();
+    EXPECT_EQ(32, snapshot_->Size());
+
+    // Reconnect and refresh only half of the remaining objects.
+    message = BuildConfig("searchResult", 2, 4);
+    parser_->Receive(&db_, message.data(), message.size(), 2);
+    task_util::WaitForIdle();
+    EXPECT_EQ(32, snapshot_->Size());
+    snapshot_->PurgeStale(2);
+    EXPECT_EQ(16, snapshot_->Size());
+    EXPECT_EQ(2, snapshot_->sequence_number());
+}
+
+// A truncated snapshot is rejected as a whole, so that none of its records
+// end up in the config DB without the stale entries cleanup.
+TEST_F(IFMapSnapshotTest, Truncated) {
+    string message = BuildConfig("searchResult", 0, 100);
+    parser_->Receive(&db_, message.data(), message.size(), 0);
+    task_util::WaitForIdle();
+    EXPECT_TRUE(snapshot_->Write());
+
+    struct stat st;
+    ASSERT_EQ(0, stat(kSnapshotFile, &st));
+    ASSERT_EQ(0, truncate(kSnapshotFile, st.st_size / 2));
+
+    IFMapSnapshot warm_snapshot(&server_, kSnapshotFile);
+    EXPECT_FALSE(warm_snapshot.Load(&warm_db_, parser_));
+    task_util::WaitForIdle();
+    EXPECT_EQ(0, warm_snapshot.loaded_records());
+    EXPECT_EQ(0, warm_snapshot.Size());
+    EXPECT_EQ(0, TableSize(&warm_db_, "virtual-network"));
+    EXPECT_EQ(0, TableSize(&warm_db_, "virtual-router"));
+    EXPECT_EQ(0, TableSize(&warm_db_, "virtual-machine"));
+    EXPECT_EQ(0, warm_graph_.edge_count());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    ControlNode::SetDefaultSchedulingPolicy();
+    int status = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return status;
+}
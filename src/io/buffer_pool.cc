@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "io/buffer_pool.h"
+
+using std::vector;
+
+const size_t BufferPool::kMinBufferSize;
+const size_t BufferPool::kMaxBufferSize;
+const size_t BufferPool::kMaxCachedBuffers;
+
+BufferPool::BufferPool() {
+    size_t class_size;
+    free_lists_.resize(SizeClass(kMaxBufferSize, &class_size) + 1);
+    allocations_ = 0;
+    hits_ = 0;
+}
+
+BufferPool::~BufferPool() {
+    for (size_t i = 0; i < free_lists_.size(); i++) {
+        for (size_t j = 0; j < free_lists_[i].size(); j++) {
+            delete[] free_lists_[i][j];
+        }
+    }
+}
+
+// Index of the smallest size class that holds size bytes, and its size.
+size_t BufferPool::SizeClass(size_t size, size_t *class_size) {
+    size_t index = 0;
+    *class_size = kMinBufferSize;
+    while (*class_size < size) {
+        *class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+uint8_t *BufferPool::Allocate(size_t size, size_t *alloc_size) {
+    allocations_++;
+    size_t index = SizeClass(size, alloc_size);
+    if (index < free_lists_.size()) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        vector<uint8_t *> &free_list = free_lists_[index];
+        if (!free_list.empty()) {
+            uint8_t *data = free_list.back();
+            free_list.pop_back();
+            hits_++;
+            return data;
+        }
+    }
+    return new uint8_t[*alloc_size];
+}
+
+void BufferPool::Release(uint8_t *data, size_t alloc_size) {
+    size_t class_size;
+    size_t index = SizeClass(alloc_size, &class_size);
+    if (index < free_lists_.size() && class_size == alloc_size) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        vector<uint8_t *> &free_list = free_lists_[index];
+        if (free_list.size() < kMaxCachedBuffers) {
+            free_list.push_back(data);
+            return;
+        }
+    }
+    delete[] data;
+}
+
+size_t BufferPool::cached() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    size_t count = 0;
+    for (size_t i = 0; i < free_lists_.size(); i++) {
+        count += free_lists_[i].size();
+    }
+    return count;
+}
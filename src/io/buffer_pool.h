@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef IO_BUFFER_POOL_H_
+#define IO_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/util.h"
+
+//
+// BufferPool caches the receive and reassembly buffers of the sessions of
+// a TcpServer, so that they are not allocated and freed for every read.
+//
+// Buffers are allocated in power of two size classes from kMinBufferSize
+// to kMaxBufferSize, and at most kMaxCachedBuffers free buffers are kept
+// per size class. Larger buffers are not cached.
+//
+class BufferPool {
+public:
+    static const size_t kMinBufferSize = 256;
+    static const size_t kMaxBufferSize = 64 * 1024;
+    static const size_t kMaxCachedBuffers = 256;
+
+    BufferPool();
+    ~BufferPool();
+
+    // Returns a buffer of at least size bytes. The size of the buffer,
+    // which must be passed to Release, is returned in alloc_size.
+    uint8_t *Allocate(size_t size, size_t *alloc_size);
+    void Release(uint8_t *data, size_t alloc_size);
+
+    uint64_t allocations() const { return allocations_; }
+    uint64_t hits() const { return hits_; }
+    size_t cached() const;
+
+private:
+    static size_t SizeClass(size_t size, size_t *class_size);
+
+    mutable tbb::mutex mutex_;
+    std::vector<std::vector<uint8_t *> > free_lists_;
+    tbb::atomic<uint64_t> allocations_;
+    tbb::atomic<uint64_t> hits_;
+
+    DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+#endif  // IO_BUFFER_POOL_H_
@@ -12,8 +12,54 @@ using namespace boost::asio;
 
 SandeshTraceBufferPtr IOTraceBuf(SandeshTraceBufferCreate(IO_TRACE_BUF, 1000));
 
-EventManager::EventManager() {
+EventManager::EventManager(int io_threads) : io_threads_joined_(false) {
     shutdown_ = false;
+    next_io_thread_ = 0;
+    for (int i = 0; i < io_threads; i++) {
+        IoThread *thread = new IoThread;
+        thread->work.reset(new io_service::work(thread->io_service));
+        io_threads_.push_back(thread);
+        int res = pthread_create(&thread->thread_id, NULL, &IoThreadRun,
+                                 thread);
+        assert(res == 0);
+    }
+}
+
+EventManager::~EventManager() {
+    StopIoThreads();
+}
+
+void *EventManager::IoThreadRun(void *arg) {
+    IoThread *thread = reinterpret_cast<IoThread *>(arg);
+    boost::system::error_code ec;
+    thread->io_service.run(ec);
+    if (ec) {
+        EVENT_MANAGER_LOG_ERROR("io_service run failed: " << ec.message());
+    }
+    return NULL;
+}
+
+// Stop the io_services of the pool and wait for their threads to exit.
+// Handlers that are still queued on them are not run.
+void EventManager::StopIoThreads() {
+    if (io_threads_joined_) return;
+    for (size_t i = 0; i < io_threads_.size(); i++) {
+        io_threads_[i].work.reset();
+        io_threads_[i].io_service.stop();
+    }
+    for (size_t i = 0; i < io_threads_.size(); i++) {
+        int res = pthread_join(io_threads_[i].thread_id, NULL);
+        assert(res == 0);
+    }
+    io_threads_joined_ = true;
+}
+
+io_service *EventManager::AssignIoService() {
+    if (io_threads_.empty()) {
+        return &io_service_;
+    }
+    size_t index = next_io_thread_.fetch_and_increment();
+    return &io_threads_[index % io_threads_.size()].io_service;
 }
 
 void EventManager::Shutdown() {
@@ -21,6 +67,7 @@ void EventManager::Shutdown() {
 
     // TODO: make sure that are no users of this event manager.
     io_service_.stop();
+    StopIoThreads();
 }
 
 void EventManager::Run() {
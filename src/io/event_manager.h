@@ -4,7 +4,11 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <boost/asio/io_service.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <tbb/atomic.h>
 #include <tbb/spin_mutex.h>
 
 #include "base/util.h"
@@ -18,9 +22,17 @@
 // Poll directly or indirectly after having started a ServerThread (which
 // calls Run).
 //
+// An EventManager created with io_threads > 0 also owns a pool of
+// io_services, each run by its own thread from construction until
+// Shutdown. TcpServer runs the sockets of the sessions that it accepts on
+// the pool, in round-robin order, so that the reads and SSL handshakes of
+// different sessions run in parallel. The acceptors, timers and all other
+// handlers still run on the main io_service, in the thread calling Run.
+//
 class EventManager {
 public:
-    EventManager();
+    explicit EventManager(int io_threads = 0);
+    ~EventManager();
 
     // Run until shutdown.
     void Run();
@@ -36,10 +48,28 @@ public:
 
     boost::asio::io_service *io_service() { return &io_service_; }
 
+    // The io_service on which to run a new session: the next one of the
+    // pool, or the main io_service if there is no pool.
+    boost::asio::io_service *AssignIoService();
+
+    size_t io_thread_count() const { return io_threads_.size(); }
+
 private:
+    struct IoThread {
+        boost::asio::io_service io_service;
+        boost::scoped_ptr<boost::asio::io_service::work> work;
+        pthread_t thread_id;
+    };
+
+    static void *IoThreadRun(void *arg);
+    void StopIoThreads();
+
     boost::asio::io_service io_service_;
     bool shutdown_;
     tbb::spin_mutex mutex_;
+    boost::ptr_vector<IoThread> io_threads_;
+    tbb::atomic<size_t> next_io_thread_;
+    bool io_threads_joined_;
 
     DISALLOW_COPY_AND_ASSIGN(EventManager);
 };
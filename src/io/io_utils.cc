@@ -14,9 +14,13 @@ SocketStats::SocketStats() {
     read_calls = 0;
     read_bytes = 0;
     read_errors = 0;
+    read_reassemblies = 0;
+    read_reassembly_bytes = 0;
     write_calls = 0;
     write_bytes = 0;
     write_errors = 0;
+    write_syscalls = 0;
+    write_bytes_copied = 0;
     write_blocked = 0;
     write_blocked_duration_usecs = 0;
     read_block_start_time = 0;
@@ -40,6 +44,9 @@ void SocketStats::GetRxStats(SocketIOStats &socket_stats) const {
                      read_blocked);
     }
     socket_stats.errors = read_errors;
+    socket_stats.syscalls = read_calls;
+    socket_stats.bytes_copied = read_reassembly_bytes;
+    socket_stats.reassemblies = read_reassemblies;
 }
 
 void SocketStats::GetTxStats(SocketIOStats &socket_stats) const {
@@ -58,6 +65,8 @@ void SocketStats::GetTxStats(SocketIOStats &socket_stats) const {
                      write_blocked);
     }
     socket_stats.errors = write_errors;
+    socket_stats.syscalls = write_syscalls;
+    socket_stats.bytes_copied = write_bytes_copied;
 }
 
 }  // namespace io
@@ -20,9 +20,13 @@ struct SocketStats {
     tbb::atomic<uint64_t> read_calls;
     tbb::atomic<uint64_t> read_bytes;
     tbb::atomic<uint64_t> read_errors;
+    tbb::atomic<uint64_t> read_reassemblies;
+    tbb::atomic<uint64_t> read_reassembly_bytes;
     tbb::atomic<uint64_t> write_calls;
     tbb::atomic<uint64_t> write_bytes;
     tbb::atomic<uint64_t> write_errors;
+    tbb::atomic<uint64_t> write_syscalls;
+    tbb::atomic<uint64_t> write_bytes_copied;
     tbb::atomic<uint64_t> write_blocked;
     tbb::atomic<uint64_t> write_blocked_duration_usecs;
     tbb::atomic<uint64_t> read_block_start_time;
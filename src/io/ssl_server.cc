@@ -132,7 +132,7 @@ TcpServer::Socket *SslServer::accept_socket() const {
 }
 
 void SslServer::set_accept_socket() {
-    so_ssl_accept_.reset(new SslSocket(*event_manager()->io_service(),
+    so_ssl_accept_.reset(new SslSocket(*event_manager()->AssignIoService(),
                                        context_));
 }
 
@@ -47,6 +47,9 @@ SslSession::SslSession(SslServer *server, SslSocket *ssl_socket,
       ssl_handshake_delayed_(false) {
 
     if (server) {
+        if (ssl_socket) {
+            set_io_service(&ssl_socket->get_io_service());
+        }
         ssl_enabled_ = server->ssl_enabled_;
         ssl_handshake_delayed_ = server->ssl_handshake_delayed_;
     }
@@ -125,6 +128,42 @@ void SslSession::AsyncWrite(const u_int8_t *data, std::size_t size) {
     }
 }
 
+// An SSL write only encrypts the first of the buffers it is given, into
+// at most one record. The buffers are gathered into one record's worth of
+// data, so that a chain of small buffers is not written one at a time.
+std::size_t SslSession::WriteSomeBuffers(
+        const std::vector<boost::asio::const_buffer> &buffers,
+        boost::system::error_code &error) {
+    if (IsSslHandShakeSuccessLocked()) {
+        if (buffers.size() == 1) {
+            return ssl_socket_->write_some(buffers, error);
+        }
+        uint8_t data[kMaxSslWriteSize];
+        std::size_t len = boost::asio::buffer_copy(buffer(data), buffers);
+        return ssl_socket_->write_some(buffer(data, len), error);
+    } else {
+        return (TcpSession::WriteSomeBuffers(buffers, error));
+    }
+}
+
+void SslSession::AsyncWriteBuffers(const BufferChain &chain) {
+    if (IsSslHandShakeSuccessLocked()) {
+        std::vector<boost::asio::const_buffer> buffers;
+        buffers.reserve(chain.size());
+        for (BufferChain::const_iterator iter = chain.begin();
+             iter != chain.end(); ++iter) {
+            buffers.push_back(buffer((*iter)->data(), (*iter)->size()));
+        }
+        boost::asio::async_write(
+            *ssl_socket_.get(), buffers,
+            boost::bind(&TcpSession::AsyncWriteBuffersHandler,
+                        TcpSessionPtr(this), chain,
+                        boost::asio::placeholders::error));
+    } else {
+        return (TcpSession::AsyncWriteBuffers(chain));
+    }
+}
+
 void SslSession::SslHandShakeCallback(SslHandShakeCallbackHandler cb,
     SslSessionPtr session,
     const boost::system::error_code &error) {
@@ -157,6 +196,6 @@ void SslSession::TriggerSslHandShakeInternal(SslSessionPtr session, SslHandShake
 }
 
 void SslSession::TriggerSslHandShake(SslHandShakeCallbackHandler cb) {
-    server()->event_manager()->io_service()->post(
+    ssl_socket_->get_io_service().post(
         boost::bind(&TriggerSslHandShakeInternal, SslSessionPtr(this), cb));
 }
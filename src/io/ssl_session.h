@@ -72,6 +72,13 @@ private:
     std::size_t WriteSome(const uint8_t *data, std::size_t len,
                           boost::system::error_code &error);
     void AsyncWrite(const u_int8_t *data, std::size_t size);
+    std::size_t WriteSomeBuffers(
+        const std::vector<boost::asio::const_buffer> &buffers,
+        boost::system::error_code &error);
+    void AsyncWriteBuffers(const BufferChain &chain);
+
+    // Largest amount of data in an SSL record
+    static const std::size_t kMaxSslWriteSize = 16 * 1024;
 
     static void TriggerSslHandShakeInternal(SslSessionPtr, SslHandShakeCallbackHandler);
 
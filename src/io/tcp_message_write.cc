@@ -18,25 +18,52 @@ TcpMessageWriter::TcpMessageWriter(TcpSession *session) :
 }
 
 TcpMessageWriter::~TcpMessageWriter() {
-    for (BufferQueue::iterator iter = buffer_queue_.begin();
-         iter != buffer_queue_.end(); ++iter) {
-        DeleteBuffer(*iter);
-    }
     buffer_queue_.clear();
 }
 
-int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
-    int wrote = 0;
+size_t TcpMessageWriter::ChainLength(const BufferChain &chain) {
+    size_t len = 0;
+    for (BufferChain::const_iterator iter = chain.begin();
+         iter != chain.end(); ++iter) {
+        len += (*iter)->size();
+    }
+    return len;
+}
 
+void TcpMessageWriter::UpdateSendStats(size_t len) {
     // Update socket write call statistics.
     session_->stats_.write_calls++;
     session_->stats_.write_bytes += len;
 
     session_->server_->stats_.write_calls++;
     session_->server_->stats_.write_bytes += len;
+}
+
+int TcpMessageWriter::Write(const uint8_t *data, size_t len,
+                            error_code &ec) {
+    session_->stats_.write_syscalls++;
+    session_->server_->stats_.write_syscalls++;
+    return session_->WriteSome(data, len, ec);
+}
+
+int TcpMessageWriter::WriteBuffers(const ConstBufferVec &buffers,
+                                   error_code &ec) {
+    if (buffers.size() == 1) {
+        return Write(buffer_cast<const uint8_t *>(buffers[0]),
+                     buffer_size(buffers[0]), ec);
+    }
+    session_->stats_.write_syscalls++;
+    session_->server_->stats_.write_syscalls++;
+    return session_->WriteSomeBuffers(buffers, ec);
+}
+
+int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
+    int wrote = 0;
+
+    UpdateSendStats(len);
 
     if (buffer_queue_.empty()) {
-        wrote = session_->WriteSome(data, len, ec);
+        wrote = Write(data, len, ec);
         if (TcpSession::IsSocketErrorHard(ec)) return -1;
         assert(wrote >= 0);
 
@@ -55,40 +82,107 @@ int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
     return wrote;
 }
 
+//
+// Send a chain of shared buffers with a single gather write, and queue the
+// buffers that were not completely written, by reference.
+//
+int TcpMessageWriter::Send(const BufferChain &chain, error_code &ec) {
+    size_t len = ChainLength(chain);
+    size_t wrote = 0;
+
+    UpdateSendStats(len);
+
+    if (buffer_queue_.empty()) {
+        ConstBufferVec buffers;
+        buffers.reserve(chain.size());
+        for (BufferChain::const_iterator iter = chain.begin();
+             iter != chain.end() && buffers.size() < kMaxWriteBuffers;
+             ++iter) {
+            if (!(*iter)->empty()) {
+                buffers.push_back(buffer((*iter)->data(), (*iter)->size()));
+            }
+        }
+        if (!buffers.empty()) {
+            int res = WriteBuffers(buffers, ec);
+            if (TcpSession::IsSocketErrorHard(ec)) return -1;
+            assert(res >= 0);
+            wrote = res;
+        }
+        if (wrote == len) {
+            return wrote;
+        }
+        TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
+            "Encountered partial send of " << wrote << " bytes when "
+            "sending " << len << " bytes, Error: " << ec);
+        session_->DeferWriter();
+    } else {
+        TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
+            "Write not ready. Enqueue buffer chain (len = " << len <<
+            ") and return");
+    }
+
+    // Skip the buffers that were written. The queue is empty if anything
+    // was, so the offset into the first one that was not completely
+    // written becomes the offset into the head of the queue.
+    size_t skip = wrote;
+    for (BufferChain::const_iterator iter = chain.begin();
+         iter != chain.end(); ++iter) {
+        size_t size = (*iter)->size();
+        if (skip >= size) {
+            skip -= size;
+            continue;
+        }
+        if (skip) {
+            offset_ = skip;
+            skip = 0;
+        }
+        buffer_queue_.push_back(*iter);
+    }
+    return wrote;
+}
+
 // Socket is ready for write. Flush any pending data
 void TcpMessageWriter::HandleWriteReady(error_code &error) {
+    ConstBufferVec buffers;
     while (!buffer_queue_.empty()) {
-        boost::asio::mutable_buffer head = buffer_queue_.front();
-        const uint8_t *data = buffer_cast<const uint8_t *>(head) + offset_;
-        int remaining = buffer_size(head) - offset_;
-        int wrote = session_->WriteSome(data, remaining, error);
+        buffers.clear();
+        size_t remaining = 0;
+        for (BufferQueue::const_iterator iter = buffer_queue_.begin();
+             iter != buffer_queue_.end() && buffers.size() < kMaxWriteBuffers;
+             ++iter) {
+            size_t offset = buffers.empty() ? offset_ : 0;
+            buffers.push_back(buffer((*iter)->data() + offset,
+                                     (*iter)->size() - offset));
+            remaining += (*iter)->size() - offset;
+        }
+        int res = WriteBuffers(buffers, error);
         if (TcpSession::IsSocketErrorHard(error)) {
             return;
         }
-        assert(wrote >= 0);
-        if (wrote != remaining) {
-            offset_ += wrote;
-            session_->DeferWriter();
-            return;
-        } else {
+        assert(res >= 0);
+        size_t wrote = res;
+
+        // Release the buffers that were completely written
+        while (wrote > 0 && !buffer_queue_.empty() &&
+               wrote >= buffer_queue_.front()->size() - offset_) {
+            wrote -= buffer_queue_.front()->size() - offset_;
             offset_ = 0;
-            DeleteBuffer(head);
             buffer_queue_.pop_front();
         }
+        offset_ += wrote;
+        if ((size_t)res != remaining) {
+            session_->DeferWriter();
+            return;
+        }
     }
-    buffer_queue_.clear();
 }
 
+// Queue a copy of data that could not be written.
 void TcpMessageWriter::BufferAppend(const uint8_t *src, int bytes) {
-    u_int8_t *data = new u_int8_t[bytes];
-    memcpy(data, src, bytes);
-    mutable_buffer buffer = mutable_buffer(data, bytes);
-    buffer_queue_.push_back(buffer);
+    if (bytes == 0)
+        return;
+    session_->stats_.write_bytes_copied += bytes;
+    session_->server_->stats_.write_bytes_copied += bytes;
+    buffer_queue_.push_back(SharedBuffer(
+        new std::string(reinterpret_cast<const char *>(src), bytes)));
 }
-
-void TcpMessageWriter::DeleteBuffer(mutable_buffer buffer) {
-    const uint8_t *data = buffer_cast<const uint8_t *>(buffer);
-    delete[] data;
-    return;
-}
-
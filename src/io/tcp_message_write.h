@@ -5,11 +5,14 @@
 #ifndef __MESSAGE_WRITE_H__
 #define __MESSAGE_WRITE_H__
 
-#include <list>
+#include <deque>
+#include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/system/error_code.hpp>
 #include <tbb/mutex.h>
 #include "base/util.h"
@@ -18,25 +21,46 @@ using namespace boost::system;
 
 class TcpSession;
 
+//
+// TcpMessageWriter queues the data that could not be written to the socket
+// right away, and flushes it when the socket is ready for write.
+//
+// Data is queued as a list of immutable, reference counted buffers. A
+// BufferChain sent with Send is queued without copying, so that a payload
+// shared by many sessions is never copied, and the queue is flushed with
+// a single gather write (writev) for up to kMaxWriteBuffers buffers.
+//
 class TcpMessageWriter {
 public:
+    typedef boost::shared_ptr<const std::string> SharedBuffer;
+    typedef std::vector<SharedBuffer> BufferChain;
+
     static const int kDefaultBufferSize = 4 * 1024;
+    static const size_t kMaxWriteBuffers = 64;
+
     explicit TcpMessageWriter(TcpSession *session);
     ~TcpMessageWriter();
 
     // return false for send  
     int Send(const uint8_t *msg, size_t len, error_code &ec);
+    int Send(const BufferChain &chain, error_code &ec);
+
+    static size_t ChainLength(const BufferChain &chain);
 
 private:
     friend class TcpSession;
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
-    typedef std::list<boost::asio::mutable_buffer> BufferQueue;
+    typedef std::deque<SharedBuffer> BufferQueue;
+    typedef std::vector<boost::asio::const_buffer> ConstBufferVec;
+
+    void UpdateSendStats(size_t len);
+    int Write(const uint8_t *data, size_t len, error_code &ec);
+    int WriteBuffers(const ConstBufferVec &buffers, error_code &ec);
     void BufferAppend(const uint8_t *data, int len);
-    void DeleteBuffer(boost::asio::mutable_buffer buffer); 
     void HandleWriteReady(boost::system::error_code &ec);
 
     BufferQueue buffer_queue_;
-    int offset_;
+    size_t offset_;
     TcpSession *session_;
 };
 
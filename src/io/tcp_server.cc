@@ -287,8 +287,10 @@ TcpServer::Socket *TcpServer::accept_socket() const {
     return so_accept_.get();
 }
 
+// The socket of a passive session is created on the io_service of the
+// event manager pool that will run it.
 void TcpServer::set_accept_socket() {
-    so_accept_.reset(new Socket(*evm_->io_service()));
+    so_accept_.reset(new Socket(*evm_->AssignIoService()));
 }
 
 bool TcpServer::AcceptSession(TcpSession *session) {
@@ -14,6 +14,7 @@
 #include <tbb/compat/condition_variable>
 
 #include "base/util.h"
+#include "io/buffer_pool.h"
 #include "io/server_manager.h"
 #include "io/io_utils.h"
 
@@ -66,6 +67,9 @@ public:
 
     EventManager *event_manager() { return evm_; }
 
+    // Pool of the read and reassembly buffers of the sessions.
+    BufferPool *buffer_pool() { return &buffer_pool_; }
+
     // Returns true if any of the sessions on this server has read available
     // data.
     bool HasSessionReadAvailable() const;
@@ -119,6 +123,7 @@ protected:
 
 private:
     friend class TcpSession;
+    friend class TcpMessageReader;
     friend class TcpMessageWriter;
     friend class BgpServerUnitTest;
     friend void intrusive_ptr_add_ref(TcpServer *server);
@@ -151,6 +156,7 @@ private:
 
     io::SocketStats stats_;
     EventManager *evm_;
+    BufferPool buffer_pool_;
     // mutex protects the session maps
     mutable tbb::mutex mutex_;
     tbb::interface5::condition_variable cond_var_;
@@ -6,7 +6,6 @@
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/asio/detail/socket_option.hpp>
 
 #include "base/logging.h"
@@ -21,6 +20,9 @@ using namespace boost::system;
 using namespace std;
 
 int TcpSession::reader_task_id_ = -1;
+const int TcpSession::kDefaultBufferSize;
+const int TcpSession::kMaxReadBufferSize;
+const int TcpSession::kShrinkReads;
 
 class TcpSession::Reader : public Task {
 public:
@@ -59,6 +61,8 @@ TcpSession::TcpSession(
       established_(false),
       closed_(false),
       direction_(ACTIVE),
+      read_buffer_size_(kDefaultBufferSize),
+      small_reads_(0),
       writer_(new TcpMessageWriter(this)),
       name_("-") {
     refcount_ = 0;
@@ -67,11 +71,18 @@ TcpSession::TcpSession(
         reader_task_id_ = scheduler->GetTaskId("io::ReaderTask");
     }
     if (server_) {
-        io_strand_.reset(new Strand(*server->event_manager()->io_service()));
+        set_io_service(socket ? &socket->get_io_service() :
+                       server->event_manager()->io_service());
     }
     defer_reader_ = false;
 }
 
+// Handlers posted to the strand of the session run on the io_service of
+// its socket, so that they are serialized with the socket operations.
+void TcpSession::set_io_service(boost::asio::io_service *io_service) {
+    io_strand_.reset(new Strand(*io_service));
+}
+
 TcpSession::~TcpSession() {
     assert(!established_);
     for (BufferQueue::iterator iter = buffer_queue_.begin();
@@ -82,18 +93,56 @@ TcpSession::~TcpSession() {
 }
 
 mutable_buffer TcpSession::AllocateBuffer() {
-    u_int8_t *data = new u_int8_t[buffer_size_];
-    mutable_buffer buffer = mutable_buffer(data, buffer_size_);
-    {
-        tbb::mutex::scoped_lock lock(mutex_);
-        buffer_queue_.push_back(buffer);
+    tbb::mutex::scoped_lock lock(mutex_);
+    size_t size;
+    u_int8_t *data;
+    if (server_) {
+        data = server_->buffer_pool()->Allocate(read_buffer_size_, &size);
+    } else {
+        data = new u_int8_t[read_buffer_size_];
+        size = read_buffer_size_;
     }
+    mutable_buffer buffer = mutable_buffer(data, size);
+    buffer_queue_.push_back(buffer);
     return buffer;
 }
 
 void TcpSession::DeleteBuffer(mutable_buffer buffer) {
     uint8_t *data = buffer_cast<uint8_t *>(buffer);
-    delete[] data;
+    if (server_) {
+        server_->buffer_pool()->Release(data, buffer_size(buffer));
+    } else {
+        delete[] data;
+    }
+}
+
+//
+// Adapt the size of the read buffers to the data available on the socket:
+// double it when a read fills the buffer, and halve it, down to the
+// minimum buffer_size_, after kShrinkReads consecutive reads that used
+// less than a quarter of it.
+//
+void TcpSession::UpdateReadBufferSizeLocked(size_t bytes_transferred,
+                                            size_t buffer_size) {
+    if (bytes_transferred >= buffer_size) {
+        small_reads_ = 0;
+        read_buffer_size_ = max(buffer_size_,
+            min(read_buffer_size_ * 2, static_cast<int>(kMaxReadBufferSize)));
+    } else if (bytes_transferred < buffer_size / 4) {
+        if (++small_reads_ >= kShrinkReads) {
+            small_reads_ = 0;
+            read_buffer_size_ = max(buffer_size_, read_buffer_size_ / 2);
+        }
+    } else {
+        small_reads_ = 0;
+    }
+}
+
+void TcpSession::ReserveReadBufferSize(int size) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    read_buffer_size_ = max(read_buffer_size_,
+        min(size, static_cast<int>(kMaxReadBufferSize)));
+    small_reads_ = 0;
 }
 
 static int BufferCmp(const mutable_buffer &lhs, const const_buffer &rhs) {
@@ -193,6 +242,26 @@ void TcpSession::AsyncWrite(const u_int8_t *data, std::size_t size) {
                     boost::asio::placeholders::error));
 }
 
+std::size_t TcpSession::WriteSomeBuffers(
+        const std::vector<boost::asio::const_buffer> &buffers,
+        boost::system::error_code &error) {
+    return socket()->write_some(buffers, error);
+}
+
+// The handler holds a reference to the buffers of the chain until the
+// write is complete.
+void TcpSession::AsyncWriteBuffers(const BufferChain &chain) {
+    std::vector<const_buffer> buffers;
+    buffers.reserve(chain.size());
+    for (BufferChain::const_iterator iter = chain.begin();
+         iter != chain.end(); ++iter) {
+        buffers.push_back(buffer((*iter)->data(), (*iter)->size()));
+    }
+    boost::asio::async_write(*socket(), buffers,
+        boost::bind(&TcpSession::AsyncWriteBuffersHandler, TcpSessionPtr(this),
+                    chain, boost::asio::placeholders::error));
+}
+
 TcpSession::Endpoint TcpSession::local_endpoint() const {
     tbb::mutex::scoped_lock lock(mutex_);
     if (!established_) {
@@ -373,6 +442,11 @@ void TcpSession::AsyncWriteHandler(TcpSessionPtr session,
     }
 }
 
+void TcpSession::AsyncWriteBuffersHandler(TcpSessionPtr session,
+        BufferChain chain, const boost::system::error_code &error) {
+    AsyncWriteHandler(session, error);
+}
+
 bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
     bool ret = true;
     tbb::mutex::scoped_lock lock(mutex_);
@@ -406,6 +480,40 @@ bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
     return ret;
 }
 
+bool TcpSession::Send(const BufferChain &chain, size_t *sent) {
+    bool ret = true;
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    // Reset sent, if provided.
+    if (sent) *sent = 0;
+
+    //
+    // If the session closed in the mean while, bail out
+    //
+    if (!established_) return false;
+
+    size_t size = TcpMessageWriter::ChainLength(chain);
+    if (socket()->non_blocking()) {
+        boost::system::error_code error;
+        int len = writer_->Send(chain, error);
+        lock.release();
+        if (len < 0) {
+            TCP_SESSION_LOG_ERROR(this, TCP_DIR_OUT,
+                                  "Write failed due to error: "
+                                  << error.category().name() << " "
+                                  << error.message());
+            CloseInternal(error, true);
+            return false;
+        }
+        if ((size_t)len != size) ret = false;
+        if (sent) *sent = len;
+    } else {
+        AsyncWriteBuffers(chain);
+        if (sent) *sent = size;
+    }
+    return ret;
+}
+
 Task* TcpSession::CreateReaderTask(boost::asio::mutable_buffer buffer,
                                   size_t bytes_transferred) {
 
@@ -454,6 +562,7 @@ void TcpSession::AsyncReadHandler(
     session->stats_.read_bytes += bytes_transferred;
     session->server_->stats_.read_calls++;
     session->server_->stats_.read_bytes += bytes_transferred;
+    session->UpdateReadBufferSizeLocked(bytes_transferred, buffer_size(buffer));
 
     Task *task = session->CreateReaderTask(buffer, bytes_transferred);
     // Starting a new task for the session
@@ -502,10 +611,44 @@ int TcpSession::ClearMd5SocketOption(uint32_t peer_ip) {
 
 TcpMessageReader::TcpMessageReader(TcpSession *session, 
                                    ReceiveCallback callback)
-    : session_(session), callback_(callback), offset_(0), remain_(-1) {
+    : session_(session), callback_(callback), offset_(0), remain_(-1),
+      reassembly_(NULL), reassembly_size_(0) {
 }
 
 TcpMessageReader::~TcpMessageReader() {
+    ReleaseReassemblyBuffer();
+}
+
+// Returns a buffer of at least size bytes to reassemble messages that
+// span multiple read buffers. The buffer is kept across messages and only
+// replaced when a larger message arrives.
+uint8_t *TcpMessageReader::ReassemblyBuffer(int size) {
+    if (reassembly_size_ >= (size_t) size) {
+        return reassembly_;
+    }
+    ReleaseReassemblyBuffer();
+    TcpServer *server = session_->server();
+    if (server) {
+        reassembly_ = server->buffer_pool()->Allocate(size, &reassembly_size_);
+    } else {
+        reassembly_ = new uint8_t[size];
+        reassembly_size_ = size;
+    }
+    return reassembly_;
+}
+
+void TcpMessageReader::ReleaseReassemblyBuffer() {
+    if (reassembly_ == NULL) {
+        return;
+    }
+    TcpServer *server = session_->server();
+    if (server) {
+        server->buffer_pool()->Release(reassembly_, reassembly_size_);
+    } else {
+        delete[] reassembly_;
+    }
+    reassembly_ = NULL;
+    reassembly_size_ = 0;
 }
 
 // Returns a buffer allocation size that is larger than the message.
@@ -607,12 +750,15 @@ void TcpMessageReader::OnRead(Buffer buffer) {
                 queue_.push_back(buffer);
                 return;
             }
-            boost::scoped_array<uint8_t> data(new uint8_t[kHeaderLenSize]);
-            Buffer header = PullUp(data.get(), buffer, kHeaderLenSize);
+            Buffer header = PullUp(ReassemblyBuffer(kHeaderLenSize), buffer,
+                                   kHeaderLenSize);
             assert(TcpSession::BufferSize(header) == (size_t) kHeaderLenSize);
 
             msglength = MsgLength(header, 0);
             remain_ = msglength - queuelen;
+
+            // Read the rest of the message into as few buffers as possible
+            session_->ReserveReadBufferSize(remain_);
         }
 
         assert(remain_ > 0);
@@ -623,12 +769,17 @@ void TcpMessageReader::OnRead(Buffer buffer) {
         }
 
         // concat the buffers into a contiguous message.
-        boost::scoped_array<uint8_t>
-            data(new uint8_t[AllocBufferSize(msglength)]);
-        BufferConcat(data.get(), buffer, msglength);
+        uint8_t *data = ReassemblyBuffer(AllocBufferSize(msglength));
+        BufferConcat(data, buffer, msglength);
         assert(remain_ == -1);
+        session_->stats_.read_reassemblies++;
+        session_->stats_.read_reassembly_bytes += msglength;
+        if (session_->server_) {
+            session_->server_->stats_.read_reassemblies++;
+            session_->server_->stats_.read_reassembly_bytes += msglength;
+        }
         // Receive the message
-        bool success = callback_(data.get(), msglength);
+        bool success = callback_(data, msglength);
         if (!success)
             return;
     }
@@ -641,6 +792,7 @@ void TcpMessageReader::OnRead(Buffer buffer) {
         }
         if (msglength > avail) {
             remain_ = msglength - avail;
+            session_->ReserveReadBufferSize(remain_);
             break;
         }
         // Receive the message
@@ -800,5 +952,7 @@ void TcpSession::GetTxSocketStats(SocketIOStats &socket_stats) const {
 }
 
 void TcpSession::SetBufferSize(int buffer_size) {
+    tbb::mutex::scoped_lock lock(mutex_);
     buffer_size_ = buffer_size;
+    read_buffer_size_ = buffer_size;
 }
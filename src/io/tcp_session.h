@@ -23,12 +23,12 @@
 #endif
 #include "base/util.h"
 #include "base/task.h"
+#include "io/tcp_message_write.h"
 #include "io/tcp_server.h"
 
 class EventManager;
 class TcpServer;
 class TcpSession;
-class TcpMessageWriter;
 
 // TcpSession
 //
@@ -38,6 +38,11 @@ class TcpMessageWriter;
 class TcpSession {
 public:
     static const int kDefaultBufferSize = 4 * 1024;
+    // Largest size to which read buffers grow when reads fill them
+    static const int kMaxReadBufferSize = 64 * 1024;
+    // Number of consecutive reads using less than a quarter of the read
+    // buffer after which its size is halved
+    static const int kShrinkReads = 16;
 
     enum Event {
         EVENT_NONE,
@@ -54,6 +59,8 @@ public:
     typedef boost::asio::ip::tcp::endpoint Endpoint;
     typedef boost::function<void(TcpSession *, Event)> EventObserver;
     typedef boost::asio::const_buffer Buffer;
+    typedef TcpMessageWriter::SharedBuffer SharedBuffer;
+    typedef TcpMessageWriter::BufferChain BufferChain;
 
     // TcpSession constructor takes ownership of socket.
     TcpSession(TcpServer *server, Socket *socket,
@@ -61,6 +68,12 @@ public:
     // Performs a non-blocking send operation.
     virtual bool Send(const u_int8_t *data, size_t size, size_t *sent);
 
+    // Performs a non-blocking send of a chain of immutable buffers, which
+    // are queued by reference rather than copied if the socket is not
+    // ready for write. The buffers may be shared with other sessions.
+    // Sessions that override either Send need to override both.
+    virtual bool Send(const BufferChain &chain, size_t *sent);
+
     // Called by TcpServer to trigger async read.
     virtual bool Connected(Endpoint remote);
 
@@ -73,8 +86,19 @@ public:
 
     virtual std::string ToString() const { return name_; }
 
+    // Sets the minimum size of the read buffers.
     void SetBufferSize(int buffer_size);
 
+    // Size of the next read buffer, which adapts to the observed reads
+    // and message sizes, between the minimum size and kMaxReadBufferSize.
+    int read_buffer_size() const {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return read_buffer_size_;
+    }
+
+    // Grow the read buffers so that a message of size bytes fits in one.
+    void ReserveReadBufferSize(int size);
+
     // Getters and setters
     virtual Socket *socket() const { return socket_.get(); }
     int sock_descriptor() { return socket_->native_handle(); }
@@ -162,6 +186,9 @@ protected:
                                  size_t size);
     static void AsyncWriteHandler(TcpSessionPtr session,
                                   const boost::system::error_code &error);
+    static void AsyncWriteBuffersHandler(TcpSessionPtr session,
+                                         BufferChain chain,
+                                         const boost::system::error_code &error);
 
     // returns true if Processing done, used by SslSession to do actual
     // synchronous read for data.
@@ -183,6 +210,10 @@ protected:
     virtual std::size_t WriteSome(const uint8_t *data, std::size_t len,
                                   boost::system::error_code &error);
     virtual void AsyncWrite(const u_int8_t *data, std::size_t size);
+    virtual std::size_t WriteSomeBuffers(
+        const std::vector<boost::asio::const_buffer> &buffers,
+        boost::system::error_code &error);
+    virtual void AsyncWriteBuffers(const BufferChain &chain);
 
     virtual int reader_task_id() const {
         return reader_task_id_;
@@ -195,12 +226,18 @@ protected:
     void CloseInternal(const boost::system::error_code &ec,
                        bool call_observer, bool notify_server = true);
 
+    void UpdateReadBufferSizeLocked(size_t bytes_transferred,
+                                    size_t buffer_size);
+
+    void set_io_service(boost::asio::io_service *io_service);
+
     // Protects session state and buffer queue.
     mutable tbb::mutex mutex_;
 
 private:
     class Reader;
     friend class TcpServer;
+    friend class TcpMessageReader;
     friend class TcpMessageWriter;
     friend void intrusive_ptr_add_ref(TcpSession *session);
     friend void intrusive_ptr_release(TcpSession *session);
@@ -239,6 +276,8 @@ private:
     Direction direction_;       // direction (active, passive)
     BufferQueue buffer_queue_;
     boost::system::error_code close_reason_;
+    int read_buffer_size_;
+    int small_reads_;
     /**************** end protected by mutex_ ****************/
 
     // Protects observer manipulation and invocation. When this lock is
@@ -298,11 +337,19 @@ private:
 
     int AllocBufferSize(int length);
 
+    // Returns the reassembly buffer, after growing it to size bytes.
+    uint8_t *ReassemblyBuffer(int size);
+    void ReleaseReassemblyBuffer();
+
     TcpSession *session_;
     ReceiveCallback callback_;
     BufferQueue queue_;
     int offset_;
     int remain_;
+    // Buffer from the server buffer pool, kept across messages, into which
+    // messages spanning several read buffers are copied
+    uint8_t *reassembly_;
+    size_t reassembly_size_;
 
     DISALLOW_COPY_AND_ASSIGN(TcpMessageReader);
 };
@@ -2,6 +2,13 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <set>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
 #include "base/test/task_test_util.h"
 #include "io/test/event_manager_test.h"
 #include "testing/gunit.h"
@@ -39,6 +46,59 @@ TEST_F(EventManagerDeathTest, RunOnce) {
         ::testing::KilledBySignal(SIGABRT), ".*RunOnce.*");
 }
 
+static void RecordThread(tbb::mutex *mutex, std::set<pthread_t> *threads,
+                         tbb::atomic<int> *count) {
+    tbb::mutex::scoped_lock lock(*mutex);
+    threads->insert(pthread_self());
+    (*count)++;
+}
+
+// Without io threads, sessions are run on the main io_service.
+TEST(EventManagerPoolTest, NoIoThreads) {
+    EventManager evm;
+    EXPECT_EQ(0, evm.io_thread_count());
+    EXPECT_EQ(evm.io_service(), evm.AssignIoService());
+    EXPECT_EQ(evm.io_service(), evm.AssignIoService());
+}
+
+// The io_services of the pool are assigned in round-robin order, and each
+// one is run by its own thread, without calling Run.
+TEST(EventManagerPoolTest, IoThreads) {
+    EventManager evm(4);
+    EXPECT_EQ(4, evm.io_thread_count());
+
+    std::vector<boost::asio::io_service *> services;
+    for (int i = 0; i < 8; i++) {
+        services.push_back(evm.AssignIoService());
+        EXPECT_NE(evm.io_service(), services.back());
+    }
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(services[i], services[i + 4]);
+        for (int j = i + 1; j < 4; j++) {
+            EXPECT_NE(services[i], services[j]);
+        }
+    }
+
+    tbb::mutex mutex;
+    std::set<pthread_t> threads;
+    tbb::atomic<int> count;
+    count = 0;
+    for (int i = 0; i < 4; i++) {
+        services[i]->post(boost::bind(&RecordThread, &mutex, &threads,
+                                      &count));
+    }
+    TASK_UTIL_EXPECT_EQ(4, count);
+    EXPECT_EQ(4, threads.size());
+    EXPECT_TRUE(threads.find(pthread_self()) == threads.end());
+
+    // Shutdown stops the io threads, so that handlers posted afterwards
+    // are not run
+    evm.Shutdown();
+    services[0]->post(boost::bind(&RecordThread, &mutex, &threads, &count));
+    usleep(10000);
+    EXPECT_EQ(4, count);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     ::testing::FLAGS_gtest_death_test_style = "threadsafe";
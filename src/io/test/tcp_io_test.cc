@@ -362,6 +362,74 @@ TEST_F(EchoServerTest, DeferRead) {
     EXPECT_NE("00:00:00", rx_stats1.blocked_duration);
 }
 
+// Chains of shared buffers are sent with gather writes, and queued by
+// reference when the socket is not ready for write.
+TEST_F(EchoServerTest, SendChain) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(client_->GetSession()->IsEstablished());
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+
+    TcpSession::SharedBuffer body(new string(4096, 'b'));
+    TcpSession::BufferChain chain;
+    chain.push_back(TcpSession::SharedBuffer(new string("header")));
+    chain.push_back(body);
+    size_t len = 6 + body->size();
+
+    size_t sent = 0;
+    EXPECT_TRUE(client_->GetSession()->Send(chain, &sent));
+    EXPECT_EQ(len, sent);
+    TASK_UTIL_ASSERT_EQ(len, server_->GetSession()->GetTotal());
+    server_->GetSession()->ResetTotal();
+
+    // Block the receiver, so that chains are queued
+    server_->GetSession()->SetDeferReader(true);
+    int total = 0;
+    bool res = true;
+    while (res) {
+        res = client_->GetSession()->Send(chain, &sent);
+        total += len;
+    }
+    for (int i = 0; i < 5; i++) {
+        res = client_->GetSession()->Send(chain, &sent);
+        EXPECT_FALSE(res);
+        EXPECT_EQ(0, sent);
+        total += len;
+    }
+    server_->GetSession()->SetDeferReader(false);
+    TASK_UTIL_ASSERT_EQ(total, server_->GetSession()->GetTotal());
+
+    // Nothing was copied, and the queued chains were flushed with fewer
+    // system calls than buffers
+    const io::SocketStats &stats = client_->GetSession()->GetSocketStats();
+    EXPECT_EQ(0, stats.write_bytes_copied);
+    EXPECT_LT(stats.write_syscalls, 2 * stats.write_calls);
+    SocketIOStats tx_stats;
+    client_->GetSession()->GetTxSocketStats(tx_stats);
+    EXPECT_EQ(len + total, tx_stats.bytes);
+    EXPECT_EQ(stats.write_syscalls, tx_stats.syscalls);
+    EXPECT_EQ(0, tx_stats.bytes_copied);
+
+    // A partial send of contiguous data copies the unsent tail
+    char msg[4096];
+    memset(msg, 0xcd, sizeof(msg));
+    server_->GetSession()->SetDeferReader(true);
+    res = true;
+    while (res) {
+        res = client_->Send((const u_int8_t *) msg, sizeof(msg), &sent);
+    }
+    EXPECT_LT(0, stats.write_bytes_copied);
+    server_->GetSession()->SetDeferReader(false);
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <tbb/atomic.h>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+#include "io/test/event_manager_test.h"
+
+using namespace std;
+
+//
+// Aggregate read throughput of a server with thousands of loopback
+// sessions, for different sizes of the io thread pool of its event
+// manager.
+//
+static const int kSessions = 2048;
+static const int kWriters = 4;
+static const int kMessages = 32;
+static const size_t kMessageSize = 1024;
+
+// Sessions that fit in the file descriptor limit, with both ends of each
+// session in this process
+static int max_sessions_ = kSessions;
+
+namespace {
+
+class CountingServer;
+
+class CountingSession : public TcpSession {
+public:
+    CountingSession(CountingServer *server, Socket *socket);
+
+protected:
+    virtual void OnRead(Buffer buffer);
+
+private:
+    CountingServer *server_;
+};
+
+class CountingServer : public TcpServer {
+public:
+    explicit CountingServer(EventManager *evm) : TcpServer(evm) {
+        rx_bytes_ = 0;
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new CountingSession(this, socket);
+    }
+
+    void AddRxBytes(size_t bytes) { rx_bytes_ += bytes; }
+    uint64_t rx_bytes() const { return rx_bytes_; }
+
+private:
+    tbb::atomic<uint64_t> rx_bytes_;
+};
+
+CountingSession::CountingSession(CountingServer *server, Socket *socket)
+    : TcpSession(server, socket), server_(server) {
+}
+
+void CountingSession::OnRead(Buffer buffer) {
+    server_->AddRxBytes(BufferSize(buffer));
+    ReleaseBuffer(buffer);
+}
+
+// Writes kMessages messages to each of a range of client sockets, one
+// message per socket at a time.
+class Writer {
+public:
+    Writer(const vector<int> &fds, size_t begin, size_t end)
+        : fds_(fds), begin_(begin), end_(end) {
+    }
+
+    void Start() {
+        int res = pthread_create(&thread_id_, NULL, &Run, this);
+        assert(res == 0);
+    }
+
+    void Join() {
+        int res = pthread_join(thread_id_, NULL);
+        assert(res == 0);
+    }
+
+private:
+    static void *Run(void *arg) {
+        Writer *writer = reinterpret_cast<Writer *>(arg);
+        char msg[kMessageSize];
+        memset(msg, 0x5a, sizeof(msg));
+        for (int i = 0; i < kMessages; i++) {
+            for (size_t j = writer->begin_; j < writer->end_; j++) {
+                size_t sent = 0;
+                while (sent < sizeof(msg)) {
+                    ssize_t res = write(writer->fds_[j], msg + sent,
+                                        sizeof(msg) - sent);
+                    assert(res > 0);
+                    sent += res;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    const vector<int> &fds_;
+    size_t begin_;
+    size_t end_;
+    pthread_t thread_id_;
+};
+
+class TcpPoolTest : public ::testing::TestWithParam<int> {
+protected:
+    virtual void SetUp() {
+        evm_.reset(new EventManager(GetParam()));
+        server_ = new CountingServer(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+        ASSERT_TRUE(server_->Initialize(0));
+        thread_->Start();
+    }
+
+    virtual void TearDown() {
+        for (size_t i = 0; i < fds_.size(); i++) {
+            close(fds_[i]);
+        }
+        server_->Shutdown();
+        server_->ClearSessions();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server_);
+        server_ = NULL;
+        evm_->Shutdown();
+        thread_->Join();
+        task_util::WaitForIdle();
+    }
+
+    // Connect the clients in groups no larger than the listen backlog,
+    // waiting for the server to accept each group.
+    void Connect(int count) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(server_->GetPort());
+        for (int i = 0; i < count; i++) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            ASSERT_LE(0, fd);
+            ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                                 sizeof(addr)));
+            fds_.push_back(fd);
+            if (fds_.size() % 64 == 0) {
+                TASK_UTIL_ASSERT_EQ(fds_.size(), server_->GetSessionCount());
+            }
+        }
+        TASK_UTIL_ASSERT_EQ(fds_.size(), server_->GetSessionCount());
+    }
+
+    auto_ptr<EventManager> evm_;
+    CountingServer *server_;
+    auto_ptr<ServerThread> thread_;
+    vector<int> fds_;
+};
+
+TEST_P(TcpPoolTest, ReadThroughput) {
+    Connect(max_sessions_);
+    uint64_t total = static_cast<uint64_t>(fds_.size()) * kMessages *
+        kMessageSize;
+
+    uint64_t start = UTCTimestampUsec();
+    vector<Writer *> writers;
+    for (int i = 0; i < kWriters; i++) {
+        writers.push_back(new Writer(fds_, fds_.size() * i / kWriters,
+                                     fds_.size() * (i + 1) / kWriters));
+        writers.back()->Start();
+    }
+    TASK_UTIL_EXPECT_EQ(total, server_->rx_bytes());
+    uint64_t usecs = UTCTimestampUsec() - start;
+    for (int i = 0; i < kWriters; i++) {
+        writers[i]->Join();
+        delete writers[i];
+    }
+
+    std::cout << "io threads " << GetParam() << ": " << fds_.size()
+              << " sessions, " << total / (1024 * 1024) << " MB in "
+              << usecs / 1000 << " msec, "
+              << (usecs ? total / usecs : 0) << " MB/s" << std::endl;
+}
+
+INSTANTIATE_TEST_CASE_P(IoThreads, TcpPoolTest,
+                        ::testing::Values(0, 1, 2, 4, 8));
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+
+    // Both ends of every session are open in this process
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur != RLIM_INFINITY &&
+            limit.rlim_cur < 2 * kSessions + 64) {
+            max_sessions_ = (limit.rlim_cur - 64) / 2;
+        }
+    }
+
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <boost/bind.hpp>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/parse_object.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "io/buffer_pool.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+
+using namespace std;
+
+namespace {
+
+//
+// Messages with a 4 byte length header, a little larger than the default
+// read buffer size, as sent by large XMPP or BGP updates.
+//
+static const int kHeaderLenSize = 4;
+static const int kMaxMessageSize = 64 * 1024;
+static const size_t kMessageSize = 6000;
+static const int kMessages = 4096;
+
+class LengthReader : public TcpMessageReader {
+public:
+    LengthReader(TcpSession *session, ReceiveCallback callback)
+        : TcpMessageReader(session, callback) {
+    }
+
+    virtual const int GetHeaderLenSize() { return kHeaderLenSize; }
+    virtual const int GetMaxMessageSize() { return kMaxMessageSize; }
+
+    virtual int MsgLength(Buffer buffer, int offset) {
+        size_t size = TcpSession::BufferSize(buffer);
+        if ((int) size - offset < kHeaderLenSize) {
+            return -1;
+        }
+        return get_value(TcpSession::BufferData(buffer) + offset,
+                         kHeaderLenSize);
+    }
+};
+
+class ReaderSession : public TcpSession {
+public:
+    ReaderSession(TcpServer *server, Socket *socket)
+        : TcpSession(server, socket),
+          reader_(new LengthReader(this,
+              boost::bind(&ReaderSession::ReceiveMsg, this, _1, _2))),
+          messages_(0) {
+    }
+
+    // Simulates the completion of a read of bytes_transferred bytes from
+    // the socket into a read buffer of buffer_size bytes.
+    void ReadDone(size_t bytes_transferred, size_t buffer_size) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        UpdateReadBufferSizeLocked(bytes_transferred, buffer_size);
+    }
+
+    void Read(const uint8_t *data, size_t bytes_transferred,
+              size_t buffer_size) {
+        ReadDone(bytes_transferred, buffer_size);
+        OnRead(Buffer(data, bytes_transferred));
+    }
+
+    // The buffers passed to Read are owned by the test.
+    virtual void ReleaseBuffer(Buffer buffer) {
+    }
+
+    int messages() const { return messages_; }
+
+protected:
+    virtual void OnRead(Buffer buffer) {
+        reader_->OnRead(buffer);
+    }
+
+private:
+    bool ReceiveMsg(const uint8_t *msg, size_t size) {
+        if (size == kMessageSize) {
+            messages_++;
+        }
+        return true;
+    }
+
+    auto_ptr<LengthReader> reader_;
+    int messages_;
+};
+
+class ReaderServer : public TcpServer {
+public:
+    explicit ReaderServer(EventManager *evm) : TcpServer(evm) {
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new ReaderSession(this, socket);
+    }
+};
+
+class BufferPoolTest : public ::testing::Test {
+protected:
+    BufferPool pool_;
+};
+
+TEST_F(BufferPoolTest, SizeClasses) {
+    size_t size;
+    uint8_t *data = pool_.Allocate(1, &size);
+    EXPECT_EQ(BufferPool::kMinBufferSize, size);
+    pool_.Release(data, size);
+
+    data = pool_.Allocate(4097, &size);
+    EXPECT_EQ(8192, size);
+    pool_.Release(data, size);
+
+    data = pool_.Allocate(BufferPool::kMaxBufferSize, &size);
+    EXPECT_EQ(BufferPool::kMaxBufferSize, size);
+    pool_.Release(data, size);
+    EXPECT_EQ(3, pool_.cached());
+}
+
+TEST_F(BufferPoolTest, Reuse) {
+    size_t size;
+    uint8_t *data = pool_.Allocate(4096, &size);
+    pool_.Release(data, size);
+    EXPECT_EQ(0, pool_.hits());
+
+    size_t size2;
+    uint8_t *data2 = pool_.Allocate(3000, &size2);
+    EXPECT_EQ(data, data2);
+    EXPECT_EQ(size, size2);
+    EXPECT_EQ(1, pool_.hits());
+    EXPECT_EQ(0, pool_.cached());
+    pool_.Release(data2, size2);
+    EXPECT_EQ(2, pool_.allocations());
+}
+
+TEST_F(BufferPoolTest, LargeBuffersNotCached) {
+    size_t size;
+    uint8_t *data = pool_.Allocate(BufferPool::kMaxBufferSize + 1, &size);
+    EXPECT_LT(BufferPool::kMaxBufferSize, size);
+    pool_.Release(data, size);
+    EXPECT_EQ(0, pool_.cached());
+}
+
+TEST_F(BufferPoolTest, MaxCachedBuffers) {
+    vector<uint8_t *> buffers;
+    size_t size;
+    for (size_t i = 0; i < BufferPool::kMaxCachedBuffers + 8; i++) {
+        buffers.push_back(pool_.Allocate(1024, &size));
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        pool_.Release(buffers[i], size);
+    }
+    EXPECT_EQ(BufferPool::kMaxCachedBuffers, pool_.cached());
+}
+
+class TcpReaderTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        evm_.reset(new EventManager());
+        server_ = new ReaderServer(evm_.get());
+        session_ = static_cast<ReaderSession *>(server_->CreateSession());
+
+        // A stream of back to back messages
+        for (int i = 0; i < kMessages; i++) {
+            uint8_t header[kHeaderLenSize];
+            put_value(header, kHeaderLenSize, kMessageSize);
+            stream_.append(reinterpret_cast<char *>(header), kHeaderLenSize);
+            stream_.append(kMessageSize - kHeaderLenSize, 'm');
+        }
+    }
+
+    virtual void TearDown() {
+        session_->Close();
+        server_->DeleteSession(session_);
+        server_->Shutdown();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server_);
+        server_ = NULL;
+        evm_->Shutdown();
+        task_util::WaitForIdle();
+    }
+
+    // Feed the stream to the session in reads of the size of its read
+    // buffer, as when the socket always has more data available.
+    uint64_t ReadStream(bool adaptive) {
+        const uint8_t *data =
+            reinterpret_cast<const uint8_t *>(stream_.data());
+        uint64_t start = UTCTimestampUsec();
+        for (size_t offset = 0; offset < stream_.size(); ) {
+            size_t buffer_size = adaptive ?
+                session_->read_buffer_size() : TcpSession::kDefaultBufferSize;
+            size_t bytes = min(buffer_size, stream_.size() - offset);
+            session_->Read(data + offset, bytes, buffer_size);
+            offset += bytes;
+        }
+        return UTCTimestampUsec() - start;
+    }
+
+    void Report(const string &name, uint64_t usecs) {
+        const io::SocketStats &stats = session_->GetSocketStats();
+        std::cout << name << ": " << kMessages << " messages of "
+                  << kMessageSize << " bytes in " << usecs << " usec, "
+                  << stats.read_reassemblies << " reassembled, "
+                  << stats.read_reassembly_bytes << " bytes copied, "
+                  << server_->buffer_pool()->allocations()
+                  << " pool allocations" << std::endl;
+    }
+
+    auto_ptr<EventManager> evm_;
+    ReaderServer *server_;
+    ReaderSession *session_;
+    string stream_;
+};
+
+TEST_F(TcpReaderTest, AdaptGrow) {
+    EXPECT_EQ(TcpSession::kDefaultBufferSize, session_->read_buffer_size());
+    int size = session_->read_buffer_size();
+    while (size < TcpSession::kMaxReadBufferSize) {
+        session_->ReadDone(size, size);
+        EXPECT_EQ(size * 2, session_->read_buffer_size());
+        size *= 2;
+    }
+    session_->ReadDone(size, size);
+    EXPECT_EQ(TcpSession::kMaxReadBufferSize, session_->read_buffer_size());
+}
+
+TEST_F(TcpReaderTest, AdaptShrink) {
+    session_->ReserveReadBufferSize(16 * 1024);
+    EXPECT_EQ(16 * 1024, session_->read_buffer_size());
+
+    // Reads using more than a quarter of the buffer keep its size.
+    for (int i = 0; i < 2 * TcpSession::kShrinkReads; i++) {
+        session_->ReadDone(8 * 1024, 16 * 1024);
+    }
+    EXPECT_EQ(16 * 1024, session_->read_buffer_size());
+
+    for (int i = 0; i < TcpSession::kShrinkReads - 1; i++) {
+        session_->ReadDone(1, 16 * 1024);
+    }
+    EXPECT_EQ(16 * 1024, session_->read_buffer_size());
+    session_->ReadDone(1, 16 * 1024);
+    EXPECT_EQ(8 * 1024, session_->read_buffer_size());
+
+    // Never below the minimum buffer size.
+    for (int i = 0; i < 4 * TcpSession::kShrinkReads; i++) {
+        session_->ReadDone(1, session_->read_buffer_size());
+    }
+    EXPECT_EQ(TcpSession::kDefaultBufferSize, session_->read_buffer_size());
+}
+
+TEST_F(TcpReaderTest, ReserveForMessage) {
+    // A header announcing a message larger than the read buffer grows the
+    // buffer for the rest of the message.
+    uint8_t data[kHeaderLenSize + 16];
+    put_value(data, kHeaderLenSize, 20000);
+    session_->Read(data, sizeof(data), TcpSession::kDefaultBufferSize);
+    EXPECT_LE(20000 - (int) sizeof(data), session_->read_buffer_size());
+}
+
+TEST_F(TcpReaderTest, FixedReads) {
+    uint64_t usecs = ReadStream(false);
+    EXPECT_EQ(kMessages, session_->messages());
+    Report("Fixed 4KB reads", usecs);
+    const io::SocketStats &stats = session_->GetSocketStats();
+    EXPECT_EQ(kMessages, stats.read_reassemblies);
+}
+
+TEST_F(TcpReaderTest, AdaptiveReads) {
+    uint64_t usecs = ReadStream(true);
+    EXPECT_EQ(kMessages, session_->messages());
+    Report("Adaptive reads", usecs);
+    const io::SocketStats &stats = session_->GetSocketStats();
+    EXPECT_GT(kMessages / 4, stats.read_reassemblies);
+    EXPECT_EQ(TcpSession::kMaxReadBufferSize, session_->read_buffer_size());
+
+    // The reassembly buffer is reused across messages.
+    EXPECT_GT(8, server_->buffer_pool()->allocations());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/task.h"
+#include "base/time_util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+#include "io/test/event_manager_test.h"
+
+using namespace std;
+
+//
+// Send 1GB of a payload shared by 100 loopback sessions, each message
+// made of a header specific to the session followed by the shared body,
+// either as a contiguous copy of the message per session or as a chain of
+// shared buffers.
+//
+static const int kSessions = 100;
+static const size_t kBodySize = 64 * 1024;
+static const uint64_t kTotalBytes = 1024ULL * 1024 * 1024;
+static const int kMessages = kTotalBytes / kSessions / kBodySize;
+
+namespace {
+
+class SendServer;
+
+class SendSession : public TcpSession {
+public:
+    SendSession(SendServer *server, Socket *socket);
+
+    // Writes are ready when the session is established and after the
+    // writer queue was flushed.
+    bool write_ready() const { return write_ready_; }
+    void set_write_ready(bool ready) { write_ready_ = ready; }
+
+protected:
+    virtual void OnRead(Buffer buffer);
+    virtual void WriteReady(const boost::system::error_code &error) {
+        write_ready_ = true;
+    }
+
+private:
+    SendServer *server_;
+    tbb::atomic<bool> write_ready_;
+};
+
+class SendServer : public TcpServer {
+public:
+    explicit SendServer(EventManager *evm) : TcpServer(evm) {
+        rx_bytes_ = 0;
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new SendSession(this, socket);
+    }
+
+    void AddRxBytes(size_t bytes) { rx_bytes_ += bytes; }
+    uint64_t rx_bytes() const { return rx_bytes_; }
+
+private:
+    tbb::atomic<uint64_t> rx_bytes_;
+};
+
+SendSession::SendSession(SendServer *server, Socket *socket)
+    : TcpSession(server, socket), server_(server) {
+    write_ready_ = true;
+}
+
+void SendSession::OnRead(Buffer buffer) {
+    server_->AddRxBytes(BufferSize(buffer));
+    ReleaseBuffer(buffer);
+}
+
+class TcpSendTest : public ::testing::TestWithParam<bool> {
+protected:
+    virtual void SetUp() {
+        evm_.reset(new EventManager());
+        server_ = new SendServer(evm_.get());
+        client_ = new SendServer(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+        ASSERT_TRUE(server_->Initialize(0));
+        thread_->Start();
+    }
+
+    virtual void TearDown() {
+        server_->Shutdown();
+        server_->ClearSessions();
+        client_->ClearSessions();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server_);
+        server_ = NULL;
+        TcpServerManager::DeleteServer(client_);
+        client_ = NULL;
+        evm_->Shutdown();
+        thread_->Join();
+        task_util::WaitForIdle();
+    }
+
+    void Connect() {
+        boost::asio::ip::tcp::endpoint endpoint(
+            boost::asio::ip::address::from_string("127.0.0.1"),
+            server_->GetPort());
+        for (int i = 0; i < kSessions; i++) {
+            SendSession *session =
+                static_cast<SendSession *>(client_->CreateSession());
+            client_->Connect(session, endpoint);
+            sessions_.push_back(session);
+        }
+        for (int i = 0; i < kSessions; i++) {
+            TASK_UTIL_ASSERT_TRUE(sessions_[i]->IsEstablished());
+        }
+        TASK_UTIL_ASSERT_EQ(kSessions, server_->GetSessionCount());
+    }
+
+    auto_ptr<EventManager> evm_;
+    SendServer *server_;
+    SendServer *client_;
+    auto_ptr<ServerThread> thread_;
+    vector<SendSession *> sessions_;
+};
+
+TEST_P(TcpSendTest, SharedPayload) {
+    bool shared = GetParam();
+    Connect();
+
+    TcpSession::SharedBuffer body(new string(kBodySize, 'b'));
+    vector<TcpSession::SharedBuffer> headers;
+    for (int i = 0; i < kSessions; i++) {
+        headers.push_back(TcpSession::SharedBuffer(
+            new string("<message to=\"agent-" + integerToString(i) + "\">")));
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < kSessions; i++) {
+        total += (headers[i]->size() + body->size()) * kMessages;
+    }
+
+    // Send the messages to the sessions in turn, skipping the ones whose
+    // writes are blocked until they are ready again.
+    uint64_t start = UTCTimestampUsec();
+    vector<int> sent(kSessions, 0);
+    int done = 0;
+    while (done < kSessions) {
+        bool progress = false;
+        for (int i = 0; i < kSessions; i++) {
+            SendSession *session = sessions_[i];
+            if (sent[i] == kMessages || !session->write_ready()) {
+                continue;
+            }
+            session->set_write_ready(false);
+            bool ready;
+            if (shared) {
+                TcpSession::BufferChain chain;
+                chain.push_back(headers[i]);
+                chain.push_back(body);
+                ready = session->Send(chain, NULL);
+            } else {
+                string msg(*headers[i] + *body);
+                ready = session->Send(
+                    reinterpret_cast<const uint8_t *>(msg.data()),
+                    msg.size(), NULL);
+            }
+            if (ready) {
+                session->set_write_ready(true);
+            }
+            if (++sent[i] == kMessages) {
+                done++;
+            }
+            progress = true;
+        }
+        if (!progress) {
+            usleep(100);
+        }
+    }
+    TASK_UTIL_EXPECT_EQ(total, server_->rx_bytes());
+    uint64_t usecs = UTCTimestampUsec() - start;
+
+    const io::SocketStats &stats = client_->GetSocketStats();
+    std::cout << (shared ? "Shared buffer chains" : "Contiguous copies")
+              << ": " << total / (1024 * 1024) << " MB to " << kSessions
+              << " sessions in " << usecs / 1000 << " msec, "
+              << stats.write_syscalls << " write system calls, "
+              << stats.write_bytes_copied << " bytes copied" << std::endl;
+    if (shared) {
+        EXPECT_EQ(0, stats.write_bytes_copied);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Send, TcpSendTest, ::testing::Bool());
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
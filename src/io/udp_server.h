@@ -56,6 +56,7 @@ class UdpServer {
 
  protected:
     EventManager *event_manager() { return evm_; }
+    boost::asio::ip::udp::socket *socket() { return &socket_; }
     virtual bool DisableSandeshLogMessages() { return false; }
     virtual std::string ToString() { return name_; }
     virtual void HandleReceive(
@@ -81,6 +81,8 @@ public:
         uint64_t time_period;
         string table;
         uint32_t max_rows;
+        // Stop fetching chunks once this many rows have been accumulated
+        uint32_t row_limit;
         tbb::atomic<uint32_t> chunk_q;
         tbb::atomic<uint32_t> total_rows;
     };
@@ -331,6 +333,11 @@ public:
                     cinp.total_rows << " chunk " << cinp.chunk_q);
                 return NULL;
             }
+            if (inp.row_limit && cinp.total_rows >= inp.row_limit) {
+                QE_LOG_NOQID(DEBUG,  "QueryExec Limit Reached " <<
+                    cinp.total_rows << " chunk " << cinp.chunk_q);
+                return NULL;
+            }
             uint32_t chunknum = cinp.chunk_q.fetch_and_increment(); 
             if (chunknum < inp.chunk_size.size()) {
                 string key = "QUERY:" + res.inp.qp.qid;
@@ -767,9 +774,10 @@ public:
         string select;
         string post;
         uint64_t time_period;
+        uint32_t row_limit;
 
         int ret = qosp_->qe_->QueryPrepare(qp, chunk_size, need_merge, map_output,
-            where, select, post, time_period, table);
+            where, select, post, time_period, row_limit, table);
 
         qs.set_where(where);
         qs.set_select(select);
@@ -818,6 +826,7 @@ public:
         inp.get()->chunk_q = 0;
         inp.get()->total_rows = 0;
         inp.get()->max_rows = max_rows_;
+        inp.get()->row_limit = row_limit;
         
 
         vector<pair<int,int> > tinfo;
@@ -31,6 +31,9 @@ query_status_t DbQueryUnit::process_query()
     GenDb::ColListVec mget_res;   // vector of result for each row
     for (uint32_t t2 = t2_start; t2 <= t2_end; t2++)
     {
+        if (t2_restricted && t2_list.find(t2) == t2_list.end()) {
+            continue;
+        }
         GenDb::ColList result;
         GenDb::DbDataValueVec rowkey;
 
@@ -53,7 +56,9 @@ query_status_t DbQueryUnit::process_query()
         keys.push_back(rowkey);
     }
 
-    if (!m_query->dbif->Db_GetMultiRow(mget_res, cfname, keys, &cr)) {
+    QE_TRACE(DEBUG, " Reading " << keys.size() << " partitions");
+    if (!keys.empty() &&
+        !m_query->dbif->Db_GetMultiRow(mget_res, cfname, keys, &cr)) {
         std::stringstream tempstr;
         for (size_t i = 0; i < cr.start_.size(); i++)
             tempstr << "cr_s(" << i << "): " << cr.start_.at(i) << ", ";
@@ -124,6 +124,13 @@ void Options::Initialize(EventManager &evm,
              "Max number of rows in chunk slice")
         ("DEFAULT.max_tasks", opt::value<int>()->default_value(0),
              "Max number of tasks used for a query")
+        ("DEFAULT.query_cache_size", opt::value<uint32_t>()->default_value(64),
+             "Size of the query chunk result cache in MB, 0 to disable")
+        ("DEFAULT.query_cache_ttl", opt::value<uint32_t>()->default_value(300),
+             "Seconds a cached query chunk result is reused for")
+        ("DEFAULT.partition_filter", opt::bool_switch(&partition_filter_),
+             "Skip index partitions using the partition filters, only when "
+             "all the collectors write them")
         ("DEFAULT.start_time", opt::value<uint64_t>()->default_value(0),
              "Lowest start time for queries")
 
@@ -248,6 +255,9 @@ void Options::Process(int argc, char *argv[],
     GetOptValue<uint64_t>(var_map, start_time_, "DEFAULT.start_time");
     GetOptValue<int>(var_map, max_tasks_, "DEFAULT.max_tasks");
     GetOptValue<int>(var_map, max_slice_, "DEFAULT.max_slice");
+    GetOptValue<uint32_t>(var_map, query_cache_size_,
+                          "DEFAULT.query_cache_size");
+    GetOptValue<uint32_t>(var_map, query_cache_ttl_, "DEFAULT.query_cache_ttl");
     GetOptValue<uint32_t>(var_map, send_ratelimit_,
                               "DEFAULT.sandesh_send_rate_limit");
 
@@ -33,6 +33,9 @@ public:
     const uint64_t start_time() const { return start_time_; }
     const int max_tasks() const { return max_tasks_; }
     const int max_slice() const { return max_slice_; }
+    const uint32_t query_cache_size() const { return query_cache_size_; }
+    const uint32_t query_cache_ttl() const { return query_cache_ttl_; }
+    const bool partition_filter() const { return partition_filter_; }
     const std::string log_category() const { return log_category_; }
     const std::string log_property_file() const { return log_property_file_; }
     const bool log_disable() const { return log_disable_; }
@@ -89,6 +92,9 @@ private:
     uint64_t start_time_;
     int max_tasks_;
     int max_slice_;
+    uint32_t query_cache_size_;
+    uint32_t query_cache_ttl_;
+    bool partition_filter_;
     bool test_mode_;
     int analytics_data_ttl_;
     uint32_t send_ratelimit_;
@@ -7,6 +7,7 @@
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 #include "query.h"
+#include "sort_keys.h"
 
 using boost::assign::map_list_of;
 
@@ -52,6 +53,104 @@ bool PostProcessingQuery::sort_field_comparator(
     return false;
 }
 
+// Sort the result rows on the sort fields. The sort fields are extracted
+// once per row into typed keys, and the rows are then moved into place
+// following the computed order, instead of comparing the row maps directly.
+void PostProcessingQuery::sort_result(QEOpServerProxy::BufferT *result) {
+    SortKeys::Schema schema;
+    for (std::vector<sort_field_t>::const_iterator it = sort_fields.begin();
+         it != sort_fields.end(); ++it) {
+        schema.push_back(SortKeys::ColumnSpec(it->name,
+            SortKeys::TypeFromString(it->type)));
+    }
+    SortKeys keys(schema);
+    keys.Reserve(result->size());
+    for (QEOpServerProxy::BufferT::const_iterator it = result->begin();
+         it != result->end(); ++it) {
+        keys.AppendRow(it->first);
+    }
+    std::vector<size_t> order;
+    keys.SortOrder(sorting_type != ASCENDING, &order);
+
+    QEOpServerProxy::BufferT sorted_result(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        QEOpServerProxy::ResultRowT &row = result->at(order[i]);
+        sorted_result[i].first.swap(row.first);
+        sorted_result[i].second.swap(row.second);
+    }
+    result->swap(sorted_result);
+}
+
+// Orders the cursors of a k-way merge so that the heap top is the cursor
+// pointing to the next row to be emitted.
+class SortedRunCompare {
+public:
+    explicit SortedRunCompare(PostProcessingQuery *query) : query_(query) {
+    }
+
+    bool operator()(const PostProcessingQuery::SortedRunCursor &lhs,
+                    const PostProcessingQuery::SortedRunCursor &rhs) const {
+        const QEOpServerProxy::ResultRowT &lrow = lhs.first->at(lhs.second);
+        const QEOpServerProxy::ResultRowT &rrow = rhs.first->at(rhs.second);
+        if (query_->sorting_type == ASCENDING) {
+            return query_->sort_field_comparator(rrow, lrow);
+        }
+        return query_->sort_field_comparator(lrow, rrow);
+    }
+
+private:
+    PostProcessingQuery *query_;
+};
+
+// Merge results that are already sorted on the sort fields, emitting rows
+// in order until limit rows have been emitted, so that only the rows that
+// make it into the final result are ever copied. If uniquify is set, rows
+// with a flow UUID that has already been emitted are skipped.
+void PostProcessingQuery::sorted_merge(
+        const std::vector<const QEOpServerProxy::BufferT *> &runs,
+        QEOpServerProxy::BufferT *output, bool uniquify) {
+    std::vector<SortedRunCursor> heap;
+    size_t total_rows = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i]->size()) {
+            heap.push_back(SortedRunCursor(runs[i], 0));
+            total_rows += runs[i]->size();
+        }
+    }
+    size_t max_rows = total_rows;
+    if (limit && (size_t)limit < max_rows) {
+        max_rows = limit;
+    }
+    output->reserve(output->size() + max_rows);
+
+    SortedRunCompare compare(this);
+    std::make_heap(heap.begin(), heap.end(), compare);
+    std::set<std::string> uuids;
+    size_t emitted = 0;
+    while (!heap.empty() && emitted < max_rows) {
+        std::pop_heap(heap.begin(), heap.end(), compare);
+        SortedRunCursor &cursor = heap.back();
+        const QEOpServerProxy::ResultRowT &row =
+            cursor.first->at(cursor.second);
+        bool emit = true;
+        if (uniquify) {
+            QEOpServerProxy::OutRowT::const_iterator it =
+                row.first.find(g_viz_constants.UUID_KEY);
+            QE_ASSERT(it != row.first.end());
+            emit = uuids.insert(it->second).second;
+        }
+        if (emit) {
+            output->push_back(row);
+            emitted++;
+        }
+        if (++cursor.second < cursor.first->size()) {
+            std::push_heap(heap.begin(), heap.end(), compare);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
 bool PostProcessingQuery::flowseries_merge_processing(
         const QEOpServerProxy::BufferT *raw_result,
         QEOpServerProxy::BufferT* merged_result, 
@@ -213,25 +312,15 @@ bool PostProcessingQuery::merge_processing(
         const QEOpServerProxy::BufferT *raw_result1 = &(input);
 
         if (result_.get() == NULL) {
-            size_t merged_result_size = merged_result->size();
-            merged_result->reserve(merged_result_size + raw_result1->size());
-            copy(raw_result1->begin(), raw_result1->end(), 
-                 std::back_inserter(*merged_result));
-            if (merged_result_size) { 
-                if (sorting_type == ASCENDING) {
-                    std::inplace_merge(merged_result->begin(), 
-                        merged_result->begin() + merged_result_size,
-                        merged_result->end(),
-                        boost::bind(&PostProcessingQuery::sort_field_comparator, 
-                                    this, _1, _2));
-                } else {
-                    std::inplace_merge(merged_result->rbegin(),
-                        merged_result->rbegin() + raw_result1->size(),
-                        merged_result->rend(),
-                        boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                    this, _1, _2));
-                }
-            }
+            // Both the accumulated result and the chunk result are sorted;
+            // keep at most limit rows in the accumulated result.
+            QEOpServerProxy::BufferT accumulated;
+            accumulated.swap(*merged_result);
+            std::vector<const QEOpServerProxy::BufferT *> runs;
+            runs.push_back(&accumulated);
+            runs.push_back(raw_result1);
+            sorted_merge(runs, merged_result,
+                         mquery->table() == g_viz_constants.FLOW_TABLE);
         } else {
             QEOpServerProxy::BufferT *raw_result2 = result_.get();
             size_t size1 = raw_result1->size();
@@ -329,7 +418,23 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
         }
     }
 
-    if (mquery->table() == g_viz_constants.FLOW_TABLE)
+    // The result of each parallel instance is sorted, merge them in order
+    // and stop as soon as the limit is reached.
+    bool sort_done = false;
+    if (sorted && !merge_done) {
+        QE_TRACE(DEBUG, "Final_Merge_Processing: Merging " << inputs.size()
+                 << " sorted results");
+        std::vector<const QEOpServerProxy::BufferT *> runs;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            runs.push_back(inputs[i].get());
+        }
+        sorted_merge(runs, &output,
+                     mquery->table() == g_viz_constants.FLOW_TABLE);
+        merge_done = true;
+        sort_done = true;
+    }
+
+    if (mquery->table() == g_viz_constants.FLOW_TABLE && !merge_done)
     {
         QE_TRACE(DEBUG, "Final_Merge_Processing: Uniquify flow records");
         // uniquify the records
@@ -370,17 +475,8 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
         }
     }
 
-    if (sorted) {
-        QEOpServerProxy::BufferT *merged_result = &output;
-        if (sorting_type == ASCENDING) {
-            std::sort(merged_result->begin(), merged_result->end(),
-                      boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                  this, _1, _2));
-        } else {
-            std::sort(merged_result->rbegin(), merged_result->rend(),
-                      boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                  this, _1, _2));
-        }
+    if (sorted && !sort_done) {
+        sort_result(&output);
     }
    
     if (limit) {
@@ -396,6 +492,21 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
     return true;
 }
 
+// An unsorted query with a limit is satisfied by any limit rows, provided
+// the merge of the chunk results neither aggregates nor uniquifies rows.
+uint32_t PostProcessingQuery::satisfying_row_count() {
+    AnalyticsQuery *mquery = (AnalyticsQuery *)main_query;
+    if (!limit || sorted) {
+        return 0;
+    }
+    if (mquery->table() == g_viz_constants.FLOW_TABLE ||
+        mquery->table() == g_viz_constants.FLOW_SERIES_TABLE ||
+        mquery->is_stat_table_query(mquery->table())) {
+        return 0;
+    }
+    return limit;
+}
+
 query_status_t PostProcessingQuery::process_query() {
     if (status_details != 0)
     {
@@ -586,15 +697,7 @@ query_status_t PostProcessingQuery::process_query() {
 
     // Check if the result has to be sorted
     if (sorted) {
-        if (sorting_type == ASCENDING) {
-            std::sort(raw_result->begin(), raw_result->end(), 
-                      boost::bind(&PostProcessingQuery::sort_field_comparator, 
-                                  this, _1, _2)); 
-        } else {
-            std::sort(raw_result->rbegin(), raw_result->rend(), 
-                      boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                  this, _1, _2));
-        }
+        sort_result(raw_result);
     }
 
     // If the flow series query is parallelized, we should apply the limit 
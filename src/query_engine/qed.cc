@@ -207,6 +207,8 @@ main(int argc, char *argv[]) {
     LOG(INFO, "Endpoint " << dss_ep);
     LOG(INFO, "Max-tasks " << max_tasks);
     LOG(INFO, "Max-slice " << options.max_slice());
+    LOG(INFO, "Query-cache-size " << options.query_cache_size() << " MB");
+    LOG(INFO, "Partition-filter " << options.partition_filter());
     BOOST_FOREACH(std::string collector_ip, options.collector_server_list()) {
         LOG(INFO, "Collectors  " << collector_ip);
     }
@@ -281,7 +283,10 @@ main(int argc, char *argv[]) {
             max_tasks,
             options.max_slice(),
             options.cassandra_user(),
-            options.cassandra_password()));
+            options.cassandra_password(),
+            options.query_cache_size() * 1024 * 1024,
+            options.query_cache_ttl(),
+            options.partition_filter()));
     } else {
         qe.reset(new QueryEngine(&evm,
             cassandra_ips,
@@ -292,7 +297,10 @@ main(int argc, char *argv[]) {
             max_tasks,
             options.max_slice(),
             options.cassandra_user(),
-            options.cassandra_password()));
+            options.cassandra_password(),
+            options.query_cache_size() * 1024 * 1024,
+            options.query_cache_ttl(),
+            options.partition_filter()));
     }
 
     CpuLoadData::Init();
@@ -31,6 +31,9 @@ using process::ConnectionStatus;
 
 GenDb::GenDbIf* query_result_unit_t::dbif = NULL;
 int QueryEngine::max_slice_ = 100;
+bool QueryEngine::partition_filter_ = false;
+// Result cache of the QueryEngine, for introspect
+static QueryResultCache *query_result_cache;
 
 typedef  std::vector< std::pair<std::string, std::string> > spair_vector;
 static spair_vector query_string_to_column_name(0);
@@ -346,25 +349,26 @@ void AnalyticsQuery::get_query_details(bool& is_merge_needed, bool& is_map_outpu
         std::string& select,
         std::string& post,
         uint64_t& time_period,
+        uint32_t& row_limit,
         int& parse_status)
 {
     QE_TRACE(DEBUG, "time_slice is " << time_slice);
     if (status_details == 0)
     {
-        for (uint64_t chunk_start = original_from_time; 
+        for (uint64_t chunk_start = chunk_base; 
                 chunk_start < original_end_time; chunk_start += time_slice)
         {
-            if ((chunk_start+time_slice) <= original_end_time) {
-                chunk_sizes.push_back(time_slice);
-            } else {
-                chunk_sizes.push_back((original_end_time - chunk_start));
-            }
+            uint64_t chunk_end = std::min(chunk_start + time_slice,
+                                          original_end_time);
+            chunk_sizes.push_back(chunk_end -
+                std::max(chunk_start, original_from_time));
         }
     } else {
         chunk_sizes.push_back(0); // just return some dummy value
     }
 
     time_period = (end_time_ - from_time_) / 1000000;
+    row_limit = 0;
 
     parse_status = status_details;
     if (parse_status != 0) return;
@@ -379,6 +383,7 @@ void AnalyticsQuery::get_query_details(bool& is_merge_needed, bool& is_map_outpu
     select = selectquery_->json_string_;
     post = postprocess_->json_string_;
     is_map_output = is_stat_table_query(table_);
+    row_limit = postprocess_->satisfying_row_count();
 }
 
 bool AnalyticsQuery::can_parallelize_query() {
@@ -582,6 +587,23 @@ void AnalyticsQuery::Init(GenDb::GenDbIf *db_if, std::string qid,
                 time_slice = ((time_slice/selectquery_->granularity)+1)*
                     selectquery_->granularity;
             }
+            // The time samples are relative to the start time
+            chunks_aligned = false;
+        }
+
+        // Round the time_slice down to a power of two multiple of the row
+        // time, and align the slices to multiples of it. Queries over a
+        // sliding time window then share all but their first and last
+        // chunks with the previous run of the query. Rounding down keeps the
+        // slice within smax; the query is then split in up to twice as many
+        // chunks, plus one for the alignment, as total_parallel_batches.
+        if (chunks_aligned) {
+            uint64_t slice = pow(2,g_viz_constants.RowTimeInBits);
+            while ((slice << 1) <= time_slice) {
+                slice <<= 1;
+            }
+            time_slice = slice;
+            chunk_base = original_from_time - (original_from_time % time_slice);
         }
 
         uint8_t fs_query_type = selectquery_->flowseries_query_type();
@@ -600,12 +622,19 @@ void AnalyticsQuery::Init(GenDb::GenDbIf *db_if, std::string qid,
         QE_LOG_GLOBAL(DEBUG, "No parallelization for this query");
         merge_needed = false;
         parallelize_query_ = false;
+        chunks_aligned = false;
         time_slice = end_time_ - from_time_;
     }
+    if (!chunks_aligned) {
+        chunk_base = original_from_time;
+    }
 
     from_time_ = 
-        original_from_time + time_slice*parallel_batch_num;
+        chunk_base + time_slice*parallel_batch_num;
     end_time_ = from_time_ + time_slice;
+    if (from_time_ < original_from_time) {
+        from_time_ = original_from_time;
+    }
     if (from_time_ >= original_end_time)
     {
         processing_needed = false;
@@ -874,7 +903,7 @@ AnalyticsQuery::AnalyticsQuery(std::string qid, std::map<std::string,
         EventManager *evm, std::vector<std::string> cassandra_ips, 
         std::vector<int> cassandra_ports, int batch,
         int total_batches, const std::string& cassandra_user,
-        const std::string& cassandra_password):
+        const std::string& cassandra_password, bool align_chunks):
         QueryUnit(NULL, this),
         dbif_(new ThriftIf(
             boost::bind(&AnalyticsQuery::db_err_handler, this),
@@ -890,6 +919,7 @@ AnalyticsQuery::AnalyticsQuery(std::string qid, std::map<std::string,
         parallel_batch_num(batch),
         total_parallel_batches(total_batches),
         processing_needed(true),
+        chunks_aligned(align_chunks),
         stats_(NULL)
 {
     // Need to do this for logging/tracing with query ids
@@ -964,6 +994,7 @@ AnalyticsQuery::AnalyticsQuery(std::string qid, GenDb::GenDbIf *dbif,
     parallel_batch_num(batch),
     total_parallel_batches(total_batches),
     processing_needed(true),
+    chunks_aligned(false),
     stats_(NULL) {
     Init(dbif, qid, json_api_data);
 }
@@ -972,7 +1003,8 @@ QueryEngine::QueryEngine(EventManager *evm,
             const std::string & redis_ip, unsigned short redis_port,
             const std::string & redis_password, int max_tasks, int max_slice,
             const std::string & cassandra_user,
-            const std::string & cassandra_password) :
+            const std::string & cassandra_password,
+            size_t cache_size, uint32_t cache_ttl, bool partition_filter) :
         qosp_(new QEOpServerProxy(evm,
             this, redis_ip, redis_port, redis_password, max_tasks)),
         evm_(evm),
@@ -981,6 +1013,8 @@ QueryEngine::QueryEngine(EventManager *evm,
         cassandra_password_(cassandra_password)
 {
     max_slice_ =  max_slice;
+    partition_filter_ = partition_filter;
+    InitCache(cache_size, cache_ttl);
     init_vizd_tables();
 
     // Initialize database connection
@@ -995,7 +1029,8 @@ QueryEngine::QueryEngine(EventManager *evm,
             const std::string & redis_ip, unsigned short redis_port,
             const std::string & redis_password, int max_tasks, int max_slice, 
             const std::string & cassandra_user,
-            const std::string & cassandra_password) :
+            const std::string & cassandra_password,
+            size_t cache_size, uint32_t cache_ttl, bool partition_filter) :
         dbif_(new ThriftIf(
             boost::bind(&QueryEngine::db_err_handler, this),
             cassandra_ips, cassandra_ports, "QueryEngine", true,
@@ -1009,6 +1044,8 @@ QueryEngine::QueryEngine(EventManager *evm,
         cassandra_password_(cassandra_password)
 {
     max_slice_ = max_slice;
+    partition_filter_ = partition_filter;
+    InitCache(cache_size, cache_ttl);
     init_vizd_tables();
 
     // Initialize database connection
@@ -1145,6 +1182,20 @@ QueryEngine::QueryEngine(EventManager *evm,
         std::string(), ConnectionStatus::UP, db_endpoint, std::string());
 }
 
+QueryEngine::~QueryEngine() {
+    if (query_result_cache == cache_.get()) {
+        query_result_cache = NULL;
+    }
+}
+
+void QueryEngine::InitCache(size_t cache_size, uint32_t cache_ttl) {
+    if (cache_size) {
+        cache_.reset(new QueryResultCache(cache_size,
+                                          cache_ttl * 1000000ULL));
+    }
+    query_result_cache = cache_.get();
+}
+
 using std::vector;
 
 int
@@ -1152,7 +1203,7 @@ QueryEngine::QueryPrepare(QueryParams qp,
         std::vector<uint64_t> &chunk_size,
         bool & need_merge, bool & map_output,
         std::string& where, std::string& select, std::string& post,
-        uint64_t& time_period, 
+        uint64_t& time_period, uint32_t& row_limit,
         std::string &table) {
     string& qid = qp.qid;
     QE_LOG_NOQID(INFO, 
@@ -1162,16 +1213,17 @@ QueryEngine::QueryPrepare(QueryParams qp,
         chunk_size.push_back(999);
         need_merge = false;
         map_output = false;
+        row_limit = 0;
         ret_code = 0;
         table = string("ObjectCollectorInfo");
     } else {
 
         AnalyticsQuery *q = new AnalyticsQuery(qid, qp.terms, ttlmap_, evm_,
                 cassandra_ips_, cassandra_ports_, 0, qp.maxChunks,
-                cassandra_user_, cassandra_password_);
+                cassandra_user_, cassandra_password_, cache_.get() != NULL);
         chunk_size.clear();
         q->get_query_details(need_merge, map_output, chunk_size,
-            where, select, post, time_period, ret_code);
+            where, select, post, time_period, row_limit, ret_code);
         table = q->table();
         delete q;
     }
@@ -1255,13 +1307,40 @@ QueryEngine::QueryExec(void * handle, QueryParams qp, uint32_t chunk)
     }
     AnalyticsQuery *q = new AnalyticsQuery(qid, qp.terms, ttlmap_, evm_,
             cassandra_ips_, cassandra_ports_, chunk, 
-            qp.maxChunks, cassandra_user_, cassandra_password_);
+            qp.maxChunks, cassandra_user_, cassandra_password_,
+            cache_.get() != NULL);
+
+    // Chunks of aligned queries that ended a while ago are served from,
+    // or added to, the result cache.
+    std::string cache_key;
+    uint64_t now = UTCTimestampUsec();
+    if (cache_.get() && q->status_details == 0 && q->processing_needed &&
+        q->chunks_aligned && cache_->IsCacheable(q->end_time(), now)) {
+        cache_key = QueryResultCache::Key(qp.terms, q->from_time(),
+                                          q->end_time());
+        std::auto_ptr<QEOpServerProxy::BufferT> result;
+        std::auto_ptr<QEOpServerProxy::OutRowMultimapT> mresult;
+        if (cache_->Lookup(cache_key, now, &result, &mresult)) {
+            QE_TRACE_NOQID(DEBUG, " Result cache hit for QID " << qid <<
+                " chunk:" << chunk);
+            qosp_->QueryResult(handle, QEOpServerProxy::QPerfInfo(0,0,0),
+                result, mresult);
+            delete q;
+            return true;
+        }
+    }
 
     QE_TRACE_NOQID(DEBUG, " Finished parsing and starting processing for QID " << qid << " chunk:" << chunk); 
-    q->process_query(); 
+    query_status_t status = q->process_query(); 
 
     QE_TRACE_NOQID(DEBUG, " Finished query processing for QID " << qid << " chunk:" << chunk);
     q->qperf_.error = q->status_details;
+    if (!cache_key.empty() && status == QUERY_SUCCESS &&
+        q->status_details == 0 && q->final_result.get() &&
+        q->final_mresult.get()) {
+        cache_->Add(cache_key, UTCTimestampUsec(), *q->final_result,
+                    *q->final_mresult);
+    }
     qosp_->QueryResult(handle, q->qperf_, q->final_result, q->final_mresult);
     delete q;
     return true;
@@ -1451,6 +1530,18 @@ std::string AnalyticsQuery::get_column_field_datatype(
     return std::string("");
 }
 
+void QueryCacheStatsReq::HandleRequest() const {
+    QueryCacheStats stats;
+    if (query_result_cache) {
+        query_result_cache->GetStats(&stats);
+    }
+    QueryCacheStatsResp *resp = new QueryCacheStatsResp;
+    resp->set_stats(stats);
+    resp->set_context(context());
+    resp->set_more(false);
+    resp->Response();
+}
+
 std::map< std::string, int > trace_enable_map;
 void TraceEnable::HandleRequest() const
 {
@@ -72,6 +72,7 @@
 #include "../analytics/viz_message.h"
 #include "json_parse.h"
 #include "QEOpServerProxy.h"
+#include "query_cache.h"
 #include "base/logging.h"
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh.h>
@@ -374,7 +375,8 @@ public:
     DbQueryUnit(QueryUnit *p_query, QueryUnit *m_query):
         QueryUnit(p_query, m_query) 
         { cr.count = MAX_DB_QUERY_ENTRIES; 
-            t_only_col = false; t_only_row = false;};
+            t_only_col = false; t_only_row = false;
+            t2_restricted = false;};
     virtual query_status_t process_query();
 
 
@@ -389,6 +391,12 @@ public:
     GenDb::DbDataValueVec row_key_suffix;
     bool t_only_col;    // only T is in column name
     bool t_only_row;    // only T2 is in row key
+    // value looked up in the partition filters of cfname, for terms that
+    // match a single keyword or flow IP
+    std::string filter_value;
+    // if set, only the partitions (T2) in t2_list are read
+    bool t2_restricted;
+    std::set<uint32_t> t2_list;
 };
 
 // This class provides interface to process SET operations involved in the 
@@ -407,6 +415,9 @@ public:
 private:
     void or_operation();
     void and_operation();
+    bool filter_partitions(const DbQueryUnit *db_query, uint32_t t2_start,
+            uint32_t t2_end, std::set<uint32_t> *partitions);
+    query_status_t process_intersection_subqueries();
 };
 
 
@@ -703,8 +714,20 @@ public:
     bool final_merge_processing(
 const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
                         QEOpServerProxy::BufferT& output);
+
+    // Number of rows after which the query result cannot change anymore,
+    // or 0 if all the chunks must be processed.
+    uint32_t satisfying_row_count();
+
+    // Position of the next row in one of the sorted results being merged
+    typedef std::pair<const QEOpServerProxy::BufferT *, size_t>
+        SortedRunCursor;
 private:
     typedef std::map<uint64_t, QEOpServerProxy::ResultRowT> fcid_rrow_map_t;
+    void sort_result(QEOpServerProxy::BufferT *result);
+    void sorted_merge(
+                const std::vector<const QEOpServerProxy::BufferT *> &runs,
+                QEOpServerProxy::BufferT *output, bool uniquify);
     bool flowseries_merge_processing(
                 const QEOpServerProxy::BufferT *raw_result,
                 QEOpServerProxy::BufferT *merged_result,
@@ -730,7 +753,7 @@ public:
             EventManager *evm, std::vector<std::string> cassandra_ips, 
             std::vector<int> cassandra_ports, int batch,
             int total_batches, const std::string& cassandra_user,
-            const std::string &cassandra_password);
+            const std::string &cassandra_password, bool align_chunks = false);
     AnalyticsQuery(std::string qid, GenDb::GenDbIf *dbif, 
             std::map<std::string, std::string> json_api_data,
             const TtlMap& ttlmap, int batch, int total_batches);
@@ -786,6 +809,11 @@ public:
     bool processing_needed;
     // time slice for each parallel instance
     uint64_t time_slice;
+    // start of the time slice of the first parallel instance
+    uint64_t chunk_base;
+    // whether the time slices are aligned to fixed time boundaries, so that
+    // the chunk results can be cached
+    bool chunks_aligned;
     // this is for merge between multiple instances running on same core
     bool merge_processing(const QEOpServerProxy::BufferT& input,
                             QEOpServerProxy::BufferT& output);
@@ -801,6 +829,7 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
         std::string& select,
         std::string& post,
         uint64_t& time_period,
+        uint32_t& row_limit,
         int& parse_status);
 
     virtual std::string table() const {
@@ -835,7 +864,7 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
     std::string get_column_field_datatype(const std::string& col_field);
     virtual bool is_query_parallelized() { return parallelize_query_; }
 
-    const StatsQuery& stats(void) const { return *stats_; }
+    virtual const StatsQuery& stats(void) const { return *stats_; }
     private:
     std::auto_ptr<StatsQuery> stats_;
     // Analytics table to query
@@ -869,6 +898,8 @@ class QueryEngine {
 public:
     static const uint64_t StartTimeDiffInSec = 12*3600;
     static int max_slice_;
+    // Whether the partition filters are used to skip index partitions
+    static bool partition_filter_;
     
     struct QueryParams {
         QueryParams(std::string qi, 
@@ -890,21 +921,25 @@ public:
             const std::string & redis_password,
             int max_tasks, int max_slice,
             const std::string & cassandra_name,
-            const std::string & cassandra_password);
+            const std::string & cassandra_password,
+            size_t cache_size, uint32_t cache_ttl, bool partition_filter);
 
     QueryEngine(EventManager *evm,
             const std::string & redis_ip, unsigned short redis_port,
             const std::string & redis_password, int max_tasks,
             int max_slice,
             const std::string  & cassandra_user,
-            const std::string  & cassandra_password);
+            const std::string  & cassandra_password,
+            size_t cache_size, uint32_t cache_ttl, bool partition_filter);
+
+    ~QueryEngine();
     
     int
     QueryPrepare(QueryParams qp,
         std::vector<uint64_t> &chunk_size,
         bool & need_merge, bool & map_output,
         std::string& where, std::string& select, std::string& post,
-        uint64_t& time_period, 
+        uint64_t& time_period, uint32_t& row_limit,
         std::string &table);
 
     bool
@@ -930,7 +965,11 @@ public:
 
     void db_err_handler() {};
     TtlMap& GetTTlMap() { return ttlmap_; }
+    // Cache of chunk results, or NULL if caching is disabled
+    QueryResultCache *query_cache() { return cache_.get(); }
 private:
+    void InitCache(size_t cache_size, uint32_t cache_ttl);
+
     boost::scoped_ptr<GenDb::GenDbIf> dbif_;
     boost::scoped_ptr<QEOpServerProxy> qosp_;
     EventManager *evm_;
@@ -939,6 +978,7 @@ private:
     std::string cassandra_user_;
     std::string cassandra_password_;
     TtlMap ttlmap_;
+    boost::scoped_ptr<QueryResultCache> cache_;
 };
 
 #endif
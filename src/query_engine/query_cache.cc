@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "query_engine/query_cache.h"
+
+#include <boost/variant/static_visitor.hpp>
+
+#include "base/string_util.h"
+#include "query_engine/json_parse.h"
+#include "query_engine/qe_types.h"
+
+using std::auto_ptr;
+using std::map;
+using std::string;
+
+namespace {
+
+// Approximate heap usage of a std::map or std::list node, in addition to
+// its value.
+const size_t kNodeOverhead = 4 * sizeof(void *);
+
+class SubValBytes : public boost::static_visitor<size_t> {
+public:
+    size_t operator()(const string &str) const {
+        return str.capacity();
+    }
+    template <typename T>
+    size_t operator()(const T &) const {
+        return 0;
+    }
+};
+
+size_t StringMapBytes(const QEOpServerProxy::OutRowT &row) {
+    size_t bytes = 0;
+    for (QEOpServerProxy::OutRowT::const_iterator it = row.begin();
+         it != row.end(); it++) {
+        bytes += kNodeOverhead + sizeof(*it) + it->first.capacity() +
+            it->second.capacity();
+    }
+    return bytes;
+}
+
+}  // namespace
+
+const uint64_t QueryResultCache::kSettleTime;
+
+QueryResultCache::QueryResultCache(size_t max_bytes, uint64_t ttl)
+    : max_bytes_(max_bytes), ttl_(ttl), bytes_(0), hits_(0), misses_(0),
+      adds_(0), evictions_(0), expirations_(0) {
+}
+
+string QueryResultCache::Key(const map<string, string> &terms,
+                             uint64_t from_time, uint64_t end_time) {
+    string key(integerToString(from_time) + "-" +
+               integerToString(end_time));
+    for (map<string, string>::const_iterator it = terms.begin();
+         it != terms.end(); it++) {
+        if (it->first == QUERY_START_TIME || it->first == QUERY_END_TIME) {
+            continue;
+        }
+        key += "\n" + it->first + "=" + it->second;
+    }
+    return key;
+}
+
+bool QueryResultCache::IsCacheable(uint64_t end_time, uint64_t now) const {
+    return max_bytes_ && end_time + kSettleTime <= now;
+}
+
+bool QueryResultCache::Lookup(const string &key, uint64_t now,
+        auto_ptr<QEOpServerProxy::BufferT> *result,
+        auto_ptr<QEOpServerProxy::OutRowMultimapT> *mresult) {
+    boost::shared_ptr<const QEOpServerProxy::BufferT> cached_result;
+    boost::shared_ptr<const QEOpServerProxy::OutRowMultimapT> cached_mresult;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        EntryMap::iterator it = entries_.find(key);
+        if (it == entries_.end()) {
+            misses_++;
+            return false;
+        }
+        if (it->second.expiry_time <= now) {
+            Remove(it);
+            expirations_++;
+            misses_++;
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        cached_result = it->second.result;
+        cached_mresult = it->second.mresult;
+        hits_++;
+    }
+
+    // The caller owns and may modify the result, so copy it outside the
+    // lock; the cached result is immutable.
+    result->reset(new QEOpServerProxy::BufferT(*cached_result));
+    mresult->reset(new QEOpServerProxy::OutRowMultimapT(*cached_mresult));
+    return true;
+}
+
+void QueryResultCache::Add(const string &key, uint64_t now,
+                           const QEOpServerProxy::BufferT &result,
+                           const QEOpServerProxy::OutRowMultimapT &mresult) {
+    size_t bytes = key.capacity() + ResultBytes(result, mresult);
+    if (bytes > max_bytes_) {
+        return;
+    }
+    Entry entry;
+    entry.result.reset(new QEOpServerProxy::BufferT(result));
+    entry.mresult.reset(new QEOpServerProxy::OutRowMultimapT(mresult));
+    entry.expiry_time = now + ttl_;
+    entry.bytes = bytes;
+
+    tbb::mutex::scoped_lock lock(mutex_);
+    EntryMap::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+        Remove(it);
+    }
+    while (bytes_ + bytes > max_bytes_) {
+        Remove(entries_.find(lru_.back()));
+        evictions_++;
+    }
+    lru_.push_front(key);
+    entry.lru = lru_.begin();
+    entries_.insert(std::make_pair(key, entry));
+    bytes_ += bytes;
+    adds_++;
+}
+
+void QueryResultCache::Remove(EntryMap::iterator it) {
+    bytes_ -= it->second.bytes;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+void QueryResultCache::Clear() {
+    tbb::mutex::scoped_lock lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+size_t QueryResultCache::ResultBytes(
+        const QEOpServerProxy::BufferT &result,
+        const QEOpServerProxy::OutRowMultimapT &mresult) {
+    size_t bytes = sizeof(result) + sizeof(mresult);
+    for (QEOpServerProxy::BufferT::const_iterator it = result.begin();
+         it != result.end(); it++) {
+        bytes += sizeof(*it) + StringMapBytes(it->first);
+    }
+    SubValBytes subval_bytes;
+    for (QEOpServerProxy::OutRowMultimapT::const_iterator it = mresult.begin();
+         it != mresult.end(); it++) {
+        bytes += kNodeOverhead + sizeof(*it) +
+            it->first.capacity() * sizeof(QEOpServerProxy::SubVal);
+        for (size_t i = 0; i < it->first.size(); i++) {
+            bytes += boost::apply_visitor(subval_bytes, it->first[i]);
+        }
+        const std::map<string, QEOpServerProxy::SubVal> &uniks =
+            it->second.first;
+        for (std::map<string, QEOpServerProxy::SubVal>::const_iterator
+             jt = uniks.begin(); jt != uniks.end(); jt++) {
+            bytes += kNodeOverhead + sizeof(*jt) + jt->first.capacity() +
+                boost::apply_visitor(subval_bytes, jt->second);
+        }
+        const QEOpServerProxy::AggRowT &aggs = it->second.second;
+        for (QEOpServerProxy::AggRowT::const_iterator jt = aggs.begin();
+             jt != aggs.end(); jt++) {
+            bytes += kNodeOverhead + sizeof(*jt) +
+                jt->first.second.capacity() +
+                boost::apply_visitor(subval_bytes, jt->second);
+        }
+    }
+    return bytes;
+}
+
+size_t QueryResultCache::Size() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return entries_.size();
+}
+
+size_t QueryResultCache::Bytes() const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    return bytes_;
+}
+
+void QueryResultCache::GetStats(QueryCacheStats *stats) const {
+    tbb::mutex::scoped_lock lock(mutex_);
+    stats->set_entries(entries_.size());
+    stats->set_bytes(bytes_);
+    stats->set_max_bytes(max_bytes_);
+    stats->set_ttl(ttl_ / 1000000);
+    stats->set_hits(hits_);
+    stats->set_misses(misses_);
+    stats->set_adds(adds_);
+    stats->set_evictions(evictions_);
+    stats->set_expirations(expirations_);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef SRC_QUERY_ENGINE_QUERY_CACHE_H_
+#define SRC_QUERY_ENGINE_QUERY_CACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <tbb/mutex.h>
+
+#include "QEOpServerProxy.h"
+
+class QueryCacheStats;
+
+//
+// Cache of the results of query chunks.
+//
+// Dashboards and alarm tooling repeat the same query every few seconds over
+// a sliding time window. Once the chunks of such a query are aligned to
+// fixed time boundaries, all but the newest chunks cover the same time
+// range from one run to the next. The result of a chunk that ended more
+// than kSettleTime ago is not expected to change, and is kept here keyed by
+// the query terms and the chunk time range, so that the next run only has
+// to query the newest chunks from the database.
+//
+// Entries are dropped ttl after they were added, so that data that arrives
+// late is picked up eventually, and in least recently used order when the
+// estimated size of the cached results exceeds max_bytes.
+//
+class QueryResultCache {
+public:
+    // Chunks that end less than this long ago are not cached
+    static const uint64_t kSettleTime = 120 * 1000000ULL;
+
+    QueryResultCache(size_t max_bytes, uint64_t ttl);
+
+    // Key of the chunk [from_time, end_time) of the query with the given
+    // terms. The requested start and end times are left out, as the chunk
+    // time range replaces them.
+    static std::string Key(const std::map<std::string, std::string> &terms,
+                           uint64_t from_time, uint64_t end_time);
+
+    // Whether the result of a chunk ending at end_time can be cached at
+    // time now.
+    bool IsCacheable(uint64_t end_time, uint64_t now) const;
+
+    // Copy the cached result for key into result and mresult. Returns false
+    // if there is no entry for key, or if it has expired.
+    bool Lookup(const std::string &key, uint64_t now,
+                std::auto_ptr<QEOpServerProxy::BufferT> *result,
+                std::auto_ptr<QEOpServerProxy::OutRowMultimapT> *mresult);
+
+    // Add the result of the chunk for key, replacing any existing entry.
+    // Results larger than max_bytes are not added.
+    void Add(const std::string &key, uint64_t now,
+             const QEOpServerProxy::BufferT &result,
+             const QEOpServerProxy::OutRowMultimapT &mresult);
+
+    void Clear();
+
+    // Estimated memory used by a chunk result.
+    static size_t ResultBytes(const QEOpServerProxy::BufferT &result,
+                              const QEOpServerProxy::OutRowMultimapT &mresult);
+
+    void GetStats(QueryCacheStats *stats) const;
+
+    size_t Size() const;
+    size_t Bytes() const;
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+    uint64_t expirations() const { return expirations_; }
+
+private:
+    struct Entry;
+    typedef std::list<std::string> LruList;
+    typedef std::map<std::string, Entry> EntryMap;
+
+    struct Entry {
+        boost::shared_ptr<const QEOpServerProxy::BufferT> result;
+        boost::shared_ptr<const QEOpServerProxy::OutRowMultimapT> mresult;
+        uint64_t expiry_time;
+        size_t bytes;
+        LruList::iterator lru;
+    };
+
+    void Remove(EntryMap::iterator it);
+
+    const size_t max_bytes_;
+    const uint64_t ttl_;
+    mutable tbb::mutex mutex_;
+    EntryMap entries_;
+    // Most recently used first
+    LruList lru_;
+    size_t bytes_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t adds_;
+    uint64_t evictions_;
+    uint64_t expirations_;
+};
+
+#endif  // SRC_QUERY_ENGINE_QUERY_CACHE_H_
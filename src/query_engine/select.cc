@@ -509,6 +509,9 @@ query_status_t SelectQuery::process_query() {
         //uint64_t parset=0;
         //uint64_t loadt=0;
         //uint64_t jsont=0;
+        std::vector<StatsSelect::StatRow> rows;
+        rows.reserve(std::min(query_result.size(),
+                              StatsSelect::kLoadBatchSize));
         for (std::vector<query_result_unit_t>::iterator it = query_result.begin();
                 it != query_result.end(); it++) {
 
@@ -523,7 +526,11 @@ query_status_t SelectQuery::process_query() {
             d.Parse<0>(const_cast<char *>(json_string.c_str()));
             //jsont += UTCTimestampUsec() - thenj;
 
-            std::vector<StatsSelect::StatEntry> attribs;
+            rows.resize(rows.size() + 1);
+            StatsSelect::StatRow& row = rows.back();
+            row.uuid = u;
+            row.timestamp = it->timestamp;
+            std::vector<StatsSelect::StatEntry>& attribs = row.entries;
             {
                 for (rapidjson::Value::ConstMemberIterator itr = d.MemberBegin();
                         itr != d.MemberEnd(); ++itr) {
@@ -556,10 +563,19 @@ query_status_t SelectQuery::process_query() {
                     //parset += UTCTimestampUsec() - thenp; 
                 }
             }
-            //uint64_t thenl = UTCTimestampUsec();
-            stats_->LoadRow(u, it->timestamp, attribs, *mresult_);
-            //loadt += UTCTimestampUsec() - thenl; 
+            if (!stats_->IsBatchLoadNeeded()) {
+                // Grouping does not pay off for rows which mostly end up
+                // in an output row of their own
+                stats_->LoadRow(row.uuid, row.timestamp, attribs, *mresult_);
+                rows.clear();
+            } else if (rows.size() == StatsSelect::kLoadBatchSize) {
+                //uint64_t thenl = UTCTimestampUsec();
+                stats_->LoadRows(rows, *mresult_);
+                //loadt += UTCTimestampUsec() - thenl; 
+                rows.clear();
+            }
         }
+        stats_->LoadRows(rows, *mresult_);
         //QE_TRACE(DEBUG, "Select ProcTime - Entries : " << query_result.size() <<
         //        " json : " << jsont << " parse : " << parset << " load : " << loadt);
 
@@ -2,6 +2,7 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include "base/bloom_filter.h"
 #include "query.h"
 
 // for sorting and set operations
@@ -52,6 +53,11 @@ void SetOperationUnit::or_operation()
     }
 }
 
+static bool result_size_less(const QueryUnit *lhs, const QueryUnit *rhs)
+{
+    return lhs->query_result.size() < rhs->query_result.size();
+}
+
 void SetOperationUnit::and_operation()
 {
     if (sub_queries.size() == 0)
@@ -60,19 +66,24 @@ void SetOperationUnit::and_operation()
         return;
     }
 
+    // intersect the smallest results first, so that the intermediate
+    // results stay small
+    std::vector<QueryUnit *> ordered(sub_queries);
+    std::stable_sort(ordered.begin(), ordered.end(), result_size_less);
+
     // with one query no need to do any operation
-    query_result = sub_queries[0]->query_result;
+    query_result = ordered[0]->query_result;
 
-    for (unsigned int i = 1; i < sub_queries.size(); i++)
+    for (unsigned int i = 1; i < ordered.size() && !query_result.empty(); i++)
     {
         std::vector<query_result_unit_t> tmp_query_result;
 
         QE_TRACE(DEBUG, "INT between tables of sizes " << 
                 query_result.size() << " and " <<
-                sub_queries[i]->query_result.size());
+                ordered[i]->query_result.size());
         set_intersection(query_result.begin(), query_result.end(),
-                sub_queries[i]->query_result.begin(), 
-                sub_queries[i]->query_result.end(),
+                ordered[i]->query_result.begin(), 
+                ordered[i]->query_result.end(),
                 std::back_inserter(tmp_query_result));
 
         query_result = tmp_query_result;    // keep the result in output var
@@ -81,6 +92,147 @@ void SetOperationUnit::and_operation()
 }
 
 
+// Most filter columns read for a partition. A partition with more is read
+// whatever its filters hold.
+static const uint32_t kPartitionFilterReadColumns = 1024;
+
+// Find the partitions (T2) in [t2_start, t2_end] in which the value of the
+// term may have been written, from the Bloom filters that the collectors
+// write for each partition of the index table. A partition is only left
+// out if it has filters, all of them were read and are sealed (not empty),
+// and none of them contains the value. Returns false if the filters could
+// not be read.
+bool SetOperationUnit::filter_partitions(const DbQueryUnit *db_query,
+        uint32_t t2_start, uint32_t t2_end, std::set<uint32_t> *partitions)
+{
+    AnalyticsQuery *m_query = (AnalyticsQuery *)main_query;
+    std::vector<GenDb::DbDataValueVec> keys;
+    for (uint32_t t2 = t2_start; t2 <= t2_end; t2++)
+    {
+        GenDb::DbDataValueVec rowkey;
+        rowkey.push_back(t2);
+        rowkey.push_back(db_query->cfname);
+        keys.push_back(rowkey);
+    }
+
+    GenDb::ColumnNameRange crange;
+    crange.count = kPartitionFilterReadColumns;
+    GenDb::ColListVec mget_res;
+    if (!m_query->dbif->Db_GetMultiRow(mget_res,
+            g_viz_constants.INDEX_PARTITION_FILTER_TABLE, keys, &crange)) {
+        QE_TRACE(DEBUG, "Reading partition filters of " << db_query->cfname
+                << " failed");
+        return false;
+    }
+
+    std::set<uint32_t> excluded;
+    for (GenDb::ColListVec::iterator it = mget_res.begin();
+            it != mget_res.end(); it++) {
+        if (it->rowkey_.empty() || it->columns_.empty())
+            continue;
+        uint32_t t2;
+        try {
+            t2 = boost::get<uint32_t>(it->rowkey_.at(0));
+        } catch (boost::bad_get& ex) {
+            continue;
+        }
+        bool may_contain =
+            it->columns_.size() >= kPartitionFilterReadColumns;
+        for (GenDb::NewColVec::iterator i = it->columns_.begin();
+                i != it->columns_.end() && !may_contain; i++) {
+            BloomFilter filter;
+            const std::string *value = NULL;
+            if (i->value->size() == 1)
+                value = boost::get<std::string>(&i->value->at(0));
+            may_contain = value == NULL || !filter.FromString(*value) ||
+                filter.MayContain(db_query->filter_value);
+        }
+        if (!may_contain)
+            excluded.insert(t2);
+    }
+
+    for (uint32_t t2 = t2_start; t2 <= t2_end; t2++)
+    {
+        if (excluded.find(t2) == excluded.end())
+            partitions->insert(t2);
+    }
+    QE_TRACE(DEBUG, "Partition filters of " << db_query->cfname << " leave "
+            << partitions->size() << " of " << (t2_end - t2_start + 1)
+            << " partitions for " << db_query->filter_value);
+    return true;
+}
+
+typedef std::pair<size_t, DbQueryUnit *> PartitionCount;
+
+static bool partition_count_less(const PartitionCount &lhs,
+        const PartitionCount &rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+// Run the sub queries of an intersection, most selective first.
+//
+// The partitions in which a term on a keyword or flow IP can not match are
+// found from the partition filters, and are not read for any of the terms.
+// This is only done when enabled, as collectors of older versions do not
+// write the filters and their values would be missed.
+// The sub queries are then run in order of the number of partitions left
+// for them, with the terms without filters last, and each one only reads
+// the partitions in which all the previous ones had results, as the
+// intersection is empty in the others.
+query_status_t SetOperationUnit::process_intersection_subqueries()
+{
+    AnalyticsQuery *m_query = (AnalyticsQuery *)main_query;
+    uint32_t t2_start = m_query->from_time() >> g_viz_constants.RowTimeInBits;
+    uint32_t t2_end = m_query->end_time() >> g_viz_constants.RowTimeInBits;
+
+    std::set<uint32_t> partitions;
+    for (uint32_t t2 = t2_start; t2 <= t2_end; t2++)
+        partitions.insert(t2);
+
+    std::vector<PartitionCount> order;
+    for (unsigned int i = 0; i < sub_queries.size(); i++)
+    {
+        DbQueryUnit *db_query = static_cast<DbQueryUnit *>(sub_queries[i]);
+        size_t count = t2_end - t2_start + 2;
+        std::set<uint32_t> filtered;
+        if (QueryEngine::partition_filter_ &&
+            !db_query->filter_value.empty() &&
+            filter_partitions(db_query, t2_start, t2_end, &filtered)) {
+            count = filtered.size();
+            std::set<uint32_t> tmp_partitions;
+            set_intersection(partitions.begin(), partitions.end(),
+                    filtered.begin(), filtered.end(),
+                    std::inserter(tmp_partitions, tmp_partitions.begin()));
+            partitions.swap(tmp_partitions);
+        }
+        order.push_back(std::make_pair(count, db_query));
+    }
+    std::stable_sort(order.begin(), order.end(), partition_count_less);
+
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        DbQueryUnit *db_query = order[i].second;
+        db_query->t2_restricted = true;
+        db_query->t2_list = partitions;
+        query_status_t query_status = db_query->process_query();
+        if (query_status == QUERY_FAILURE)
+        {
+            status_details = db_query->status_details;
+            return QUERY_FAILURE;
+        }
+
+        std::set<uint32_t> hits;
+        for (std::vector<query_result_unit_t>::const_iterator it =
+                db_query->query_result.begin();
+                it != db_query->query_result.end(); it++) {
+            hits.insert(it->timestamp >> g_viz_constants.RowTimeInBits);
+        }
+        partitions.swap(hits);
+    }
+    return QUERY_SUCCESS;
+}
+
 query_status_t SetOperationUnit::process_query()
 {
     if (status_details != 0)
@@ -92,16 +244,31 @@ query_status_t SetOperationUnit::process_query()
 
     QE_TRACE(DEBUG, 
              " No of subset queries:"  << sub_queries.size());
-    // invoke processing of all the sub queries
-    // TBD: Handle ASYNC processing
+    // the database queries of an intersection are run most selective first
+    bool db_intersection = (set_operation == INTERSECTION_OP) &&
+        (sub_queries.size() > 1);
     for (unsigned int i = 0; i < sub_queries.size(); i++)
     {
-        query_status_t query_status = sub_queries[i]->process_query();
+        if (dynamic_cast<DbQueryUnit *>(sub_queries[i]) == NULL)
+            db_intersection = false;
+    }
 
-        if (query_status == QUERY_FAILURE)
-        {
-            status_details = sub_queries[i]->status_details;
+    // invoke processing of all the sub queries
+    // TBD: Handle ASYNC processing
+    if (db_intersection)
+    {
+        if (process_intersection_subqueries() == QUERY_FAILURE)
             return QUERY_FAILURE;
+    } else {
+        for (unsigned int i = 0; i < sub_queries.size(); i++)
+        {
+            query_status_t query_status = sub_queries[i]->process_query();
+
+            if (query_status == QUERY_FAILURE)
+            {
+                status_details = sub_queries[i]->status_details;
+                return QUERY_FAILURE;
+            }
         }
     }
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "query_engine/sort_keys.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "base/string_util.h"
+
+using std::string;
+using std::vector;
+
+class SortKeys::RowComparator {
+public:
+    RowComparator(const SortKeys *result, bool descending)
+        : result_(result), descending_(descending) {
+    }
+
+    bool operator()(size_t lhs, size_t rhs) const {
+        if (descending_) {
+            return result_->Compare(rhs, lhs) < 0;
+        }
+        return result_->Compare(lhs, rhs) < 0;
+    }
+
+private:
+    const SortKeys *result_;
+    bool descending_;
+};
+
+SortKeys::SortKeys(const Schema &schema)
+    : size_(0), finalized_(false) {
+    columns_.reserve(schema.size());
+    for (Schema::const_iterator it = schema.begin(); it != schema.end();
+         ++it) {
+        columns_.push_back(Column(it->name, it->type));
+    }
+}
+
+SortKeys::ColumnType SortKeys::TypeFromString(
+        const string &datatype) {
+    if (datatype == "int" || datatype == "long" || datatype == "ipv4") {
+        return UINT64;
+    }
+    return STRING;
+}
+
+void SortKeys::Reserve(size_t rows) {
+    for (vector<Column>::iterator it = columns_.begin();
+         it != columns_.end(); ++it) {
+        it->values.reserve(rows);
+    }
+}
+
+uint32_t SortKeys::Encode(Column *column, const string &value) {
+    std::pair<std::map<string, uint32_t>::iterator, bool> result =
+        column->codes.insert(std::make_pair(value, column->dictionary.size()));
+    if (result.second) {
+        column->dictionary.push_back(value);
+    }
+    return result.first->second;
+}
+
+void SortKeys::AppendRow(const QEOpServerProxy::OutRowT &row) {
+    assert(!finalized_);
+    static const string kEmpty;
+    for (vector<Column>::iterator it = columns_.begin();
+         it != columns_.end(); ++it) {
+        QEOpServerProxy::OutRowT::const_iterator col = row.find(it->name);
+        const string &value = (col != row.end()) ? col->second : kEmpty;
+        if (it->type == UINT64) {
+            uint64_t number = 0;
+            stringToInteger(value, number);
+            it->values.push_back(number);
+        } else {
+            it->values.push_back(Encode(&(*it), value));
+        }
+    }
+    size_++;
+}
+
+void SortKeys::GetRow(size_t row,
+                            QEOpServerProxy::OutRowT *out) const {
+    for (vector<Column>::const_iterator it = columns_.begin();
+         it != columns_.end(); ++it) {
+        if (it->type == UINT64) {
+            (*out)[it->name] = integerToString(it->values[row]);
+        } else {
+            (*out)[it->name] = it->dictionary[it->values[row]];
+        }
+    }
+}
+
+uint64_t SortKeys::GetUint64(size_t column, size_t row) const {
+    assert(columns_[column].type == UINT64);
+    return columns_[column].values[row];
+}
+
+const string &SortKeys::GetString(size_t column, size_t row) const {
+    assert(columns_[column].type == STRING);
+    return columns_[column].dictionary[columns_[column].values[row]];
+}
+
+//
+// Rank the dictionary of each string column. The codes map is ordered, so
+// walking it yields the dictionary entries in sorted order.
+//
+void SortKeys::Finalize() {
+    if (finalized_) {
+        return;
+    }
+    for (vector<Column>::iterator it = columns_.begin();
+         it != columns_.end(); ++it) {
+        if (it->type != STRING) {
+            continue;
+        }
+        it->ranks.resize(it->dictionary.size());
+        uint32_t rank = 0;
+        for (std::map<string, uint32_t>::const_iterator code =
+             it->codes.begin(); code != it->codes.end(); ++code) {
+            it->ranks[code->second] = rank++;
+        }
+    }
+    finalized_ = true;
+}
+
+int SortKeys::Compare(size_t lhs, size_t rhs) const {
+    for (vector<Column>::const_iterator it = columns_.begin();
+         it != columns_.end(); ++it) {
+        uint64_t lhs_value = it->values[lhs];
+        uint64_t rhs_value = it->values[rhs];
+        if (it->type == STRING) {
+            lhs_value = it->ranks[lhs_value];
+            rhs_value = it->ranks[rhs_value];
+        }
+        if (lhs_value < rhs_value) return -1;
+        if (lhs_value > rhs_value) return 1;
+    }
+    return 0;
+}
+
+void SortKeys::SortOrder(bool descending, vector<size_t> *order) {
+    Finalize();
+    order->resize(size_);
+    for (size_t i = 0; i < size_; ++i) {
+        (*order)[i] = i;
+    }
+    std::stable_sort(order->begin(), order->end(),
+                     RowComparator(this, descending));
+}
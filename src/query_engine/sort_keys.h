@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef SRC_QUERY_ENGINE_SORT_KEYS_H_
+#define SRC_QUERY_ENGINE_SORT_KEYS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "QEOpServerProxy.h"
+
+//
+// Typed sort keys of a set of result rows, used by the final sort in
+// post-processing. Rows themselves stay string maps throughout the query.
+//
+// Rows produced by the select stage are string keyed maps of string values
+// (QEOpServerProxy::OutRowT). Sorting them directly requires a map lookup
+// and, for numeric columns, a string to integer conversion per column per
+// comparison. SortKeys extracts the sort fields named in its schema once
+// per row into typed key vectors: numeric fields are stored as uint64_t
+// and string fields are dictionary encoded. After Finalize(), the
+// dictionary codes are replaced by their rank in the sorted dictionary, so
+// that all row comparisons are integer comparisons.
+//
+class SortKeys {
+public:
+    enum ColumnType {
+        STRING,
+        UINT64
+    };
+
+    struct ColumnSpec {
+        ColumnSpec(const std::string &column_name, ColumnType column_type)
+            : name(column_name), type(column_type) {
+        }
+        std::string name;
+        ColumnType type;
+    };
+    typedef std::vector<ColumnSpec> Schema;
+
+    explicit SortKeys(const Schema &schema);
+
+    // Map a query engine sort field datatype to a column type.
+    static ColumnType TypeFromString(const std::string &datatype);
+
+    void Reserve(size_t rows);
+
+    // Append the schema columns of row. Columns missing from the row are
+    // stored as 0 or the empty string.
+    void AppendRow(const QEOpServerProxy::OutRowT &row);
+
+    // Convert row back to its string representation.
+    void GetRow(size_t row, QEOpServerProxy::OutRowT *out) const;
+
+    // Compute the order of the rows comparing schema columns left to right.
+    // Ties are kept in insertion order.
+    void SortOrder(bool descending, std::vector<size_t> *order);
+
+    uint64_t GetUint64(size_t column, size_t row) const;
+    const std::string &GetString(size_t column, size_t row) const;
+
+    size_t Size() const { return size_; }
+    size_t ColumnCount() const { return columns_.size(); }
+    size_t DictionarySize(size_t column) const {
+        return columns_[column].dictionary.size();
+    }
+
+private:
+    struct Column {
+        Column(const std::string &column_name, ColumnType column_type)
+            : name(column_name), type(column_type) {
+        }
+        std::string name;
+        ColumnType type;
+        // Integer values, or dictionary codes for string columns.
+        std::vector<uint64_t> values;
+        std::vector<std::string> dictionary;
+        std::map<std::string, uint32_t> codes;
+        // Rank of each dictionary code in the sorted dictionary.
+        std::vector<uint32_t> ranks;
+    };
+
+    class RowComparator;
+
+    void Finalize();
+    uint32_t Encode(Column *column, const std::string &value);
+    int Compare(size_t lhs, size_t rhs) const;
+
+    std::vector<Column> columns_;
+    size_t size_;
+    bool finalized_;
+};
+
+#endif  // SRC_QUERY_ENGINE_SORT_KEYS_H_
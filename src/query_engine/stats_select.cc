@@ -5,9 +5,12 @@
 #include "stats_select.h"
 #include "stats_query.h"
 #include "query.h"
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <boost/assign/list_of.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
@@ -21,6 +24,9 @@ using std::set;
 using std::pair;
 using std::make_pair;
 
+const size_t StatsSelect::kLoadBatchSize;
+const size_t StatsSelect::kMinLoadBatchReduction;
+
 bool
 StatsSelect::Jsonify(const std::map<std::string, StatVal>&  uniks, 
         const QEOpServerProxy::AggRowT& aggs, std::string& jstr) {
@@ -168,6 +174,7 @@ StatsSelect::StatsSelect(AnalyticsQuery * m_query,
 
     QE_ASSERT(main_query->is_stat_table_query(main_query->table()));
     status_ = false;
+    batch_load_ = true;
 
     for (size_t j=0; j<select_fields_.size(); j++) {
 
@@ -248,6 +255,19 @@ StatsSelect::StatsSelect(AnalyticsQuery * m_query,
         }
     }
 
+    std::set<std::string> agg_cols(sum_cols_);
+    agg_cols.insert(max_field_.begin(), max_field_.end());
+    agg_cols.insert(min_field_.begin(), min_field_.end());
+    for (std::set<std::string>::const_iterator it = agg_cols.begin();
+            it != agg_cols.end(); it++) {
+        AggColumn col(*it);
+        col.sum = sum_cols_.find(*it) != sum_cols_.end();
+        col.max = max_field_.find(*it) != max_field_.end();
+        col.min = min_field_.find(*it) != min_field_.end();
+        agg_column_index_.insert(make_pair(*it, agg_columns_.size()));
+        agg_columns_.push_back(col);
+    }
+
     status_ = true;
 }
 
@@ -310,6 +330,63 @@ void StatsSelect::MergeFullRow(
 }
 
 
+void StatsSelect::MergeAggValue(QEOpServerProxy::AggOper oper,
+        StatVal& sv, const StatVal& nv) {
+    if (oper == QEOpServerProxy::SUM) {
+        try {
+            if (sv.which() == QEOpServerProxy::UINT64) {
+                sv = boost::get<uint64_t>(sv) + boost::get<uint64_t>(nv);
+            }
+            if (sv.which() == QEOpServerProxy::DOUBLE) {
+                sv = boost::get<double>(sv) + boost::get<double>(nv);
+            }                   
+        } catch (boost::bad_get& ex) {
+            QE_ASSERT(0);
+        } catch (const std::out_of_range& oor) {
+            QE_ASSERT(0);
+        }                        
+
+    }
+    if (oper == QEOpServerProxy::COUNT) {
+        try {
+            uint64_t& count =  boost::get<uint64_t>(sv);
+            count = count + boost::get<uint64_t>(nv);
+        } catch (boost::bad_get& ex) {
+            QE_ASSERT(0);
+        } catch (const std::out_of_range& oor) {
+            QE_ASSERT(0);
+        }     
+    }
+    if (oper == QEOpServerProxy::MAX) {
+        try {
+            if (sv.which() == QEOpServerProxy::UINT64) {
+                uint64_t& existing_max = boost::get<uint64_t>(sv);
+                existing_max = (existing_max > (boost::get<uint64_t>(nv))) ? existing_max:(boost::get<uint64_t>(nv));
+            }
+            if (sv.which() == QEOpServerProxy::DOUBLE) {
+                double& existing_max = boost::get<double>(sv);
+                existing_max = (existing_max > (boost::get<double>(nv))) ? existing_max:(boost::get<double>(nv));
+            }                   
+        } catch (boost::bad_get& ex) {
+            QE_ASSERT(0);
+        }     
+    }
+    if (oper == QEOpServerProxy::MIN) {
+        try {
+            if (sv.which() == QEOpServerProxy::UINT64) {
+                uint64_t& existing_min = boost::get<uint64_t>(sv);
+                existing_min = (existing_min < (boost::get<uint64_t>(nv))) ? existing_min:(boost::get<uint64_t>(nv));
+            }
+            if (sv.which() == QEOpServerProxy::DOUBLE) {
+                double& existing_min = boost::get<double>(sv);
+                existing_min = (existing_min < (boost::get<double>(nv))) ? existing_min:(boost::get<double>(nv));
+            }                   
+        } catch (boost::bad_get& ex) {
+            QE_ASSERT(0);
+        }     
+    }
+}
+
 void StatsSelect::MergeAggRow(QEOpServerProxy::AggRowT &arows,
         const QEOpServerProxy::AggRowT &narows) {
     for (QEOpServerProxy::AggRowT::iterator jt = arows.begin();
@@ -318,64 +395,7 @@ void StatsSelect::MergeAggRow(QEOpServerProxy::AggRowT &arows,
         if (kt!=narows.end()) {
             // Attribute name must match for aggregate and for the new value
             QE_ASSERT(jt->first.second == kt->first.second);
-
-            if (jt->first.first == QEOpServerProxy::SUM) {
-                StatsSelect::StatVal & sv = jt->second;
-                try {
-                    if (sv.which() == QEOpServerProxy::UINT64) {
-                        sv = boost::get<uint64_t>(sv) + boost::get<uint64_t>(kt->second);
-                    }
-                    if (sv.which() == QEOpServerProxy::DOUBLE) {
-                        sv = boost::get<double>(sv) + boost::get<double>(kt->second);
-                    }                   
-                } catch (boost::bad_get& ex) {
-                    QE_ASSERT(0);
-                } catch (const std::out_of_range& oor) {
-                    QE_ASSERT(0);
-                }                        
-
-            }
-            if (jt->first.first == QEOpServerProxy::COUNT) {
-                try {
-                    uint64_t& sv =  boost::get<uint64_t>(jt->second);
-                    sv = sv + boost::get<uint64_t>(kt->second);
-                } catch (boost::bad_get& ex) {
-                    QE_ASSERT(0);
-                } catch (const std::out_of_range& oor) {
-                    QE_ASSERT(0);
-                }     
-            }
-            if (jt->first.first == QEOpServerProxy::MAX) {
-                StatsSelect::StatVal & sv = jt->second;
-                try {
-                    if (sv.which() == QEOpServerProxy::UINT64) {
-                        uint64_t& existing_max = boost::get<uint64_t>(jt->second);
-                        existing_max = (existing_max > (boost::get<uint64_t>(kt->second))) ? existing_max:(boost::get<uint64_t>(kt->second));
-                    }
-                    if (sv.which() == QEOpServerProxy::DOUBLE) {
-                        double& existing_max = boost::get<double>(jt->second);
-                        existing_max = (existing_max > (boost::get<double>(kt->second))) ? existing_max:(boost::get<double>(kt->second));
-                    }                   
-                } catch (boost::bad_get& ex) {
-                    QE_ASSERT(0);
-                }     
-            }
-            if (jt->first.first == QEOpServerProxy::MIN) {
-                StatsSelect::StatVal & sv = jt->second;
-                try {
-                    if (sv.which() == QEOpServerProxy::UINT64) {
-                        uint64_t& existing_min = boost::get<uint64_t>(jt->second);
-                        existing_min = (existing_min < (boost::get<uint64_t>(kt->second))) ? existing_min:(boost::get<uint64_t>(kt->second));
-                    }
-                    if (sv.which() == QEOpServerProxy::DOUBLE) {
-                        double& existing_min = boost::get<double>(jt->second);
-                        existing_min = (existing_min < (boost::get<double>(kt->second))) ? existing_min:(boost::get<double>(kt->second));
-                    }                   
-                } catch (boost::bad_get& ex) {
-                    QE_ASSERT(0);
-                }     
-            }
-
+            MergeAggValue(jt->first.first, jt->second, kt->second);
         }
     }
 
@@ -391,6 +411,194 @@ std::size_t boost::hash_value(const StatsSelect::StatVal& sv) {
     return boost::hash_value(ostr.str());
 }
 
+namespace {
+
+struct SumOp {
+    template <typename T>
+    T operator()(T a, T b) const { return a + b; }
+};
+
+struct MaxOp {
+    template <typename T>
+    T operator()(T a, T b) const { return a > b ? a : b; }
+};
+
+struct MinOp {
+    template <typename T>
+    T operator()(T a, T b) const { return a < b ? a : b; }
+};
+
+// Fold a column of values into per-group accumulators. The common case of
+// a single group is a plain reduction over the column.
+template <typename T, typename Op>
+void AggregateValues(const std::vector<T>& vals, const vector<size_t>& gid,
+        Op op, std::vector<T>* acc) {
+    const T *v = vals.empty() ? NULL : &vals[0];
+    T *a = &(*acc)[0];
+    const size_t nrows = vals.size();
+    if (acc->size() == 1) {
+        T res = a[0];
+        for (size_t i = 0; i < nrows; i++) {
+            res = op(res, v[i]);
+        }
+        a[0] = res;
+        return;
+    }
+    const size_t *g = &gid[0];
+    for (size_t i = 0; i < nrows; i++) {
+        a[g[i]] = op(a[g[i]], v[i]);
+    }
+}
+
+template <typename T, typename Op>
+void AggregateTypedColumn(const std::vector<T>& vals,
+        const vector<size_t>& gid, QEOpServerProxy::AggOper oper,
+        const string& name, T init, Op op,
+        std::vector<QEOpServerProxy::AggRowT>* group_aggs) {
+    std::vector<T> acc(group_aggs->size(), init);
+    AggregateValues(vals, gid, op, &acc);
+    pair<QEOpServerProxy::AggOper,string> aggkey(oper, name);
+    for (size_t g = 0; g < acc.size(); g++) {
+        (*group_aggs)[g].insert(make_pair(aggkey, acc[g]));
+    }
+}
+
+template <typename T>
+void AppendPacked(string *key, const T& val) {
+    key->append(reinterpret_cast<const char *>(&val), sizeof(val));
+}
+
+void AppendPackedValue(string *key, const StatsSelect::StatVal& val) {
+    key->push_back(static_cast<char>(val.which()));
+    switch (val.which()) {
+        case QEOpServerProxy::STRING : {
+                const string& str = boost::get<string>(val);
+                AppendPacked(key, static_cast<uint32_t>(str.size()));
+                key->append(str);
+            }
+            break;
+        case QEOpServerProxy::UINT64 :
+            AppendPacked(key, boost::get<uint64_t>(val));
+            break;
+        case QEOpServerProxy::DOUBLE :
+            AppendPacked(key, boost::get<double>(val));
+            break;
+        case QEOpServerProxy::UUID : {
+                const boost::uuids::uuid& u =
+                    boost::get<boost::uuids::uuid>(val);
+                key->append(reinterpret_cast<const char *>(u.data), u.size());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+}  // namespace
+
+void StatsSelect::AggColumn::Reset(size_t nrows) {
+    type = QEOpServerProxy::BLANK;
+    typed = true;
+    uvals.assign(nrows, 0);
+    dvals.assign(nrows, 0);
+    vals.assign(nrows, NULL);
+}
+
+size_t StatsSelect::FindRowLayout(const vector<StatEntry>& entries,
+        vector<RowLayout>* layouts) const {
+    for (size_t idx = 0; idx < layouts->size(); idx++) {
+        const RowLayout& layout = (*layouts)[idx];
+        if (layout.names.size() != entries.size()) {
+            continue;
+        }
+        size_t pos = 0;
+        while (pos < entries.size() && layout.names[pos] == entries[pos].name) {
+            pos++;
+        }
+        if (pos == entries.size()) {
+            return idx;
+        }
+    }
+    RowLayout layout;
+    for (size_t pos = 0; pos < entries.size(); pos++) {
+        const string& name = entries[pos].name;
+        layout.names.push_back(name);
+        layout.unik.push_back(unik_cols_.find(name) != unik_cols_.end());
+        map<string, int>::const_iterator it = agg_column_index_.find(name);
+        layout.column.push_back(it != agg_column_index_.end() ?
+                                it->second : -1);
+    }
+    layouts->push_back(layout);
+    return layouts->size() - 1;
+}
+
+void StatsSelect::AggregateColumn(const AggColumn& col,
+        const vector<size_t>& gid, const vector<size_t>& first_row,
+        vector<QEOpServerProxy::AggRowT>* group_aggs) const {
+    if (col.typed && col.type == QEOpServerProxy::UINT64) {
+        if (col.sum) {
+            AggregateTypedColumn(col.uvals, gid, QEOpServerProxy::SUM,
+                col.name, (uint64_t) 0, SumOp(), group_aggs);
+        }
+        if (col.max) {
+            AggregateTypedColumn(col.uvals, gid, QEOpServerProxy::MAX,
+                col.name, std::numeric_limits<uint64_t>::min(), MaxOp(),
+                group_aggs);
+        }
+        if (col.min) {
+            AggregateTypedColumn(col.uvals, gid, QEOpServerProxy::MIN,
+                col.name, std::numeric_limits<uint64_t>::max(), MinOp(),
+                group_aggs);
+        }
+        return;
+    }
+    if (col.typed && col.type == QEOpServerProxy::DOUBLE) {
+        if (col.sum) {
+            AggregateTypedColumn(col.dvals, gid, QEOpServerProxy::SUM,
+                col.name, 0.0, SumOp(), group_aggs);
+        }
+        if (col.max) {
+            AggregateTypedColumn(col.dvals, gid, QEOpServerProxy::MAX,
+                col.name, -std::numeric_limits<double>::infinity(), MaxOp(),
+                group_aggs);
+        }
+        if (col.min) {
+            AggregateTypedColumn(col.dvals, gid, QEOpServerProxy::MIN,
+                col.name, std::numeric_limits<double>::infinity(), MinOp(),
+                group_aggs);
+        }
+        return;
+    }
+
+    // Values that are missing from some rows or not uniformly numeric are
+    // merged a row at a time, as MergeAggRow would: the group has the
+    // aggregate only if its first row has the attribute.
+    vector<QEOpServerProxy::AggOper> opers;
+    if (col.sum) opers.push_back(QEOpServerProxy::SUM);
+    if (col.max) opers.push_back(QEOpServerProxy::MAX);
+    if (col.min) opers.push_back(QEOpServerProxy::MIN);
+    for (size_t op = 0; op < opers.size(); op++) {
+        vector<StatVal> acc(first_row.size());
+        for (size_t i = 0; i < gid.size(); i++) {
+            const StatVal *val = col.vals[i];
+            size_t g = gid[i];
+            if (i == first_row[g]) {
+                if (val) {
+                    acc[g] = *val;
+                }
+            } else if (val && acc[g].which() != QEOpServerProxy::BLANK) {
+                MergeAggValue(opers[op], acc[g], *val);
+            }
+        }
+        pair<QEOpServerProxy::AggOper,string> aggkey(opers[op], col.name);
+        for (size_t g = 0; g < acc.size(); g++) {
+            if (acc[g].which() != QEOpServerProxy::BLANK) {
+                (*group_aggs)[g].insert(make_pair(aggkey, acc[g]));
+            }
+        }
+    }
+}
+
 bool StatsSelect::LoadRow(boost::uuids::uuid u,
 		uint64_t timestamp, const vector<StatEntry>& row, MapBufT& output) {
 
@@ -490,3 +698,162 @@ bool StatsSelect::LoadRow(boost::uuids::uuid u,
     return true;
 }
 
+bool StatsSelect::LoadRows(const vector<StatRow>& rows, MapBufT& output) {
+
+	if (!Status()) return false;
+
+    const size_t nrows = rows.size();
+    if (!nrows) return true;
+    bool uuid_unik = unik_cols_.find(g_viz_constants.STAT_UUID_FIELD) !=
+        unik_cols_.end();
+    vector<AggColumn> columns(agg_columns_);
+    for (size_t c = 0; c < columns.size(); c++) {
+        columns[c].Reset(nrows);
+    }
+
+    // Group the rows by their non-aggregate columns, packed into a string
+    // along with the row layout, and gather the aggregated columns.
+    typedef boost::unordered_map<string, size_t> GroupMap;
+    GroupMap groups;
+    vector<RowLayout> layouts;
+    vector<size_t> gid(nrows);
+    vector<size_t> first_row;
+    string key;
+    for (size_t i = 0; i < nrows; i++) {
+        const StatRow& row = rows[i];
+        size_t lidx = FindRowLayout(row.entries, &layouts);
+        const RowLayout& layout = layouts[lidx];
+        key.clear();
+        AppendPacked(&key, lidx);
+        if (uuid_unik) {
+            key.append(reinterpret_cast<const char *>(row.uuid.data),
+                       row.uuid.size());
+        }
+        if (isT_) {
+            AppendPacked(&key, row.timestamp);
+        }
+        if (ts_period_) {
+            AppendPacked(&key, row.timestamp - (row.timestamp % ts_period_));
+        }
+        for (size_t pos = 0; pos < row.entries.size(); pos++) {
+            const StatVal& val = row.entries[pos].value;
+            if (layout.unik[pos]) {
+                AppendPackedValue(&key, val);
+            }
+            if (layout.column[pos] < 0) {
+                continue;
+            }
+            AggColumn& col = columns[layout.column[pos]];
+            if (col.vals[i]) {
+                continue;
+            }
+            col.vals[i] = &val;
+            if (col.type == QEOpServerProxy::BLANK) {
+                col.type = val.which();
+            }
+            if (val.which() != col.type) {
+                col.typed = false;
+            } else if (col.type == QEOpServerProxy::UINT64) {
+                col.uvals[i] = boost::get<uint64_t>(val);
+            } else if (col.type == QEOpServerProxy::DOUBLE) {
+                col.dvals[i] = boost::get<double>(val);
+            } else {
+                col.typed = false;
+            }
+        }
+        pair<GroupMap::iterator, bool> ret =
+            groups.insert(make_pair(key, first_row.size()));
+        if (ret.second) {
+            first_row.push_back(i);
+        }
+        gid[i] = ret.first->second;
+    }
+    const size_t ngroups = first_row.size();
+    if (ngroups * kMinLoadBatchReduction > nrows) {
+        batch_load_ = false;
+    }
+
+    // Aggregate a column at a time
+    vector<QEOpServerProxy::AggRowT> group_aggs(ngroups);
+    for (size_t c = 0; c < columns.size(); c++) {
+        AggColumn& col = columns[c];
+        if (std::find(col.vals.begin(), col.vals.end(),
+                      static_cast<const StatVal *>(NULL)) != col.vals.end()) {
+            col.typed = false;
+        }
+        AggregateColumn(col, gid, first_row, &group_aggs);
+    }
+    if (!count_field_.empty()) {
+        vector<uint64_t> counts(ngroups, 0);
+        for (size_t i = 0; i < nrows; i++) {
+            counts[gid[i]]++;
+        }
+        pair<QEOpServerProxy::AggOper,string> aggkey(QEOpServerProxy::COUNT,count_field_);
+        for (size_t g = 0; g < ngroups; g++) {
+            group_aggs[g].insert(make_pair(aggkey, counts[g]));
+        }
+    }
+
+    // Merge each group into the output, keyed by its first row
+    for (size_t g = 0; g < ngroups; g++) {
+        const StatRow& row = rows[first_row[g]];
+        QEOpServerProxy::AggRowT& narows = group_aggs[g];
+
+        // Build Uniks map
+        StatMap uniks;
+        if (uuid_unik) {
+            uniks.insert(make_pair(g_viz_constants.STAT_UUID_FIELD,row.uuid));
+        }
+        if (isT_) {
+            uniks.insert(make_pair(g_viz_constants.STAT_TIME_FIELD,row.timestamp)); 
+        }
+        if (ts_period_) {
+            uint64_t ts = row.timestamp - (row.timestamp % ts_period_);
+            uniks.insert(make_pair(g_viz_constants.STAT_TIMEBIN_FIELD,ts)); 
+        }
+        for (vector<StatEntry>::const_iterator it = row.entries.begin();
+                it != row.entries.end(); it++) {
+            set<string>::const_iterator uit = unik_cols_.find(it->name);
+            if (uit!=unik_cols_.end()) {
+                uniks.insert(make_pair(it->name, it->value));
+            }
+        }
+
+        // Build sort vector
+        // Last slot is reserved for the hash
+        std::vector<StatVal> ukey(sort_cols_.size() + agg_sort_cols_.size() + 1);
+        size_t hash_slot = sort_cols_.size() + agg_sort_cols_.size();
+        uint64_t hash_val = boost::hash_range(uniks.begin(), uniks.end());
+        ukey[hash_slot] = hash_val;
+
+        for (map<string, size_t>::const_iterator st = sort_cols_.begin();
+                st!=sort_cols_.end(); st++) {
+            QE_ASSERT(uniks.find(st->first) != uniks.end());
+            ukey[st->second] = uniks.at(st->first);
+        }
+
+        // CLASS is not merged, so it only depends on the first row
+        for (std::set<std::string>::const_iterator ct = class_cols_.begin();
+                ct!=class_cols_.end(); ct++) {
+            pair<QEOpServerProxy::AggOper,string> aggkey(QEOpServerProxy::CLASS,*ct);
+            StatMap huniks;
+            for (vector<StatEntry>::const_iterator rit = row.entries.begin();
+                    rit != row.entries.end(); rit++) {
+                if (rit->name != *ct) {
+                    if (uniks.find(rit->name) != uniks.end()) {
+                        // For generating the hash, consider all attributes that 
+                        // are in the row, and that do not match the CLASS attribute,
+                        // and that are in non-aggregate attributes in the SELECT
+                        huniks[rit->name] = rit->value;
+                    }
+                }
+            }
+            uint64_t hh = boost::hash_range(huniks.begin(), huniks.end());
+            narows.insert(make_pair(aggkey, hh));
+        }
+
+        MergeFullRow(ukey, uniks, narows, output);
+    }
+
+    return true;
+}
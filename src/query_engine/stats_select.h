@@ -35,6 +35,15 @@ public:
         std::string name;
         StatVal value;
     };
+    struct StatRow {
+        boost::uuids::uuid uuid;
+        uint64_t timestamp;
+        std::vector<StatEntry> entries;
+    };
+    static const size_t kLoadBatchSize = 8192;
+    // A batch has to have at least this many rows per output group on
+    // average for LoadRows to be used for the rest of the query.
+    static const size_t kMinLoadBatchReduction = 2;
 
     StatsSelect(AnalyticsQuery * main_query, const std::vector<std::string> & select_fields);
 
@@ -46,6 +55,17 @@ public:
     bool LoadRow(boost::uuids::uuid u, uint64_t timestamp,
             const std::vector<StatEntry>& row, MapBufT& output);
 
+    // Same as LoadRow for a batch of rows. The rows are grouped by their
+    // non-aggregate columns first, and the numeric aggregates are computed
+    // a column at a time over the batch, so that output is only merged
+    // once per group.
+    bool LoadRows(const std::vector<StatRow>& rows, MapBufT& output);
+
+    // Whether the rows should be loaded in batches with LoadRows. Not when
+    // T is in the SELECT, as every row then is its own group, nor after a
+    // batch has been loaded that did not reduce the rows enough.
+    bool IsBatchLoadNeeded() const { return batch_load_ && !isT_; }
+
     bool Status() { return status_; }
 
     bool IsMergeNeeded() { return !isT_; }
@@ -58,7 +78,40 @@ public:
             const QEOpServerProxy::AggRowT&, std::string& jstr);
 
 private:
+    // Names of a sequence of row entries, and the role of each entry
+    struct RowLayout {
+        std::vector<std::string> names;
+        std::vector<bool> unik;
+        std::vector<int> column;
+    };
+    // Values of an attribute that is SUM, MAX or MIN aggregated.
+    // The column is typed if every row of the batch has a value of the
+    // same numeric type, otherwise it is aggregated through StatVal.
+    struct AggColumn {
+        explicit AggColumn(const std::string &n) :
+            name(n), sum(false), max(false), min(false),
+            type(QEOpServerProxy::BLANK), typed(true) {
+        }
+        void Reset(size_t nrows);
+        std::string name;
+        bool sum;
+        bool max;
+        bool min;
+        int type;
+        bool typed;
+        std::vector<uint64_t> uvals;
+        std::vector<double> dvals;
+        std::vector<const StatVal *> vals;
+    };
 
+    size_t FindRowLayout(const std::vector<StatEntry>& entries,
+            std::vector<RowLayout>* layouts) const;
+    void AggregateColumn(const AggColumn& col, const std::vector<size_t>& gid,
+            const std::vector<size_t>& first_row,
+            std::vector<QEOpServerProxy::AggRowT>* group_aggs) const;
+
+    static void MergeAggValue(QEOpServerProxy::AggOper oper, StatVal& sv,
+            const StatVal& nv);
     static void MergeAggRow(QEOpServerProxy::AggRowT &arows,
             const QEOpServerProxy::AggRowT &narows);
     static void MergeFullRow(
@@ -69,6 +122,7 @@ private:
 
     bool isStatic_;
     bool status_;
+    bool batch_load_;
 
     AnalyticsQuery * const main_query;
     const std::vector<std::string> select_fields_;
@@ -102,5 +156,9 @@ private:
     std::set<std::string> max_field_;
     std::set<std::string> min_field_;
 
+    // SUM, MAX and MIN aggregated attributes, without values
+    std::vector<AggColumn> agg_columns_;
+    std::map<std::string, int> agg_column_index_;
+
 };
 #endif
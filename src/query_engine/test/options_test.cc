@@ -85,6 +85,9 @@ TEST_F(OptionsTest, NoArguments) {
     EXPECT_EQ(options_.start_time(), 0);
     EXPECT_EQ(options_.max_tasks(), 0);
     EXPECT_EQ(options_.max_slice(), 100);
+    EXPECT_EQ(options_.query_cache_size(), 64);
+    EXPECT_EQ(options_.query_cache_ttl(), 300);
+    EXPECT_EQ(options_.partition_filter(), false);
     EXPECT_EQ(options_.test_mode(), false);
     EXPECT_EQ(options_.sandesh_send_rate_limit(), 0);
 }
@@ -126,6 +129,9 @@ TEST_F(OptionsTest, DefaultConfFile) {
     EXPECT_EQ(options_.start_time(), 0);
     EXPECT_EQ(options_.max_tasks(), 0);
     EXPECT_EQ(options_.max_slice(), 100);
+    EXPECT_EQ(options_.query_cache_size(), 64);
+    EXPECT_EQ(options_.query_cache_ttl(), 300);
+    EXPECT_EQ(options_.partition_filter(), false);
     EXPECT_EQ(options_.test_mode(), false);
     EXPECT_EQ(options_.sandesh_send_rate_limit(), 100);
 }
@@ -170,6 +176,9 @@ TEST_F(OptionsTest, OverrideStringFromCommandLine) {
     EXPECT_EQ(options_.start_time(), 0);
     EXPECT_EQ(options_.max_tasks(), 0);
     EXPECT_EQ(options_.max_slice(), 100);
+    EXPECT_EQ(options_.query_cache_size(), 64);
+    EXPECT_EQ(options_.query_cache_ttl(), 300);
+    EXPECT_EQ(options_.partition_filter(), false);
     EXPECT_EQ(options_.test_mode(), false);
     EXPECT_EQ(options_.sandesh_send_rate_limit(), 5);
 }
@@ -212,6 +221,9 @@ TEST_F(OptionsTest, OverrideBooleanFromCommandLine) {
     EXPECT_EQ(options_.start_time(), 0);
     EXPECT_EQ(options_.max_tasks(), 0);
     EXPECT_EQ(options_.max_slice(), 100);
+    EXPECT_EQ(options_.query_cache_size(), 64);
+    EXPECT_EQ(options_.query_cache_ttl(), 300);
+    EXPECT_EQ(options_.partition_filter(), false);
     EXPECT_EQ(options_.test_mode(), true); // Overridden from command line.
 }
 
@@ -238,6 +250,9 @@ TEST_F(OptionsTest, CustomConfigFile) {
         "start_time=123456\n"
         "max_tasks=200\n"
         "max_slice=500\n"
+        "query_cache_size=128\n"
+        "query_cache_ttl=60\n"
+        "partition_filter=1\n"
         "sandesh_send_rate_limit=5\n"
         "\n"
         "[DISCOVERY]\n"
@@ -312,6 +327,9 @@ TEST_F(OptionsTest, CustomConfigFile) {
     EXPECT_EQ(options_.start_time(), 123456);
     EXPECT_EQ(options_.max_tasks(), 200);
     EXPECT_EQ(options_.max_slice(), 500);
+    EXPECT_EQ(options_.query_cache_size(), 128);
+    EXPECT_EQ(options_.query_cache_ttl(), 60);
+    EXPECT_EQ(options_.partition_filter(), true);
     EXPECT_EQ(options_.test_mode(), true);
     EXPECT_EQ(options_.cassandra_user(), "cassandra1");
     EXPECT_EQ(options_.cassandra_password(), "cassandra1");
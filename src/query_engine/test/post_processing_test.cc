@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "testing/gunit.h"
+
+#include "base/time_util.h"
+#include "query.h"
+#include "analytics_query_mock.h"
+
+using ::testing::Return;
+using ::testing::AnyNumber;
+
+static const int kHoursPerWeek = 7 * 24;
+static const int kRowsPerChunk = 2000;
+static const int kParallelInstances = 4;
+static const int kLimit = 100;
+
+class PostProcessingTest : public ::testing::Test {
+public:
+    PostProcessingTest() {
+    }
+
+    ~PostProcessingTest() {
+    }
+
+    void default_expect_init(AnalyticsQueryMock& aqmock,
+                             const std::string& table) {
+        EXPECT_CALL(aqmock, table())
+            .Times(AnyNumber())
+            .WillRepeatedly(Return(table));
+        EXPECT_CALL(aqmock, is_object_table_query())
+            .Times(AnyNumber())
+            .WillRepeatedly(Return(false));
+        EXPECT_CALL(aqmock, is_flow_query())
+            .Times(AnyNumber())
+            .WillRepeatedly(Return(table == g_viz_constants.FLOW_TABLE));
+        EXPECT_CALL(aqmock, is_query_parallelized())
+            .Times(AnyNumber())
+            .WillRepeatedly(Return(true));
+    }
+
+    // Sort descending on setup_time, limit kLimit
+    PostProcessingQuery *create_query(AnalyticsQueryMock& aqmock) {
+        std::map<std::string, std::string> json_post;
+        PostProcessingQuery *query =
+            new PostProcessingQuery(json_post, &aqmock);
+        query->sorted = true;
+        query->sorting_type = DESCENDING;
+        query->sort_fields.push_back(sort_field_t("setup_time", "long"));
+        query->limit = kLimit;
+        return query;
+    }
+
+    static QEOpServerProxy::ResultRowT flow_record(uint64_t uuid,
+                                                   uint64_t setup_time) {
+        QEOpServerProxy::ResultRowT row;
+        row.first[g_viz_constants.UUID_KEY] = integerToString(uuid);
+        row.first["setup_time"] = integerToString(setup_time);
+        row.first["sourcevn"] = "default-domain:admin:vn1";
+        row.first["destvn"] = "default-domain:admin:vn2";
+        row.first["sourceip"] = "10.1.1.1";
+        row.first["destip"] = "10.1.1.2";
+        return row;
+    }
+
+    // Flow records set up during the given hour of the week, sorted in
+    // descending order of setup_time as produced by process_query.
+    static void hour_chunk(int hour, QEOpServerProxy::BufferT *chunk) {
+        uint64_t hour_start = hour * 3600ULL * 1000000;
+        for (int i = 0; i < kRowsPerChunk; i++) {
+            uint64_t offset = ((hour * kRowsPerChunk + i) * 2654435761ULL) %
+                (3600ULL * 1000000);
+            chunk->push_back(flow_record(hour * kRowsPerChunk + i,
+                                         hour_start + offset));
+        }
+        uint64_t setup_time;
+        std::vector<std::pair<uint64_t, size_t> > order;
+        for (size_t i = 0; i < chunk->size(); i++) {
+            stringToInteger(chunk->at(i).first["setup_time"], setup_time);
+            order.push_back(std::make_pair(setup_time, i));
+        }
+        std::sort(order.rbegin(), order.rend());
+        QEOpServerProxy::BufferT sorted_chunk;
+        for (size_t i = 0; i < order.size(); i++) {
+            sorted_chunk.push_back(chunk->at(order[i].second));
+        }
+        chunk->swap(sorted_chunk);
+    }
+};
+
+// Merge the chunks of a 1-week FlowRecordTable query sorted on setup_time
+// with limit 100, and compare the peak number of rows held and the latency
+// with concatenating and sorting all the chunk results.
+TEST_F(PostProcessingTest, FlowRecordTopN) {
+    AnalyticsQueryMock analytics_query_mock;
+    default_expect_init(analytics_query_mock, g_viz_constants.FLOW_TABLE);
+    std::auto_ptr<PostProcessingQuery> query(
+        create_query(analytics_query_mock));
+
+    std::vector<QEOpServerProxy::BufferT> chunks(kHoursPerWeek);
+    for (int hour = 0; hour < kHoursPerWeek; hour++) {
+        hour_chunk(hour, &chunks[hour]);
+    }
+
+    // Concatenate and sort
+    uint64_t start = UTCTimestampUsec();
+    QEOpServerProxy::BufferT full_result;
+    for (int hour = 0; hour < kHoursPerWeek; hour++) {
+        full_result.insert(full_result.end(), chunks[hour].begin(),
+                           chunks[hour].end());
+    }
+    size_t full_peak_rows = full_result.size();
+    std::sort(full_result.rbegin(), full_result.rend(),
+              boost::bind(&PostProcessingQuery::sort_field_comparator,
+                          query.get(), _1, _2));
+    full_result.resize(kLimit);
+    uint64_t full_usecs = UTCTimestampUsec() - start;
+
+    // Accumulate the chunks on each parallel instance and merge.
+    start = UTCTimestampUsec();
+    std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> > instances;
+    for (int i = 0; i < kParallelInstances; i++) {
+        instances.push_back(boost::shared_ptr<QEOpServerProxy::BufferT>(
+            new QEOpServerProxy::BufferT));
+    }
+    size_t peak_rows = 0;
+    for (int hour = 0; hour < kHoursPerWeek; hour++) {
+        QEOpServerProxy::BufferT& output = *instances[hour % kParallelInstances];
+        EXPECT_TRUE(query->merge_processing(chunks[hour], output));
+        size_t rows = 0;
+        for (int i = 0; i < kParallelInstances; i++) {
+            rows += instances[i]->size();
+        }
+        peak_rows = std::max(peak_rows, rows);
+    }
+    QEOpServerProxy::BufferT result;
+    EXPECT_TRUE(query->final_merge_processing(instances, result));
+    uint64_t merge_usecs = UTCTimestampUsec() - start;
+
+    ASSERT_EQ(kLimit, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(full_result[i].first["setup_time"],
+                  result[i].first["setup_time"]);
+    }
+    EXPECT_LE(peak_rows, (size_t)kParallelInstances * kLimit);
+
+    std::cout << "FlowRecordTable 1 week, " << kHoursPerWeek * kRowsPerChunk
+              << " rows, limit " << kLimit << ": concatenate and sort "
+              << full_usecs / 1000 << " msec, peak " << full_peak_rows
+              << " rows; streaming merge " << merge_usecs / 1000
+              << " msec, peak " << peak_rows << " rows" << std::endl;
+}
+
+// Flow records that are returned by more than one chunk are only counted
+// once towards the limit.
+TEST_F(PostProcessingTest, FlowRecordUniquify) {
+    AnalyticsQueryMock analytics_query_mock;
+    default_expect_init(analytics_query_mock, g_viz_constants.FLOW_TABLE);
+    std::auto_ptr<PostProcessingQuery> query(
+        create_query(analytics_query_mock));
+    query->limit = 3;
+
+    boost::shared_ptr<QEOpServerProxy::BufferT> run1(
+        new QEOpServerProxy::BufferT);
+    run1->push_back(flow_record(1, 50));
+    run1->push_back(flow_record(2, 40));
+    run1->push_back(flow_record(3, 30));
+    boost::shared_ptr<QEOpServerProxy::BufferT> run2(
+        new QEOpServerProxy::BufferT);
+    run2->push_back(flow_record(1, 50));
+    run2->push_back(flow_record(2, 40));
+    run2->push_back(flow_record(4, 20));
+    std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> > runs;
+    runs.push_back(run1);
+    runs.push_back(run2);
+
+    QEOpServerProxy::BufferT result;
+    EXPECT_TRUE(query->final_merge_processing(runs, result));
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ("1", result[0].first[g_viz_constants.UUID_KEY]);
+    EXPECT_EQ("2", result[1].first[g_viz_constants.UUID_KEY]);
+    EXPECT_EQ("3", result[2].first[g_viz_constants.UUID_KEY]);
+}
+
+// Only unsorted queries that do not aggregate rows can stop fetching chunks
+// once the limit has been reached.
+TEST_F(PostProcessingTest, SatisfyingRowCount) {
+    AnalyticsQueryMock flow_query_mock;
+    default_expect_init(flow_query_mock, g_viz_constants.FLOW_TABLE);
+    std::auto_ptr<PostProcessingQuery> flow_query(
+        create_query(flow_query_mock));
+    EXPECT_EQ(0, flow_query->satisfying_row_count());
+    flow_query->sorted = false;
+    EXPECT_EQ(0, flow_query->satisfying_row_count());
+
+    AnalyticsQueryMock message_query_mock;
+    default_expect_init(message_query_mock,
+                        g_viz_constants.COLLECTOR_GLOBAL_TABLE);
+    std::auto_ptr<PostProcessingQuery> message_query(
+        create_query(message_query_mock));
+    EXPECT_EQ(0, message_query->satisfying_row_count());
+    message_query->sorted = false;
+    EXPECT_EQ(kLimit, message_query->satisfying_row_count());
+    message_query->limit = 0;
+    EXPECT_EQ(0, message_query->satisfying_row_count());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
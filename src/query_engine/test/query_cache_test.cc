@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "testing/gunit.h"
+
+#include <boost/assign/list_of.hpp>
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "query_engine/json_parse.h"
+#include "query_engine/qe_types.h"
+#include "query_engine/query_cache.h"
+
+using std::auto_ptr;
+using std::map;
+using std::string;
+using boost::assign::map_list_of;
+
+static const uint64_t kTtl = 300 * 1000000ULL;
+
+class QueryCacheTest : public ::testing::Test {
+protected:
+    static map<string, string> Terms(const string &start_time) {
+        return map_list_of<string, string>
+            (QUERY_TABLE, "\"StatTable.VirtualMachineStats.cpu_stats\"")
+            (QUERY_START_TIME, start_time)
+            (QUERY_END_TIME, "\"now\"")
+            (QUERY_SELECT, "[\"name\", \"SUM(cpu_stats.cpu_one_min_avg)\"]")
+            (QUERY_WHERE, "[[{\"name\": \"name\", \"value\": \"vm\", "
+                          "\"op\": 7}]]");
+    }
+
+    static void Result(int rows, QEOpServerProxy::BufferT *result,
+                       QEOpServerProxy::OutRowMultimapT *mresult) {
+        for (int i = 0; i < rows; i++) {
+            QEOpServerProxy::OutRowT row;
+            row["name"] = "vm-" + integerToString(i);
+            row["SUM(cpu_stats.cpu_one_min_avg)"] = integerToString(i * 10);
+            result->push_back(std::make_pair(row,
+                QEOpServerProxy::MetadataT()));
+
+            std::vector<QEOpServerProxy::SubVal> ukey;
+            ukey.push_back((uint64_t) i);
+            std::map<string, QEOpServerProxy::SubVal> uniks;
+            uniks["name"] = row["name"];
+            QEOpServerProxy::AggRowT aggs;
+            aggs[std::make_pair(QEOpServerProxy::SUM,
+                                string("cpu_stats.cpu_one_min_avg"))] =
+                (double) i * 10;
+            mresult->insert(std::make_pair(ukey,
+                std::make_pair(uniks, aggs)));
+        }
+    }
+
+    static size_t ResultBytes(int rows) {
+        QEOpServerProxy::BufferT result;
+        QEOpServerProxy::OutRowMultimapT mresult;
+        Result(rows, &result, &mresult);
+        return QueryResultCache::ResultBytes(result, mresult);
+    }
+
+    static void Add(QueryResultCache *cache, const string &key, uint64_t now,
+                    int rows) {
+        QEOpServerProxy::BufferT result;
+        QEOpServerProxy::OutRowMultimapT mresult;
+        Result(rows, &result, &mresult);
+        cache->Add(key, now, result, mresult);
+    }
+
+    static bool Lookup(QueryResultCache *cache, const string &key,
+                       uint64_t now, size_t *rows) {
+        auto_ptr<QEOpServerProxy::BufferT> result;
+        auto_ptr<QEOpServerProxy::OutRowMultimapT> mresult;
+        if (!cache->Lookup(key, now, &result, &mresult)) {
+            return false;
+        }
+        EXPECT_EQ(result->size(), mresult->size());
+        *rows = result->size();
+        return true;
+    }
+};
+
+// The key depends on the chunk time range, but not on the requested time
+// range of the query.
+TEST_F(QueryCacheTest, Key) {
+    EXPECT_EQ(QueryResultCache::Key(Terms("\"now-10m\""), 100, 200),
+              QueryResultCache::Key(Terms("\"now-1h\""), 100, 200));
+    EXPECT_NE(QueryResultCache::Key(Terms("\"now-10m\""), 100, 200),
+              QueryResultCache::Key(Terms("\"now-10m\""), 200, 300));
+    map<string, string> terms(Terms("\"now-10m\""));
+    terms[QUERY_WHERE] = "[[{\"name\": \"name\", \"value\": \"vn\", "
+                         "\"op\": 7}]]";
+    EXPECT_NE(QueryResultCache::Key(Terms("\"now-10m\""), 100, 200),
+              QueryResultCache::Key(terms, 100, 200));
+}
+
+// Only chunks that ended at least kSettleTime ago are cached.
+TEST_F(QueryCacheTest, Cacheable) {
+    QueryResultCache cache(1024 * 1024, kTtl);
+    uint64_t now = 3600 * 1000000ULL;
+    EXPECT_TRUE(cache.IsCacheable(now - QueryResultCache::kSettleTime, now));
+    EXPECT_FALSE(cache.IsCacheable(now - QueryResultCache::kSettleTime + 1,
+                                   now));
+    QueryResultCache disabled(0, kTtl);
+    EXPECT_FALSE(disabled.IsCacheable(0, now));
+}
+
+TEST_F(QueryCacheTest, HitMiss) {
+    QueryResultCache cache(1024 * 1024, kTtl);
+    string key(QueryResultCache::Key(Terms("\"now-10m\""), 100, 200));
+    size_t rows = 0;
+    EXPECT_FALSE(Lookup(&cache, key, 1000, &rows));
+    Add(&cache, key, 1000, 10);
+    EXPECT_TRUE(Lookup(&cache, key, 2000, &rows));
+    EXPECT_EQ(10, rows);
+    EXPECT_TRUE(Lookup(&cache, key, 3000, &rows));
+    EXPECT_EQ(2, cache.hits());
+    EXPECT_EQ(1, cache.misses());
+    EXPECT_EQ(1, cache.Size());
+
+    // Replacing the entry keeps the size accounting right
+    Add(&cache, key, 4000, 20);
+    EXPECT_EQ(1, cache.Size());
+    EXPECT_EQ(key.capacity() + ResultBytes(20), cache.Bytes());
+    EXPECT_TRUE(Lookup(&cache, key, 5000, &rows));
+    EXPECT_EQ(20, rows);
+
+    QueryCacheStats stats;
+    cache.GetStats(&stats);
+    EXPECT_EQ(3, stats.get_hits());
+    EXPECT_EQ(1, stats.get_misses());
+    EXPECT_EQ(2, stats.get_adds());
+    EXPECT_EQ(1, stats.get_entries());
+    EXPECT_EQ(300, stats.get_ttl());
+}
+
+// Entries are not returned once their ttl has passed.
+TEST_F(QueryCacheTest, Expiry) {
+    QueryResultCache cache(1024 * 1024, kTtl);
+    string key(QueryResultCache::Key(Terms("\"now-10m\""), 100, 200));
+    size_t rows = 0;
+    Add(&cache, key, 1000, 10);
+    EXPECT_TRUE(Lookup(&cache, key, 1000 + kTtl - 1, &rows));
+    EXPECT_FALSE(Lookup(&cache, key, 1000 + kTtl, &rows));
+    EXPECT_EQ(1, cache.expirations());
+    EXPECT_EQ(0, cache.Size());
+    EXPECT_EQ(0, cache.Bytes());
+}
+
+// The least recently used entries are evicted to stay within max_bytes.
+TEST_F(QueryCacheTest, Eviction) {
+    string key0(QueryResultCache::Key(Terms("\"now-1h\""), 1000, 1100));
+    size_t entry_bytes = key0.capacity() + ResultBytes(100);
+    QueryResultCache cache(3 * entry_bytes + entry_bytes / 2, kTtl);
+    std::vector<string> keys;
+    for (int i = 0; i < 4; i++) {
+        keys.push_back(QueryResultCache::Key(Terms("\"now-1h\""),
+                                             1000 + i * 100,
+                                             1100 + i * 100));
+        ASSERT_EQ(key0.size(), keys[i].size());
+    }
+    size_t rows = 0;
+    Add(&cache, keys[0], 1000, 100);
+    Add(&cache, keys[1], 1000, 100);
+    Add(&cache, keys[2], 1000, 100);
+    EXPECT_EQ(3, cache.Size());
+
+    // Use keys[0], so that keys[1] is evicted to make room for keys[3]
+    EXPECT_TRUE(Lookup(&cache, keys[0], 2000, &rows));
+    Add(&cache, keys[3], 2000, 100);
+    EXPECT_EQ(3, cache.Size());
+    EXPECT_EQ(1, cache.evictions());
+    EXPECT_LE(cache.Bytes(), 3 * entry_bytes + entry_bytes / 2);
+    EXPECT_TRUE(Lookup(&cache, keys[0], 3000, &rows));
+    EXPECT_FALSE(Lookup(&cache, keys[1], 3000, &rows));
+    EXPECT_TRUE(Lookup(&cache, keys[2], 3000, &rows));
+    EXPECT_TRUE(Lookup(&cache, keys[3], 3000, &rows));
+
+    // A result larger than the cache is not added
+    QueryResultCache small(entry_bytes / 2, kTtl);
+    Add(&small, keys[0], 1000, 100);
+    EXPECT_EQ(0, small.Size());
+}
+
+// A query over a sliding window of 16 aligned time slices only misses on
+// its first and last chunk once the cache is warm.
+TEST_F(QueryCacheTest, SlidingWindow) {
+    QueryResultCache cache(16 * 1024 * 1024, kTtl);
+    const uint64_t slice = 1ULL << 28;
+    const uint64_t window = 16 * slice;
+    uint64_t now = 1000 * slice + QueryResultCache::kSettleTime;
+    size_t rows = 0;
+    int queried = 0;
+    for (int run = 0; run < 10; run++) {
+        uint64_t end_time = now;
+        uint64_t from_time = end_time - window;
+        uint64_t base = from_time - from_time % slice;
+        for (uint64_t start = base; start < end_time; start += slice) {
+            uint64_t chunk_from = std::max(start, from_time);
+            uint64_t chunk_end = std::min(start + slice, end_time);
+            if (!cache.IsCacheable(chunk_end, now)) {
+                queried++;
+                continue;
+            }
+            string key(QueryResultCache::Key(Terms("\"now-1h\""),
+                                             chunk_from, chunk_end));
+            if (!Lookup(&cache, key, now, &rows)) {
+                queried++;
+                Add(&cache, key, now, 10);
+            }
+        }
+        now += 5 * 1000000ULL;
+    }
+    // The first run queries all 17 chunks, and the others only the first
+    // and the last one.
+    EXPECT_EQ(17 + 9 * 2, queried);
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <algorithm>
+#include <iostream>
+
+#include <testing/gunit.h>
+#include <base/time_util.h>
+#include <base/string_util.h>
+#include "../sort_keys.h"
+
+using std::string;
+using std::vector;
+
+static const size_t kBenchmarkRows = 200000;
+
+class SortKeysTest : public ::testing::Test {
+protected:
+    SortKeysTest() {
+        schema_.push_back(SortKeys::ColumnSpec("vrouter",
+            SortKeys::STRING));
+        schema_.push_back(SortKeys::ColumnSpec("bytes",
+            SortKeys::UINT64));
+    }
+
+    static QEOpServerProxy::OutRowT Row(const string &vrouter,
+                                        uint64_t bytes, uint64_t index) {
+        QEOpServerProxy::OutRowT row;
+        row["vrouter"] = vrouter;
+        row["bytes"] = integerToString(bytes);
+        row["index"] = integerToString(index);
+        row["sourcevn"] = "default-domain:admin:vn" +
+            integerToString(index % 64);
+        return row;
+    }
+
+    // Reference comparator, equivalent to comparing the row maps directly.
+    static bool MapComparator(const QEOpServerProxy::OutRowT &lhs,
+                              const QEOpServerProxy::OutRowT &rhs) {
+        const string &lhs_vrouter = lhs.find("vrouter")->second;
+        const string &rhs_vrouter = rhs.find("vrouter")->second;
+        if (lhs_vrouter < rhs_vrouter) return true;
+        if (lhs_vrouter > rhs_vrouter) return false;
+        uint64_t lhs_bytes = 0, rhs_bytes = 0;
+        stringToInteger(lhs.find("bytes")->second, lhs_bytes);
+        stringToInteger(rhs.find("bytes")->second, rhs_bytes);
+        return lhs_bytes < rhs_bytes;
+    }
+
+    SortKeys::Schema schema_;
+};
+
+TEST_F(SortKeysTest, TypeFromString) {
+    EXPECT_EQ(SortKeys::UINT64, SortKeys::TypeFromString("int"));
+    EXPECT_EQ(SortKeys::UINT64, SortKeys::TypeFromString("long"));
+    EXPECT_EQ(SortKeys::UINT64, SortKeys::TypeFromString("ipv4"));
+    EXPECT_EQ(SortKeys::STRING,
+              SortKeys::TypeFromString("string"));
+    EXPECT_EQ(SortKeys::STRING, SortKeys::TypeFromString("uuid"));
+}
+
+TEST_F(SortKeysTest, SortOrder) {
+    SortKeys result(schema_);
+    result.AppendRow(Row("b", 10, 0));
+    result.AppendRow(Row("a", 20, 1));
+    result.AppendRow(Row("b", 5, 2));
+    result.AppendRow(Row("a", 20, 3));
+    result.AppendRow(Row("c", 1, 4));
+    EXPECT_EQ(5, result.Size());
+    EXPECT_EQ(2, result.ColumnCount());
+    EXPECT_EQ(3, result.DictionarySize(0));
+    EXPECT_EQ("b", result.GetString(0, 2));
+    EXPECT_EQ(5, result.GetUint64(1, 2));
+
+    // Numeric columns compare as numbers, ties keep insertion order.
+    vector<size_t> order;
+    result.SortOrder(false, &order);
+    size_t ascending[] = { 1, 3, 2, 0, 4 };
+    EXPECT_EQ(vector<size_t>(ascending, ascending + 5), order);
+
+    result.SortOrder(true, &order);
+    size_t descending[] = { 4, 0, 2, 1, 3 };
+    EXPECT_EQ(vector<size_t>(descending, descending + 5), order);
+}
+
+TEST_F(SortKeysTest, MissingColumn) {
+    SortKeys result(schema_);
+    QEOpServerProxy::OutRowT row;
+    row["vrouter"] = "a";
+    result.AppendRow(row);
+    result.AppendRow(Row("a", 1, 0));
+    EXPECT_EQ(0, result.GetUint64(1, 0));
+
+    vector<size_t> order;
+    result.SortOrder(true, &order);
+    EXPECT_EQ(1, order[0]);
+}
+
+TEST_F(SortKeysTest, GetRow) {
+    SortKeys result(schema_);
+    result.AppendRow(Row("a", 12345678901ULL, 7));
+    QEOpServerProxy::OutRowT row;
+    result.GetRow(0, &row);
+    EXPECT_EQ(2, row.size());
+    EXPECT_EQ("a", row["vrouter"]);
+    EXPECT_EQ("12345678901", row["bytes"]);
+}
+
+// Compare sorting result rows with a comparator over the row maps against
+// sorting with typed keys and moving the rows into place.
+TEST_F(SortKeysTest, SortBenchmark) {
+    vector<QEOpServerProxy::OutRowT> rows;
+    rows.reserve(kBenchmarkRows);
+    for (size_t i = 0; i < kBenchmarkRows; ++i) {
+        uint64_t hash = (i * 2654435761ULL) % 1000003;
+        rows.push_back(Row("vrouter" + integerToString(hash % 128),
+                           hash, i));
+    }
+    vector<QEOpServerProxy::OutRowT> map_rows(rows);
+
+    uint64_t start = UTCTimestampUsec();
+    std::sort(map_rows.begin(), map_rows.end(),
+              &SortKeysTest::MapComparator);
+    uint64_t map_usecs = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    SortKeys keys(schema_);
+    keys.Reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        keys.AppendRow(rows[i]);
+    }
+    vector<size_t> order;
+    keys.SortOrder(false, &order);
+    vector<QEOpServerProxy::OutRowT> key_rows(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        key_rows[i].swap(rows[order[i]]);
+    }
+    uint64_t key_usecs = UTCTimestampUsec() - start;
+
+    ASSERT_EQ(map_rows.size(), key_rows.size());
+    for (size_t i = 0; i < map_rows.size(); ++i) {
+        EXPECT_FALSE(MapComparator(map_rows[i], key_rows[i]));
+        EXPECT_FALSE(MapComparator(key_rows[i], map_rows[i]));
+    }
+
+    std::cout << "Sort " << kBenchmarkRows << " rows: map comparator "
+              << map_usecs / 1000 << " msec, sort keys "
+              << key_usecs / 1000 << " msec" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "testing/gunit.h"
+
+#include <limits>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/uuid/nil_generator.hpp>
+
+#include "base/time_util.h"
+#include "query.h"
+#include "stats_query.h"
+#include "stats_select.h"
+#include "analytics_query_mock.h"
+
+using ::testing::Return;
+using ::testing::ReturnRef;
+using ::testing::AnyNumber;
+using boost::assign::list_of;
+
+static const std::string kVmCpuTable("StatTable.VirtualMachineStats.cpu_stats");
+static const int kBenchmarkRows = 500000;
+
+class StatsSelectTest : public ::testing::Test {
+public:
+    StatsSelectTest() : stats_query_(kVmCpuTable) {
+    }
+
+    ~StatsSelectTest() {
+    }
+
+    void default_expect_init(AnalyticsQueryMock& aqmock) {
+        EXPECT_CALL(aqmock, table())
+            .Times(AnyNumber())
+            .WillRepeatedly(Return(kVmCpuTable));
+        EXPECT_CALL(aqmock, stats())
+            .Times(AnyNumber())
+            .WillRepeatedly(ReturnRef(stats_query_));
+    }
+
+    // CPU stats sample of a VM, as parsed from the where query result
+    static StatsSelect::StatRow vm_cpu_row(int vm, uint64_t timestamp) {
+        StatsSelect::StatRow row;
+        row.uuid = boost::uuids::nil_uuid();
+        row.timestamp = timestamp;
+        add_entry(&row, "name", std::string("vm-") + integerToString(vm));
+        add_entry(&row, "cpu_stats.cpu_one_min_avg",
+                  (double)((vm + timestamp / 1000000) % 100) / 4);
+        add_entry(&row, "cpu_stats.rss",
+                  (uint64_t)(1048576 + (vm * 7919 + timestamp) % 65536));
+        add_entry(&row, "cpu_stats.virt_memory",
+                  (double)(4194304 + vm % 1024));
+        return row;
+    }
+
+    // One row per VM per second, for as many seconds as needed
+    static void vm_cpu_rows(int vms, int count,
+                            std::vector<StatsSelect::StatRow> *rows) {
+        for (int i = 0; i < count; i++) {
+            rows->push_back(vm_cpu_row(i % vms, (i / vms) * 1000000ULL));
+        }
+    }
+
+    static std::vector<std::string> select_fields() {
+        return list_of(std::string("name"))("T=60")
+            ("SUM(cpu_stats.cpu_one_min_avg)")
+            ("MAX(cpu_stats.rss)")("MIN(cpu_stats.rss)")
+            ("SUM(cpu_stats.virt_memory)")("COUNT(cpu_stats)");
+    }
+
+    // Index the output by the non-aggregate columns, as rows that hash
+    // to the same key may be stored in any order.
+    typedef std::map<StatsSelect::StatMap, QEOpServerProxy::AggRowT> ResultMap;
+    static ResultMap result_map(const StatsSelect::MapBufT& output) {
+        ResultMap result;
+        for (StatsSelect::MapBufT::const_iterator it = output.begin();
+             it != output.end(); it++) {
+            EXPECT_TRUE(result.insert(it->second).second);
+        }
+        return result;
+    }
+
+    // Load the rows one at a time, or in batches of kLoadBatchSize as
+    // SelectQuery does.
+    uint64_t load_rows(StatsSelect *select,
+                       const std::vector<StatsSelect::StatRow>& rows,
+                       bool batch, StatsSelect::MapBufT *output) {
+        std::vector<std::vector<StatsSelect::StatRow> > batches;
+        for (size_t i = 0; batch && i < rows.size();
+             i += StatsSelect::kLoadBatchSize) {
+            size_t end = std::min(rows.size(),
+                                  i + StatsSelect::kLoadBatchSize);
+            batches.push_back(std::vector<StatsSelect::StatRow>(
+                rows.begin() + i, rows.begin() + end));
+        }
+        uint64_t start = UTCTimestampUsec();
+        if (!batch) {
+            for (size_t i = 0; i < rows.size(); i++) {
+                EXPECT_TRUE(select->LoadRow(rows[i].uuid, rows[i].timestamp,
+                                            rows[i].entries, *output));
+            }
+        } else {
+            for (size_t i = 0; i < batches.size(); i++) {
+                EXPECT_TRUE(select->LoadRows(batches[i], *output));
+            }
+        }
+        return UTCTimestampUsec() - start;
+    }
+
+    void benchmark(int vms) {
+        AnalyticsQueryMock analytics_query_mock;
+        default_expect_init(analytics_query_mock);
+        StatsSelect select(&analytics_query_mock, select_fields());
+        ASSERT_TRUE(select.Status());
+        std::vector<StatsSelect::StatRow> rows;
+        vm_cpu_rows(vms, kBenchmarkRows, &rows);
+
+        StatsSelect::MapBufT row_output;
+        uint64_t row_usecs = load_rows(&select, rows, false, &row_output);
+        StatsSelect::MapBufT batch_output;
+        uint64_t batch_usecs = load_rows(&select, rows, true, &batch_output);
+        EXPECT_TRUE(result_map(row_output) == result_map(batch_output));
+
+        std::cout << kVmCpuTable << " " << kBenchmarkRows << " rows, "
+                  << batch_output.size() << " groups: LoadRow "
+                  << kBenchmarkRows * 1000000ULL / (row_usecs ? row_usecs : 1)
+                  << " rows/sec, LoadRows "
+                  << kBenchmarkRows * 1000000ULL /
+                     (batch_usecs ? batch_usecs : 1)
+                  << " rows/sec" << std::endl;
+    }
+
+    template <typename T>
+    static void add_entry(StatsSelect::StatRow *row, const std::string& name,
+                          const T& value) {
+        StatsSelect::StatEntry entry;
+        entry.name = name;
+        entry.value = value;
+        row->entries.push_back(entry);
+    }
+
+    template <typename T>
+    static T agg_value(const QEOpServerProxy::AggRowT& arows,
+                       QEOpServerProxy::AggOper oper,
+                       const std::string& name) {
+        QEOpServerProxy::AggRowT::const_iterator it =
+            arows.find(std::make_pair(oper, name));
+        EXPECT_TRUE(it != arows.end());
+        return boost::get<T>(it->second);
+    }
+
+    StatsQuery stats_query_;
+};
+
+// Rows of each VM in each minute are aggregated into one output row.
+TEST_F(StatsSelectTest, Aggregate) {
+    AnalyticsQueryMock analytics_query_mock;
+    default_expect_init(analytics_query_mock);
+    StatsSelect select(&analytics_query_mock, select_fields());
+    ASSERT_TRUE(select.Status());
+
+    std::vector<StatsSelect::StatRow> rows;
+    vm_cpu_rows(3, 3 * 120, &rows);
+    StatsSelect::MapBufT output;
+    EXPECT_TRUE(select.LoadRows(rows, output));
+    ASSERT_EQ(6, output.size());
+
+    ResultMap result(result_map(output));
+    for (ResultMap::const_iterator it = result.begin(); it != result.end();
+         it++) {
+        std::string name(boost::get<std::string>(it->first.at("name")));
+        uint64_t tbin = boost::get<uint64_t>(it->first.at("T="));
+        double sum_cpu = 0;
+        double sum_virt = 0;
+        uint64_t max_rss = 0;
+        uint64_t min_rss = std::numeric_limits<uint64_t>::max();
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (boost::get<std::string>(rows[i].entries[0].value) != name ||
+                rows[i].timestamp - rows[i].timestamp % 60000000 != tbin) {
+                continue;
+            }
+            sum_cpu += boost::get<double>(rows[i].entries[1].value);
+            uint64_t rss = boost::get<uint64_t>(rows[i].entries[2].value);
+            max_rss = std::max(max_rss, rss);
+            min_rss = std::min(min_rss, rss);
+            sum_virt += boost::get<double>(rows[i].entries[3].value);
+        }
+        const QEOpServerProxy::AggRowT& arows = it->second;
+        EXPECT_EQ(60, agg_value<uint64_t>(arows, QEOpServerProxy::COUNT,
+                                          "cpu_stats"));
+        EXPECT_DOUBLE_EQ(sum_cpu, agg_value<double>(arows,
+            QEOpServerProxy::SUM, "cpu_stats.cpu_one_min_avg"));
+        EXPECT_EQ(max_rss, agg_value<uint64_t>(arows, QEOpServerProxy::MAX,
+                                               "cpu_stats.rss"));
+        EXPECT_EQ(min_rss, agg_value<uint64_t>(arows, QEOpServerProxy::MIN,
+                                               "cpu_stats.rss"));
+        EXPECT_DOUBLE_EQ(sum_virt, agg_value<double>(arows,
+            QEOpServerProxy::SUM, "cpu_stats.virt_memory"));
+    }
+}
+
+// Loading a batch gives the same result as loading its rows one at a time,
+// also when an aggregated attribute is missing from some of the rows.
+TEST_F(StatsSelectTest, MissingAttribute) {
+    AnalyticsQueryMock analytics_query_mock;
+    default_expect_init(analytics_query_mock);
+    StatsSelect select(&analytics_query_mock, select_fields());
+    ASSERT_TRUE(select.Status());
+
+    std::vector<StatsSelect::StatRow> rows;
+    vm_cpu_rows(4, 4 * 90, &rows);
+    for (size_t i = 0; i < rows.size(); i += 7) {
+        rows[i].entries.pop_back();
+    }
+    StatsSelect::MapBufT row_output;
+    load_rows(&select, rows, false, &row_output);
+    StatsSelect::MapBufT batch_output;
+    load_rows(&select, rows, true, &batch_output);
+    EXPECT_TRUE(result_map(row_output) == result_map(batch_output));
+}
+
+// Rows are loaded one at a time when T is in the SELECT, and after a batch
+// that did not reduce the number of rows.
+TEST_F(StatsSelectTest, BatchLoadFallback) {
+    AnalyticsQueryMock analytics_query_mock;
+    default_expect_init(analytics_query_mock);
+
+    std::vector<std::string> t_fields(list_of(std::string("name"))("T")
+        ("cpu_stats.rss"));
+    StatsSelect t_select(&analytics_query_mock, t_fields);
+    ASSERT_TRUE(t_select.Status());
+    EXPECT_FALSE(t_select.IsBatchLoadNeeded());
+
+    StatsSelect select(&analytics_query_mock, select_fields());
+    ASSERT_TRUE(select.Status());
+    EXPECT_TRUE(select.IsBatchLoadNeeded());
+    std::vector<StatsSelect::StatRow> rows;
+    vm_cpu_rows(10, 600, &rows);
+    StatsSelect::MapBufT output;
+    EXPECT_TRUE(select.LoadRows(rows, output));
+    EXPECT_TRUE(select.IsBatchLoadNeeded());
+
+    rows.clear();
+    vm_cpu_rows(600, 600, &rows);
+    EXPECT_TRUE(select.LoadRows(rows, output));
+    EXPECT_FALSE(select.IsBatchLoadNeeded());
+}
+
+// Compare the rate of loading VirtualMachineStats rows one at a time and in
+// batches, with many and with few output rows.
+TEST_F(StatsSelectTest, LoadBenchmark) {
+    benchmark(50000);
+    benchmark(100);
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
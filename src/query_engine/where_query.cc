@@ -4,6 +4,7 @@
 
 #include <cstdlib>
 #include <limits> 
+#include "base/string_util.h"
 #include "rapidjson/document.h"
 #include "query.h"
 #include "json_parse.h"
@@ -515,6 +516,7 @@ WhereQuery::WhereQuery(const std::string& where_json_string, int direction,
 
                 // string encoding
                 db_query->row_key_suffix.push_back(value);
+                db_query->filter_value = value;
 
                 QE_TRACE(DEBUG, "where match term for source " << value);
             }
@@ -825,6 +827,8 @@ WhereQuery::WhereQuery(const std::string& where_json_string, int direction,
                     db_query->cr.finish_.push_back(sip2);
                 } else {
                     db_query->cr.finish_.push_back(sip);
+                    db_query->filter_value =
+                        integerToString(boost::get<uint32_t>(sip));
                 }
             }  else {
                 db_query->cr.finish_.push_back((uint32_t)0xffffffff);
@@ -854,6 +858,8 @@ WhereQuery::WhereQuery(const std::string& where_json_string, int direction,
                     db_query->cr.finish_.push_back(dip2);
                 } else {
                     db_query->cr.finish_.push_back(dip);
+                    db_query->filter_value =
+                        integerToString(boost::get<uint32_t>(dip));
                 }
             }  else {
                 db_query->cr.finish_.push_back((uint32_t)0xffffffff);
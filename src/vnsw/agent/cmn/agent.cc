@@ -207,6 +207,11 @@ void Agent::SetAgentTaskPolicy() {
     };
     SetTaskPolicyOne(AGENT_INIT_TASKNAME, agent_init_exclude_list,
                      sizeof(agent_init_exclude_list) / sizeof(char *));
+
+    // Keepalives from the control nodes are not to wait behind table walks
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->SetPriority(scheduler->GetTaskId("xmpp::StateMachine"),
+                           TaskScheduler::HIGH);
 }
 
 void Agent::CreateLifetimeManager() {
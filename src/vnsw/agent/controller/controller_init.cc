@@ -82,6 +82,8 @@ void VNController::XmppServerConnect() {
             if (xmpp_cfg->auth_enabled) {
                 xmpp_cfg->path_to_server_cert =  agent_->xmpp_server_cert(count);
             }
+            xmpp_cfg->compression_level =
+                agent_->params()->xmpp_compression_level();
             uint32_t port = agent_->controller_ifmap_xmpp_port(count);
             if (!port) {
                 port = XMPP_SERVER_PORT;
@@ -4,6 +4,7 @@
 
 #include <base/util.h>
 #include <base/logging.h>
+#include <base/timer.h>
 #include <base/connection_info.h>
 #include <net/bgp_af.h>
 #include <sandesh/sandesh.h>
@@ -76,13 +77,22 @@ AgentXmppChannel::AgentXmppChannel(Agent *agent,
                                    const std::string &label_range,
                                    uint8_t xs_idx)
     : channel_(NULL), xmpp_server_(xmpp_server), label_range_(label_range),
-      xs_idx_(xs_idx), agent_(agent), unicast_sequence_number_(0) {
+      xs_idx_(xs_idx), agent_(agent), unicast_sequence_number_(0),
+      publish_batch_size_(0),
+      publish_timer_(TimerManager::CreateTimer(
+                     *(agent->event_manager()->io_service()),
+                     "Agent Xmpp Route Publish Timer",
+                     TaskScheduler::GetInstance()->GetTaskId("db::DBTable"),
+                     0)),
+      publish_messages_(0), publish_items_(0) {
     bgp_peer_id_.reset();
 }
 
 AgentXmppChannel::~AgentXmppChannel() {
     BgpPeer *bgp_peer = bgp_peer_id_.get();
     assert(bgp_peer == NULL);
+    ClearPublishBatch();
+    TimerManager::DeleteTimer(publish_timer_);
     channel_->UnRegisterReceive(xmps::BGP);
 }
 
@@ -1484,6 +1494,10 @@ void AgentXmppChannel::HandleAgentXmppClientChannelEvent(AgentXmppChannel *peer,
         if (peer->bgp_peer_id() == NULL)
             return;
 
+        // Route updates queued for the old session are not sent, routes
+        // are exported again when the channel comes back up.
+        peer->ClearPublishBatch();
+
         BgpPeer *decommissioned_peer_id = peer->bgp_peer_id();
         // Add BgpPeer to global decommissioned list
         peer->DeCommissionBgpPeer();
@@ -1679,6 +1693,10 @@ bool AgentXmppChannel::ControllerSendSubscribe(AgentXmppChannel *peer,
     }
     CONTROLLER_INFO_TRACE(Trace, peer->GetBgpPeerName(), vrf->GetName(),
                      subscribe ? "Subscribe" : "Unsubscribe");
+    // Routes already queued for publish must be sent before the subscription
+    // state of any VRF changes.
+    peer->FlushPublishBatch();
+
     //Build the DOM tree
     auto_ptr<XmlBase> impl(XmppStanza::AllocXmppXmlImpl());
     XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl.get());
@@ -1717,6 +1735,172 @@ bool AgentXmppChannel::ControllerSendSubscribe(AgentXmppChannel *peer,
     return true;
 }
 
+// Counts the bytes added to the encoded publish message by an item.
+struct PublishItemSizer : public pugi::xml_writer {
+    PublishItemSizer() : size(0) { }
+    virtual void write(const void *data, size_t sz) { size += sz; }
+    size_t size;
+};
+
+bool AgentXmppChannel::PublishKey::operator<(const PublishKey &rhs) const {
+    if (vrf != rhs.vrf)
+        return vrf < rhs.vrf;
+    if (af != rhs.af)
+        return af < rhs.af;
+    if (safi != rhs.safi)
+        return safi < rhs.safi;
+    return associate < rhs.associate;
+}
+
+AgentXmppChannel::PublishBatch *
+AgentXmppChannel::StartPublishBatch(const PublishKey &key,
+                                    const std::string &node_id) {
+    // Updates of a route are sent in the batches for its VRF and family.
+    // Send the batch for the other operation first, so that an add and a
+    // delete of the route are not reordered.
+    PublishKey other(key.vrf, key.af, key.safi, !key.associate);
+    PublishBatchMap::iterator iter = publish_batches_.find(other);
+    if (iter != publish_batches_.end()) {
+        FlushPublishBatch(iter);
+    }
+
+    iter = publish_batches_.find(key);
+    if (iter != publish_batches_.end()) {
+        return iter->second;
+    }
+
+    //Build the DOM tree, items are appended to publish node
+    PublishBatch *batch = new PublishBatch();
+    batch->doc.reset(XmppStanza::AllocXmppXmlImpl());
+    batch->node = node_id;
+    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(batch->doc.get());
+
+    pugi->AddNode("iq", "");
+    pugi->AddAttribute("type", "set");
+
+    pugi->AddAttribute("from", channel_->FromString());
+    std::string to(channel_->ToString());
+    to += "/";
+    to += XmppInit::kBgpPeer;
+    pugi->AddAttribute("to", to);
+
+    pugi->AddChildNode("pubsub", "");
+    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
+    pugi->AddChildNode("publish", "");
+    // Control node merges the publish with the collection message following
+    // it by this node id and derives the address family from its prefix.
+    pugi->AddAttribute("node", node_id);
+
+    publish_batches_.insert(std::make_pair(key, batch));
+    return batch;
+}
+
+template <typename ItemT>
+bool AgentXmppChannel::EnqueuePublishItem(ItemT &item,
+                                          const std::string &vrf_name,
+                                          const std::string &node_id,
+                                          bool associate) {
+    PublishKey key(vrf_name, item.entry.nlri.af, item.entry.nlri.safi,
+                   associate);
+    PublishBatch *batch = StartPublishBatch(key, node_id);
+
+    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(batch->doc.get());
+    pugi::xml_node node = pugi->FindNode("publish").append_child("item");
+
+    //Call Auto-generated Code to encode the struct
+    item.Encode(&node);
+
+    PublishItemSizer sizer;
+    node.print(sizer, "", pugi::format_default, pugi::encoding_utf8);
+    batch->bytes += sizer.size;
+    batch->size++;
+    publish_batch_size_++;
+    publish_items_++;
+
+    if ((batch->size >= kMaxPublishItems) ||
+        (batch->bytes >= kMaxPublishBytes)) {
+        FlushPublishBatch(publish_batches_.find(key));
+    } else {
+        publish_timer_->Start(kPublishBatchDelayMsec,
+                              boost::bind(&AgentXmppChannel::PublishTimerExpired,
+                                          this));
+    }
+    return true;
+}
+
+bool AgentXmppChannel::PublishTimerExpired() {
+    FlushPublishBatch();
+    return false;
+}
+
+void AgentXmppChannel::FlushPublishBatch() {
+    while (!publish_batches_.empty()) {
+        FlushPublishBatch(publish_batches_.begin());
+    }
+    publish_timer_->Cancel();
+}
+
+void AgentXmppChannel::FlushPublishBatch(PublishBatchMap::iterator iter) {
+    static int id = 0;
+
+    const PublishKey &key = iter->first;
+    boost::scoped_ptr<PublishBatch> batch(iter->second);
+    publish_batch_size_ -= batch->size;
+    if (channel_->GetPeerState() != xmps::READY) {
+        publish_batches_.erase(iter);
+        return;
+    }
+
+    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(batch->doc.get());
+
+    stringstream pubsub_id;
+    pubsub_id << "pubsub" << id;
+    pugi->ReadNode("iq");
+    pugi->AddAttribute("id", pubsub_id.str());
+
+    // Message size is bounded by kMaxPublishBytes plus the last item, so
+    // encode to a string rather than a fixed size buffer.
+    ostringstream publish;
+    pugi->doc().save(publish, "", pugi::format_default, pugi::encoding_utf8);
+    std::string data(publish.str());
+    // send data
+    SendUpdate(reinterpret_cast<uint8_t *>(const_cast<char *>(data.c_str())),
+               data.size());
+
+    pugi->DeleteNode("pubsub");
+    pugi->ReadNode("iq");
+
+    stringstream collection_id;
+    collection_id << "collection" << id++;
+    pugi->ModifyAttribute("id", collection_id.str());
+    pugi->AddChildNode("pubsub", "");
+    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
+    pugi->AddChildNode("collection", "");
+
+    pugi->AddAttribute("node", key.vrf);
+    if (key.associate) {
+        pugi->AddChildNode("associate", "");
+    } else {
+        pugi->AddChildNode("dissociate", "");
+    }
+    pugi->AddAttribute("node", batch->node);
+
+    uint8_t data_[4096];
+    size_t datalen_ = XmppProto::EncodeMessage(batch->doc.get(), data_,
+                                               sizeof(data_));
+    // send data
+    SendUpdate(data_,datalen_);
+
+    publish_messages_++;
+    publish_batches_.erase(iter);
+}
+
+void AgentXmppChannel::ClearPublishBatch() {
+    publish_timer_->Cancel();
+    STLDeleteValues(&publish_batches_);
+    publish_batch_size_ = 0;
+}
+
 bool AgentXmppChannel::ControllerSendV4V6UnicastRouteCommon(AgentRoute *route,
                                        const std::string &vn,
                                        const SecurityGroupList *sg_list,
@@ -1727,14 +1911,7 @@ bool AgentXmppChannel::ControllerSendV4V6UnicastRouteCommon(AgentRoute *route,
                                        bool associate,
                                        Agent::RouteTableType type) {
 
-    static int id = 0;
     ItemType item;
-    uint8_t data_[4096];
-    size_t datalen_;
-
-    //Build the DOM tree
-    auto_ptr<XmlBase> impl(XmppStanza::AllocXmppXmlImpl());
-    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl.get());
 
     if (type == Agent::INET4_UNICAST) {
         item.entry.nlri.af = BgpAf::IPv4;
@@ -1775,23 +1952,6 @@ bool AgentXmppChannel::ControllerSendV4V6UnicastRouteCommon(AgentRoute *route,
     item.entry.sequence_number = path_preference.sequence();
     item.entry.local_preference = path_preference.preference();
 
-    pugi->AddNode("iq", "");
-    pugi->AddAttribute("type", "set");
-
-    pugi->AddAttribute("from", channel_->FromString());
-    std::string to(channel_->ToString());
-    to += "/";
-    to += XmppInit::kBgpPeer;
-    pugi->AddAttribute("to", to);
-
-    stringstream pubsub_id;
-    pubsub_id << "pubsub" << id;
-    pugi->AddAttribute("id", pubsub_id.str());
-
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("publish", "");
-
     //Catering for inet4 and evpn unicast routes
     stringstream ss_node;
     ss_node << item.entry.nlri.af << "/"
@@ -1799,40 +1959,9 @@ bool AgentXmppChannel::ControllerSendV4V6UnicastRouteCommon(AgentRoute *route,
             << route->vrf()->GetName() << "/"
             << route->GetAddressString();
     std::string node_id(ss_node.str());
-    pugi->AddAttribute("node", node_id);
-    pugi->AddChildNode("item", "");
-
-    pugi::xml_node node = pugi->FindNode("item");
-
-    //Call Auto-generated Code to encode the struct
-    item.Encode(&node);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-
-    pugi->DeleteNode("pubsub");
-    pugi->ReadNode("iq");
-
-    stringstream collection_id;
-    collection_id << "collection" << id++;
-    pugi->ModifyAttribute("id", collection_id.str());
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("collection", "");
 
-    pugi->AddAttribute("node", route->vrf()->GetName());
-    if (associate) {
-        pugi->AddChildNode("associate", "");
-    } else {
-        pugi->AddChildNode("dissociate", "");
-    }
-    pugi->AddAttribute("node", node_id);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-    return true;
+    return EnqueuePublishItem(item, route->vrf()->GetName(), node_id,
+                              associate);
 }
 
 bool AgentXmppChannel::BuildTorMulticastMessage(EnetItemType &item,
@@ -2087,66 +2216,8 @@ bool AgentXmppChannel::BuildAndSendEvpnDom(EnetItemType &item,
                                            stringstream &ss_node,
                                            const AgentRoute *route,
                                            bool associate) {
-    static int id = 0;
-    uint8_t data_[4096];
-    size_t datalen_;
-
-    //Build the DOM tree
-    auto_ptr<XmlBase> impl(XmppStanza::AllocXmppXmlImpl());
-    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl.get());
-
-    pugi->AddNode("iq", "");
-    pugi->AddAttribute("type", "set");
-
-    pugi->AddAttribute("from", channel_->FromString());
-    std::string to(channel_->ToString());
-    to += "/";
-    to += XmppInit::kBgpPeer;
-    pugi->AddAttribute("to", to);
-
-    stringstream pubsub_id;
-    pubsub_id << "pubsub_l2" << id;
-    pugi->AddAttribute("id", pubsub_id.str());
-
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("publish", "");
-
-    std::string node_id(ss_node.str());
-    pugi->AddAttribute("node", node_id);
-    pugi->AddChildNode("item", "");
-
-    pugi::xml_node node = pugi->FindNode("item");
-
-    //Call Auto-generated Code to encode the struct
-    item.Encode(&node);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-
-    pugi->DeleteNode("pubsub");
-    pugi->ReadNode("iq");
-
-    stringstream collection_id;
-    collection_id << "collection_l2" << id++;
-    pugi->ModifyAttribute("id", collection_id.str());
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("collection", "");
-
-    pugi->AddAttribute("node", route->vrf()->GetName());
-    if (associate) {
-        pugi->AddChildNode("associate", "");
-    } else {
-        pugi->AddChildNode("dissociate", "");
-    }
-    pugi->AddAttribute("node", node_id);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-    return true;
+    return EnqueuePublishItem(item, route->vrf()->GetName(), ss_node.str(),
+                              associate);
 }
 
 bool AgentXmppChannel::ControllerSendEvpnRouteCommon(AgentRoute *route,
@@ -2211,10 +2282,7 @@ bool AgentXmppChannel::ControllerSendEvpnRouteCommon(AgentRoute *route,
 bool AgentXmppChannel::ControllerSendMcastRouteCommon(AgentRoute *route,
                                                       bool add_route) {
 
-    static int id = 0;
     autogen::McastItemType item;
-    uint8_t data_[4096];
-    size_t datalen_;
 
     if (add_route && (agent_->mulitcast_builder() != this)) {
         CONTROLLER_INFO_TRACE(Trace, GetBgpPeerName(),
@@ -2227,10 +2295,6 @@ bool AgentXmppChannel::ControllerSendMcastRouteCommon(AgentRoute *route,
                                 route->vrf()->GetName(), " ",
                                 route->ToString());
 
-    //Build the DOM tree
-    auto_ptr<XmlBase> impl(XmppStanza::AllocXmppXmlImpl());
-    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl.get());
-
     item.entry.nlri.af = BgpAf::IPv4;
     item.entry.nlri.safi = BgpAf::Mcast;
     item.entry.nlri.group = route->GetAddressString();
@@ -2245,65 +2309,15 @@ bool AgentXmppChannel::ControllerSendMcastRouteCommon(AgentRoute *route,
     item_nexthop.tunnel_encapsulation_list.tunnel_encapsulation.push_back("udp");
     item.entry.next_hops.next_hop.push_back(item_nexthop);
 
-    //Build the pugi tree
-    pugi->AddNode("iq", "");
-    pugi->AddAttribute("type", "set");
-    pugi->AddAttribute("from", channel_->FromString());
-    std::string to(channel_->ToString());
-    to += "/";
-    to += XmppInit::kBgpPeer;
-    pugi->AddAttribute("to", to);
-
-    std::string pubsub_id("pubsub_b");
-    stringstream str_id;
-    str_id << id;
-    pubsub_id += str_id.str();
-    pugi->AddAttribute("id", pubsub_id);
-
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("publish", "");
     stringstream ss_node;
     ss_node << item.entry.nlri.af << "/"
             << item.entry.nlri.safi << "/"
             << route->vrf()->GetName() << "/"
             << route->GetAddressString();
     std::string node_id(ss_node.str());
-    pugi->AddAttribute("node", node_id);
-    pugi->AddChildNode("item", "");
 
-    pugi::xml_node node = pugi->FindNode("item");
-
-    //Call Auto-generated Code to encode the struct
-    item.Encode(&node);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-
-
-    pugi->DeleteNode("pubsub");
-    pugi->ReadNode("iq");
-
-    stringstream collection_id;
-    collection_id << "collection" << id++;
-    pugi->ModifyAttribute("id", collection_id.str());
-    pugi->AddChildNode("pubsub", "");
-    pugi->AddAttribute("xmlns", "http://jabber.org/protocol/pubsub");
-    pugi->AddChildNode("collection", "");
-
-    pugi->AddAttribute("node", route->vrf()->GetName());
-    if (add_route) {
-        pugi->AddChildNode("associate", "");
-    } else {
-        pugi->AddChildNode("dissociate", "");
-    }
-    pugi->AddAttribute("node", node_id);
-
-    datalen_ = XmppProto::EncodeMessage(impl.get(), data_, sizeof(data_));
-    // send data
-    SendUpdate(data_,datalen_);
-    return true;
+    return EnqueuePublishItem(item, route->vrf()->GetName(), node_id,
+                              add_route);
 }
 
 bool AgentXmppChannel::ControllerSendEvpnRouteAdd(AgentXmppChannel *peer,
@@ -19,6 +19,7 @@
 
 class AgentRoute;
 class Peer;
+class Timer;
 class BgpPeer;
 class VrfEntry;
 class XmlPugi;
@@ -27,6 +28,21 @@ class AgentPath;
 
 class AgentXmppChannel {
 public:
+    // Route publish batching. Items for route updates with the same VRF,
+    // address family and operation (associate/dissociate) are coalesced
+    // into a single pubsub publish. A batch is kept open for each of these
+    // keys, so that interleaved updates of different VRFs and families are
+    // coalesced as well. A batch is flushed when it reaches kMaxPublishItems
+    // items or kMaxPublishBytes bytes, and before an update for the same VRF
+    // and family with the other operation is added to a batch, so that the
+    // updates of a route reach the control node in the order they were
+    // generated. All batches are flushed before a VRF subscribe or
+    // unsubscribe, and when kPublishBatchDelayMsec expires after the first
+    // item was added.
+    static const uint32_t kMaxPublishItems = 64;
+    static const size_t kMaxPublishBytes = 32 * 1024;
+    static const int kPublishBatchDelayMsec = 5;
+
     AgentXmppChannel(Agent *agent,
                      const std::string &xmpp_server, 
                      const std::string &label_range, uint8_t xs_idx);
@@ -148,10 +164,43 @@ public:
     bool ControllerSendMcastRouteCommon(AgentRoute *route,
                                         bool associate);
 
+    void FlushPublishBatch();
+    void ClearPublishBatch();
+    // Number of items in the open batches
+    uint32_t publish_batch_size() const { return publish_batch_size_; }
+    size_t publish_batch_count() const { return publish_batches_.size(); }
+    uint64_t publish_messages() const { return publish_messages_; }
+    uint64_t publish_items() const { return publish_items_; }
+
 protected:
     virtual void WriteReadyCb(const boost::system::error_code &ec);
 
 private:
+    struct PublishKey {
+        PublishKey(const std::string &vrf_name, uint32_t af, uint32_t safi,
+                   bool associate)
+            : vrf(vrf_name), af(af), safi(safi), associate(associate) {
+        }
+        bool operator<(const PublishKey &rhs) const;
+
+        std::string vrf;
+        uint32_t af;
+        uint32_t safi;
+        bool associate;
+    };
+
+    // The control node only takes the address family from the node id of a
+    // publish, so the node id of the first item is used for the batch.
+    struct PublishBatch {
+        PublishBatch() : size(0), bytes(0) { }
+
+        boost::scoped_ptr<XmlBase> doc;
+        std::string node;
+        uint32_t size;
+        size_t bytes;
+    };
+    typedef std::map<PublishKey, PublishBatch *> PublishBatchMap;
+
     void ReceiveInternal(const XmppStanza::XmppMessage *msg);
     void AddRoute(std::string vrf_name, IpAddress ip, uint32_t plen,
                   autogen::ItemType *item);
@@ -213,6 +262,13 @@ private:
                              std::stringstream &ss_node,
                              const AgentRoute *route,
                              bool associate);
+    template <typename ItemT>
+    bool EnqueuePublishItem(ItemT &item, const std::string &vrf_name,
+                            const std::string &node_id, bool associate);
+    PublishBatch *StartPublishBatch(const PublishKey &key,
+                                    const std::string &node_id);
+    void FlushPublishBatch(PublishBatchMap::iterator iter);
+    bool PublishTimerExpired();
 
     XmppChannel *channel_;
     std::string xmpp_server_;
@@ -221,6 +277,13 @@ private:
     boost::shared_ptr<BgpPeer> bgp_peer_id_;
     Agent *agent_;
     uint64_t unicast_sequence_number_;
+
+    // Pending route publish batches
+    PublishBatchMap publish_batches_;
+    uint32_t publish_batch_size_;
+    Timer *publish_timer_;
+    uint64_t publish_messages_;
+    uint64_t publish_items_;
 };
 
 #endif // __CONTROLLER_PEER_H__
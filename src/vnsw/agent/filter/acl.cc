@@ -2,6 +2,7 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <algorithm>
 #include <vector>
 #include <boost/uuid/uuid_io.hpp>
 
@@ -123,6 +124,7 @@ bool AclTable::OperDBOnChange(DBEntry *entry, const DBRequest *req) {
 
     if (data->ace_id_to_del_) {
         acl->DeleteAclEntry(data->ace_id_to_del_);
+        acl->InvalidateVnPairCache();
         return true;
     }
 
@@ -151,7 +153,9 @@ bool AclTable::OperDBOnChange(DBEntry *entry, const DBRequest *req) {
         }
     }
 
-    if (changed == false) {
+    if (changed) {
+        acl->InvalidateVnPairCache();
+    } else {
         //Remove temporary create acl entries
         AclDBEntry::AclEntries::iterator iter;
         iter = entries.begin();
@@ -168,6 +172,7 @@ bool AclTable::OperDBDelete(DBEntry *entry, const DBRequest *req) {
     AclDBEntry *acl = static_cast<AclDBEntry *>(entry);
     ACL_TRACE(Info, "Delete " + UuidToString(acl->GetUuid()));
     acl->DeleteAllAclEntries();
+    acl->InvalidateVnPairCache();
     return true;
 }
 
@@ -475,72 +480,236 @@ void AclDBEntry::DeleteAllAclEntries()
     return;
 }
 
+// Accumulate actions of a matched ace into m_acl. Returns true if the ace is
+// terminal and no further aces must be matched.
+bool AclDBEntry::AceMatch(const AclEntry &ace, const AclEntry::ActionList &al,
+                          MatchAclParams &m_acl, FlowPolicyInfo *info) const
+{
+    AclEntry::ActionList::const_iterator al_it;
+    for (al_it = al.begin(); al_it != al.end(); ++al_it) {
+        TrafficAction *ta = static_cast<TrafficAction *>(*al_it.operator->());
+        m_acl.action_info.action |= 1 << ta->action();
+        if (ta->action_type() == TrafficAction::MIRROR_ACTION) {
+            MirrorAction *a = static_cast<MirrorAction *>(*al_it.operator->());
+            MirrorActionSpec as;
+            as.ip = a->GetIp();
+            as.port = a->GetPort();
+            as.vrf_name = a->vrf_name();
+            as.analyzer_name = a->GetAnalyzerName();
+            as.encap = a->GetEncap();
+            m_acl.action_info.mirror_l.push_back(as);
+        }
+        if (ta->action_type() == TrafficAction::VRF_TRANSLATE_ACTION) {
+            const VrfTranslateAction *a =
+                static_cast<VrfTranslateAction *>(*al_it.operator->());
+            VrfTranslateActionSpec vrf_translate_action(a->vrf_name(),
+                                                        a->ignore_acl());
+            m_acl.action_info.vrf_translate_action_ = vrf_translate_action;
+        }
+        if (info && ta->IsDrop()) {
+            if (!info->drop) {
+                info->drop = true;
+                info->terminal = false;
+                info->other = false;
+                info->uuid = ace.uuid();
+            }
+        }
+    }
+
+    m_acl.ace_id_list.push_back((int32_t)(ace.id()));
+    if (ace.IsTerminal()) {
+        m_acl.terminal_rule = true;
+        /* Set uuid only if it is NOT already set as
+         * drop/terminal uuid */
+        if (info && !info->drop && !info->terminal) {
+            info->terminal = true;
+            info->other = false;
+            info->uuid = ace.uuid();
+        }
+        return true;
+    }
+    /* If the ace action is not drop and if ace is not terminal rule
+     * then set the uuid with the first matching uuid */
+    if (info && !info->drop && !info->terminal && !info->other) {
+        info->other = true;
+        info->uuid = ace.uuid();
+    }
+    return false;
+}
+
 bool AclDBEntry::PacketMatch(const PacketHeader &packet_header, 
-			                 MatchAclParams &m_acl, FlowPolicyInfo *info) const
+                             MatchAclParams &m_acl, FlowPolicyInfo *info) const
 {
-    AclEntries::const_iterator iter;
     bool ret_val = false;
     m_acl.terminal_rule = false;
-	m_acl.action_info.action = 0;
-    for (iter = acl_entries_.begin();
-         iter != acl_entries_.end();
-         ++iter) {
-        const AclEntry::ActionList &al = iter->PacketMatch(packet_header);
-	AclEntry::ActionList::const_iterator al_it;
-	for (al_it = al.begin(); al_it != al.end(); ++al_it) {
-	     TrafficAction *ta = static_cast<TrafficAction *>(*al_it.operator->());
-	     m_acl.action_info.action |= 1 << ta->action();
-	     if (ta->action_type() == TrafficAction::MIRROR_ACTION) {
-	         MirrorAction *a = static_cast<MirrorAction *>(*al_it.operator->());
-                 MirrorActionSpec as;
-		 as.ip = a->GetIp();
-		 as.port = a->GetPort();
-                 as.vrf_name = a->vrf_name();
-                 as.analyzer_name = a->GetAnalyzerName();
-                 as.encap = a->GetEncap();
-                 m_acl.action_info.mirror_l.push_back(as);
-	     }
-         if (ta->action_type() == TrafficAction::VRF_TRANSLATE_ACTION) {
-             const VrfTranslateAction *a =
-                 static_cast<VrfTranslateAction *>(*al_it.operator->());
-             VrfTranslateActionSpec vrf_translate_action(a->vrf_name(),
-                                                         a->ignore_acl());
-             m_acl.action_info.vrf_translate_action_ = vrf_translate_action;
-         }
-         if (info && ta->IsDrop()) {
-             if (!info->drop) {
-                 info->drop = true;
-                 info->terminal = false;
-                 info->other = false;
-                 info->uuid = iter->uuid();
-             }
-         }
-	}
-        if (!(al.empty())) {
+    m_acl.action_info.action = 0;
+
+    AclVnPairMatchPtr vn_match = GetVnPairMatch(packet_header);
+    if (vn_match.get() == NULL) {
+        AclEntries::const_iterator iter;
+        for (iter = acl_entries_.begin(); iter != acl_entries_.end(); ++iter) {
+            const AclEntry::ActionList &al = iter->PacketMatch(packet_header);
+            if (al.empty())
+                continue;
             ret_val = true;
-            m_acl.ace_id_list.push_back((int32_t)(iter->id()));
-            if (iter->IsTerminal()) {
-                m_acl.terminal_rule = true;
-                /* Set uuid only if it is NOT already set as
-                 * drop/terminal uuid */
-                if (info && !info->drop && !info->terminal) {
-                    info->terminal = true;
-                    info->other = false;
-                    info->uuid = iter->uuid();
-                }
-                return ret_val;
-            }
-            /* If the ace action is not drop and if ace is not terminal rule
-             * then set the uuid with the first matching uuid */
-            if (info && !info->drop && !info->terminal && !info->other) {
-                info->other = true;
-                info->uuid = iter->uuid();
-            }
+            if (AceMatch(*iter, al, m_acl, info))
+                break;
+        }
+        return ret_val;
+    }
+
+    // Only aces which can match the VN pair, and the ports of TCP and UDP
+    // packets, are looked at. Either port index gives a superset of the
+    // aces matching the packet, so the shorter list is used.
+    const AclVnPairMatch::AceIndexList *index = NULL;
+    if (packet_header.protocol == IPPROTO_TCP ||
+        packet_header.protocol == IPPROTO_UDP) {
+        index = vn_match->dst_port_index.Find(packet_header.dst_port);
+        const AclVnPairMatch::AceIndexList *src_index =
+            vn_match->src_port_index.Find(packet_header.src_port);
+        if (index == NULL ||
+            (src_index != NULL && src_index->size() < index->size())) {
+            index = src_index;
         }
     }
+
+    size_t count = index ? index->size() : vn_match->aces.size();
+    for (size_t i = 0; i < count; i++) {
+        const AclVnPairMatch::Ace &ace =
+            vn_match->aces[index ? (*index)[i] : i];
+        const AclEntry::ActionList &al = ace.vn_only ? ace.ace->Actions() :
+            ace.ace->PacketMatch(packet_header);
+        if (al.empty())
+            continue;
+        ret_val = true;
+        if (AceMatch(*ace.ace, al, m_acl, info))
+            break;
+    }
     return ret_val;
 }
 
+void AclVnPairMatch::PortIndex::Build(const AceList &aces, bool src) {
+    std::vector<AclEntry::PortRangeList> ranges(aces.size());
+    std::vector<bool> any_port(aces.size(), true);
+    std::vector<uint32_t> points;
+    for (size_t i = 0; i < aces.size(); i++) {
+        if (aces[i].vn_only || !aces[i].ace->PortRanges(src, &ranges[i]))
+            continue;
+        any_port[i] = false;
+        AclEntry::PortRangeList::const_iterator it;
+        for (it = ranges[i].begin(); it != ranges[i].end(); ++it) {
+            points.push_back(it->first);
+            points.push_back(it->second + 1);
+        }
+    }
+    if (points.empty())
+        return;
+
+    points.push_back(0);
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    if (points.back() > 0xFFFF)
+        points.pop_back();
+
+    // A port range either covers an interval or does not overlap it, so
+    // checking the first port of the interval is enough
+    bounds = points;
+    ace_lists.resize(bounds.size());
+    for (size_t b = 0; b < bounds.size(); b++) {
+        for (size_t i = 0; i < aces.size(); i++) {
+            bool match = any_port[i];
+            AclEntry::PortRangeList::const_iterator it;
+            for (it = ranges[i].begin(); !match && it != ranges[i].end();
+                 ++it) {
+                match = (bounds[b] >= it->first && bounds[b] <= it->second);
+            }
+            if (match)
+                ace_lists[b].push_back(i);
+        }
+    }
+}
+
+const AclVnPairMatch::AceIndexList *
+AclVnPairMatch::PortIndex::Find(uint16_t port) const {
+    if (bounds.empty())
+        return NULL;
+    std::vector<uint32_t>::const_iterator it =
+        std::upper_bound(bounds.begin(), bounds.end(), port);
+    return &ace_lists[(it - bounds.begin()) - 1];
+}
+
+// Returns aces that can match traffic between source and destination VN of
+// the packet, compiling and caching them on first lookup for the VN pair.
+// Returns NULL if the cache is not used for this ACL or packet.
+AclDBEntry::AclVnPairMatchPtr
+AclDBEntry::GetVnPairMatch(const PacketHeader &packet_header) const {
+    if (packet_header.src_policy_id == NULL ||
+        packet_header.dst_policy_id == NULL ||
+        acl_entries_.size() < kVnPairCacheMinAces) {
+        return AclVnPairMatchPtr();
+    }
+    if (acl_table_ && acl_table_->vn_pair_cache_enable() == false) {
+        return AclVnPairMatchPtr();
+    }
+
+    VnPair key(*packet_header.src_policy_id, *packet_header.dst_policy_id);
+    {
+        tbb::mutex::scoped_lock lock(vn_pair_cache_mutex_);
+        VnPairMatchCache::iterator it = vn_pair_cache_.find(key);
+        if (it != vn_pair_cache_.end()) {
+            vn_pair_cache_hits_++;
+            vn_pair_lru_.splice(vn_pair_lru_.begin(), vn_pair_lru_,
+                                it->second.lru);
+            return it->second.match;
+        }
+    }
+    vn_pair_cache_misses_++;
+
+    AclVnPairMatch *match = new AclVnPairMatch();
+    AclEntries::const_iterator iter;
+    for (iter = acl_entries_.begin(); iter != acl_entries_.end(); ++iter) {
+        bool vn_only = false;
+        if (!iter->VnPairMatch(key.first, key.second, &vn_only))
+            continue;
+        match->aces.push_back(AclVnPairMatch::Ace(iter.operator->(),
+                                                  vn_only));
+        // Aces after a terminal ace matching the whole VN pair are never hit
+        if (vn_only && iter->IsTerminal() && !iter->Actions().empty())
+            break;
+    }
+    match->src_port_index.Build(match->aces, true);
+    match->dst_port_index.Build(match->aces, false);
+
+    AclVnPairMatchPtr ptr(match);
+    tbb::mutex::scoped_lock lock(vn_pair_cache_mutex_);
+    // Another flow may have added the VN pair in the meantime
+    std::pair<VnPairMatchCache::iterator, bool> result =
+        vn_pair_cache_.insert(std::make_pair(key, VnPairCacheEntry()));
+    if (!result.second) {
+        return result.first->second.match;
+    }
+    if (vn_pair_cache_.size() > kVnPairCacheMaxEntries) {
+        vn_pair_cache_.erase(vn_pair_lru_.back());
+        vn_pair_lru_.pop_back();
+    }
+    vn_pair_lru_.push_front(key);
+    result.first->second.match = ptr;
+    result.first->second.lru = vn_pair_lru_.begin();
+    return ptr;
+}
+
+void AclDBEntry::InvalidateVnPairCache() {
+    tbb::mutex::scoped_lock lock(vn_pair_cache_mutex_);
+    vn_pair_cache_.clear();
+    vn_pair_lru_.clear();
+    generation_++;
+}
+
+size_t AclDBEntry::vn_pair_cache_size() const {
+    tbb::mutex::scoped_lock lock(vn_pair_cache_mutex_);
+    return vn_pair_cache_.size();
+}
+
 bool AclDBEntry::Changed(const AclEntries &new_entries) const {
     AclEntries::const_iterator it = acl_entries_.begin();
     AclEntries::const_iterator new_entries_it = new_entries.begin();
@@ -5,10 +5,14 @@
 #ifndef __AGENT_ACL_N_H__
 #define __AGENT_ACL_N_H__
 
+#include <list>
+#include <map>
 #include <boost/intrusive/list.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <tbb/atomic.h>
+#include <tbb/mutex.h>
 
 #include <oper/oper_db.h>
 #include <filter/traffic_action.h>
@@ -55,6 +59,41 @@ struct MatchAclParams {
     bool terminal_rule;
 };
 
+// Aces of an ACL which can match traffic between a pair of virtual networks,
+// in ACL order. An ace with vn_only set matches every packet between the pair
+// and its actions are taken without matching the packet. Other aces still
+// have their port, protocol and address conditions matched per packet.
+//
+// For TCP and UDP packets, the source and destination port indexes give the
+// aces which can match a port, so that only those are matched.
+struct AclVnPairMatch {
+    struct Ace {
+        Ace(const AclEntry *entry, bool only_vn) :
+            ace(entry), vn_only(only_vn) { }
+        const AclEntry *ace;
+        bool vn_only;
+    };
+    typedef std::vector<Ace> AceList;
+    typedef std::vector<uint32_t> AceIndexList;
+
+    // Ports split in intervals at the bounds of the port ranges of the aces.
+    // bounds holds the first port of each interval in ascending order and
+    // ace_lists the indexes in aces, in ACL order, of the aces which can
+    // match a port of the interval. Empty if no ace has a port condition.
+    struct PortIndex {
+        void Build(const AceList &aces, bool src);
+        const AceIndexList *Find(uint16_t port) const;
+
+        std::vector<uint32_t> bounds;
+        std::vector<AceIndexList> ace_lists;
+    };
+
+    AclVnPairMatch() : aces() { }
+    AceList aces;
+    PortIndex src_port_index;
+    PortIndex dst_port_index;
+};
+
 struct AclKey : public AgentOperDBKey {
     AclKey(const uuid &id) : AgentOperDBKey(), uuid_(id) {} ;
     virtual ~AclKey() {};
@@ -86,9 +125,28 @@ public:
             boost::intrusive::list_member_hook<>, 
             &AclEntry::acl_list_node> AclEntryNode;
     typedef boost::intrusive::list<AclEntry, AclEntryNode> AclEntries;
-    
+    typedef std::pair<std::string, std::string> VnPair;
+    typedef boost::shared_ptr<const AclVnPairMatch> AclVnPairMatchPtr;
+    // VN pairs in the order of last lookup, most recent first
+    typedef std::list<VnPair> VnPairLru;
+    struct VnPairCacheEntry {
+        AclVnPairMatchPtr match;
+        VnPairLru::iterator lru;
+    };
+    typedef std::map<VnPair, VnPairCacheEntry> VnPairMatchCache;
+
+    // Packet match results are cached per (source VN, destination VN) for
+    // ACLs with at least kVnPairCacheMinAces aces. Cache is flushed whenever
+    // the aces change, which also bumps the ACL generation. Once the cache
+    // has kVnPairCacheMaxEntries entries, the least recently used VN pair is
+    // evicted for a new one.
+    static const uint32_t kVnPairCacheMinAces = 8;
+    static const uint32_t kVnPairCacheMaxEntries = 4096;
+
     AclDBEntry(const uuid &id) :
-        AgentOperDBEntry(), uuid_(id), dynamic_acl_(false) {
+        AgentOperDBEntry(), uuid_(id), dynamic_acl_(false), generation_(0) {
+        vn_pair_cache_hits_ = 0;
+        vn_pair_cache_misses_ = 0;
     }
     ~AclDBEntry() {
     }
@@ -122,12 +180,30 @@ public:
     bool Changed(const AclEntries &new_acl_entries) const;
     uint32_t ace_count() const { return acl_entries_.size();}
     bool IsRulePresent(const std::string &uuid) const;
+
+    uint64_t generation() const { return generation_; }
+    void InvalidateVnPairCache();
+    size_t vn_pair_cache_size() const;
+    uint64_t vn_pair_cache_hits() const { return vn_pair_cache_hits_; }
+    uint64_t vn_pair_cache_misses() const { return vn_pair_cache_misses_; }
 private:
     friend class AclTable;
+    AclVnPairMatchPtr GetVnPairMatch(const PacketHeader &packet_header) const;
+    bool AceMatch(const AclEntry &ace, const AclEntry::ActionList &al,
+                  MatchAclParams &m_acl, FlowPolicyInfo *info) const;
+
     uuid uuid_;
     bool dynamic_acl_;
     std::string name_;
     AclEntries acl_entries_;
+    uint64_t generation_;
+    // Lookups happen from flow tasks in parallel, changes to aces are done
+    // in db::DBTable task which is in exclusion with them.
+    mutable tbb::mutex vn_pair_cache_mutex_;
+    mutable VnPairMatchCache vn_pair_cache_;
+    mutable VnPairLru vn_pair_lru_;
+    mutable tbb::atomic<uint64_t> vn_pair_cache_hits_;
+    mutable tbb::atomic<uint64_t> vn_pair_cache_misses_;
     DISALLOW_COPY_AND_ASSIGN(AclDBEntry);
 };
 
@@ -142,7 +218,8 @@ public:
     typedef boost::function<void(const AclDBEntry *acl, AclFlowResp &data,
                                  const int last_count)> FlowAclSandeshDataFn;
 
-    AclTable(DB *db, const std::string &name) : AgentOperDBTable(db, name) { }
+    AclTable(DB *db, const std::string &name) :
+        AgentOperDBTable(db, name), vn_pair_cache_enable_(true) { }
     virtual ~AclTable() { }
     void GetTables(DB *db) { };
 
@@ -168,6 +245,10 @@ public:
                                      const std::string ctx, int ace_id);
     void set_ace_flow_sandesh_data_cb(FlowAceSandeshDataFn fn);
     void set_acl_flow_sandesh_data_cb(FlowAclSandeshDataFn fn);
+    bool vn_pair_cache_enable() const { return vn_pair_cache_enable_; }
+    void set_vn_pair_cache_enable(bool enable) {
+        vn_pair_cache_enable_ = enable;
+    }
 private:
     static const AclDBEntry* GetAclDBEntry(const std::string uuid_str, 
                                            const std::string ctx,
@@ -176,6 +257,7 @@ private:
     TrafficActionMap ta_map_;
     FlowAceSandeshDataFn flow_ace_sandesh_data_cb_;
     FlowAclSandeshDataFn flow_acl_sandesh_data_cb_;
+    bool vn_pair_cache_enable_;
     DISALLOW_COPY_AND_ASSIGN(AclTable);
 };
 
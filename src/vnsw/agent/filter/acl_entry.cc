@@ -165,6 +165,49 @@ const AclEntry::ActionList &AclEntry::PacketMatch(const PacketHeader &packet_hea
     return Actions();
 }
 
+bool AclEntry::VnPairMatch(const std::string &src_vn, const std::string &dst_vn,
+                           bool *vn_only) const
+{
+    PacketHeader packet_header;
+    packet_header.src_policy_id = &src_vn;
+    packet_header.dst_policy_id = &dst_vn;
+    *vn_only = true;
+
+    std::vector<AclEntryMatch *>::const_iterator it;
+    for (it = matches_.begin(); it != matches_.end(); it++) {
+        if (!(*it)->IsVnMatch()) {
+            *vn_only = false;
+            continue;
+        }
+        if (!((*it)->Match(&packet_header))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AclEntry::PortRanges(bool src, PortRangeList *ranges) const
+{
+    std::vector<AclEntryMatch *>::const_iterator it;
+    for (it = matches_.begin(); it != matches_.end(); it++) {
+        const PortMatch *port_match = src ?
+            static_cast<const PortMatch *>(
+                dynamic_cast<const SrcPortMatch *>(*it)) :
+            static_cast<const PortMatch *>(
+                dynamic_cast<const DstPortMatch *>(*it));
+        if (port_match == NULL) {
+            continue;
+        }
+        const RangeSList &port_ranges = port_match->port_ranges();
+        for (RangeSList::const_iterator range = port_ranges.begin();
+             range != port_ranges.end(); range++) {
+            ranges->push_back(std::make_pair(range->min, range->max));
+        }
+        return true;
+    }
+    return false;
+}
+
 void AclEntry::SetAclEntrySandeshData(AclEntrySandeshData &data) const {
 
     // Set match data
@@ -368,6 +411,13 @@ bool AddressMatch::Match(const PacketHeader *pheader) const
     return false;
 }
 
+bool AddressMatch::IsVnMatch() const {
+    if (policy_id_s_.compare("any") == 0) {
+        return true;
+    }
+    return (addr_type_ == NETWORK_ID);
+}
+
 bool AddressMatch::Compare(const AclEntryMatch &rhs) const {
     const AddressMatch &rhs_address_match =
         static_cast<const AddressMatch &>(rhs);
@@ -30,6 +30,7 @@ public:
     };
 
     typedef std::list<TrafficAction *> ActionList;
+    typedef std::vector<std::pair<uint16_t, uint16_t> > PortRangeList;
     static ActionList kEmptyActionList;
     AclEntry() : 
         id_(0), type_(TERMINAL), matches_(), actions_(), mirror_entry_(NULL),
@@ -49,6 +50,15 @@ public:
     // Match packet header
     const ActionList &PacketMatch(const PacketHeader &packet_header) const;
     const ActionList &Actions() const {return actions_;};
+    // Match only the virtual network conditions of the entry. vn_only is
+    // set when the entry has no other condition, in which case the result
+    // holds for every packet between the two networks.
+    bool VnPairMatch(const std::string &src_vn, const std::string &dst_vn,
+                     bool *vn_only) const;
+    // Port ranges, as (min, max), of the source or destination port
+    // condition of the entry. Returns false if the entry has no such
+    // condition.
+    bool PortRanges(bool src, PortRangeList *ranges) const;
 
     void SetAclEntrySandeshData(AclEntrySandeshData &data) const;
 
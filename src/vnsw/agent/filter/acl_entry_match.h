@@ -28,6 +28,9 @@ public:
     virtual bool Match(const PacketHeader *packet_header) const = 0;
     virtual void SetAclEntryMatchSandeshData(AclEntrySandeshData &data) = 0;
     virtual bool Compare(const AclEntryMatch &rhs) const = 0;
+    // True if result of the match depends only on virtual networks of the
+    // packet
+    virtual bool IsVnMatch() const { return false; }
     bool operator ==(const AclEntryMatch &rhs) const {
         if (type_ != rhs.type_) {
             return false;
@@ -75,6 +78,7 @@ public:
     void SetAclEntryMatchSandeshData(AclEntrySandeshData &data) = 0;
     virtual bool Match(const PacketHeader *packet_header) const = 0;
     virtual bool Compare(const AclEntryMatch &rhs) const;
+    const RangeSList &port_ranges() const { return port_ranges_; }
 protected:
     RangeSList port_ranges_;
 };
@@ -133,6 +137,7 @@ public:
     bool Match(const PacketHeader *packet_header) const;
     void SetAclEntryMatchSandeshData(AclEntrySandeshData &data);
     virtual bool Compare(const AclEntryMatch &rhs) const;
+    virtual bool IsVnMatch() const;
 private:
     AddressType addr_type_;
     bool src_;
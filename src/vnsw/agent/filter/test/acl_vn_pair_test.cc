@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/os.h"
+#include <base/time_util.h>
+#include <test_cmn_util.h>
+#include <filter/packet_header.h>
+
+using namespace std;
+
+void RouterIdDepInit(Agent *agent) {
+}
+
+namespace {
+
+static const int kVnCount = 8;
+static const int kPortRulesPerVnPair = 4;
+static const int kBenchmarkIterations = 200000;
+
+class AclVnPairTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        table_ = Agent::GetInstance()->acl_table();
+        acl_id_ = StringToUuid("00000000-0000-0000-0000-000000000020");
+        for (int i = 0; i < kVnCount; i++) {
+            stringstream ss;
+            ss << "vn" << i;
+            vn_names_.push_back(ss.str());
+        }
+    }
+
+    virtual void TearDown() {
+        table_->set_vn_pair_cache_enable(true);
+        DBRequest req;
+        req.key.reset(new AclKey(acl_id_));
+        req.oper = DBRequest::DB_ENTRY_DELETE;
+        table_->Enqueue(&req);
+        client->WaitForIdle();
+    }
+
+    static void AddAce(AclSpec *spec, uint32_t id, const string &src_vn,
+                       const string &dst_vn, uint16_t port_min,
+                       uint16_t port_max, TrafficAction::Action action) {
+        AclEntrySpec ae;
+        ae.id = id;
+        ae.terminal = true;
+        ae.src_addr_type = AddressMatch::NETWORK_ID;
+        ae.src_policy_id_str = src_vn;
+        ae.dst_addr_type = AddressMatch::NETWORK_ID;
+        ae.dst_policy_id_str = dst_vn;
+        if (port_max != 0) {
+            RangeSpec proto = { IPPROTO_TCP, IPPROTO_TCP };
+            ae.protocol.push_back(proto);
+            RangeSpec port = { port_min, port_max };
+            ae.dst_port.push_back(port);
+        }
+        ActionSpec as;
+        as.ta_type = TrafficAction::SIMPLE_ACTION;
+        as.simple_action = action;
+        ae.action_l.push_back(as);
+        spec->acl_entry_specs_.push_back(ae);
+    }
+
+    // Port based rules for every VN pair, one rule allowing all traffic
+    // from vn0 to vn1 and an implicit deny at the end.
+    void AddAcl(bool allow_all_vn0_vn1) {
+        AclSpec spec;
+        spec.acl_id = acl_id_;
+        uint32_t id = 1;
+        if (allow_all_vn0_vn1) {
+            AddAce(&spec, id++, vn_names_[0], vn_names_[1], 0, 0,
+                   TrafficAction::PASS);
+        }
+        for (int i = 0; i < kVnCount; i++) {
+            for (int j = 0; j < kVnCount; j++) {
+                for (int k = 0; k < kPortRulesPerVnPair; k++) {
+                    uint16_t port = 1000 + (k * 100);
+                    AddAce(&spec, id++, vn_names_[i], vn_names_[j], port,
+                           port + 9, TrafficAction::PASS);
+                }
+            }
+        }
+        AddAce(&spec, id++, "any", "any", 0, 0, TrafficAction::DENY);
+
+        DBRequest req;
+        req.key.reset(new AclKey(acl_id_));
+        req.data.reset(new AclData(Agent::GetInstance(), NULL, spec));
+        req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        table_->Enqueue(&req);
+        client->WaitForIdle();
+    }
+
+    AclDBEntry *GetAcl() {
+        AclKey key(acl_id_);
+        return static_cast<AclDBEntry *>(table_->FindActiveEntry(&key));
+    }
+
+    void MakePacket(PacketHeader *hdr, int src_vn, int dst_vn,
+                    uint16_t dst_port) {
+        hdr->src_policy_id = &vn_names_[src_vn];
+        hdr->dst_policy_id = &vn_names_[dst_vn];
+        hdr->src_sg_id_l = NULL;
+        hdr->dst_sg_id_l = NULL;
+        hdr->protocol = IPPROTO_TCP;
+        hdr->src_port = 32768;
+        hdr->dst_port = dst_port;
+    }
+
+    uint32_t Match(AclDBEntry *acl, int src_vn, int dst_vn, uint16_t port,
+                   AclEntryIDList *ace_list) {
+        PacketHeader hdr;
+        MakePacket(&hdr, src_vn, dst_vn, port);
+        MatchAclParams m_acl;
+        m_acl.acl = acl;
+        acl->PacketMatch(hdr, m_acl, NULL);
+        if (ace_list)
+            *ace_list = m_acl.ace_id_list;
+        return m_acl.action_info.action;
+    }
+
+    uint64_t RunMatches(AclDBEntry *acl, int iterations) {
+        uint64_t start = UTCTimestampUsec();
+        for (int i = 0; i < iterations; i++) {
+            Match(acl, i % kVnCount, (i / kVnCount) % kVnCount,
+                  995 + (i % 400), NULL);
+        }
+        return UTCTimestampUsec() - start;
+    }
+
+    AclTable *table_;
+    uuid acl_id_;
+    vector<string> vn_names_;
+};
+
+// Cached and uncached evaluation give same result for every VN pair
+TEST_F(AclVnPairTest, CachedMatch) {
+    AddAcl(true);
+    AclDBEntry *acl = GetAcl();
+    ASSERT_TRUE(acl != NULL);
+
+    for (int i = 0; i < kVnCount; i++) {
+        for (int j = 0; j < kVnCount; j++) {
+            for (uint16_t port = 995; port < 1400; port += 5) {
+                AclEntryIDList cached_aces;
+                AclEntryIDList aces;
+                table_->set_vn_pair_cache_enable(true);
+                uint32_t cached = Match(acl, i, j, port, &cached_aces);
+                table_->set_vn_pair_cache_enable(false);
+                uint32_t action = Match(acl, i, j, port, &aces);
+                EXPECT_EQ(action, cached);
+                EXPECT_TRUE(aces == cached_aces);
+            }
+        }
+    }
+    table_->set_vn_pair_cache_enable(true);
+    EXPECT_EQ((size_t)(kVnCount * kVnCount), acl->vn_pair_cache_size());
+    EXPECT_EQ((uint64_t)(kVnCount * kVnCount), acl->vn_pair_cache_misses());
+
+    // vn0 to vn1 is allowed irrespective of ports
+    uint32_t pass = (1 << TrafficAction::PASS);
+    uint32_t deny = (1 << TrafficAction::DENY);
+    EXPECT_EQ(pass, Match(acl, 0, 1, 80, NULL));
+    EXPECT_EQ(deny, Match(acl, 1, 0, 80, NULL));
+    EXPECT_EQ(pass, Match(acl, 1, 0, 1205, NULL));
+}
+
+// Cache is flushed and generation bumped when ACL changes
+TEST_F(AclVnPairTest, Invalidate) {
+    AddAcl(true);
+    AclDBEntry *acl = GetAcl();
+    ASSERT_TRUE(acl != NULL);
+    uint64_t generation = acl->generation();
+
+    uint32_t pass = (1 << TrafficAction::PASS);
+    uint32_t deny = (1 << TrafficAction::DENY);
+    EXPECT_EQ(pass, Match(acl, 0, 1, 80, NULL));
+    EXPECT_EQ(1U, acl->vn_pair_cache_size());
+
+    AddAcl(false);
+    EXPECT_TRUE(acl == GetAcl());
+    EXPECT_LT(generation, acl->generation());
+    EXPECT_EQ(0U, acl->vn_pair_cache_size());
+    EXPECT_EQ(deny, Match(acl, 0, 1, 80, NULL));
+    EXPECT_EQ(pass, Match(acl, 0, 1, 1005, NULL));
+}
+
+// Least recently used VN pair is evicted once the cache is full, so that
+// new VN pairs are still cached
+TEST_F(AclVnPairTest, Eviction) {
+    AddAcl(true);
+    AclDBEntry *acl = GetAcl();
+    ASSERT_TRUE(acl != NULL);
+
+    const uint32_t max_entries = AclDBEntry::kVnPairCacheMaxEntries;
+    vector<string> names;
+    for (uint32_t i = 0; i <= max_entries; i++) {
+        stringstream ss;
+        ss << "evict-vn" << i;
+        names.push_back(ss.str());
+    }
+
+    PacketHeader hdr;
+    MakePacket(&hdr, 0, 1, 80);
+    MatchAclParams m_acl;
+    for (uint32_t i = 0; i < max_entries; i++) {
+        hdr.src_policy_id = &names[i];
+        acl->PacketMatch(hdr, m_acl, NULL);
+    }
+    EXPECT_EQ(max_entries, acl->vn_pair_cache_size());
+
+    // Look up the oldest pair again, so that the second oldest is evicted
+    // for the new pair
+    hdr.src_policy_id = &names[0];
+    acl->PacketMatch(hdr, m_acl, NULL);
+    EXPECT_EQ(1U, acl->vn_pair_cache_hits());
+    hdr.src_policy_id = &names[max_entries];
+    acl->PacketMatch(hdr, m_acl, NULL);
+    EXPECT_EQ(max_entries, acl->vn_pair_cache_size());
+    EXPECT_EQ((uint64_t)max_entries + 1, acl->vn_pair_cache_misses());
+
+    hdr.src_policy_id = &names[0];
+    acl->PacketMatch(hdr, m_acl, NULL);
+    EXPECT_EQ(2U, acl->vn_pair_cache_hits());
+    hdr.src_policy_id = &names[1];
+    acl->PacketMatch(hdr, m_acl, NULL);
+    EXPECT_EQ(2U, acl->vn_pair_cache_hits());
+    EXPECT_EQ((uint64_t)max_entries + 2, acl->vn_pair_cache_misses());
+    EXPECT_EQ(max_entries, acl->vn_pair_cache_size());
+}
+
+// Port index gives same result as matching every ace, with overlapping port
+// ranges and ranges at the ends of the port space
+TEST_F(AclVnPairTest, PortIndex) {
+    AclSpec spec;
+    spec.acl_id = acl_id_;
+    AddAce(&spec, 1, vn_names_[0], vn_names_[1], 100, 200,
+           TrafficAction::DENY);
+    AddAce(&spec, 2, vn_names_[0], vn_names_[1], 150, 300,
+           TrafficAction::PASS);
+    AddAce(&spec, 3, vn_names_[0], vn_names_[1], 0, 10, TrafficAction::PASS);
+    AddAce(&spec, 4, vn_names_[0], vn_names_[1], 65000, 65535,
+           TrafficAction::PASS);
+    AddAce(&spec, 5, "any", "any", 0, 0, TrafficAction::DENY);
+
+    DBRequest req;
+    req.key.reset(new AclKey(acl_id_));
+    req.data.reset(new AclData(Agent::GetInstance(), NULL, spec));
+    req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+    table_->Enqueue(&req);
+    client->WaitForIdle();
+    AclDBEntry *acl = GetAcl();
+    ASSERT_TRUE(acl != NULL);
+
+    uint16_t ports[] = { 0, 10, 11, 99, 100, 149, 150, 200, 201, 300, 301,
+                         64999, 65000, 65535 };
+    for (size_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        AclEntryIDList cached_aces;
+        AclEntryIDList aces;
+        table_->set_vn_pair_cache_enable(true);
+        uint32_t cached = Match(acl, 0, 1, ports[i], &cached_aces);
+        table_->set_vn_pair_cache_enable(false);
+        uint32_t action = Match(acl, 0, 1, ports[i], &aces);
+        EXPECT_EQ(action, cached);
+        EXPECT_TRUE(aces == cached_aces);
+    }
+    table_->set_vn_pair_cache_enable(true);
+
+    uint32_t pass = (1 << TrafficAction::PASS);
+    uint32_t deny = (1 << TrafficAction::DENY);
+    EXPECT_EQ(pass, Match(acl, 0, 1, 5, NULL));
+    EXPECT_EQ(deny, Match(acl, 0, 1, 160, NULL));
+    EXPECT_EQ(pass, Match(acl, 0, 1, 250, NULL));
+    EXPECT_EQ(deny, Match(acl, 0, 1, 400, NULL));
+    EXPECT_EQ(pass, Match(acl, 0, 1, 65535, NULL));
+}
+
+// Flow setup style benchmark: many flows between same VN pairs differing only
+// in L4 ports.
+TEST_F(AclVnPairTest, Benchmark) {
+    AddAcl(true);
+    AclDBEntry *acl = GetAcl();
+    ASSERT_TRUE(acl != NULL);
+
+    table_->set_vn_pair_cache_enable(false);
+    uint64_t uncached = RunMatches(acl, kBenchmarkIterations);
+    table_->set_vn_pair_cache_enable(true);
+    uint64_t cached = RunMatches(acl, kBenchmarkIterations);
+
+    cout << "ACL with " << acl->ace_count() << " aces, "
+         << kBenchmarkIterations << " matches: uncached "
+         << uncached / 1000 << " msec, cached " << cached / 1000
+         << " msec" << endl;
+    EXPECT_LT(cached, uncached);
+}
+
+} //namespace
+
+int main (int argc, char **argv) {
+    GETUSERARGS();
+    client = TestInit(init_file, ksync_init);
+
+    int ret = RUN_ALL_TESTS();
+    TestShutdown();
+    delete client;
+    return ret;
+}
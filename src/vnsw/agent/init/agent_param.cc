@@ -446,6 +446,8 @@ void AgentParam::ParseDefaultSection() {
     if (!GetValueFromTree<string>(xmpp_server_cert_2_, "DEFAULT.xmpp_server_cert_2")) {
         xmpp_server_cert_2_ = "/etc/contrail/ssl/certs/control-node-cert.pem";
     }
+    GetValueFromTree<int>(xmpp_compression_level_,
+                          "DEFAULT.xmpp_compression_level");
 
     GetValueFromTree<bool>(xmpp_dns_auth_enable_1_, "DEFAULT.xmpp_dns_auth_enable_1");
     GetValueFromTree<bool>(xmpp_dns_auth_enable_2_, "DEFAULT.xmpp_dns_auth_enable_2");
@@ -660,6 +662,8 @@ void AgentParam::ParseDefaultSectionArguments
     GetOptValue<bool>(var_map, xmpp_auth_enable_2_, "DEFAULT.xmpp_auth_enable_2");
     GetOptValue<string>(var_map, xmpp_server_cert_1_, "DEFAULT.xmpp_server_cert_1");
     GetOptValue<string>(var_map, xmpp_server_cert_2_, "DEFAULT.xmpp_server_cert_2");
+    GetOptValue<int>(var_map, xmpp_compression_level_,
+                     "DEFAULT.xmpp_compression_level");
 
     GetOptValue<bool>(var_map, xmpp_dns_auth_enable_1_, "DEFAULT.xmpp_dns_auth_enable_1");
     GetOptValue<bool>(var_map, xmpp_dns_auth_enable_2_, "DEFAULT.xmpp_dns_auth_enable_2");
@@ -1020,6 +1024,7 @@ void AgentParam::LogConfig() const {
         LOG(DEBUG, "Xmpp Server Certificate : " << xmpp_server_cert_2_);
 
     }
+    LOG(DEBUG, "Xmpp Compression Level      : " << xmpp_compression_level_);
     LOG(DEBUG, "DNS Server-1                : " << dns_server_1_);
     LOG(DEBUG, "DNS Port-1                  : " << dns_port_1_);
     LOG(DEBUG, "Xmpp Dns Authentication-1   : " << xmpp_dns_auth_enable_1_);
@@ -1142,6 +1147,7 @@ AgentParam::AgentParam(Agent *agent, bool enable_flow_options,
         headless_mode_(false), dhcp_relay_mode_(false),
         xmpp_auth_enable_1_(false), xmpp_auth_enable_2_(false),
         xmpp_server_cert_1_(""), xmpp_server_cert_2_(""),
+        xmpp_compression_level_(0),
         xmpp_dns_auth_enable_1_(false), xmpp_dns_auth_enable_2_(false),
         xmpp_dns_server_cert_1_(""), xmpp_dns_server_cert_2_(""),
         simulate_evpn_tor_(false), si_netns_command_(),
@@ -1206,6 +1212,9 @@ AgentParam::AgentParam(Agent *agent, bool enable_flow_options,
          "Enable authentication over Xmpp Server 1")
         ("DEFAULT.xmpp_auth_enable_2", opt::value<bool>(),
          "Enable authentication over Xmpp Server 2")
+        ("DEFAULT.xmpp_compression_level", opt::value<int>(),
+         "zlib compression level of Xmpp streams without authentication, "
+         "0 disables compression")
         ("DEFAULT.xmpp_server_cert_1",
           opt::value<string>()->default_value(
           "/etc/contrail/ssl/certs/control-node-cert.pem"),
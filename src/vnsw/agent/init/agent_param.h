@@ -114,6 +114,7 @@ public:
     bool xmpp_auth_enabled_2() const {return xmpp_auth_enable_2_;}
     std::string xmpp_server_cert_1() const { return xmpp_server_cert_1_;}
     std::string xmpp_server_cert_2() const { return xmpp_server_cert_2_;}
+    int xmpp_compression_level() const { return xmpp_compression_level_; }
     bool xmpp_dns_auth_enabled_1() const {return xmpp_dns_auth_enable_1_;}
     bool xmpp_dns_auth_enabled_2() const {return xmpp_dns_auth_enable_2_;}
     std::string xmpp_dns_server_cert_1() const { return xmpp_dns_server_cert_1_;}
@@ -390,6 +391,7 @@ private:
     bool xmpp_auth_enable_2_;
     std::string xmpp_server_cert_1_;
     std::string xmpp_server_cert_2_;
+    int xmpp_compression_level_;
     bool xmpp_dns_auth_enable_1_;
     bool xmpp_dns_auth_enable_2_;
     std::string xmpp_dns_server_cert_1_;
@@ -1,7 +1,10 @@
 /*
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
+#include <algorithm>
+
 #include <cmn/agent_cmn.h>
+#include <base/time_util.h>
 #include <route/route.h>
 
 #include <vnc_cfg_types.h>
@@ -12,6 +15,7 @@
 #include <oper/agent_route_walker.h>
 #include <oper/vrf.h>
 #include <oper/agent_route.h>
+#include <oper/operdb_init.h>
 
 using namespace std;
 
@@ -35,6 +39,14 @@ AgentRouteWalker::AgentRouteWalker(Agent *agent, WalkType type) :
 
 AgentRouteWalker::~AgentRouteWalker() {
     work_queue_.Shutdown();
+    for (uint8_t table_type = (Agent::INVALID + 1);
+         table_type < Agent::ROUTE_TABLE_MAX;
+         table_type++) {
+        if (route_walkid_[table_type].size() != 0) {
+            agent_->oper_db()->route_walker_manager()->ReleaseWalker(this);
+            break;
+        }
+    }
 }
 
 bool AgentRouteWalker::RouteWalker(boost::shared_ptr<AgentRouteWalkerQueueEntry> data) {
@@ -98,7 +110,7 @@ void AgentRouteWalker::CancelRouteWalk(VrfEntry *vrf) {
 }
 
 void AgentRouteWalker::CancelRouteWalkInternal(const VrfEntry *vrf) {
-    DBTableWalker *walker = agent_->db()->GetWalker();
+    AgentRouteWalkerManager *mgr = agent_->oper_db()->route_walker_manager();
     uint32_t vrf_id = vrf->vrf_id();
 
     //Cancel Route table walks
@@ -112,7 +124,7 @@ void AgentRouteWalker::CancelRouteWalkInternal(const VrfEntry *vrf) {
                                "route table walk cancelled", walk_type_,
                                (vrf != NULL) ? vrf->GetName() : "Unknown",
                                vrf_walkid_, table_type, "", iter->second);
-            walker->WalkCancel(iter->second);
+            mgr->WalkCancel(this, iter->second);
             route_walkid_[table_type].erase(iter);
             DecrementWalkCount();
         }
@@ -166,7 +178,7 @@ void AgentRouteWalker::StartRouteWalk(VrfEntry *vrf) {
 }
 
 void AgentRouteWalker::StartRouteWalkInternal(const VrfEntry *vrf) {
-    DBTableWalker *walker = agent_->db()->GetWalker();
+    AgentRouteWalkerManager *mgr = agent_->oper_db()->route_walker_manager();
     DBTableWalker::WalkId walkid = DBTableWalker::kInvalidWalkerId;
     uint32_t vrf_id = vrf->vrf_id();
     AgentRouteTable *table = NULL;
@@ -189,11 +201,7 @@ void AgentRouteWalker::StartRouteWalkInternal(const VrfEntry *vrf) {
                                vrf_walkid_, table_type, "", walkid);
             continue;
         }
-        walkid = walker->WalkTable(table, NULL, 
-                             boost::bind(&AgentRouteWalker::RouteWalkNotify, 
-                                         this, _1, _2),
-                             boost::bind(&AgentRouteWalker::RouteWalkDone, 
-                                         this, _1));
+        walkid = mgr->WalkTable(this, table);
         if (walkid != DBTableWalker::kInvalidWalkerId) {
             route_walkid_[table_type][vrf_id] = walkid;
             IncrementWalkCount();
@@ -393,3 +401,170 @@ void AgentRouteWalker::WalkDoneCallback(WalkDone cb) {
 void AgentRouteWalker::RouteWalkDoneForVrfCallback(RouteWalkDoneCb cb) {
     route_walk_done_for_vrf_cb_ = cb;
 }
+
+AgentRouteWalkerManager::Walk::Walk(DBTable *table) :
+    table_(table), id_(DBTableWalker::kInvalidWalkerId), walkers_(),
+    started_(false), request_time_(UTCTimestampUsec()) {
+    routes_visited_ = 0;
+}
+
+AgentRouteWalkerManager::AgentRouteWalkerManager(Agent *agent) :
+    agent_(agent), walks_requested_(0), walks_started_(0),
+    walks_coalesced_(0), walks_cancelled_(0), walks_completed_(0),
+    routes_visited_(0), last_walk_usecs_(0), max_walk_usecs_(0) {
+}
+
+AgentRouteWalkerManager::~AgentRouteWalkerManager() {
+    STLDeleteValues(&walks_);
+}
+
+DBTableWalker::WalkId
+AgentRouteWalkerManager::WalkTable(AgentRouteWalker *walker, DBTable *table) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    walks_requested_++;
+
+    // Join the walk issued on this table if it has not notified any route yet
+    JoinableWalkMap::iterator it = joinable_walks_.find(table);
+    if (it != joinable_walks_.end()) {
+        Walk *walk = it->second;
+        if (walk->started_ == false) {
+            walk->walkers_.push_back(walker);
+            walks_coalesced_++;
+            return walk->id_;
+        }
+        joinable_walks_.erase(it);
+    }
+
+    DBTableWalker *db_walker = agent_->db()->GetWalker();
+    Walk *walk = new Walk(table);
+    walk->walkers_.push_back(walker);
+    walk->id_ = db_walker->WalkTable(table, NULL,
+                    boost::bind(&AgentRouteWalkerManager::RouteWalkNotify,
+                                this, walk, _1, _2),
+                    boost::bind(&AgentRouteWalkerManager::RouteWalkDone,
+                                this, walk, _1));
+    if (walk->id_ == DBTableWalker::kInvalidWalkerId) {
+        delete walk;
+        return DBTableWalker::kInvalidWalkerId;
+    }
+    walks_started_++;
+    walks_.insert(std::make_pair(walk->id_, walk));
+    joinable_walks_[table] = walk;
+    return walk->id_;
+}
+
+void AgentRouteWalkerManager::WalkCancel(AgentRouteWalker *walker,
+                                         DBTableWalker::WalkId id) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    WalkMap::iterator it = walks_.find(id);
+    if (it == walks_.end())
+        return;
+    LeaveWalk(walker, it->second);
+}
+
+void AgentRouteWalkerManager::ReleaseWalker(AgentRouteWalker *walker) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    WalkMap::iterator it = walks_.begin();
+    while (it != walks_.end()) {
+        Walk *walk = it->second;
+        it++;
+        LeaveWalk(walker, walk);
+    }
+}
+
+// Called with mutex held. Cancels the table walk once the last walker leaves.
+// DBTableWalker does not invoke walk done on a cancelled walk, so the walk
+// can be freed right away.
+void AgentRouteWalkerManager::LeaveWalk(AgentRouteWalker *walker, Walk *walk) {
+    std::vector<AgentRouteWalker *>::iterator it =
+        std::find(walk->walkers_.begin(), walk->walkers_.end(), walker);
+    if (it == walk->walkers_.end())
+        return;
+    walk->walkers_.erase(it);
+    if (walk->walkers_.empty() == false)
+        return;
+
+    agent_->db()->GetWalker()->WalkCancel(walk->id_);
+    walks_cancelled_++;
+    DeleteWalk(walk);
+}
+
+// Called with mutex held
+void AgentRouteWalkerManager::DeleteWalk(Walk *walk) {
+    JoinableWalkMap::iterator it = joinable_walks_.find(walk->table_);
+    if (it != joinable_walks_.end() && it->second == walk)
+        joinable_walks_.erase(it);
+    walks_.erase(walk->id_);
+    delete walk;
+}
+
+bool AgentRouteWalkerManager::RouteWalkNotify(Walk *walk,
+                                              DBTablePartBase *partition,
+                                              DBEntryBase *e) {
+    walk->started_ = true;
+    walk->routes_visited_++;
+
+    // Continue the walk as long as any of the walkers is interested
+    bool more = false;
+    for (std::vector<AgentRouteWalker *>::iterator it =
+         walk->walkers_.begin(); it != walk->walkers_.end(); it++) {
+        if ((*it)->RouteWalkNotify(partition, e))
+            more = true;
+    }
+    return more;
+}
+
+void AgentRouteWalkerManager::RouteWalkDone(Walk *walk, DBTableBase *table) {
+    std::vector<AgentRouteWalker *> walkers;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
+        walkers.swap(walk->walkers_);
+        uint64_t usecs = UTCTimestampUsec() - walk->request_time_;
+        last_walk_usecs_ = usecs;
+        if (usecs > max_walk_usecs_)
+            max_walk_usecs_ = usecs;
+        routes_visited_ += walk->routes_visited_;
+        walks_completed_++;
+        DeleteWalk(walk);
+    }
+
+    for (std::vector<AgentRouteWalker *>::iterator it = walkers.begin();
+         it != walkers.end(); it++) {
+        (*it)->RouteWalkDone(table);
+    }
+}
+
+void AgentRouteWalkerManager::FillStats(AgentRouteWalkerStatsResp *resp) {
+    tbb::mutex::scoped_lock lock(mutex_);
+    uint64_t now = UTCTimestampUsec();
+    std::vector<AgentRouteWalkInfo> list;
+    for (WalkMap::const_iterator it = walks_.begin(); it != walks_.end();
+         it++) {
+        const Walk *walk = it->second;
+        AgentRouteWalkInfo info;
+        info.set_table(walk->table_->name());
+        info.set_walk_id(walk->id_);
+        info.set_walkers(walk->walkers_.size());
+        info.set_started(walk->started_);
+        info.set_routes_visited(walk->routes_visited_);
+        info.set_elapsed_usecs(now - walk->request_time_);
+        list.push_back(info);
+    }
+    resp->set_walks_requested(walks_requested_);
+    resp->set_walks_started(walks_started_);
+    resp->set_walks_coalesced(walks_coalesced_);
+    resp->set_walks_cancelled(walks_cancelled_);
+    resp->set_walks_completed(walks_completed_);
+    resp->set_routes_visited(routes_visited_);
+    resp->set_last_walk_usecs(last_walk_usecs_);
+    resp->set_max_walk_usecs(max_walk_usecs_);
+    resp->set_active_walks(list);
+}
+
+void AgentRouteWalkerStatsReq::HandleRequest() const {
+    AgentRouteWalkerStatsResp *resp = new AgentRouteWalkerStatsResp();
+    resp->set_context(context());
+    Agent *agent = Agent::GetInstance();
+    agent->oper_db()->route_walker_manager()->FillStats(resp);
+    resp->Response();
+}
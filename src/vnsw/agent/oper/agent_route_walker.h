@@ -5,9 +5,14 @@
 #ifndef vnsw_agent_route_walker_hpp
 #define vnsw_agent_route_walker_hpp
 
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
 #include <cmn/agent_cmn.h>
 #include <cmn/agent.h>
 
+class AgentRouteWalker;
+class AgentRouteWalkerStatsResp;
+
 /**
  * The infrastructure is to support and manage VRF walks along with
  * corresponding route walks. The walkids are internally managed.
@@ -35,6 +40,10 @@
  * argument.
  * TODO - Do route cancellation for route walks when vrf walk is cancelled.
  *
+ * Route table walks are issued through AgentRouteWalkerManager, which lets
+ * walkers of different objects share a single traversal of a route table.
+ * E.g. export walk for a new peer and stale walk for the old peer started on
+ * the same VRF will visit every route once and notify both walkers.
  */
 
 struct AgentRouteWalkerQueueEntry {
@@ -141,4 +150,79 @@ private:
     DISALLOW_COPY_AND_ASSIGN(AgentRouteWalker);
 };
 
+/*
+ * Coalesces route table walks requested by AgentRouteWalker objects.
+ *
+ * A walk request for a route table which already has a walk issued but not
+ * yet started (i.e. no route has been notified so far) joins that walk instead
+ * of starting a new one. Every route visited is notified to all walkers which
+ * joined the walk and walk done is notified to each of them at the end.
+ * The traversal itself is done by DBTableWalker, which yields after a bounded
+ * number of entries. Agent route tables have a single partition, so walks run
+ * one at a time in db::DBTable instance 0; sharing a walk saves traversals,
+ * it does not add concurrency.
+ *
+ * Walks are joined and left from Agent::RouteWalker task which is in exclusion
+ * with db::DBTable, so walker list of a walk does not change while routes are
+ * being notified. The mutex only protects the walk maps and statistics for
+ * introspect.
+ */
+class AgentRouteWalkerManager {
+public:
+    AgentRouteWalkerManager(Agent *agent);
+    virtual ~AgentRouteWalkerManager();
+
+    // Request a walk of table on behalf of walker. Returns the id of the
+    // walk which will notify walker.
+    DBTableWalker::WalkId WalkTable(AgentRouteWalker *walker, DBTable *table);
+    // Stop notifying walker for walk id. The table walk is cancelled when no
+    // walker is left on it.
+    void WalkCancel(AgentRouteWalker *walker, DBTableWalker::WalkId id);
+    // Remove walker from all walks, called when walker is destroyed.
+    void ReleaseWalker(AgentRouteWalker *walker);
+
+    void FillStats(AgentRouteWalkerStatsResp *resp);
+    uint64_t walks_requested() const {return walks_requested_;}
+    uint64_t walks_started() const {return walks_started_;}
+    uint64_t walks_coalesced() const {return walks_coalesced_;}
+    uint64_t walks_cancelled() const {return walks_cancelled_;}
+    uint64_t walks_completed() const {return walks_completed_;}
+    uint64_t routes_visited() const {return routes_visited_;}
+    size_t active_walk_count() const {return walks_.size();}
+
+private:
+    struct Walk {
+        Walk(DBTable *table);
+
+        DBTable *table_;
+        DBTableWalker::WalkId id_;
+        std::vector<AgentRouteWalker *> walkers_;
+        bool started_;
+        uint64_t request_time_;
+        tbb::atomic<uint64_t> routes_visited_;
+    };
+    typedef std::map<DBTableWalker::WalkId, Walk *> WalkMap;
+    typedef std::map<const DBTableBase *, Walk *> JoinableWalkMap;
+
+    bool RouteWalkNotify(Walk *walk, DBTablePartBase *partition,
+                         DBEntryBase *e);
+    void RouteWalkDone(Walk *walk, DBTableBase *table);
+    void LeaveWalk(AgentRouteWalker *walker, Walk *walk);
+    void DeleteWalk(Walk *walk);
+
+    Agent *agent_;
+    tbb::mutex mutex_;
+    WalkMap walks_;
+    JoinableWalkMap joinable_walks_;
+    uint64_t walks_requested_;
+    uint64_t walks_started_;
+    uint64_t walks_coalesced_;
+    uint64_t walks_cancelled_;
+    uint64_t walks_completed_;
+    uint64_t routes_visited_;
+    uint64_t last_walk_usecs_;
+    uint64_t max_walk_usecs_;
+    DISALLOW_COPY_AND_ASSIGN(AgentRouteWalkerManager);
+};
+
 #endif
@@ -38,6 +38,7 @@
 #include <oper/agent_profile.h>
 #include <oper/agent_sandesh.h>
 #include <oper/vrouter.h>
+#include <oper/agent_route_walker.h>
 #include <nexthop_server/nexthop_manager.h>
 
 using boost::assign::map_list_of;
@@ -239,6 +240,7 @@ OperDB::OperDB(Agent *agent)
     }
 
     agent_sandesh_manager_.reset(new AgentSandeshManager(agent));
+    route_walker_manager_.reset(new AgentRouteWalkerManager(agent));
 }
 
 OperDB::~OperDB() {
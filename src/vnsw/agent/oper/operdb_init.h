@@ -21,6 +21,7 @@ class NexthopManager;
 class AgentSandeshManager;
 class AgentProfile;
 class VRouter;
+class AgentRouteWalkerManager;
 
 class OperDB {
 public:
@@ -56,6 +57,9 @@ public:
         return agent_sandesh_manager_.get();
     }
     VRouter *vrouter() const { return vrouter_.get(); }
+    AgentRouteWalkerManager *route_walker_manager() const {
+        return route_walker_manager_.get();
+    }
 
 private:
     OperDB();
@@ -71,6 +75,7 @@ private:
     std::auto_ptr<AgentSandeshManager> agent_sandesh_manager_;
     std::auto_ptr<AgentProfile> profile_;
     std::auto_ptr<VRouter> vrouter_;
+    std::auto_ptr<AgentRouteWalkerManager> route_walker_manager_;
     DISALLOW_COPY_AND_ASSIGN(OperDB);
 };
 #endif
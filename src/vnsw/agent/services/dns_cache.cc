@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <algorithm>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include "base/time_util.h"
+#include "services/dns_cache.h"
+
+DnsCache::DnsCache(uint32_t max_entries)
+    : max_entries_(max_entries), size_(0) {
+}
+
+DnsCache::~DnsCache() {
+}
+
+bool DnsCache::Lookup(const std::string &vdns, const DnsItem &question,
+                      dns_flags *flags, DnsItems *ans, DnsItems *auth,
+                      DnsItems *add) {
+    if (!max_entries_)
+        return false;
+
+    VdnsMap::iterator vdns_it = vdns_map_.find(VdnsName(vdns));
+    if (vdns_it == vdns_map_.end()) {
+        stats_.misses++;
+        return false;
+    }
+    VdnsEntries *entries = &vdns_it->second;
+    EntryMap::iterator it = entries->map.find(Key(question));
+    if (it == entries->map.end()) {
+        stats_.misses++;
+        return false;
+    }
+
+    EntryList::iterator entry = it->second;
+    uint64_t now = Now();
+    if (now >= entry->expiry) {
+        Erase(entries, entry);
+        stats_.misses++;
+        return false;
+    }
+
+    entries->lru.splice(entries->lru.begin(), entries->lru, entry);
+    uint32_t age = (now - entry->added) / 1000000;
+    *flags = entry->flags;
+    *ans = entry->ans;
+    *auth = entry->auth;
+    *add = entry->add;
+    AgeItems(age, ans);
+    AgeItems(age, auth);
+    AgeItems(age, add);
+
+    stats_.hits++;
+    if (flags->ret || ans->empty())
+        stats_.negative_hits++;
+    return true;
+}
+
+bool DnsCache::Add(const std::string &vdns, const DnsItem &question,
+                   const dns_flags &flags, const DnsItems &ans,
+                   const DnsItems &auth, const DnsItems &add) {
+    if (!max_entries_)
+        return false;
+
+    uint32_t ttl = ResponseTtl(flags, ans, auth, add);
+    if (!ttl)
+        return false;
+
+    VdnsEntries *entries = &vdns_map_[VdnsName(vdns)];
+    Key key(question);
+    EntryMap::iterator it = entries->map.find(key);
+    if (it != entries->map.end()) {
+        Erase(entries, it->second);
+    } else {
+        Evict(entries, max_entries_ - 1);
+    }
+
+    entries->lru.push_front(Entry(key));
+    EntryList::iterator entry = entries->lru.begin();
+    entry->flags = flags;
+    entry->ans = ans;
+    entry->auth = auth;
+    entry->add = add;
+    entry->added = Now();
+    entry->expiry = entry->added + ttl * 1000000ULL;
+    entries->map.insert(std::make_pair(key, entry));
+    size_++;
+    return true;
+}
+
+void DnsCache::Invalidate(const DnsUpdateData &update) {
+    VdnsMap::iterator vdns_it = vdns_map_.find(VdnsName(update.virtual_dns));
+    if (vdns_it == vdns_map_.end())
+        return;
+
+    // names in the update may or may not include the zone
+    std::vector<std::string> names;
+    for (DnsItems::const_iterator item = update.items.begin();
+         item != update.items.end(); ++item) {
+        names.push_back(item->name);
+        if (!update.zone.empty())
+            names.push_back(item->name + "." + update.zone);
+    }
+
+    VdnsEntries *entries = &vdns_it->second;
+    for (EntryList::iterator it = entries->lru.begin();
+         it != entries->lru.end(); ) {
+        EntryList::iterator entry = it++;
+        for (std::vector<std::string>::const_iterator name = names.begin();
+             name != names.end(); ++name) {
+            if (entry->Refers(*name)) {
+                Erase(entries, entry);
+                break;
+            }
+        }
+    }
+}
+
+void DnsCache::Flush(const std::string &vdns) {
+    VdnsMap::iterator vdns_it = vdns_map_.find(VdnsName(vdns));
+    if (vdns_it == vdns_map_.end())
+        return;
+    size_ -= vdns_it->second.map.size();
+    vdns_map_.erase(vdns_it);
+}
+
+void DnsCache::Clear() {
+    vdns_map_.clear();
+    size_ = 0;
+}
+
+uint32_t DnsCache::Size() const {
+    return size_;
+}
+
+void DnsCache::set_max_entries(uint32_t max_entries) {
+    max_entries_ = max_entries;
+    for (VdnsMap::iterator it = vdns_map_.begin(); it != vdns_map_.end();
+         ++it) {
+        Evict(&it->second, max_entries_);
+    }
+}
+
+uint64_t DnsCache::Now() const {
+    return ClockMonotonicUsec();
+}
+
+bool DnsCache::Entry::Refers(const std::string &name) const {
+    if (boost::iequals(key.name, name))
+        return true;
+    for (DnsItems::const_iterator it = ans.begin(); it != ans.end(); ++it) {
+        if (boost::iequals(it->name, name))
+            return true;
+    }
+    return false;
+}
+
+// The names of the virtual DNS in the agent updates are as configured while
+// the queries carry them with the special characters replaced.
+std::string DnsCache::VdnsName(const std::string &vdns) {
+    std::string name(vdns);
+    BindUtil::RemoveSpecialChars(name);
+    return name;
+}
+
+uint32_t DnsCache::ResponseTtl(const dns_flags &flags, const DnsItems &ans,
+                               const DnsItems &auth, const DnsItems &add) {
+    if (flags.ret == DNS_ERR_NO_ERROR && !ans.empty()) {
+        uint32_t ttl = ans.front().ttl;
+        for (DnsItems::const_iterator it = ans.begin(); it != ans.end(); ++it)
+            ttl = std::min(ttl, it->ttl);
+        for (DnsItems::const_iterator it = auth.begin(); it != auth.end(); ++it)
+            ttl = std::min(ttl, it->ttl);
+        for (DnsItems::const_iterator it = add.begin(); it != add.end(); ++it)
+            ttl = std::min(ttl, it->ttl);
+        return ttl;
+    }
+
+    if (flags.ret != DNS_ERR_NO_ERROR && flags.ret != DNS_ERR_NO_SUCH_NAME)
+        return 0;
+
+    // negative response, cached for the SOA ttl
+    for (DnsItems::const_iterator it = auth.begin(); it != auth.end(); ++it) {
+        if (it->type == DNS_TYPE_SOA) {
+            uint32_t ttl = std::min(it->ttl, it->soa.ttl);
+            uint32_t max_ttl = kMaxNegativeTtl;
+            return std::min(ttl, max_ttl);
+        }
+    }
+    return 0;
+}
+
+void DnsCache::AgeItems(uint32_t age, DnsItems *items) {
+    for (DnsItems::iterator it = items->begin(); it != items->end(); ++it)
+        it->ttl = (it->ttl > age) ? it->ttl - age : 0;
+}
+
+void DnsCache::Erase(VdnsEntries *entries, EntryList::iterator it) {
+    entries->map.erase(it->key);
+    entries->lru.erase(it);
+    size_--;
+}
+
+void DnsCache::Evict(VdnsEntries *entries, uint32_t size) {
+    while (entries->map.size() > size) {
+        EntryList::iterator it = entries->lru.end();
+        Erase(entries, --it);
+        stats_.evictions++;
+    }
+}
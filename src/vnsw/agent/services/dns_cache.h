@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef vnsw_agent_dns_cache_h__
+#define vnsw_agent_dns_cache_h__
+
+#include <list>
+#include <map>
+#include <string>
+#include "base/util.h"
+#include "bind/bind_util.h"
+
+// Cache of the responses from the DNS servers to queries from VMs, kept per
+// virtual DNS. Entries are keyed by the name, type and class of the (single)
+// question in the query and live for the smallest ttl of the records in the
+// response. Responses without records (NXDOMAIN / NODATA) are cached for the
+// ttl given by the SOA record in the authority section, as in RFC 2308, and
+// not at all when there is no SOA record.
+//
+// Each virtual DNS holds at most max_entries entries; the least recently
+// used entry is evicted to make room for a new one. Entries for names that
+// are updated through the agent or by the DNS server are invalidated, and
+// all entries of a virtual DNS are flushed when its configuration changes.
+//
+// The cache is accessed only from the Agent::Services task.
+class DnsCache {
+public:
+    static const uint32_t kMaxEntries = 1024;      // per virtual DNS
+    static const uint32_t kMaxNegativeTtl = 900;   // seconds
+
+    struct Stats {
+        Stats() { Reset(); }
+        void Reset() { hits = negative_hits = misses = evictions = 0; }
+
+        uint32_t hits;          // includes negative hits
+        uint32_t negative_hits;
+        uint32_t misses;
+        uint32_t evictions;
+    };
+
+    explicit DnsCache(uint32_t max_entries = kMaxEntries);
+    virtual ~DnsCache();
+
+    // Retrieve the cached response to the question, with the ttl of the
+    // records reduced by the time spent in the cache.
+    bool Lookup(const std::string &vdns, const DnsItem &question,
+                dns_flags *flags, DnsItems *ans, DnsItems *auth,
+                DnsItems *add);
+    // Cache the response to the question; returns false if the response
+    // is not cacheable.
+    bool Add(const std::string &vdns, const DnsItem &question,
+             const dns_flags &flags, const DnsItems &ans,
+             const DnsItems &auth, const DnsItems &add);
+    // Remove the entries that refer to any of the names in the update
+    void Invalidate(const DnsUpdateData &update);
+    // Remove all entries of a virtual DNS
+    void Flush(const std::string &vdns);
+    void Clear();
+
+    uint32_t Size() const;
+    uint32_t max_entries() const { return max_entries_; }
+    // a limit of 0 disables the cache
+    void set_max_entries(uint32_t max_entries);
+    const Stats &stats() const { return stats_; }
+    void ClearStats() { stats_.Reset(); }
+
+protected:
+    // monotonic time in usec
+    virtual uint64_t Now() const;
+
+private:
+
+    struct Key {
+        Key(const DnsItem &question)
+            : name(question.name), type(question.type),
+              eclass(question.eclass) {}
+        bool operator<(const Key &rhs) const {
+            if (type != rhs.type)
+                return type < rhs.type;
+            if (eclass != rhs.eclass)
+                return eclass < rhs.eclass;
+            return name < rhs.name;
+        }
+
+        std::string name;
+        uint16_t type;
+        uint16_t eclass;
+    };
+
+    struct Entry {
+        Entry(const Key &k) : key(k), added(0), expiry(0) {}
+        bool Refers(const std::string &name) const;
+
+        Key key;
+        dns_flags flags;
+        DnsItems ans;
+        DnsItems auth;
+        DnsItems add;
+        uint64_t added;     // usec
+        uint64_t expiry;    // usec
+    };
+
+    // entries in the order of use, most recently used first
+    typedef std::list<Entry> EntryList;
+    typedef std::map<Key, EntryList::iterator> EntryMap;
+    struct VdnsEntries {
+        EntryList lru;
+        EntryMap map;
+    };
+    typedef std::map<std::string, VdnsEntries> VdnsMap;
+
+    static std::string VdnsName(const std::string &vdns);
+    static uint32_t ResponseTtl(const dns_flags &flags, const DnsItems &ans,
+                                const DnsItems &auth, const DnsItems &add);
+    static void AgeItems(uint32_t age, DnsItems *items);
+    void Erase(VdnsEntries *entries, EntryList::iterator it);
+    void Evict(VdnsEntries *entries, uint32_t size);
+
+    uint32_t max_entries_;
+    uint32_t size_;
+    VdnsMap vdns_map_;
+    Stats stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(DnsCache);
+};
+
+#endif // vnsw_agent_dns_cache_h__
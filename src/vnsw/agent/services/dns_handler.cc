@@ -326,6 +326,8 @@ bool DnsHandler::HandleVirtualDnsRequest(const VmInterface *vmitf) {
                 break;
             }
             UpdateQueryNames();
+            if (ResolveFromCache())
+                break;
 
             int8_t count = 0;
             bool query_success = false;
@@ -422,6 +424,40 @@ cleanup:
     return false;
 }
 
+// Only responses to queries with a single question that is not resolved
+// locally are cached
+bool DnsHandler::IsCacheable() const {
+    return (items_.size() == 1 && linklocal_items_.empty());
+}
+
+bool DnsHandler::ResolveFromCache() {
+    if (!IsCacheable())
+        return false;
+
+    dns_flags flags;
+    DnsItems ans, auth, add;
+    DnsCache *cache = agent()->GetDnsProto()->dns_cache();
+    if (!cache->Lookup(ipam_type_.ipam_dns_server.virtual_dns_server_name,
+                       items_.front(), &flags, &ans, &auth, &add))
+        return false;
+
+    DNS_BIND_TRACE(DnsBindTrace, "Query resolved from cache : xid = " <<
+                   ntohs(dns_->xid) << " " << DnsItemsToString(items_));
+    Resolve(flags, items_, ans, auth, add);
+    return true;
+}
+
+// Called with the response from the DNS server, before Resolve updates it
+void DnsHandler::CacheResponse(const dns_flags &flags, const DnsItems &ans,
+                               const DnsItems &auth, const DnsItems &add) {
+    if (!IsCacheable())
+        return;
+
+    DnsCache *cache = agent()->GetDnsProto()->dns_cache();
+    cache->Add(ipam_type_.ipam_dns_server.virtual_dns_server_name,
+               items_.front(), flags, ans, auth, add);
+}
+
 // Check the request against configured link local services and
 // update DnsItems, if found
 bool DnsHandler::ResolveLinkLocalRequest(DnsItems::iterator &item,
@@ -555,6 +591,7 @@ bool DnsHandler::HandleBindResponse() {
                                        DnsItemsToString(linklocal_items_));
                     } else {
                         valid_response = true;
+                        handler->CacheResponse(flags, ans, auth, add);
                         handler->Resolve(flags, ques, ans, auth, add);
                         DNS_BIND_TRACE(DnsBindTrace,
                                        "Query successful : xid = " <<
@@ -584,6 +621,7 @@ bool DnsHandler::HandleBindResponse() {
         } else if (!dns_proto->IsDnsHandlerInUse(handler)) {
             if (flags.ret) {
                 /* Send last invalid response to requesting VM */
+                handler->CacheResponse(flags, ans, auth, add);
                 handler->Resolve(flags, ques, ans, auth, add);
                 DNS_BIND_TRACE(DnsBindTrace,
                                "Send invalid BIND response: xid = " << xid);
@@ -627,6 +665,8 @@ bool DnsHandler::HandleRetryExpiry() {
 bool DnsHandler::HandleUpdateResponse() {
     DnsProto::DnsUpdateIpc *ipc =
         static_cast<DnsProto::DnsUpdateIpc *>(pkt_info_->ipc);
+    if (ipc->xmpp_data)
+        agent()->GetDnsProto()->dns_cache()->Invalidate(*ipc->xmpp_data);
     delete ipc;
     return true;
 }
@@ -646,6 +686,10 @@ bool DnsHandler::HandleModifyVdns() {
     DnsProto::DnsUpdateIpc *ipc =
         static_cast<DnsProto::DnsUpdateIpc *>(pkt_info_->ipc);
     DnsProto *dns_proto = agent()->GetDnsProto();
+    // cached responses may have come from the earlier configuration
+    dns_proto->dns_cache()->Flush(ipc->old_vdns);
+    if (!ipc->new_vdns.empty())
+        dns_proto->dns_cache()->Flush(ipc->new_vdns);
     std::vector<DnsProto::DnsUpdateIpc *> change_list;
     const DnsProto::DnsUpdateSet &update_set = dns_proto->update_set();
     for (DnsProto::DnsUpdateSet::const_iterator it = update_set.begin();
@@ -921,6 +965,7 @@ void DnsHandler::Update(InterTaskMsg *msg) {
     DnsProto::DnsUpdateIpc *update = static_cast<DnsProto::DnsUpdateIpc *>(msg);
     bool free_update = true;
     DnsProto *dns_proto = agent()->GetDnsProto();
+    dns_proto->dns_cache()->Invalidate(*update->xmpp_data);
     DnsProto::DnsUpdateIpc *update_req = dns_proto->FindUpdateRequest(update);
     if (update_req) {
         DnsUpdateData *data = update_req->xmpp_data;
@@ -964,6 +1009,7 @@ void DnsHandler::DelUpdate(InterTaskMsg *msg) {
     DnsProto *dns_proto = agent()->GetDnsProto();
     DnsProto::DnsUpdateIpc *update_req = dns_proto->FindUpdateRequest(update);
     while (update_req) {
+        dns_proto->dns_cache()->Invalidate(*update_req->xmpp_data);
         for (DnsItems::iterator item = update_req->xmpp_data->items.begin(); 
              item != update_req->xmpp_data->items.end(); ++item) {
             // in case of delete, set the class to NONE and ttl to 0
@@ -74,6 +74,10 @@ private:
     void Resolve(dns_flags flags, const DnsItems &ques, DnsItems &ans,
                  DnsItems &auth, DnsItems &add);
     bool SendDnsQuery(int8_t idx, uint16_t xid);
+    bool IsCacheable() const;
+    bool ResolveFromCache();
+    void CacheResponse(const dns_flags &flags, const DnsItems &ans,
+                       const DnsItems &auth, const DnsItems &add);
     void SendDnsResponse();
     void UpdateQueryNames();
     void UpdateOffsets(DnsItem &item, bool name_update_required);
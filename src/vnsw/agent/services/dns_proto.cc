@@ -26,6 +26,7 @@ void DnsProto::IoShutdown() {
     }
 
     curr_vm_requests_.clear();
+    dns_cache_.Clear();
     // Following tables should be deleted when all VMs are gone
     assert(update_set_.empty());
     assert(all_vms_.empty());
@@ -6,6 +6,7 @@
 #define vnsw_agent_dns_proto_hpp
 
 #include "pkt/proto.h"
+#include "services/dns_cache.h"
 #include "services/dns_handler.h"
 #include "vnc_cfg_types.h"
 
@@ -209,7 +210,9 @@ public:
     void IncrStatsFail() { stats_.fail++; }
     void IncrStatsDrop() { stats_.drop++; }
     const DnsStats &GetStats() const { return stats_; }
-    void ClearStats() { stats_.Reset(); }
+    void ClearStats() { stats_.Reset(); dns_cache_.ClearStats(); }
+    DnsCache *dns_cache() { return &dns_cache_; }
+    const DnsCache *dns_cache() const { return &dns_cache_; }
     const VmDataMap& all_vms() const { return all_vms_; }
     const DnsFipSet& fip_list() const { return fip_list_; }
 
@@ -248,6 +251,7 @@ private:
     DnsVmRequestSet curr_vm_requests_;
     DnsBindQueryIndexMap dns_query_index_map_;
     DnsStats stats_;
+    DnsCache dns_cache_;
     uint32_t timeout_;   // milli seconds
     uint32_t max_retries_;
 
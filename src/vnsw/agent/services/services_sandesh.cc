@@ -222,6 +222,12 @@ void ServicesSandesh::DnsStatsSandesh(std::string ctxt, bool more) {
     dns->set_dns_unsupported(nstats.unsupported);
     dns->set_dns_failures(nstats.fail);
     dns->set_dns_drops(nstats.drop);
+    const DnsCache *cache = Agent::GetInstance()->GetDnsProto()->dns_cache();
+    dns->set_dns_cache_hits(cache->stats().hits);
+    dns->set_dns_cache_negative_hits(cache->stats().negative_hits);
+    dns->set_dns_cache_misses(cache->stats().misses);
+    dns->set_dns_cache_evictions(cache->stats().evictions);
+    dns->set_dns_cache_entries(cache->Size());
     dns->set_context(ctxt);
     dns->set_more(more);
     dns->Response();
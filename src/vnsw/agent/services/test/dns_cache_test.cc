@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/os.h"
+#include "testing/gunit.h"
+
+#include <sstream>
+#include <boost/scoped_ptr.hpp>
+#include <sys/socket.h>
+#include <netinet/if_ether.h>
+#include <base/logging.h>
+#include <base/test/task_test_util.h>
+
+#include <io/event_manager.h>
+#include <cmn/agent_cmn.h>
+#include <oper/operdb_init.h>
+#include <controller/controller_init.h>
+#include <pkt/pkt_init.h>
+#include <services/services_init.h>
+#include <vrouter/ksync/ksync_init.h>
+#include <services/dns_proto.h>
+#include <vr_interface.h>
+#include "bind/bind_util.h"
+#include "bind/bind_resolver.h"
+#include <test/test_cmn_util.h>
+#include <services/services_sandesh.h>
+#include "vr_types.h"
+
+using boost::asio::ip::udp;
+
+#define DNS_CLIENT_PORT 9999
+#define BUF_SIZE 1024
+
+// Answers the queries forwarded by the agent in place of the DNS server:
+// A queries for names in the table are answered, the rest get NXDOMAIN with
+// an SOA record in the authority section.
+class StubResolver {
+public:
+    static const uint32_t kTtl = 300;           // seconds
+    static const uint32_t kNegativeTtl = 60;    // seconds
+
+    explicit StubResolver(boost::asio::io_service &io)
+        : socket_(io, udp::endpoint(boost::asio::ip::address_v4::loopback(),
+                                    0)) {
+        queries_ = 0;
+        StartReceive();
+    }
+
+    void Shutdown() {
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+
+    void AddName(const std::string &name, const std::string &address) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        names_[name] = address;
+    }
+
+    uint16_t port() const { return socket_.local_endpoint().port(); }
+    uint32_t queries() const { return queries_; }
+
+private:
+    void StartReceive() {
+        socket_.async_receive_from(boost::asio::buffer(buf_, sizeof(buf_)),
+            remote_, boost::bind(&StubResolver::HandleReceive, this,
+                                 boost::asio::placeholders::error));
+    }
+
+    void HandleReceive(const boost::system::error_code &error) {
+        if (error)
+            return;
+
+        DnsItems ques;
+        BindUtil::ParseDnsQuery(buf_, ques);
+        queries_++;
+
+        uint16_t xid = ntohs(((dnshdr *) buf_)->xid);
+        uint8_t resp[BUF_SIZE];
+        memset(resp, 0, sizeof(resp));
+        dnshdr *dns = (dnshdr *) resp;
+        DnsItem answer;
+        answer.eclass = DNS_CLASS_IN;
+        answer.type = DNS_A_RECORD;
+        answer.ttl = kTtl;
+        if (ques.size() == 1) {
+            answer.name = ques.front().name;
+            tbb::mutex::scoped_lock lock(mutex_);
+            std::map<std::string, std::string>::iterator it =
+                names_.find(answer.name);
+            if (it != names_.end())
+                answer.data = it->second;
+        }
+
+        uint8_t ret = answer.data.empty() ? DNS_ERR_NO_SUCH_NAME : 0;
+        BindUtil::BuildDnsHeader(dns, xid, DNS_QUERY_RESPONSE,
+                                 DNS_OPCODE_QUERY, 0, 0, ret, 0);
+        uint16_t len = sizeof(dnshdr);
+        uint8_t *ptr = (uint8_t *) (dns + 1);
+        if (!answer.name.empty()) {
+            dns->ques_rrcount = htons(1);
+            ptr = BindUtil::AddQuestionSection(ptr, answer.name, answer.type,
+                                               answer.eclass, len);
+        }
+        if (!ret) {
+            dns->ans_rrcount = htons(1);
+            ptr = BindUtil::AddAnswerSection(ptr, answer, len);
+        } else {
+            DnsItem soa;
+            soa.eclass = DNS_CLASS_IN;
+            soa.type = DNS_TYPE_SOA;
+            soa.ttl = kTtl;
+            soa.name = "example.com";
+            soa.soa.primary_ns = "ns.example.com";
+            soa.soa.mailbox = "admin.example.com";
+            soa.soa.serial = 1;
+            soa.soa.refresh = soa.soa.retry = soa.soa.expiry = kTtl;
+            soa.soa.ttl = kNegativeTtl;
+            dns->auth_rrcount = htons(1);
+            ptr = BindUtil::AddAnswerSection(ptr, soa, len);
+        }
+
+        boost::system::error_code ec;
+        socket_.send_to(boost::asio::buffer(resp, len), remote_, 0, ec);
+        StartReceive();
+    }
+
+    udp::socket socket_;
+    udp::endpoint remote_;
+    uint8_t buf_[BUF_SIZE];
+    tbb::atomic<uint32_t> queries_;
+    tbb::mutex mutex_;
+    std::map<std::string, std::string> names_;
+};
+
+// Cache with a clock that moves only when the test ages it
+class DnsCacheAging : public DnsCache {
+public:
+    explicit DnsCacheAging(uint32_t max_entries = kMaxEntries)
+        : DnsCache(max_entries), now_(1000000) {
+    }
+
+    void Age(uint32_t seconds) { now_ += seconds * 1000000ULL; }
+
+protected:
+    virtual uint64_t Now() const { return now_; }
+
+private:
+    uint64_t now_;
+};
+
+class DnsCacheTest : public ::testing::Test {
+public:
+    DnsCacheTest() : sandesh_cache_hits_(0) {
+        flags_ = dns_flags();
+    }
+
+    virtual void SetUp() {
+        Agent::GetInstance()->controller()->Cleanup();
+        client->WaitForIdle();
+        Agent::GetInstance()->controller()->DisConnect();
+        client->WaitForIdle();
+
+        resolver_.reset(new StubResolver(
+            *Agent::GetInstance()->event_manager()->io_service()));
+        Agent::GetInstance()->set_dns_server("127.0.0.1", 0);
+        Agent::GetInstance()->set_dns_server_port(resolver_->port(), 0);
+        Agent::GetInstance()->reset_dns_server(1);
+        BindResolver::Resolver()->SetupResolver(
+            BindResolver::DnsServer("127.0.0.1", resolver_->port()), 0);
+        Agent::GetInstance()->GetDnsProto()->ClearStats();
+    }
+
+    virtual void TearDown() {
+        client->WaitForIdle();
+        resolver_->Shutdown();
+        client->WaitForIdle();
+    }
+
+    static DnsItem Question(const std::string &name) {
+        DnsItem item;
+        item.eclass = DNS_CLASS_IN;
+        item.type = DNS_A_RECORD;
+        item.name = name;
+        return item;
+    }
+
+    static DnsItem Answer(const std::string &name, const std::string &address,
+                          uint32_t ttl) {
+        DnsItem item = Question(name);
+        item.data = address;
+        item.ttl = ttl;
+        return item;
+    }
+
+    static DnsItem Soa(uint32_t ttl, uint32_t minimum) {
+        DnsItem item;
+        item.eclass = DNS_CLASS_IN;
+        item.type = DNS_TYPE_SOA;
+        item.name = "example.com";
+        item.ttl = ttl;
+        item.soa.primary_ns = "ns.example.com";
+        item.soa.mailbox = "admin.example.com";
+        item.soa.ttl = minimum;
+        return item;
+    }
+
+    void SendDnsQuery(short itf_index, const std::string &name) {
+        uint8_t *buf = new uint8_t[BUF_SIZE];
+        memset(buf, 0, BUF_SIZE);
+
+        struct ether_header *eth = (struct ether_header *)buf;
+        eth->ether_dhost[5] = 1;
+        eth->ether_shost[5] = 2;
+        eth->ether_type = htons(0x800);
+
+        agent_hdr *agent = (agent_hdr *)(eth + 1);
+        agent->hdr_ifindex = htons(itf_index);
+        agent->hdr_vrf = htons(0);
+        agent->hdr_cmd = htons(AgentHdr::TRAP_NEXTHOP);
+
+        eth = (struct ether_header *) (agent + 1);
+        eth->ether_dhost[5] = 0x15;
+        eth->ether_shost[5] = 0x05;
+        eth->ether_type = htons(0x800);
+
+        struct ip *ip = (struct ip *) (eth + 1);
+        ip->ip_hl = 5;
+        ip->ip_v = 4;
+        ip->ip_ttl = 16;
+        ip->ip_p = IPPROTO_UDP;
+        ip->ip_src.s_addr = htonl(1234);
+        ip->ip_dst.s_addr = htonl(5678);
+
+        udphdr *udp = (udphdr *) (ip + 1);
+        udp->uh_sport = htons(DNS_CLIENT_PORT);
+        udp->uh_dport = htons(DNS_SERVER_PORT);
+
+        dnshdr *dns = (dnshdr *) (udp + 1);
+        DnsItems questions;
+        questions.push_back(Question(name));
+        int len = BindUtil::BuildDnsQuery((uint8_t *)dns, 0x0102,
+                                          "default-vdns", questions);
+        dns->flags = flags_;
+
+        len += sizeof(udphdr);
+        udp->uh_ulen = htons(len);
+        ip->ip_len = htons(len + sizeof(struct ip));
+
+        len += sizeof(struct ip) + sizeof(struct ether_header) +
+            Agent::GetInstance()->pkt()->pkt_handler()->EncapHeaderLen();
+        TestPkt0Interface *tap = (TestPkt0Interface *)
+                (Agent::GetInstance()->pkt()->control_interface());
+        tap->TxPacket(buf, len);
+    }
+
+    // Update of a record of the virtual DNS, as pushed by the DNS server
+    void SendRecordUpdate(const std::string &vdns, const std::string &zone,
+                          const std::string &name) {
+        DnsUpdateData *data = new DnsUpdateData(vdns, zone);
+        data->items.push_back(Answer(name, "10.1.1.1", 100));
+        Agent::GetInstance()->GetDnsProto()->SendDnsUpdateIpc(data,
+            DnsAgentXmpp::UpdateResponse, NULL, false);
+    }
+
+    void CheckSandeshResponse(Sandesh *sandesh) {
+        DnsStats *resp = dynamic_cast<DnsStats *>(sandesh);
+        if (resp)
+            sandesh_cache_hits_ = resp->get_dns_cache_hits();
+    }
+
+    const DnsProto::DnsStats &stats() const {
+        return Agent::GetInstance()->GetDnsProto()->GetStats();
+    }
+
+    const DnsCache::Stats &cache_stats() const {
+        return Agent::GetInstance()->GetDnsProto()->dns_cache()->stats();
+    }
+
+    dns_flags flags_;
+    int sandesh_cache_hits_;
+    boost::scoped_ptr<StubResolver> resolver_;
+};
+
+// Positive responses live for the smallest ttl in the response and are
+// returned with the ttl reduced by their age.
+TEST_F(DnsCacheTest, Ttl) {
+    DnsCacheAging cache;
+    dns_flags flags = dns_flags(), cached_flags;
+    DnsItems ans, auth, add, cached_ans, cached_auth, cached_add;
+    ans.push_back(Answer("www.example.com", "1.2.3.4", 300));
+    ans.push_back(Answer("www.example.com", "1.2.3.5", 200));
+    auth.push_back(Answer("ns.example.com", "1.2.3.1", 600));
+
+    DnsItem question = Question("www.example.com");
+    EXPECT_FALSE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+    EXPECT_TRUE(cache.Add("vdns1", question, flags, ans, auth, add));
+    EXPECT_EQ(1U, cache.Size());
+
+    cache.Age(50);
+    EXPECT_TRUE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                             &cached_auth, &cached_add));
+    EXPECT_EQ(2U, cached_ans.size());
+    EXPECT_EQ(250U, cached_ans.front().ttl);
+    EXPECT_EQ(150U, cached_ans.back().ttl);
+    EXPECT_EQ(550U, cached_auth.front().ttl);
+    EXPECT_EQ("1.2.3.4", cached_ans.front().data);
+
+    // other virtual DNS, name and type
+    EXPECT_FALSE(cache.Lookup("vdns2", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+    DnsItem other = Question("ftp.example.com");
+    EXPECT_FALSE(cache.Lookup("vdns1", other, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+    other = question;
+    other.type = DNS_AAAA_RECORD;
+    EXPECT_FALSE(cache.Lookup("vdns1", other, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+
+    cache.Age(150);
+    EXPECT_FALSE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+    EXPECT_EQ(0U, cache.Size());
+    EXPECT_EQ(1U, cache.stats().hits);
+    EXPECT_EQ(5U, cache.stats().misses);
+
+    // records with no ttl are not cached
+    ans.push_back(Answer("www.example.com", "1.2.3.6", 0));
+    EXPECT_FALSE(cache.Add("vdns1", question, flags, ans, auth, add));
+    EXPECT_EQ(0U, cache.Size());
+}
+
+// NXDOMAIN and NODATA responses are cached for the SOA ttl; other failures
+// and negative responses without an SOA are not cached.
+TEST_F(DnsCacheTest, Negative) {
+    DnsCacheAging cache;
+    dns_flags flags = dns_flags(), cached_flags;
+    DnsItems ans, auth, add, cached_ans, cached_auth, cached_add;
+    DnsItem question = Question("missing.example.com");
+
+    flags.ret = DNS_ERR_NO_SUCH_NAME;
+    EXPECT_FALSE(cache.Add("vdns1", question, flags, ans, auth, add));
+    flags.ret = DNS_ERR_SERVER_FAIL;
+    auth.push_back(Soa(3600, 60));
+    EXPECT_FALSE(cache.Add("vdns1", question, flags, ans, auth, add));
+
+    flags.ret = DNS_ERR_NO_SUCH_NAME;
+    EXPECT_TRUE(cache.Add("vdns1", question, flags, ans, auth, add));
+    EXPECT_TRUE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                             &cached_auth, &cached_add));
+    EXPECT_EQ(DNS_ERR_NO_SUCH_NAME, static_cast<int>(cached_flags.ret));
+    EXPECT_TRUE(cached_ans.empty());
+    EXPECT_EQ(1U, cached_auth.size());
+    EXPECT_EQ(1U, cache.stats().negative_hits);
+    cache.Age(60);
+    EXPECT_FALSE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+
+    // NODATA, limited by the ttl of the SOA record itself
+    flags.ret = 0;
+    auth.clear();
+    auth.push_back(Soa(30, 60));
+    EXPECT_TRUE(cache.Add("vdns1", question, flags, ans, auth, add));
+    cache.Age(29);
+    EXPECT_TRUE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                             &cached_auth, &cached_add));
+    EXPECT_EQ(2U, cache.stats().negative_hits);
+    cache.Age(1);
+    EXPECT_FALSE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+
+    // long negative ttls are capped
+    auth.clear();
+    auth.push_back(Soa(86400, 86400));
+    EXPECT_TRUE(cache.Add("vdns1", question, flags, ans, auth, add));
+    cache.Age(DnsCache::kMaxNegativeTtl);
+    EXPECT_FALSE(cache.Lookup("vdns1", question, &cached_flags, &cached_ans,
+                              &cached_auth, &cached_add));
+}
+
+// Each virtual DNS holds at most max_entries, evicting the least recently
+// used entry.
+TEST_F(DnsCacheTest, Lru) {
+    DnsCacheAging cache(4);
+    dns_flags flags = dns_flags(), cached_flags;
+    DnsItems auth, add, cached_ans, cached_auth, cached_add;
+    std::vector<DnsItem> questions;
+    for (int i = 0; i < 6; ++i) {
+        std::stringstream name;
+        name << "host" << i << ".example.com";
+        questions.push_back(Question(name.str()));
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        DnsItems ans;
+        ans.push_back(Answer(questions[i].name, "1.1.1.1", 100));
+        EXPECT_TRUE(cache.Add("vdns1", questions[i], flags, ans, auth, add));
+        EXPECT_TRUE(cache.Add("vdns2", questions[i], flags, ans, auth, add));
+    }
+    EXPECT_EQ(8U, cache.Size());
+
+    // host0 is used, so host1 is evicted first
+    EXPECT_TRUE(cache.Lookup("vdns1", questions[0], &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+    for (int i = 4; i < 6; ++i) {
+        DnsItems ans;
+        ans.push_back(Answer(questions[i].name, "1.1.1.1", 100));
+        EXPECT_TRUE(cache.Add("vdns1", questions[i], flags, ans, auth, add));
+    }
+    EXPECT_EQ(8U, cache.Size());
+    EXPECT_EQ(2U, cache.stats().evictions);
+    EXPECT_TRUE(cache.Lookup("vdns1", questions[0], &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+    EXPECT_FALSE(cache.Lookup("vdns1", questions[1], &cached_flags,
+                              &cached_ans, &cached_auth, &cached_add));
+    EXPECT_FALSE(cache.Lookup("vdns1", questions[2], &cached_flags,
+                              &cached_ans, &cached_auth, &cached_add));
+    EXPECT_TRUE(cache.Lookup("vdns1", questions[3], &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+    EXPECT_TRUE(cache.Lookup("vdns2", questions[1], &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+
+    cache.set_max_entries(2);
+    EXPECT_EQ(4U, cache.Size());
+    cache.set_max_entries(0);
+    EXPECT_EQ(0U, cache.Size());
+    DnsItems ans;
+    ans.push_back(Answer(questions[0].name, "1.1.1.1", 100));
+    EXPECT_FALSE(cache.Add("vdns1", questions[0], flags, ans, auth, add));
+}
+
+// Updated names are removed from the cache, whether or not the update
+// carries the zone in the name, as are responses with the name in the
+// answer; the whole virtual DNS is flushed on configuration changes.
+TEST_F(DnsCacheTest, Invalidate) {
+    DnsCacheAging cache;
+    dns_flags flags = dns_flags(), cached_flags;
+    DnsItems auth, add, cached_ans, cached_auth, cached_add;
+
+    DnsItem www = Question("www.example.com");
+    DnsItems ans;
+    ans.push_back(Answer(www.name, "1.1.1.1", 100));
+    EXPECT_TRUE(cache.Add("default-domain-vdns1", www, flags, ans, auth, add));
+
+    DnsItem alias = Question("alias.example.com");
+    DnsItem cname = Answer(alias.name, www.name, 100);
+    cname.type = DNS_CNAME_RECORD;
+    ans.push_front(cname);
+    EXPECT_TRUE(cache.Add("default-domain-vdns1", alias, flags, ans, auth,
+                          add));
+
+    DnsItem ftp = Question("ftp.example.com");
+    ans.clear();
+    ans.push_back(Answer(ftp.name, "1.1.1.2", 100));
+    EXPECT_TRUE(cache.Add("default-domain-vdns1", ftp, flags, ans, auth, add));
+    EXPECT_TRUE(cache.Add("default-domain-vdns2", www, flags, ans, auth, add));
+    EXPECT_EQ(4U, cache.Size());
+
+    // configured virtual DNS name, in another case
+    DnsUpdateData update("default-domain:vdns1", "example.com");
+    update.items.push_back(Answer("WWW", "1.1.1.3", 100));
+    cache.Invalidate(update);
+    EXPECT_EQ(2U, cache.Size());
+    EXPECT_FALSE(cache.Lookup("default-domain-vdns1", www, &cached_flags,
+                              &cached_ans, &cached_auth, &cached_add));
+    EXPECT_FALSE(cache.Lookup("default-domain-vdns1", alias, &cached_flags,
+                              &cached_ans, &cached_auth, &cached_add));
+    EXPECT_TRUE(cache.Lookup("default-domain-vdns1", ftp, &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+    EXPECT_TRUE(cache.Lookup("default-domain-vdns2", www, &cached_flags,
+                             &cached_ans, &cached_auth, &cached_add));
+
+    cache.Flush("default-domain:vdns1");
+    EXPECT_EQ(1U, cache.Size());
+    cache.Clear();
+    EXPECT_EQ(0U, cache.Size());
+}
+
+// Queries from a VM are answered from the cache, through the agent, without
+// going to the DNS server again.
+TEST_F(DnsCacheTest, VirtualDns) {
+    struct PortInfo input[] = {
+        {"vnet1", 1, "1.1.1.1", "00:00:00:01:01:01", 1, 1},
+    };
+    IpamInfo ipam_info[] = {
+        {"1.1.1.0", 24, "1.1.1.200", true},
+    };
+    char vdns_attr[] =
+        "<virtual-DNS-data>\
+            <domain-name>example.com</domain-name>\
+            <dynamic-records-from-client>true</dynamic-records-from-client>\
+            <record-order>fixed</record-order>\
+            <default-ttl-seconds>120</default-ttl-seconds>\
+        </virtual-DNS-data>\n";
+    char vdns_ttl_attr[] =
+        "<virtual-DNS-data>\
+            <domain-name>example.com</domain-name>\
+            <dynamic-records-from-client>true</dynamic-records-from-client>\
+            <record-order>fixed</record-order>\
+            <default-ttl-seconds>240</default-ttl-seconds>\
+        </virtual-DNS-data>\n";
+    char ipam_attr[] = "<network-ipam-mgmt>\n <ipam-dns-method>virtual-dns-server</ipam-dns-method>\n <ipam-dns-server><virtual-dns-server-name>vdns1</virtual-dns-server-name></ipam-dns-server>\n </network-ipam-mgmt>\n";
+
+    resolver_->AddName("www.example.com", "10.1.1.10");
+    CreateVmportEnv(input, 1, 0);
+    client->WaitForIdle();
+    AddIPAM("vn1", ipam_info, 1, ipam_attr, "vdns1");
+    AddVDNS("vdns1", vdns_attr);
+    client->WaitForIdle();
+    EXPECT_TRUE(VmPortActive(input, 0));
+    short itf_index = VmPortGet(1)->id();
+    DnsCache *cache = Agent::GetInstance()->GetDnsProto()->dns_cache();
+    cache->Clear();
+    Agent::GetInstance()->GetDnsProto()->ClearStats();
+
+    // miss, resolved by the DNS server
+    SendDnsQuery(itf_index, "www.example.com");
+    TASK_UTIL_EXPECT_EQ(1U, stats().resolved);
+    EXPECT_EQ(1U, resolver_->queries());
+    EXPECT_EQ(1U, cache_stats().misses);
+    EXPECT_EQ(1U, cache->Size());
+
+    // hit
+    SendDnsQuery(itf_index, "www.example.com");
+    TASK_UTIL_EXPECT_EQ(2U, stats().resolved);
+    EXPECT_EQ(1U, resolver_->queries());
+    EXPECT_EQ(1U, cache_stats().hits);
+
+    // negative miss and hit
+    SendDnsQuery(itf_index, "missing.example.com");
+    TASK_UTIL_EXPECT_EQ(1U, stats().fail);
+    EXPECT_EQ(2U, resolver_->queries());
+    SendDnsQuery(itf_index, "missing.example.com");
+    TASK_UTIL_EXPECT_EQ(2U, stats().fail);
+    EXPECT_EQ(2U, resolver_->queries());
+    EXPECT_EQ(1U, cache_stats().negative_hits);
+    EXPECT_EQ(2U, cache->Size());
+
+    // a record update from the DNS server invalidates the cached response
+    SendRecordUpdate("vdns1", "example.com", "www");
+    client->WaitForIdle();
+    EXPECT_EQ(1U, cache->Size());
+    SendDnsQuery(itf_index, "www.example.com");
+    TASK_UTIL_EXPECT_EQ(3U, stats().resolved);
+    EXPECT_EQ(3U, resolver_->queries());
+    EXPECT_EQ(3U, cache_stats().misses);
+
+    // as does a change to the virtual DNS
+    AddVDNS("vdns1", vdns_ttl_attr);
+    client->WaitForIdle();
+    SendDnsQuery(itf_index, "www.example.com");
+    TASK_UTIL_EXPECT_EQ(4U, stats().resolved);
+    EXPECT_EQ(4U, resolver_->queries());
+
+    // Retrieve the stats via Introspect
+    DnsInfo *sand = new DnsInfo();
+    Sandesh::set_response_callback(
+        boost::bind(&DnsCacheTest::CheckSandeshResponse, this, _1));
+    sand->HandleRequest();
+    client->WaitForIdle();
+    sand->Release();
+    EXPECT_EQ(2, sandesh_cache_hits_);
+
+    DeleteVmportEnv(input, 1, 1, 0);
+    client->WaitForIdle();
+    DelIPAM("vn1", "vdns1");
+    client->WaitForIdle();
+    DelVDNS("vdns1");
+    client->WaitForIdle();
+    Agent::GetInstance()->GetDnsProto()->ClearStats();
+}
+
+int main(int argc, char *argv[]) {
+    GETUSERARGS();
+
+    client = TestInit(init_file, ksync_init, true, true);
+    usleep(100000);
+    client->WaitForIdle();
+
+    Agent::GetInstance()->reset_controller_ifmap_xmpp_server(0);
+    Agent::GetInstance()->reset_controller_ifmap_xmpp_server(1);
+
+    int ret = RUN_ALL_TESTS();
+    client->WaitForIdle();
+    TestShutdown();
+    delete client;
+    return ret;
+}
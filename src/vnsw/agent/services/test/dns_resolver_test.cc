@@ -109,6 +109,9 @@ public:
         Agent::GetInstance()->set_dns_server_port(53, 0);
         Agent::GetInstance()->set_dns_server("127.0.0.2", 1);
         Agent::GetInstance()->set_dns_server_port(53, 1);
+        // repeated queries are expected to reach the DNS server; the
+        // response cache is covered in dns_cache_test
+        Agent::GetInstance()->GetDnsProto()->dns_cache()->set_max_entries(0);
 
         rid_ = Agent::GetInstance()->interface_table()->Register(
                 boost::bind(&DnsTest::ItfUpdate, this, _2));
@@ -100,6 +100,9 @@ public:
     DnsTest() { 
         Agent::GetInstance()->set_controller_ifmap_xmpp_server("127.0.0.1", 0);
         Agent::GetInstance()->set_ifmap_active_xmpp_server("127.0.0.1", 0);
+        // repeated queries are expected to reach the DNS server; the
+        // response cache is covered in dns_cache_test
+        Agent::GetInstance()->GetDnsProto()->dns_cache()->set_max_entries(0);
         rid_ = Agent::GetInstance()->interface_table()->Register(
                 boost::bind(&DnsTest::ItfUpdate, this, _2));
         for (int i = 0; i < MAX_ITEMS; i++) {
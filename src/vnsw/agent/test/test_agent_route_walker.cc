@@ -262,6 +262,48 @@ class SetupTask : public Task {
         std::string test_name_;
 };
 
+// Walker counting route notifications, used to verify that route walks
+// issued by different walkers on same VRF share one table traversal.
+class SharedRouteWalker : public AgentRouteWalker {
+public:
+    SharedRouteWalker(Agent *agent) :
+        AgentRouteWalker(agent, AgentRouteWalker::ALL), route_notifications_(0) {
+    }
+    virtual bool RouteWalkNotify(DBTablePartBase *partition, DBEntryBase *e) {
+        route_notifications_++;
+        return true;
+    }
+    tbb::atomic<uint32_t> route_notifications_;
+};
+
+class SharedWalkTask : public Task {
+public:
+    SharedWalkTask(AgentRouteWalker *walker1, AgentRouteWalker *walker2,
+                   VrfEntry *vrf) :
+        Task((TaskScheduler::GetInstance()->
+              GetTaskId("Agent::RouteWalker")), 0),
+        walker1_(walker1), walker2_(walker2), vrf_(vrf) {
+    }
+
+    // Both walks are started from same task run, so second walker finds the
+    // route table walks of first one not started yet and joins them.
+    virtual bool Run() {
+        boost::shared_ptr<AgentRouteWalkerQueueEntry> data1
+            (new AgentRouteWalkerQueueEntry(vrf_,
+                 AgentRouteWalkerQueueEntry::START_ROUTE_WALK, false));
+        boost::shared_ptr<AgentRouteWalkerQueueEntry> data2
+            (new AgentRouteWalkerQueueEntry(vrf_,
+                 AgentRouteWalkerQueueEntry::START_ROUTE_WALK, false));
+        walker1_->RouteWalker(data1);
+        walker2_->RouteWalker(data2);
+        return true;
+    }
+private:
+    AgentRouteWalker *walker1_;
+    AgentRouteWalker *walker2_;
+    VrfEntry *vrf_;
+};
+
 TEST_F(AgentRouteWalkerTest, walk_all_routes_wih_no_vrf) {
     client->Reset();
     SetupEnvironment(0);
@@ -354,6 +396,41 @@ TEST_F(AgentRouteWalkerTest, walk_on_deleted_vrf_with_deleted_route_table) {
     DeleteEnvironment(1);
 }
 
+TEST_F(AgentRouteWalkerTest, shared_route_walk) {
+    client->Reset();
+    SetupEnvironment(1);
+    Agent *agent = Agent::GetInstance();
+    AgentRouteWalkerManager *mgr = agent->oper_db()->route_walker_manager();
+    uint64_t started = mgr->walks_started();
+    uint64_t coalesced = mgr->walks_coalesced();
+    uint64_t completed = mgr->walks_completed();
+
+    SharedRouteWalker walker1(agent);
+    SharedRouteWalker walker2(agent);
+    VrfEntry *vrf = VrfGet(vrf_name_1_.c_str());
+    EXPECT_TRUE(vrf != NULL);
+    SharedWalkTask *task = new SharedWalkTask(&walker1, &walker2, vrf);
+    TaskScheduler::GetInstance()->Enqueue(task);
+    client->WaitForIdle();
+    WAIT_FOR(1000, 1000, (walker1.IsWalkCompleted() &&
+                          walker2.IsWalkCompleted()));
+
+    // Each route table is walked once for both walkers
+    uint64_t tables = mgr->walks_started() - started;
+    EXPECT_TRUE(tables > 0);
+    EXPECT_EQ(tables, mgr->walks_coalesced() - coalesced);
+    EXPECT_EQ(tables, mgr->walks_completed() - completed);
+    EXPECT_EQ(0, mgr->active_walk_count());
+    EXPECT_TRUE(walker1.route_notifications_ > 0);
+    EXPECT_EQ(walker1.route_notifications_, walker2.route_notifications_);
+
+    AgentRouteWalkerStatsReq *req = new AgentRouteWalkerStatsReq();
+    req->HandleRequest();
+    client->WaitForIdle();
+    req->Release();
+    DeleteEnvironment(1);
+}
+
 //TODO REMAINING TESTS
 // - based on walktype - unicast/multicast/all
 //
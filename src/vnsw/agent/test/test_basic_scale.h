@@ -149,7 +149,8 @@ private:
 class ControlNodeMockBgpXmppPeer {
 public:
     ControlNodeMockBgpXmppPeer() : channel_ (NULL), rx_count_(0),
-    label1_(1000), label2_(5000) {
+    label1_(1000), label2_(5000), item_add_count_(0), item_delete_count_(0),
+    reflect_(true) {
         peer_skip_route_list_.clear();
     }
 
@@ -459,6 +460,12 @@ public:
                     for (xml_node item = pugi->FindNode("item"); item;
                          item = item.next_sibling()) {
                         if (strcmp(item.name(), "item") != 0) continue;
+                        if (iq->is_as_node) {
+                            item_add_count_++;
+                        } else {
+                            item_delete_count_++;
+                        }
+                        if (!reflect_) continue;
                         std::string id(iq->as_node.c_str());
                         char *str = const_cast<char *>(id.c_str());
                         char *saveptr;
@@ -537,6 +544,9 @@ public:
     }
 
     size_t Count() const { return rx_count_; }
+    size_t ItemAddCount() const { return item_add_count_; }
+    size_t ItemDeleteCount() const { return item_delete_count_; }
+    void set_reflect(bool reflect) { reflect_ = reflect; }
     virtual ~ControlNodeMockBgpXmppPeer() {
     }
 private:
@@ -545,6 +555,9 @@ private:
     uint32_t label1_;
     uint32_t label2_;
     std::set<string> peer_skip_route_list_;
+    size_t item_add_count_;
+    size_t item_delete_count_;
+    bool reflect_;
 };
 
 
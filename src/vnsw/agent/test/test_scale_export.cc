@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/os.h"
+#include <base/time_util.h>
+#include <test/test_basic_scale.h>
+#include <oper/inet_unicast_route.h>
+#include <oper/evpn_route.h>
+
+static const uint32_t kExportRouteCount = 10000;
+static const uint32_t kInterleavedRouteCount = 1000;
+
+class AgentScaleExportTest : public AgentBasicScaleTest {
+protected:
+    void AddLocalRoutes(const Peer *peer, uint32_t count) {
+        Ip4Address addr = Ip4Address::from_string("100.0.0.0");
+        for (uint32_t i = 0; i < count; i++) {
+            addr = IncrementIpAddress(addr);
+            agent_->fabric_inet4_unicast_table()->
+                AddLocalVmRouteReq(peer, "vrf1", addr, 32, MakeUuid(1), "vn1",
+                                   (16 + i), SecurityGroupList(),
+                                   CommunityList(), false, PathPreference(),
+                                   Ip4Address(0));
+        }
+    }
+
+    void DeleteLocalRoutes(const Peer *peer, uint32_t count) {
+        Ip4Address addr = Ip4Address::from_string("100.0.0.0");
+        for (uint32_t i = 0; i < count; i++) {
+            addr = IncrementIpAddress(addr);
+            InetUnicastAgentRouteTable::DeleteReq(peer, "vrf1", addr, 32, NULL);
+        }
+    }
+
+    static MacAddress RouteMac(uint32_t index) {
+        return MacAddress(0x02, 0x00, (index >> 16) & 0xFF,
+                          (index >> 8) & 0xFF, index & 0xFF, 0x01);
+    }
+
+    // Add an inet route and an evpn route in turn, so that consecutive
+    // updates are for different address families.
+    void AddInterleavedRoutes(const Peer *peer, uint32_t count) {
+        EvpnAgentRouteTable *evpn_table = static_cast<EvpnAgentRouteTable *>(
+            VrfGet("vrf1")->GetEvpnRouteTable());
+        Ip4Address addr = Ip4Address::from_string("100.0.0.0");
+        for (uint32_t i = 0; i < count; i++) {
+            addr = IncrementIpAddress(addr);
+            agent_->fabric_inet4_unicast_table()->
+                AddLocalVmRouteReq(peer, "vrf1", addr, 32, MakeUuid(1), "vn1",
+                                   (16 + i), SecurityGroupList(),
+                                   CommunityList(), false, PathPreference(),
+                                   Ip4Address(0));
+            VmInterfaceKey intf_key(AgentKey::ADD_DEL_CHANGE, MakeUuid(1), "");
+            LocalVmRoute *data = new LocalVmRoute(intf_key, (16 + i),
+                VxLanTable::kInvalidvxlan_id, false, "vn1",
+                InterfaceNHFlags::BRIDGE, SecurityGroupList(),
+                CommunityList(), PathPreference(), IpAddress());
+            evpn_table->AddLocalVmRouteReq(peer, "vrf1", RouteMac(i),
+                                           IpAddress(), 0, data);
+        }
+    }
+
+    void DeleteInterleavedRoutes(const Peer *peer, uint32_t count) {
+        Ip4Address addr = Ip4Address::from_string("100.0.0.0");
+        for (uint32_t i = 0; i < count; i++) {
+            addr = IncrementIpAddress(addr);
+            InetUnicastAgentRouteTable::DeleteReq(peer, "vrf1", addr, 32, NULL);
+            EvpnAgentRouteTable::DeleteReq(peer, "vrf1", RouteMac(i),
+                                           IpAddress(), 0, NULL);
+        }
+    }
+};
+
+// Measure time taken to export kExportRouteCount routes to control node and
+// the number of publish messages used to do so.
+TEST_F(AgentScaleExportTest, ExportRoutes) {
+    client->Reset();
+    client->WaitForIdle();
+
+    XmppConnectionSetUp();
+    BuildVmPortEnvironment();
+
+    ControlNodeMockBgpXmppPeer *mock = mock_peer[0].get();
+    AgentXmppChannel *channel = bgp_peer[0].get();
+    mock->set_reflect(false);
+    size_t add_count = mock->ItemAddCount();
+    size_t delete_count = mock->ItemDeleteCount();
+    uint64_t messages = channel->publish_messages();
+
+    uint64_t start = UTCTimestampUsec();
+    AddLocalRoutes(agent_->local_vm_peer(), kExportRouteCount);
+    WAIT_FOR(100000, 1000,
+             (mock->ItemAddCount() >= add_count + kExportRouteCount));
+    uint64_t add_time = UTCTimestampUsec() - start;
+    EXPECT_EQ(add_count + kExportRouteCount, mock->ItemAddCount());
+    uint64_t add_messages = channel->publish_messages() - messages;
+    EXPECT_LT(add_messages, kExportRouteCount);
+
+    messages = channel->publish_messages();
+    start = UTCTimestampUsec();
+    DeleteLocalRoutes(agent_->local_vm_peer(), kExportRouteCount);
+    WAIT_FOR(100000, 1000,
+             (mock->ItemDeleteCount() >= delete_count + kExportRouteCount));
+    uint64_t delete_time = UTCTimestampUsec() - start;
+    EXPECT_EQ(delete_count + kExportRouteCount, mock->ItemDeleteCount());
+    uint64_t delete_messages = channel->publish_messages() - messages;
+
+    cout << "Export " << kExportRouteCount << " routes: add "
+         << add_time / 1000 << " msec in " << add_messages
+         << " messages, delete " << delete_time / 1000 << " msec in "
+         << delete_messages << " messages" << endl;
+
+    mock->set_reflect(true);
+    DeleteVmPortEnvironment();
+}
+
+// Updates of different address families that are interleaved are still
+// coalesced, in a batch per family.
+TEST_F(AgentScaleExportTest, InterleavedFamilies) {
+    client->Reset();
+    client->WaitForIdle();
+
+    XmppConnectionSetUp();
+    BuildVmPortEnvironment();
+
+    ControlNodeMockBgpXmppPeer *mock = mock_peer[0].get();
+    AgentXmppChannel *channel = bgp_peer[0].get();
+    mock->set_reflect(false);
+    size_t add_count = mock->ItemAddCount();
+    size_t delete_count = mock->ItemDeleteCount();
+    uint64_t messages = channel->publish_messages();
+
+    AddInterleavedRoutes(agent_->local_vm_peer(), kInterleavedRouteCount);
+    WAIT_FOR(100000, 1000,
+             (mock->ItemAddCount() >= add_count + 2 * kInterleavedRouteCount));
+    EXPECT_EQ(add_count + 2 * kInterleavedRouteCount, mock->ItemAddCount());
+    // With a single open batch, every update would start a new message
+    uint64_t add_messages = channel->publish_messages() - messages;
+    EXPECT_LT(add_messages, kInterleavedRouteCount);
+
+    messages = channel->publish_messages();
+    DeleteInterleavedRoutes(agent_->local_vm_peer(), kInterleavedRouteCount);
+    WAIT_FOR(100000, 1000, (mock->ItemDeleteCount() >=
+                            delete_count + 2 * kInterleavedRouteCount));
+    EXPECT_EQ(delete_count + 2 * kInterleavedRouteCount,
+              mock->ItemDeleteCount());
+    uint64_t delete_messages = channel->publish_messages() - messages;
+    EXPECT_LT(delete_messages, kInterleavedRouteCount);
+    EXPECT_EQ(0U, channel->publish_batch_size());
+    EXPECT_EQ(0U, channel->publish_batch_count());
+
+    cout << "Export " << kInterleavedRouteCount << " inet and evpn routes: "
+         << add_messages << " add messages, " << delete_messages
+         << " delete messages" << endl;
+
+    mock->set_reflect(true);
+    DeleteVmPortEnvironment();
+}
+
+int main(int argc, char **argv) {
+    GETSCALEARGS();
+    if ((num_vns * num_vms_per_vn) > MAX_INTERFACES) {
+        LOG(DEBUG, "Max interfaces is 200");
+        return false;
+    }
+    if (num_ctrl_peers == 0 || num_ctrl_peers > MAX_CONTROL_PEER) {
+        LOG(DEBUG, "Supported values - 1, 2");
+        return false;
+    }
+
+    client = TestInit(init_file, ksync_init);
+    InitXmppServers();
+
+    int ret = RUN_ALL_TESTS();
+    Agent::GetInstance()->event_manager()->Shutdown();
+    AsioStop();
+    TaskScheduler::GetInstance()->Terminate();
+    return ret;
+}
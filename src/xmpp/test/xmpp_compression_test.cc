@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "xmpp/test/xmpp_sample_peer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <tbb/atomic.h>
+
+#include "base/logging.h"
+#include "base/test/task_test_util.h"
+#include "base/time_util.h"
+#include "control-node/control_node.h"
+#include "io/test/event_manager_test.h"
+#include "xmpp/xmpp_channel_mux.h"
+#include "xmpp/xmpp_client.h"
+#include "xmpp/xmpp_compression.h"
+#include "xmpp/xmpp_config.h"
+#include "xmpp/xmpp_init.h"
+#include "xmpp/xmpp_server.h"
+#include "xmpp/xmpp_session.h"
+#include "xmpp/xmpp_state_machine.h"
+
+#include "testing/gunit.h"
+
+using namespace boost::asio;
+using namespace std;
+
+#define SUB_ADDR "agent@vnsw.contrailsystems.com"
+#define XMPP_CONTROL_SERV   "bgp.contrail.com"
+
+static const int kRoutes = 100000;
+static const int kRoutesPerMessage = 64;
+
+class XmppBgpMockPeer : public XmppSamplePeer {
+public:
+    XmppBgpMockPeer(XmppChannelMux *channel) :
+        XmppSamplePeer(channel) {
+        count_ = 0;
+    }
+
+    virtual void ReceiveUpdate(const XmppStanza::XmppMessage *) {
+        count_++;
+    }
+
+    size_t Count() const { return count_; }
+
+private:
+    tbb::atomic<size_t> count_;
+};
+
+class XmppCompressorTest : public ::testing::Test {
+};
+
+// Messages compressed one at a time are decompressed in pieces of any size.
+TEST_F(XmppCompressorTest, RoundTrip) {
+    XmppCompressor compressor(XmppCompressor::kDefaultLevel);
+    XmppDecompressor decompressor;
+
+    string sent, compressed;
+    for (int i = 0; i < 128; i++) {
+        ostringstream oss;
+        oss << "<message to='" << SUB_ADDR << "'><item id='" << i
+            << "'/></message>";
+        sent += oss.str();
+        EXPECT_TRUE(compressor.Compress(
+            reinterpret_cast<const uint8_t *>(oss.str().data()),
+            oss.str().size(), &compressed));
+    }
+    EXPECT_GT(sent.size(), compressed.size());
+
+    string received;
+    const uint8_t *data =
+        reinterpret_cast<const uint8_t *>(compressed.data());
+    for (size_t offset = 0; offset < compressed.size(); offset += 7) {
+        size_t size = min(compressed.size() - offset, size_t(7));
+        EXPECT_TRUE(decompressor.Decompress(data + offset, size, &received));
+    }
+    EXPECT_EQ(sent, received);
+}
+
+TEST_F(XmppCompressorTest, BadInput) {
+    XmppDecompressor decompressor;
+    string garbage("<message>not compressed</message>");
+    string out;
+    EXPECT_FALSE(decompressor.Decompress(
+        reinterpret_cast<const uint8_t *>(garbage.data()), garbage.size(),
+        &out));
+}
+
+//
+// Loopback server and client sessions, with the given compression level
+// at each end.
+//
+class XmppCompressionTestBase : public ::testing::Test {
+protected:
+    void Init(int server_level, int client_level) {
+        evm_.reset(new EventManager());
+        XmppChannelConfig server_cfg(false);
+        server_cfg.compression_level = server_level;
+        a_ = new XmppServer(evm_.get(), XMPP_CONTROL_SERV, &server_cfg);
+        b_ = new XmppClient(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+
+        a_->Initialize(0, false);
+        LOG(DEBUG, "Created server at port: " << a_->GetPort());
+        thread_->Start();
+
+        XmppConfigData *cfg_b = new XmppConfigData;
+        XmppChannelConfig *cfg = new XmppChannelConfig(true);
+        cfg->endpoint.address(ip::address::from_string("127.0.0.1"));
+        cfg->endpoint.port(a_->GetPort());
+        cfg->ToAddr = XMPP_CONTROL_SERV;
+        cfg->FromAddr = SUB_ADDR;
+        cfg->compression_level = client_level;
+        cfg_b->AddXmppChannelConfig(cfg);
+        b_->ConfigUpdate(cfg_b);
+    }
+
+    virtual void TearDown() {
+        b_->ConfigUpdate(new XmppConfigData());
+        task_util::WaitForIdle();
+
+        a_->Shutdown();
+        b_->Shutdown();
+        task_util::WaitForIdle();
+
+        TcpServerManager::DeleteServer(a_);
+        a_ = NULL;
+        TcpServerManager::DeleteServer(b_);
+        b_ = NULL;
+
+        evm_->Shutdown();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+    }
+
+    // An update of count routes in the format of the bgp xmpp channel.
+    string RouteUpdate(int first, int count) {
+        ostringstream oss;
+        oss << "<?xml version=\"1.0\"?>\n"
+            << "<message from=\"" << XMPP_CONTROL_SERV << "\" to=\""
+            << SUB_ADDR << "/" << XmppInit::kOtherPeer << "\">\n"
+            << "\t<event xmlns=\"http://jabber.org/protocol/pubsub\">\n"
+            << "\t\t<items node=\"1/1/blue\">\n";
+        for (int i = first; i < first + count; i++) {
+            oss << "\t\t\t<item id=\"10." << (i >> 16) << "."
+                << ((i >> 8) & 0xff) << "." << (i & 0xff) << "/32\">\n"
+                << "\t\t\t\t<entry>\n"
+                << "\t\t\t\t\t<nlri><af>1</af><safi>1</safi>"
+                << "<address>10." << (i >> 16) << "." << ((i >> 8) & 0xff)
+                << "." << (i & 0xff) << "/32</address></nlri>\n"
+                << "\t\t\t\t\t<next-hops><next-hop><af>1</af>"
+                << "<address>192.168.1." << (i % 16) << "</address>"
+                << "<label>" << 16 + i % 4096 << "</label>"
+                << "<tunnel-encapsulation-list>"
+                << "<tunnel-encapsulation>gre</tunnel-encapsulation>"
+                << "<tunnel-encapsulation>udp</tunnel-encapsulation>"
+                << "</tunnel-encapsulation-list>"
+                << "</next-hop></next-hops>\n"
+                << "\t\t\t\t\t<virtual-network>default-domain:demo:blue"
+                << "</virtual-network>\n"
+                << "\t\t\t\t\t<local-preference>100</local-preference>\n"
+                << "\t\t\t\t</entry>\n"
+                << "\t\t\t</item>\n";
+        }
+        oss << "\t\t</items>\n\t</event>\n</message>\n";
+        return oss.str();
+    }
+
+    auto_ptr<EventManager> evm_;
+    auto_ptr<ServerThread> thread_;
+    XmppServer *a_;
+    XmppClient *b_;
+};
+
+//
+// Parameterized by the compression level of both ends.
+//
+class XmppCompressionTest : public XmppCompressionTestBase,
+                            public ::testing::WithParamInterface<int> {
+protected:
+    virtual void SetUp() {
+        Init(GetParam(), GetParam());
+    }
+};
+
+TEST_P(XmppCompressionTest, RouteTable) {
+    XmppConnection *sconnection;
+    TASK_UTIL_EXPECT_TRUE((sconnection = a_->FindConnection(SUB_ADDR)) != NULL);
+    TASK_UTIL_EXPECT_TRUE(sconnection->GetStateMcState() == xmsm::ESTABLISHED);
+    XmppConnection *cconnection = b_->FindConnection(XMPP_CONTROL_SERV);
+    ASSERT_TRUE(cconnection != NULL);
+    TASK_UTIL_EXPECT_TRUE(cconnection->GetStateMcState() == xmsm::ESTABLISHED);
+
+    XmppSession *ssession = sconnection->session();
+    XmppSession *csession = cconnection->session();
+    EXPECT_EQ(GetParam() != 0, ssession->IsCompressionStarted());
+    EXPECT_EQ(GetParam() != 0, csession->IsCompressionStarted());
+
+    XmppBgpMockPeer *bgp_schannel =
+        new XmppBgpMockPeer(sconnection->ChannelMux());
+    XmppBgpMockPeer *bgp_cchannel =
+        new XmppBgpMockPeer(cconnection->ChannelMux());
+
+    const io::SocketStats &stats = ssession->GetSocketStats();
+    uint64_t wire_start = stats.write_bytes;
+    uint64_t payload = 0;
+    size_t messages = 0;
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < kRoutes; i += kRoutesPerMessage) {
+        string update = RouteUpdate(i, min(kRoutesPerMessage, kRoutes - i));
+        bgp_schannel->SendUpdate(
+            reinterpret_cast<const uint8_t *>(update.data()), update.size());
+        payload += update.size();
+        messages++;
+    }
+    TASK_UTIL_WAIT_EQ_NO_MSG(messages, bgp_cchannel->Count(),
+                             1000, 60000, "Wait for route updates");
+    uint64_t usecs = UTCTimestampUsec() - start;
+    uint64_t wire = stats.write_bytes - wire_start;
+
+    const XmppSession::CompressionStats &tx =
+        ssession->tx_compression_stats();
+    const XmppSession::CompressionStats &rx =
+        csession->rx_compression_stats();
+    cout << "Compression level " << GetParam() << ": " << kRoutes
+         << " routes in " << messages << " messages, " << payload
+         << " bytes of xml, " << wire << " bytes on the wire, ratio "
+         << static_cast<double>(payload) / wire << ", "
+         << tx.usecs << " usec compressing, " << rx.usecs
+         << " usec decompressing, " << usecs << " usec total" << endl;
+
+    if (GetParam() == 0) {
+        EXPECT_LE(payload, wire);
+        EXPECT_EQ(0, tx.compressed_bytes);
+        EXPECT_EQ(0, rx.compressed_bytes);
+    } else {
+        // Route updates are very repetitive xml.
+        EXPECT_GT(payload / 4, wire);
+        EXPECT_LE(payload, tx.uncompressed_bytes);
+        EXPECT_EQ(tx.compressed_bytes, rx.compressed_bytes);
+        EXPECT_EQ(tx.uncompressed_bytes, rx.uncompressed_bytes);
+    }
+
+    delete bgp_schannel;
+    delete bgp_cchannel;
+    task_util::WaitForIdle();
+}
+
+INSTANTIATE_TEST_CASE_P(Level, XmppCompressionTest,
+                        ::testing::Values(0, 1, XmppCompressor::kDefaultLevel));
+
+//
+// Compression is optional, a session with compression enabled at one end
+// only is established without it.
+//
+class XmppCompressionOptionalTest : public XmppCompressionTestBase {
+protected:
+    void VerifyUncompressed() {
+        XmppConnection *sconnection;
+        TASK_UTIL_EXPECT_TRUE(
+            (sconnection = a_->FindConnection(SUB_ADDR)) != NULL);
+        TASK_UTIL_EXPECT_TRUE(
+            sconnection->GetStateMcState() == xmsm::ESTABLISHED);
+        XmppConnection *cconnection = b_->FindConnection(XMPP_CONTROL_SERV);
+        ASSERT_TRUE(cconnection != NULL);
+        TASK_UTIL_EXPECT_TRUE(
+            cconnection->GetStateMcState() == xmsm::ESTABLISHED);
+        EXPECT_FALSE(sconnection->session()->IsCompressionStarted());
+        EXPECT_FALSE(cconnection->session()->IsCompressionStarted());
+        EXPECT_EQ(0, sconnection->flap_count());
+        EXPECT_EQ(0, cconnection->flap_count());
+    }
+};
+
+TEST_F(XmppCompressionOptionalTest, ServerOnly) {
+    Init(XmppCompressor::kDefaultLevel, 0);
+    VerifyUncompressed();
+}
+
+TEST_F(XmppCompressionOptionalTest, ClientOnly) {
+    Init(0, XmppCompressor::kDefaultLevel);
+    VerifyUncompressed();
+}
+
+static void SetUp() {
+    LoggingInit();
+    ControlNode::SetDefaultSchedulingPolicy();
+}
+
+static void TearDown() {
+    task_util::WaitForIdle();
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Terminate();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    SetUp();
+    int result = RUN_ALL_TESTS();
+    TearDown();
+    return result;
+}
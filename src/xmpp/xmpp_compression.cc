@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "xmpp/xmpp_compression.h"
+
+#include <string.h>
+
+using namespace std;
+
+static const size_t kChunkSize = 16 * 1024;
+
+XmppCompressor::XmppCompressor(int level) {
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ = (deflateInit(&stream_, level) == Z_OK);
+}
+
+XmppCompressor::~XmppCompressor() {
+    if (initialized_) {
+        deflateEnd(&stream_);
+    }
+}
+
+bool XmppCompressor::Compress(const uint8_t *data, size_t size,
+                              string *out) {
+    if (!initialized_) {
+        return false;
+    }
+
+    uint8_t chunk[kChunkSize];
+    stream_.next_in = const_cast<Bytef *>(data);
+    stream_.avail_in = size;
+
+    // Z_SYNC_FLUSH terminates the output on a byte boundary, so that the
+    // peer can decompress all of it, and is done once the output space
+    // is not used up.
+    do {
+        stream_.next_out = chunk;
+        stream_.avail_out = sizeof(chunk);
+        int ret = deflate(&stream_, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        out->append(reinterpret_cast<const char *>(chunk),
+                    sizeof(chunk) - stream_.avail_out);
+    } while (stream_.avail_out == 0);
+
+    return true;
+}
+
+XmppDecompressor::XmppDecompressor() {
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ = (inflateInit(&stream_) == Z_OK);
+}
+
+XmppDecompressor::~XmppDecompressor() {
+    if (initialized_) {
+        inflateEnd(&stream_);
+    }
+}
+
+bool XmppDecompressor::Decompress(const uint8_t *data, size_t size,
+                                  string *out) {
+    if (!initialized_) {
+        return false;
+    }
+
+    uint8_t chunk[kChunkSize];
+    stream_.next_in = const_cast<Bytef *>(data);
+    stream_.avail_in = size;
+
+    do {
+        stream_.next_out = chunk;
+        stream_.avail_out = sizeof(chunk);
+        int ret = inflate(&stream_, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            // The peer never ends the zlib stream, so Z_STREAM_END is
+            // an error as well.
+            inflateEnd(&stream_);
+            initialized_ = false;
+            return false;
+        }
+        out->append(reinterpret_cast<const char *>(chunk),
+                    sizeof(chunk) - stream_.avail_out);
+    } while (stream_.avail_in > 0 || stream_.avail_out == 0);
+
+    return true;
+}
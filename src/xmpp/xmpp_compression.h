@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __XMPP_COMPRESSION_H__
+#define __XMPP_COMPRESSION_H__
+
+#include <stdint.h>
+#include <string>
+#include <zlib.h>
+
+#include "base/util.h"
+
+//
+// zlib stream compression of an xmpp stream, as negotiated per XEP-0138.
+//
+// The whole stream after the compression negotiation is a single zlib
+// stream in each direction. The compressor flushes the zlib stream after
+// every message so that the peer can decompress and process each message
+// as soon as it is received.
+//
+class XmppCompressor {
+public:
+    static const int kDefaultLevel = Z_DEFAULT_COMPRESSION;
+
+    explicit XmppCompressor(int level);
+    ~XmppCompressor();
+
+    // Appends the compressed data to out. Returns false on error.
+    bool Compress(const uint8_t *data, size_t size, std::string *out);
+
+private:
+    z_stream stream_;
+    bool initialized_;
+
+    DISALLOW_COPY_AND_ASSIGN(XmppCompressor);
+};
+
+class XmppDecompressor {
+public:
+    XmppDecompressor();
+    ~XmppDecompressor();
+
+    // Appends the decompressed data to out. Returns false on error, after
+    // which the stream can not be decompressed any further.
+    bool Decompress(const uint8_t *data, size_t size, std::string *out);
+
+private:
+    z_stream stream_;
+    bool initialized_;
+
+    DISALLOW_COPY_AND_ASSIGN(XmppDecompressor);
+};
+
+#endif // __XMPP_COMPRESSION_H__
@@ -15,6 +15,7 @@ XmppChannelConfig::XmppChannelConfig(bool isClient) :
      ToAddr(""), FromAddr(""), NodeAddr(""), logUVE(false), auth_enabled(false),
      path_to_server_cert(""), path_to_pvt_key(""),
      tcp_hold_time(XmppChannelConfig::kTcpHoldTime),
+     compression_level(0),
      isClient_(isClient)  {
 }
 
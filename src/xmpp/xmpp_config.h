@@ -28,6 +28,8 @@ public:
     std::string path_to_server_cert;
     std::string path_to_pvt_key;
     int tcp_hold_time;
+    // zlib compression level of the stream, 0 disables compression
+    int compression_level;
 
     int CompareTo(const XmppChannelConfig &rhs) const;
     static int const default_client_port = 5269;
@@ -52,6 +52,7 @@ XmppConnection::XmppConnection(TcpServer *server,
       from_(config->FromAddr),
       to_(config->ToAddr),
       auth_enabled_(config->auth_enabled),
+      compression_level_(config->compression_level),
       state_machine_(XmppObjectFactory::Create<XmppStateMachine>(
           this, config->ClientOnly(), config->auth_enabled)),
       mux_(XmppObjectFactory::Create<XmppChannelMux>(this)) {
@@ -255,8 +256,16 @@ bool XmppConnection::SendStreamFeatureRequest(XmppSession *session) {
     tbb::spin_mutex::scoped_lock lock(spin_mutex_);
     if (!session_) return false;
     XmppStanza::XmppStreamMessage featurestream;
-    featurestream.strmtype = XmppStanza::XmppStreamMessage::FEATURE_TLS;
-    featurestream.strmtlstype = XmppStanza::XmppStreamMessage::TLS_FEATURE_REQUEST;
+    if (IsCompressionEnabled()) {
+        featurestream.strmtype =
+            XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+        featurestream.strmcompresstype =
+            XmppStanza::XmppStreamMessage::COMPRESS_FEATURE_REQUEST;
+    } else {
+        featurestream.strmtype = XmppStanza::XmppStreamMessage::FEATURE_TLS;
+        featurestream.strmtlstype =
+            XmppStanza::XmppStreamMessage::TLS_FEATURE_REQUEST;
+    }
     uint8_t data[256];
     int len = XmppProto::EncodeStream(featurestream, to_, from_, data,
                                       sizeof(data));
@@ -312,6 +321,44 @@ bool XmppConnection::SendProceedTls(XmppSession *session) {
     }
 }
 
+bool XmppConnection::SendStartCompress(XmppSession *session) {
+    tbb::spin_mutex::scoped_lock lock(spin_mutex_);
+    if (!session_) return false;
+    XmppStanza::XmppStreamMessage stream;
+    stream.strmtype = XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+    stream.strmcompresstype = XmppStanza::XmppStreamMessage::COMPRESS_START;
+    uint8_t data[256];
+    int len = XmppProto::EncodeStream(stream, to_, from_, data,
+                                      sizeof(data));
+    if (len <= 0) {
+        inc_stream_feature_fail();
+        return false;
+    } else {
+        XMPP_UTDEBUG(XmppControlMessage, "Send Compress", len, from_, to_);
+        session_->Send(data, len, NULL);
+        return true;
+    }
+}
+
+bool XmppConnection::SendCompressed(XmppSession *session) {
+    tbb::spin_mutex::scoped_lock lock(spin_mutex_);
+    if (!session_) return false;
+    XmppStanza::XmppStreamMessage stream;
+    stream.strmtype = XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+    stream.strmcompresstype = XmppStanza::XmppStreamMessage::COMPRESSED;
+    uint8_t data[256];
+    int len = XmppProto::EncodeStream(stream, to_, from_, data,
+                                      sizeof(data));
+    if (len <= 0) {
+        inc_stream_feature_fail();
+        return false;
+    } else {
+        XMPP_UTDEBUG(XmppControlMessage, "Send Compressed", len, from_, to_);
+        session_->Send(data, len, NULL);
+        return true;
+    }
+}
+
 void XmppConnection::SendClose(XmppSession *session) {
     tbb::spin_mutex::scoped_lock lock(spin_mutex_);
     if (!session_) return;
@@ -755,6 +802,16 @@ const std::string XmppServerConnection::last_flap_at() const {
     return conn_endpoint_ ? conn_endpoint_->last_flap_at() : "";
 }
 
+static void FillCompressionStats(const XmppSession::CompressionStats &stats,
+                                 ShowXmppCompressionStats *show_stats) {
+    show_stats->set_uncompressed_bytes(stats.uncompressed_bytes);
+    show_stats->set_compressed_bytes(stats.compressed_bytes);
+    show_stats->set_ratio(stats.compressed_bytes ?
+        static_cast<double>(stats.uncompressed_bytes) /
+        stats.compressed_bytes : 0.0);
+    show_stats->set_usecs(stats.usecs);
+}
+
 void XmppServerConnection::FillShowInfo(
     ShowXmppConnection *show_connection) const {
     show_connection->set_name(ToString());
@@ -767,6 +824,18 @@ void XmppServerConnection::FillShowInfo(
     show_connection->set_last_state_at(LastStateChangeAt());
     show_connection->set_receivers(channel_mux()->GetReceiverList());
     show_connection->set_server_auth_type(GetXmppAuthenticationType());
+    show_connection->set_compression_level(compression_level_);
+
+    const XmppSession *session = this->session();
+    if (!session)
+        return;
+    show_connection->set_compressed(session->IsCompressionStarted());
+    ShowXmppCompressionStats tx_stats;
+    FillCompressionStats(session->tx_compression_stats(), &tx_stats);
+    show_connection->set_tx_compression(tx_stats);
+    ShowXmppCompressionStats rx_stats;
+    FillCompressionStats(session->rx_compression_stats(), &rx_stats);
+    show_connection->set_rx_compression(rx_stats);
 }
 
 class XmppClientConnection::DeleteActor : public LifetimeActor {
@@ -77,6 +77,8 @@ public:
     virtual bool SendStreamFeatureRequest(XmppSession *session);
     virtual bool SendStartTls(XmppSession *session);
     virtual bool SendProceedTls(XmppSession *session);
+    virtual bool SendStartCompress(XmppSession *session);
+    virtual bool SendCompressed(XmppSession *session);
 
     void SendKeepAlive();
     void SendClose(XmppSession *session);
@@ -222,6 +224,12 @@ public:
     static const char *kAuthTypeTls;
     std::string GetXmppAuthenticationType() const;
 
+    // Compression is negotiated only on sessions without TLS.
+    int compression_level() const { return compression_level_; }
+    bool IsCompressionEnabled() const {
+        return compression_level_ != 0 && !auth_enabled_;
+    }
+
 protected:
     TcpServer *server_;
     XmppSession *session_;
@@ -249,6 +257,7 @@ private:
     std::string from_; // bare jid
     std::string to_;
     bool auth_enabled_;
+    int compression_level_;
 
     boost::scoped_ptr<XmppStateMachine> state_machine_;
     boost::scoped_ptr<XmppChannelMux> mux_;
@@ -57,6 +57,19 @@ int XmppProto::EncodeStream(const XmppStreamMessage &str, string &to,
                     break;
             }
             break;
+        case (XmppStanza::XmppStreamMessage::FEATURE_COMPRESS):
+            switch (str.strmcompresstype) {
+                case (XmppStanza::XmppStreamMessage::COMPRESS_FEATURE_REQUEST):
+                    len = EncodeFeatureCompressRequest(buf);
+                    break;
+                case (XmppStanza::XmppStreamMessage::COMPRESS_START):
+                    len = EncodeFeatureCompressStart(buf);
+                    break;
+                case (XmppStanza::XmppStreamMessage::COMPRESSED):
+                    len = EncodeFeatureCompressed(buf);
+                    break;
+            }
+            break;
         default:
             break;
     }
@@ -209,6 +222,29 @@ int XmppProto::EncodeFeatureTlsProceed(uint8_t *buf) {
     return len;
 }
 
+int XmppProto::EncodeFeatureCompressRequest(uint8_t *buf) {
+    auto_ptr<XmlBase> resp_doc(XmppStanza::AllocXmppXmlImpl(sXMPP_STREAM_FEATURE_COMPRESS));
+    //Returns byte encoded in the doc
+    int len = resp_doc->WriteDoc(buf);
+    return len;
+}
+
+// The stream is compressed right after <compress> and <compressed>, hence
+// these are encoded without trailing whitespace.
+int XmppProto::EncodeFeatureCompressStart(uint8_t *buf) {
+    auto_ptr<XmlBase> resp_doc(XmppStanza::AllocXmppXmlImpl(sXMPP_STREAM_COMPRESS));
+    //Returns byte encoded in the doc
+    int len = resp_doc->WriteRawDoc(buf);
+    return len;
+}
+
+int XmppProto::EncodeFeatureCompressed(uint8_t *buf) {
+    auto_ptr<XmlBase> resp_doc(XmppStanza::AllocXmppXmlImpl(sXMPP_STREAM_COMPRESSED));
+    //Returns byte encoded in the doc
+    int len = resp_doc->WriteRawDoc(buf);
+    return len;
+}
+
 XmppStanza::XmppMessage *XmppProto::Decode(const string &ts) {
     auto_ptr<XmlBase> impl(XmppStanza::AllocXmppXmlImpl());
     if (impl.get() == NULL) {
@@ -369,6 +405,50 @@ XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts,
         }
         goto done;
 
+    } else if ((ts.find(sXMPP_STREAM_NS_COMPRESS_FEATURE) != string::npos) ||
+               (ts.find(sXMPP_STREAM_NS_COMPRESS) != string::npos)) {
+
+        if (impl->LoadDoc(ts) == -1) {
+            XMPP_WARNING(XmppBadMessage, "Stream compression parse failed.");
+            goto done;
+        }
+
+        // find stream:features compression, check for <compressed before
+        // <compress as the latter is a prefix of the former
+        if (ts.find(sXMPP_STREAM_FEATURES_O) != string::npos) {
+            XmppStanza::XmppStreamMessage *strm =
+                new XmppStanza::XmppStreamMessage();
+            strm->strmtype = XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+            strm->strmcompresstype =
+                XmppStanza::XmppStreamMessage::COMPRESS_FEATURE_REQUEST;
+
+            ret = strm;
+
+            XMPP_UTDEBUG(XmppRxStreamCompressFeature);
+
+        } else if (ts.find(sXMPP_STREAM_COMPRESSED_O) != string::npos) {
+            XmppStanza::XmppStreamMessage *strm =
+                new XmppStanza::XmppStreamMessage();
+            strm->strmtype = XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+            strm->strmcompresstype = XmppStanza::XmppStreamMessage::COMPRESSED;
+
+            ret = strm;
+
+            XMPP_UTDEBUG(XmppRxStreamCompressed);
+
+        } else if (ts.find(sXMPP_STREAM_COMPRESS_O) != string::npos) {
+            XmppStanza::XmppStreamMessage *strm =
+                new XmppStanza::XmppStreamMessage();
+            strm->strmtype = XmppStanza::XmppStreamMessage::FEATURE_COMPRESS;
+            strm->strmcompresstype =
+                XmppStanza::XmppStreamMessage::COMPRESS_START;
+
+            ret = strm;
+
+            XMPP_UTDEBUG(XmppRxStreamCompress);
+        }
+        goto done;
+
     } else if (ts.find_first_of(sXMPP_VALIDWS) != string::npos) {
 
         XmppStanza::XmppMessage *msg = 
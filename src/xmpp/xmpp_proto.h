@@ -73,7 +73,7 @@ public:
             INIT_STREAM_HEADER_RESP = 2,
             FEATURE_SASL = 3,
             FEATURE_TLS = 4,
-            FEAUTRE_COMPRESS_LZW = 5,
+            FEATURE_COMPRESS = 5,
             CLOSE_STREAM = 6 
         };
 
@@ -87,8 +87,15 @@ public:
             TLS_PROCEED = 3
         };
 
+        enum XmppStreamCompressType {
+            COMPRESS_FEATURE_REQUEST = 1,
+            COMPRESS_START = 2,
+            COMPRESSED = 3
+        };
+
         XmppStreamMsgType strmtype;
         XmppStreamTlsType strmtlstype;
+        XmppStreamCompressType strmcompresstype;
     };
 
     enum XmppMessageStateType {
@@ -188,6 +195,9 @@ private:
     static int EncodeFeatureTlsRequest(uint8_t *data);
     static int EncodeFeatureTlsStart(uint8_t *data);
     static int EncodeFeatureTlsProceed(uint8_t *data);
+    static int EncodeFeatureCompressRequest(uint8_t *data);
+    static int EncodeFeatureCompressStart(uint8_t *data);
+    static int EncodeFeatureCompressed(uint8_t *data);
     static int EncodeWhitespace(uint8_t *data);
     static int SetTo(std::string &to, XmlBase *doc);
     static int SetFrom(std::string &from, XmlBase *doc);
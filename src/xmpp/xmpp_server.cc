@@ -63,6 +63,7 @@ XmppServer::XmppServer(EventManager *evm, const string &server_addr,
       log_uve_(false),
       auth_enabled_(config->auth_enabled),
       tcp_hold_time_(config->tcp_hold_time),
+      compression_level_(config->compression_level),
       connection_queue_(TaskScheduler::GetInstance()->GetTaskId("bgp::Config"),
           0, boost::bind(&XmppServer::DequeueConnection, this, _1)) {
 
@@ -97,6 +98,7 @@ XmppServer::XmppServer(EventManager *evm, const string &server_addr)
       log_uve_(false),
       auth_enabled_(false),
       tcp_hold_time_(XmppChannelConfig::kTcpHoldTime),
+      compression_level_(0),
       connection_queue_(TaskScheduler::GetInstance()->GetTaskId("bgp::Config"),
           0, boost::bind(&XmppServer::DequeueConnection, this, _1)) {
 }
@@ -111,6 +113,7 @@ XmppServer::XmppServer(EventManager *evm)
       log_uve_(false),
       auth_enabled_(false),
       tcp_hold_time_(XmppChannelConfig::kTcpHoldTime),
+      compression_level_(0),
       connection_queue_(TaskScheduler::GetInstance()->GetTaskId("bgp::Config"),
           0, boost::bind(&XmppServer::DequeueConnection, this, _1)) {
 }
@@ -372,6 +375,7 @@ XmppServerConnection *XmppServer::CreateConnection(XmppSession *session) {
     cfg.FromAddr = server_addr_;
     cfg.logUVE = log_uve_;
     cfg.auth_enabled = auth_enabled_;
+    cfg.compression_level = compression_level_;
 
     XMPP_DEBUG(XmppCreateConnection, session->ToString());
     connection = XmppObjectFactory::Create<XmppServerConnection>(this, &cfg);
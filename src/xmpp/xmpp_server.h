@@ -115,6 +115,7 @@ private:
     bool log_uve_;
     bool auth_enabled_;
     int tcp_hold_time_;
+    int compression_level_;
     WorkQueue<XmppServerConnection *> connection_queue_;
 
     DISALLOW_COPY_AND_ASSIGN(XmppServer);
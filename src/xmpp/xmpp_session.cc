@@ -4,6 +4,8 @@
 
 #include "xmpp/xmpp_session.h"
 
+#include "base/time_util.h"
+#include "xmpp/xmpp_compression.h"
 #include "xmpp/xmpp_connection.h"
 #include "xmpp/xmpp_log.h"
 #include "xmpp/xmpp_proto.h"
@@ -26,6 +28,9 @@ const boost::regex XmppSession::whitespace_(sXMPP_WHITESPACE);
 const boost::regex XmppSession::stream_features_patt_(rXMPP_STREAM_FEATURES);
 const boost::regex XmppSession::starttls_patt_(rXMPP_STREAM_STARTTLS);
 const boost::regex XmppSession::proceed_patt_(rXMPP_STREAM_PROCEED);
+const boost::regex XmppSession::compress_patt_(rXMPP_STREAM_COMPRESS);
+const boost::regex XmppSession::compress_end_patt_(rXMPP_STREAM_COMPRESS_END);
+const boost::regex XmppSession::compressed_patt_(rXMPP_STREAM_COMPRESSED);
 const boost::regex XmppSession::end_patt_(rXMPP_STREAM_STANZA_END);
 
 XmppSession::XmppSession(XmppConnectionManager *manager, SslSocket *socket,
@@ -114,6 +119,107 @@ boost::system::error_code XmppSession::EnableTcpKeepalive(int hold_time) {
                                       tcp_user_timeout_));
 }
 
+//
+// Concurrency: called in the context of any task sending xmpp messages.
+//
+// The compressed stream must be sent in the order in which it is produced,
+// hence the compression and the send are done under compress_mutex_.
+//
+bool XmppSession::Send(const uint8_t *data, size_t size, size_t *sent) {
+    tbb::mutex::scoped_lock lock(compress_mutex_);
+    if (!compressor_) {
+        lock.release();
+        return SslSession::Send(data, size, sent);
+    }
+
+    if (sent) *sent = 0;
+    uint64_t start = UTCTimestampUsec();
+    string out;
+    if (!compressor_->Compress(data, size, &out)) {
+        return false;
+    }
+    tx_compression_stats_.usecs += UTCTimestampUsec() - start;
+    tx_compression_stats_.uncompressed_bytes += size;
+    tx_compression_stats_.compressed_bytes += out.size();
+
+    // Any part of the compressed data not sent right away is buffered by
+    // the writer, so report all of the uncompressed data as sent.
+    size_t compressed_sent;
+    bool ret = SslSession::Send(reinterpret_cast<const uint8_t *>(out.data()),
+                                out.size(), &compressed_sent);
+    if (sent && compressed_sent) *sent = size;
+    return ret;
+}
+
+// The compressed stream is specific to the session, so once compression is
+// started the chain is copied and compressed like any other data.
+bool XmppSession::Send(const BufferChain &chain, size_t *sent) {
+    tbb::mutex::scoped_lock lock(compress_mutex_);
+    if (!compressor_) {
+        lock.release();
+        return SslSession::Send(chain, sent);
+    }
+    lock.release();
+
+    string data;
+    data.reserve(TcpMessageWriter::ChainLength(chain));
+    for (BufferChain::const_iterator iter = chain.begin();
+         iter != chain.end(); ++iter) {
+        data.append(**iter);
+    }
+    return Send(reinterpret_cast<const uint8_t *>(data.data()), data.size(),
+                sent);
+}
+
+//
+// Concurrency: called in the context of bgp::Config task.
+//
+// Called after the message that starts compression of the transmitted
+// stream (<compressed/> on the server, <compress/> on the client) is sent.
+//
+void XmppSession::StartCompression(int level) {
+    tbb::mutex::scoped_lock lock(compress_mutex_);
+    if (!compressor_) {
+        compressor_.reset(new XmppCompressor(level));
+    }
+}
+
+//
+// Concurrency: called in the context of io thread.
+//
+// Called when the message that starts compression of the received stream
+// is matched. Any data after this message is already compressed.
+//
+void XmppSession::StartDecompression() {
+    if (decompressor_) {
+        return;
+    }
+    decompressor_.reset(new XmppDecompressor());
+
+    int pos = offset_ - buf_.begin();
+    string str;
+    if (!Decompress(reinterpret_cast<const uint8_t *>(buf_.data()) + pos,
+                    buf_.size() - pos, &str)) {
+        // Drop the rest of the stream, the hold timer expires eventually.
+        str.clear();
+    }
+    buf_.erase(pos);
+    buf_ += str;
+    offset_ = buf_.begin() + pos;
+}
+
+bool XmppSession::Decompress(const uint8_t *data, size_t size, string *out) {
+    uint64_t start = UTCTimestampUsec();
+    size_t out_size = out->size();
+    if (!decompressor_->Decompress(data, size, out)) {
+        return false;
+    }
+    rx_compression_stats_.usecs += UTCTimestampUsec() - start;
+    rx_compression_stats_.compressed_bytes += size;
+    rx_compression_stats_.uncompressed_bytes += out->size() - out_size;
+    return true;
+}
+
 boost::regex XmppSession::tag_to_pattern(const char *tag) {
     std::string token("</");
     token += ++tag;
@@ -177,7 +283,19 @@ bool XmppSession::Match(Buffer buffer, int *result, bool NewBuf) {
     xmsm::XmOpenConfirmState oc_state =
         connection->GetStateMcOpenConfirmState();
 
-    if (NewBuf) {
+    if (NewBuf && decompressor_) {
+        std::string str;
+        if (!Decompress(BufferData(buffer), BufferSize(buffer), &str)) {
+            *result = -1;
+            return false;
+        }
+        XmppSession::SetBuf(str);
+
+        // Only part of a compressed block may have been received.
+        if (buf_.empty()) {
+            return true;
+        }
+    } else if (NewBuf) {
         const uint8_t *cp = BufferData(buffer);
         // TODO Avoid this copy
         std::string str(cp, cp + BufferSize(buffer));
@@ -210,6 +328,32 @@ bool XmppSession::Match(Buffer buffer, int *result, bool NewBuf) {
                 m = MatchRegex(tag_known_ ? tag_to_pattern(begin_tag_.c_str()):
                                             stream_features_patt_);
             }
+        } else if ((state == xmsm::OPENCONFIRM) &&
+                   connection->IsCompressionEnabled()) {
+            // Compression is only negotiated on sessions without TLS.
+            if (connection->IsClient()) {
+                if (oc_state == xmsm::OPENCONFIRM_FEATURE_NEGOTIATION) {
+                    m = MatchRegex(tag_known_ ? end_patt_: compressed_patt_);
+                    if ((m == 0) && (tag_known_)) {
+                        StartDecompression();
+                    }
+                } else if (oc_state == xmsm::OPENCONFIRM_FEATURE_SUCCESS) {
+                    m = MatchRegex(tag_known_ ? stream_res_end_:stream_patt_);
+                } else {
+                    m = MatchRegex(tag_known_ ? tag_to_pattern(begin_tag_.c_str()):
+                                                stream_features_patt_);
+                }
+            } else {
+                if (oc_state == xmsm::OPENCONFIRM_FEATURE_SUCCESS) {
+                    m = MatchRegex(tag_known_ ? stream_res_end_:stream_patt_);
+                } else {
+                    m = MatchRegex(tag_known_ ? compress_end_patt_:
+                                                compress_patt_);
+                    if ((m == 0) && (tag_known_)) {
+                        StartDecompression();
+                    }
+                }
+            }
         } else if ((state == xmsm::OPENCONFIRM) && !(IsSslDisabled())) {
             if (connection->IsClient()) {
                 if (oc_state == xmsm::OPENCONFIRM_FEATURE_NEGOTIATION) {
@@ -7,6 +7,9 @@
 
 #include <string>
 #include <boost/regex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
 #include "io/ssl_server.h"
 #include "io/ssl_session.h"
 
@@ -14,6 +17,8 @@ class XmppServer;
 class XmppConnection;
 class XmppConnectionManager;
 class XmppRegexMock;
+class XmppCompressor;
+class XmppDecompressor;
 
 class XmppSession : public SslSession {
 public:
@@ -39,6 +44,31 @@ public:
 
     boost::system::error_code EnableTcpKeepalive(int tcp_hold_time);
 
+    // Compresses the data, once compression is started, before sending it.
+    virtual bool Send(const uint8_t *data, size_t size, size_t *sent);
+    virtual bool Send(const BufferChain &chain, size_t *sent);
+
+    // Compress all data sent after the current message.
+    void StartCompression(int level);
+    bool IsCompressionStarted() const { return compressor_.get() != NULL; }
+
+    struct CompressionStats {
+        CompressionStats() {
+            uncompressed_bytes = 0;
+            compressed_bytes = 0;
+            usecs = 0;
+        }
+        tbb::atomic<uint64_t> uncompressed_bytes;
+        tbb::atomic<uint64_t> compressed_bytes;
+        tbb::atomic<uint64_t> usecs;
+    };
+    const CompressionStats &tx_compression_stats() const {
+        return tx_compression_stats_;
+    }
+    const CompressionStats &rx_compression_stats() const {
+        return rx_compression_stats_;
+    }
+
 protected:
     std::string jid;
     virtual void OnRead(Buffer buffer);
@@ -58,6 +88,8 @@ private:
     void SetBuf(const std::string &);
     void ReplaceBuf(const std::string &);
     bool LeftOver() const;
+    void StartDecompression();
+    bool Decompress(const uint8_t *data, size_t size, std::string *out);
 
     XmppConnectionManager *manager_;
     XmppConnection *connection_;
@@ -75,6 +107,15 @@ private:
     int tcp_user_timeout_;
     bool stream_open_matched_;
 
+    // compressor_ is updated and used under compress_mutex_ as messages
+    // are sent from multiple tasks. decompressor_ is only used by the io
+    // thread reading from the session.
+    tbb::mutex compress_mutex_;
+    boost::scoped_ptr<XmppCompressor> compressor_;
+    boost::scoped_ptr<XmppDecompressor> decompressor_;
+    CompressionStats tx_compression_stats_;
+    CompressionStats rx_compression_stats_;
+
     static const boost::regex patt_;
     static const boost::regex stream_patt_;
     static const boost::regex stream_res_end_;
@@ -82,6 +123,9 @@ private:
     static const boost::regex stream_features_patt_;
     static const boost::regex starttls_patt_;
     static const boost::regex proceed_patt_;
+    static const boost::regex compress_patt_;
+    static const boost::regex compress_end_patt_;
+    static const boost::regex compressed_patt_;
     static const boost::regex end_patt_;
 
     DISALLOW_COPY_AND_ASSIGN(XmppSession);
@@ -172,6 +172,32 @@ struct EvTlsProceed : sc::event<EvTlsProceed> {
     boost::shared_ptr<const XmppStanza::XmppMessage> msg;
 };
 
+struct EvStartCompress : sc::event<EvStartCompress> {
+    EvStartCompress(XmppSession *session,
+                    const XmppStanza::XmppMessage *msg) :
+        session(session),
+        msg(static_cast<const XmppStanza::XmppStreamMessage *>(msg)) {
+    }
+    static const char *Name() {
+        return "EvStartCompress";
+    }
+    XmppSession *session;
+    boost::shared_ptr<const XmppStanza::XmppMessage> msg;
+};
+
+struct EvCompressed : sc::event<EvCompressed> {
+    EvCompressed(XmppSession *session,
+                 const XmppStanza::XmppMessage *msg) :
+        session(session),
+        msg(static_cast<const XmppStanza::XmppStreamMessage *>(msg)) {
+    }
+    static const char *Name() {
+        return "EvCompressed";
+    }
+    XmppSession *session;
+    boost::shared_ptr<const XmppStanza::XmppMessage> msg;
+};
+
 struct EvTlsHandShakeSuccess : sc::event<EvTlsHandShakeSuccess> {
     explicit EvTlsHandShakeSuccess(XmppSession *session) :
         session(session) { }
@@ -377,11 +403,14 @@ struct Active : public sc::state<Active, XmppStateMachine> {
         } else {
             XmppConnectionInfo info;
             info.set_identifier(event.msg->from);
-            if (state_machine->IsAuthEnabled()) {
+            if (state_machine->IsFeatureNegotiationEnabled()) {
                 state_machine->SendConnectionInfo(&info, event.Name(),
                                                   "Open Confirm");
                 return transit<OpenConfirm>();
             } else {
+                // A client waiting to negotiate compression takes the
+                // keepalive as the server not offering it
+                connection->SendKeepAlive();
                 connection->StartKeepAliveTimer();
                 state_machine->SendConnectionInfo(&info, event.Name(), 
                                                   "Established");
@@ -613,7 +642,7 @@ struct OpenSent : public sc::state<OpenSent, XmppStateMachine> {
             state_machine->AssignSession();
             XmppConnectionInfo info;
             info.set_identifier(event.msg->from);
-            if (state_machine->IsAuthEnabled()) {
+            if (state_machine->IsFeatureNegotiationEnabled()) {
                 state_machine->SendConnectionInfo(&info, event.Name(),
                                                   "Open Confirm");
                 return transit<OpenConfirm>();
@@ -681,9 +710,12 @@ struct OpenConfirm : public sc::state<OpenConfirm, XmppStateMachine> {
         sc::custom_reaction<EvStreamFeatureRequest>, //received by client
         sc::custom_reaction<EvStartTls>,             //received by server
         sc::custom_reaction<EvTlsProceed>,           //received by client
+        sc::custom_reaction<EvStartCompress>,        //received by server
+        sc::custom_reaction<EvCompressed>,           //received by client
         sc::custom_reaction<EvTlsHandShakeSuccess>,
         sc::custom_reaction<EvTlsHandShakeFailure>,
         sc::custom_reaction<EvXmppOpen>,             //received by server
+        sc::custom_reaction<EvXmppKeepalive>,
         sc::custom_reaction<EvStop>
     > reactions;
 
@@ -693,7 +725,7 @@ struct OpenConfirm : public sc::state<OpenConfirm, XmppStateMachine> {
         state_machine->StartHoldTimer();
         XmppConnectionInfo info;
         if (!state_machine->IsActiveChannel()) { //server
-            if (state_machine->IsAuthEnabled()) {
+            if (state_machine->IsFeatureNegotiationEnabled()) {
                 XmppConnection *connection = state_machine->connection();
                 XmppSession *session = state_machine->session();
                 if (!connection->SendStreamFeatureRequest(session)) {
@@ -761,6 +793,25 @@ struct OpenConfirm : public sc::state<OpenConfirm, XmppStateMachine> {
         // TODO, we need to have a supported stream feature list
         // and compare against the requested stream feature list
         // which will enable us to send start of various features
+        if (connection->IsCompressionEnabled()) {
+            // Set the state first, <compressed/> is matched by the session
+            // as soon as it is received.
+            state_machine->set_openconfirm_state(
+                       OPENCONFIRM_FEATURE_NEGOTIATION);
+            if (!connection->SendStartCompress(session)) {
+                connection->SendClose(session);
+                state_machine->ResetSession();
+                XmppConnectionInfo info;
+                info.set_close_reason("Send Compress Failed");
+                state_machine->SendConnectionInfo(&info, event.Name(),
+                                                  "Active");
+                return transit<Active>();
+            }
+            state_machine->StartHoldTimer();
+            state_machine->SendConnectionInfo(event.Name(),
+                "Sent Compress, OpenConfirm Feature Negotiation");
+            return discard_event();
+        }
         if (!connection->SendStartTls(session)) {
             connection->SendClose(session);
             state_machine->ResetSession();
@@ -821,6 +872,60 @@ struct OpenConfirm : public sc::state<OpenConfirm, XmppStateMachine> {
         }
     }
 
+    //received by server
+    sc::result react(const EvStartCompress &event) {
+        XmppStateMachine *state_machine = &context<XmppStateMachine>();
+        if (event.session != state_machine->session()) {
+            return discard_event();
+        }
+        SM_LOG(state_machine, "EvStartCompress in (OpenConfirm) State");
+        XmppConnection *connection = state_machine->connection();
+        XmppSession *session = state_machine->session();
+        XmppConnectionInfo info;
+        info.set_identifier(connection->GetTo());
+        // Set the state first, the compressed stream open is matched by
+        // the session as soon as it is received.
+        state_machine->set_openconfirm_state(OPENCONFIRM_FEATURE_SUCCESS);
+        if (!connection->SendCompressed(session)) {
+            connection->SendClose(session);
+            state_machine->ResetSession();
+            info.set_close_reason("Send Compressed Failed");
+            state_machine->SendConnectionInfo(&info, event.Name(), "Idle");
+            return transit<Idle>();
+        }
+        // Everything after <compressed/> is compressed
+        session->StartCompression(connection->compression_level());
+        state_machine->StartHoldTimer();
+        state_machine->SendConnectionInfo(&info, event.Name(),
+            "OpenConfirm Feature Negotiation Success");
+        return discard_event();
+    }
+
+    //received by client
+    sc::result react(const EvCompressed &event) {
+        XmppStateMachine *state_machine = &context<XmppStateMachine>();
+        if (event.session != state_machine->session()) {
+            return discard_event();
+        }
+        SM_LOG(state_machine, "EvCompressed in (OpenConfirm) State");
+        XmppConnection *connection = state_machine->connection();
+        XmppSession *session = state_machine->session();
+        session->StartCompression(connection->compression_level());
+        state_machine->set_openconfirm_state(OPENCONFIRM_FEATURE_SUCCESS);
+        if (!connection->SendOpen(session)) {
+            connection->SendClose(session);
+            state_machine->ResetSession();
+            XmppConnectionInfo info;
+            info.set_close_reason("Open send failed in OpenConfirm State");
+            state_machine->SendConnectionInfo(&info, event.Name(), "Active");
+            return transit<Active>();
+        }
+        state_machine->StartHoldTimer();
+        state_machine->SendConnectionInfo(event.Name(),
+            "OpenConfirm Feature Negotiation Success");
+        return discard_event();
+    }
+
     sc::result react(const EvStop &event) {
         XmppStateMachine *state_machine = &context<XmppStateMachine>();
         SM_LOG(state_machine, "EvStop in (OpenConfirm) State");
@@ -919,6 +1024,33 @@ struct OpenConfirm : public sc::state<OpenConfirm, XmppStateMachine> {
         }
     }
 
+    // Compression is optional (XEP-0138). A peer that does not negotiate
+    // it, as it has compression disabled or is of an older version, goes
+    // to Established after the open exchange and sends a keepalive. The
+    // stream then stays uncompressed. Not so with authentication, which
+    // requires TLS to be negotiated.
+    sc::result react(const EvXmppKeepalive &event) {
+        XmppStateMachine *state_machine = &context<XmppStateMachine>();
+        if (event.session != state_machine->session()) {
+            return discard_event();
+        }
+        if (state_machine->IsAuthEnabled() ||
+            state_machine->get_openconfirm_state() != OPENCONFIRM_INIT) {
+            return discard_event();
+        }
+        SM_LOG(state_machine, "EvXmppKeepalive in (OpenConfirm) State, "
+               "compression not negotiated");
+        XmppConnection *connection = state_machine->connection();
+        if (connection->IsActiveChannel()) { //client
+            connection->SendKeepAlive();
+        }
+        connection->StartKeepAliveTimer();
+        state_machine->StartHoldTimer();
+        state_machine->SendConnectionInfo(event.Name(),
+            "Established without compression");
+        return transit<XmppStreamEstablished>();
+    }
+
     sc::result react(const EvAdminDown &event) {
         XmppStateMachine *state_machine = &context<XmppStateMachine>();
         CloseSession(state_machine);
@@ -1369,6 +1501,24 @@ void XmppStateMachine::OnMessage(XmppSession *session,
                         break;
                 }
 
+            } else if (stream_msg->strmtype ==
+                XmppStanza::XmppStreamMessage::FEATURE_COMPRESS) {
+
+                switch (stream_msg->strmcompresstype) {
+                    case (XmppStanza::XmppStreamMessage::COMPRESS_FEATURE_REQUEST):
+                        enqueued =
+                            Enqueue(xmsm::EvStreamFeatureRequest(session, msg));
+                        break;
+                    case (XmppStanza::XmppStreamMessage::COMPRESS_START):
+                        enqueued = Enqueue(xmsm::EvStartCompress(session, msg));
+                        break;
+                    case (XmppStanza::XmppStreamMessage::COMPRESSED):
+                        enqueued = Enqueue(xmsm::EvCompressed(session, msg));
+                        break;
+                    default:
+                        break;
+                }
+
             } else if (stream_msg->strmtype ==
                 (XmppStanza::XmppStreamMessage::INIT_STREAM_HEADER ||
                  XmppStanza::XmppStreamMessage::INIT_STREAM_HEADER_RESP)) {
@@ -1492,7 +1642,15 @@ bool XmppStateMachine::IsActiveChannel() {
     return is_active_;
 }
 
-bool XmppStateMachine::logUVE() { 
+bool XmppStateMachine::IsCompressionEnabled() const {
+    return connection_->IsCompressionEnabled();
+}
+
+bool XmppStateMachine::IsFeatureNegotiationEnabled() const {
+    return auth_enabled_ || IsCompressionEnabled();
+}
+
+bool XmppStateMachine::logUVE() {
     return connection()->logUVE(); 
 }
 
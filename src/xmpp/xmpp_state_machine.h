@@ -87,6 +87,9 @@ public:
     void ResetSession();
 
     bool IsAuthEnabled() { return auth_enabled_; }
+    bool IsCompressionEnabled() const;
+    // Stream features are negotiated in OpenConfirm for TLS or compression.
+    bool IsFeatureNegotiationEnabled() const;
 
     void TimerErrorHandler(std::string name, std::string error);
 
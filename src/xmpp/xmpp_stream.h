@@ -15,7 +15,7 @@ public:
             INIT_STREAM_HEADER_RESP = 2,
             FEATURE_SASL = 3,
             FEATURE_TLS = 4,
-            FEAUTRE_COMPRESS_LZW = 5,
+            FEATURE_COMPRESS = 5,
             CLOSE_STREAM = 6
         };
 